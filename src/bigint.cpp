@@ -0,0 +1,377 @@
+#include "bigint.h"
+
+#include <algorithm>
+#include <climits>
+#include <ostream>
+#include <stdexcept>
+
+using namespace std;
+
+namespace runtime {
+
+namespace {
+
+using Limbs = std::vector<uint32_t>;
+
+// Цифры модуля без старших нулей
+struct Span {
+    const uint32_t* data;
+    size_t size;
+};
+
+Span MakeSpan(const uint32_t* data, size_t size) {
+    while (size > 0u && data[size - 1u] == 0u) {
+        --size;
+    }
+    return {data, size};
+}
+
+Span MakeSpan(const Limbs& limbs) {
+    return MakeSpan(limbs.data(), limbs.size());
+}
+
+void Trim(Limbs& limbs) {
+    while (!limbs.empty() && limbs.back() == 0u) {
+        limbs.pop_back();
+    }
+}
+
+int CompareMagnitude(Span lhs, Span rhs) {
+    if (lhs.size != rhs.size) {
+        return lhs.size < rhs.size ? -1 : 1;
+    }
+    for (size_t i = lhs.size; i-- > 0u;) {
+        if (lhs.data[i] != rhs.data[i]) {
+            return lhs.data[i] < rhs.data[i] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+Limbs AddMagnitude(Span lhs, Span rhs) {
+    if (lhs.size < rhs.size) {
+        std::swap(lhs, rhs);
+    }
+    Limbs result(lhs.size + 1u);
+    uint32_t carry = 0u;
+    for (size_t i = 0; i < lhs.size; ++i) {
+        uint32_t sum = lhs.data[i] + carry + (i < rhs.size ? rhs.data[i] : 0u);
+        carry = sum >= BigInt::BASE ? 1u : 0u;
+        result[i] = sum - carry * BigInt::BASE;
+    }
+    result[lhs.size] = carry;
+    Trim(result);
+    return result;
+}
+
+// lhs >= rhs
+Limbs SubMagnitude(Span lhs, Span rhs) {
+    Limbs result(lhs.size);
+    int64_t borrow = 0;
+    for (size_t i = 0; i < lhs.size; ++i) {
+        int64_t diff = static_cast<int64_t>(lhs.data[i]) - borrow - (i < rhs.size ? rhs.data[i] : 0u);
+        borrow = diff < 0 ? 1 : 0;
+        result[i] = static_cast<uint32_t>(diff + borrow * BigInt::BASE);
+    }
+    Trim(result);
+    return result;
+}
+
+// Прибавляет part, сдвинутое на offset цифр, к result. Ёмкости result должно хватать
+void AddShifted(Limbs& result, Span part, size_t offset) {
+    uint32_t carry = 0u;
+    size_t i = 0;
+    for (; i < part.size || carry; ++i) {
+        uint32_t sum = result[offset + i] + carry + (i < part.size ? part.data[i] : 0u);
+        carry = sum >= BigInt::BASE ? 1u : 0u;
+        result[offset + i] = sum - carry * BigInt::BASE;
+    }
+}
+
+Limbs MultiplySchoolbook(Span lhs, Span rhs) {
+    if (lhs.size == 0u || rhs.size == 0u) {
+        return {};
+    }
+    Limbs result(lhs.size + rhs.size);
+    for (size_t i = 0; i < lhs.size; ++i) {
+        uint64_t carry = 0u;
+        const uint64_t digit = lhs.data[i];
+        for (size_t j = 0; j < rhs.size; ++j) {
+            const uint64_t cur = result[i + j] + digit * rhs.data[j] + carry;
+            result[i + j] = static_cast<uint32_t>(cur % BigInt::BASE);
+            carry = cur / BigInt::BASE;
+        }
+        result[i + rhs.size] = static_cast<uint32_t>(carry);
+    }
+    Trim(result);
+    return result;
+}
+
+Limbs Multiply(Span lhs, Span rhs) {
+    if (lhs.size < rhs.size) {
+        std::swap(lhs, rhs);
+    }
+    if (rhs.size < BigInt::KARATSUBA_THRESHOLD) {
+        return MultiplySchoolbook(lhs, rhs);
+    }
+
+    // Сильно различающиеся по длине множители: длинный режется на куски длины короткого
+    if (rhs.size <= lhs.size / 2u) {
+        Limbs result(lhs.size + rhs.size + 1u);
+        for (size_t offset = 0; offset < lhs.size; offset += rhs.size) {
+            const Limbs part = Multiply(MakeSpan(lhs.data + offset, std::min(rhs.size, lhs.size - offset)), rhs);
+            AddShifted(result, MakeSpan(part), offset);
+        }
+        Trim(result);
+        return result;
+    }
+
+    // lhs = a1 * B^half + a0, rhs = b1 * B^half + b0
+    const size_t half = lhs.size / 2u;
+    const Span a0 = MakeSpan(lhs.data, half);
+    const Span a1 = MakeSpan(lhs.data + half, lhs.size - half);
+    const Span b0 = MakeSpan(rhs.data, half);
+    const Span b1 = MakeSpan(rhs.data + half, rhs.size - half);
+
+    const Limbs z0 = Multiply(a0, b0);
+    const Limbs z2 = Multiply(a1, b1);
+    const Limbs a_sum = AddMagnitude(a0, a1);
+    const Limbs b_sum = AddMagnitude(b0, b1);
+    Limbs z1 = Multiply(MakeSpan(a_sum), MakeSpan(b_sum));
+    z1 = SubMagnitude(MakeSpan(z1), MakeSpan(z0));
+    z1 = SubMagnitude(MakeSpan(z1), MakeSpan(z2));
+
+    Limbs result(lhs.size + rhs.size + 1u);
+    AddShifted(result, MakeSpan(z0), 0u);
+    AddShifted(result, MakeSpan(z1), half);
+    AddShifted(result, MakeSpan(z2), 2u * half);
+    Trim(result);
+    return result;
+}
+
+Limbs MultiplySmall(Span lhs, uint32_t factor) {
+    Limbs result(lhs.size + 1u);
+    uint64_t carry = 0u;
+    for (size_t i = 0; i < lhs.size; ++i) {
+        const uint64_t cur = static_cast<uint64_t>(lhs.data[i]) * factor + carry;
+        result[i] = static_cast<uint32_t>(cur % BigInt::BASE);
+        carry = cur / BigInt::BASE;
+    }
+    result[lhs.size] = static_cast<uint32_t>(carry);
+    Trim(result);
+    return result;
+}
+
+// Деление модулей в столбик: каждая цифра частного подбирается двоичным поиском
+Limbs DivideMagnitude(Span lhs, Span rhs) {
+    if (CompareMagnitude(lhs, rhs) < 0) {
+        return {};
+    }
+    Limbs quotient(lhs.size);
+    if (rhs.size == 1u) {
+        uint64_t remainder = 0u;
+        for (size_t i = lhs.size; i-- > 0u;) {
+            const uint64_t cur = remainder * BigInt::BASE + lhs.data[i];
+            quotient[i] = static_cast<uint32_t>(cur / rhs.data[0]);
+            remainder = cur % rhs.data[0];
+        }
+        Trim(quotient);
+        return quotient;
+    }
+
+    Limbs remainder;
+    for (size_t i = lhs.size; i-- > 0u;) {
+        remainder.insert(remainder.begin(), lhs.data[i]);
+        Trim(remainder);
+        uint32_t low = 0u;
+        uint32_t high = BigInt::BASE - 1u;
+        while (low < high) {
+            const uint32_t mid = low + (high - low + 1u) / 2u;
+            if (CompareMagnitude(MakeSpan(MultiplySmall(rhs, mid)), MakeSpan(remainder)) <= 0) {
+                low = mid;
+            }
+            else {
+                high = mid - 1u;
+            }
+        }
+        quotient[i] = low;
+        if (low) {
+            remainder = SubMagnitude(MakeSpan(remainder), MakeSpan(MultiplySmall(rhs, low)));
+        }
+    }
+    Trim(quotient);
+    return quotient;
+}
+
+}  // namespace
+
+BigInt::BigInt(int64_t value) : m_negative(value < 0) {
+    uint64_t magnitude = m_negative ? 0u - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+    while (magnitude) {
+        m_limbs.push_back(static_cast<uint32_t>(magnitude % BASE));
+        magnitude /= BASE;
+    }
+}
+
+BigInt::BigInt(Limbs limbs, bool negative) : m_limbs(std::move(limbs)), m_negative(negative) {
+    Normalize();
+}
+
+void BigInt::Normalize() {
+    Trim(m_limbs);
+    if (m_limbs.empty()) {
+        m_negative = false;
+    }
+}
+
+BigInt BigInt::FromString(const std::string& text) {
+    const bool negative = !text.empty() && text[0] == '-';
+    const size_t first = negative ? 1u : 0u;
+    if (first == text.size() || !std::all_of(text.begin() + first, text.end(), [](char ch) { return ch >= '0' && ch <= '9'; })) {
+        throw std::invalid_argument("Not an integer: "s + text);
+    }
+    Limbs limbs;
+    for (size_t end = text.size(); end > first;) {
+        const size_t begin = end >= first + BASE_DIGITS ? end - BASE_DIGITS : first;
+        uint32_t limb = 0u;
+        for (size_t i = begin; i < end; ++i) {
+            limb = limb * 10u + static_cast<uint32_t>(text[i] - '0');
+        }
+        limbs.push_back(limb);
+        end = begin;
+    }
+    return BigInt(std::move(limbs), negative);
+}
+
+bool BigInt::IsZero() const {
+    return m_limbs.empty();
+}
+
+bool BigInt::IsNegative() const {
+    return m_negative;
+}
+
+bool BigInt::FitsInt() const {
+    if (m_limbs.size() > 2u) {
+        return false;
+    }
+    int64_t magnitude = 0;
+    for (size_t i = m_limbs.size(); i-- > 0u;) {
+        magnitude = magnitude * BASE + m_limbs[i];
+    }
+    return m_negative ? -magnitude >= INT_MIN : magnitude <= INT_MAX;
+}
+
+int BigInt::ToInt() const {
+    int64_t magnitude = 0;
+    for (size_t i = m_limbs.size(); i-- > 0u;) {
+        magnitude = magnitude * BASE + m_limbs[i];
+    }
+    return static_cast<int>(m_negative ? -magnitude : magnitude);
+}
+
+bool BigInt::FitsInt64() const {
+    static const BigInt min_value(INT64_MIN);
+    static const BigInt max_value(INT64_MAX);
+    return m_limbs.size() <= 2u || (min_value <= *this && *this <= max_value);
+}
+
+int64_t BigInt::ToInt64() const {
+    // Модуль INT64_MIN не помещается в int64_t, поэтому накапливаем его беззнаково
+    uint64_t magnitude = 0u;
+    for (size_t i = m_limbs.size(); i-- > 0u;) {
+        magnitude = magnitude * BASE + m_limbs[i];
+    }
+    return static_cast<int64_t>(m_negative ? 0u - magnitude : magnitude);
+}
+
+std::string BigInt::ToString() const {
+    if (m_limbs.empty()) {
+        return "0"s;
+    }
+    std::string result = (m_negative ? "-"s : ""s) + std::to_string(m_limbs.back());
+    result.reserve(result.size() + (m_limbs.size() - 1u) * BASE_DIGITS);
+    char digits[BASE_DIGITS];
+    for (size_t i = m_limbs.size() - 1u; i-- > 0u;) {
+        uint32_t limb = m_limbs[i];
+        for (size_t d = BASE_DIGITS; d-- > 0u;) {
+            digits[d] = static_cast<char>('0' + limb % 10u);
+            limb /= 10u;
+        }
+        result.append(digits, BASE_DIGITS);
+    }
+    return result;
+}
+
+size_t BigInt::LimbCount() const {
+    return m_limbs.size();
+}
+
+BigInt operator+(const BigInt& lhs, const BigInt& rhs) {
+    const Span l = MakeSpan(lhs.m_limbs);
+    const Span r = MakeSpan(rhs.m_limbs);
+    if (lhs.m_negative == rhs.m_negative) {
+        return BigInt(AddMagnitude(l, r), lhs.m_negative);
+    }
+    if (CompareMagnitude(l, r) >= 0) {
+        return BigInt(SubMagnitude(l, r), lhs.m_negative);
+    }
+    return BigInt(SubMagnitude(r, l), rhs.m_negative);
+}
+
+BigInt BigInt::operator-() const {
+    return BigInt(m_limbs, !m_negative);
+}
+
+BigInt operator-(const BigInt& lhs, const BigInt& rhs) {
+    return lhs + (-rhs);
+}
+
+BigInt operator*(const BigInt& lhs, const BigInt& rhs) {
+    return BigInt(Multiply(MakeSpan(lhs.m_limbs), MakeSpan(rhs.m_limbs)), lhs.m_negative != rhs.m_negative);
+}
+
+BigInt operator/(const BigInt& lhs, const BigInt& rhs) {
+    if (rhs.IsZero()) {
+        throw std::runtime_error("Division by zero"s);
+    }
+    return BigInt(DivideMagnitude(MakeSpan(lhs.m_limbs), MakeSpan(rhs.m_limbs)), lhs.m_negative != rhs.m_negative);
+}
+
+BigInt BigInt::MultiplySchoolbook(const BigInt& lhs, const BigInt& rhs) {
+    return BigInt(runtime::MultiplySchoolbook(MakeSpan(lhs.m_limbs), MakeSpan(rhs.m_limbs)), lhs.m_negative != rhs.m_negative);
+}
+
+bool operator==(const BigInt& lhs, const BigInt& rhs) {
+    return lhs.m_negative == rhs.m_negative && lhs.m_limbs == rhs.m_limbs;
+}
+
+bool operator<(const BigInt& lhs, const BigInt& rhs) {
+    if (lhs.m_negative != rhs.m_negative) {
+        return lhs.m_negative;
+    }
+    const int cmp = CompareMagnitude(MakeSpan(lhs.m_limbs), MakeSpan(rhs.m_limbs));
+    return lhs.m_negative ? cmp > 0 : cmp < 0;
+}
+
+bool operator!=(const BigInt& lhs, const BigInt& rhs) {
+    return !(lhs == rhs);
+}
+
+bool operator>(const BigInt& lhs, const BigInt& rhs) {
+    return rhs < lhs;
+}
+
+bool operator<=(const BigInt& lhs, const BigInt& rhs) {
+    return !(rhs < lhs);
+}
+
+bool operator>=(const BigInt& lhs, const BigInt& rhs) {
+    return !(lhs < rhs);
+}
+
+std::ostream& operator<<(std::ostream& os, const BigInt& value) {
+    return os << value.ToString();
+}
+
+}  // namespace runtime
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace runtime {
+
+/*
+ * Целое число произвольной точности.
+ *
+ * Модуль хранится цифрами по основанию 10^9 от младшей к старшей, знак - отдельно.
+ * Десятичное основание позволяет переводить число в строку за линейное время: каждая цифра
+ * выводится девятью десятичными знаками. Умножение длинных чисел выполняется алгоритмом Карацубы,
+ * коротких - в столбик (порог KARATSUBA_THRESHOLD цифр). Деление - с отбрасыванием дробной части,
+ * как у встроенного целочисленного деления.
+ */
+class BigInt {
+public:
+    static constexpr uint32_t BASE = 1000000000u;
+    static constexpr size_t BASE_DIGITS = 9u;
+    static constexpr size_t KARATSUBA_THRESHOLD = 32u;
+
+    BigInt() = default;
+    BigInt(int64_t value);
+
+    // Разбирает десятичную запись с необязательным знаком минус
+    static BigInt FromString(const std::string& text);
+
+    [[nodiscard]] bool IsZero() const;
+    [[nodiscard]] bool IsNegative() const;
+
+    // Помещается ли значение в int
+    [[nodiscard]] bool FitsInt() const;
+    // Значение в виде int. Число должно помещаться в int
+    [[nodiscard]] int ToInt() const;
+    // Помещается ли значение в int64_t
+    [[nodiscard]] bool FitsInt64() const;
+    // Значение в виде int64_t. Число должно помещаться в int64_t
+    [[nodiscard]] int64_t ToInt64() const;
+
+    [[nodiscard]] std::string ToString() const;
+
+    // Число цифр по основанию 10^9
+    [[nodiscard]] size_t LimbCount() const;
+
+    friend BigInt operator+(const BigInt& lhs, const BigInt& rhs);
+    friend BigInt operator-(const BigInt& lhs, const BigInt& rhs);
+    friend BigInt operator*(const BigInt& lhs, const BigInt& rhs);
+    // Бросает std::runtime_error при делении на ноль
+    friend BigInt operator/(const BigInt& lhs, const BigInt& rhs);
+
+    BigInt operator-() const;
+
+    friend bool operator==(const BigInt& lhs, const BigInt& rhs);
+    friend bool operator<(const BigInt& lhs, const BigInt& rhs);
+
+    // Умножение в столбик без перехода к алгоритму Карацубы, для проверки и замеров
+    static BigInt MultiplySchoolbook(const BigInt& lhs, const BigInt& rhs);
+
+private:
+    using Limbs = std::vector<uint32_t>;
+
+    BigInt(Limbs limbs, bool negative);
+    void Normalize();
+
+    Limbs m_limbs;
+    bool m_negative = false;
+};
+
+bool operator!=(const BigInt& lhs, const BigInt& rhs);
+bool operator>(const BigInt& lhs, const BigInt& rhs);
+bool operator<=(const BigInt& lhs, const BigInt& rhs);
+bool operator>=(const BigInt& lhs, const BigInt& rhs);
+
+std::ostream& operator<<(std::ostream& os, const BigInt& value);
+
+}  // namespace runtime
@@ -0,0 +1,129 @@
+#include "bigint.h"
+#include "lexer.h"
+#include "parse.h"
+#include "runtime.h"
+#include "statement.h"
+#include "test_runner_p.h"
+
+#include <climits>
+#include <random>
+#include <sstream>
+#include <string>
+
+using namespace std;
+
+namespace runtime {
+
+namespace {
+
+string RandomDigits(mt19937& generator, size_t count) {
+    uniform_int_distribution<int> digit('0', '9');
+    string result(count, '0');
+    for (char& ch : result) {
+        ch = static_cast<char>(digit(generator));
+    }
+    result[0] = '1';
+    return result;
+}
+
+void TestBigIntStringRoundTrip() {
+    for (const string& text : {"0"s, "7"s, "-7"s, "1000000000"s, "999999999"s, "-123456789012345678901234567890"s}) {
+        ASSERT_EQUAL(BigInt::FromString(text).ToString(), text);
+    }
+    ASSERT_EQUAL(BigInt(INT64_MIN).ToString(), "-9223372036854775808"s);
+    ASSERT_EQUAL(BigInt::FromString("-0"s).ToString(), "0"s);
+
+    mt19937 generator(42);
+    const string huge = RandomDigits(generator, 100000u);
+    ASSERT_EQUAL(BigInt::FromString(huge).ToString(), huge);
+}
+
+void TestBigIntArithmetic() {
+    const BigInt a = BigInt::FromString("123456789012345678901234567890"s);
+    const BigInt b = BigInt::FromString("-987654321098765432109876543210"s);
+    ASSERT_EQUAL((a + b).ToString(), "-864197532086419753208641975320"s);
+    ASSERT_EQUAL((a - b).ToString(), "1111111110111111111011111111100"s);
+    ASSERT_EQUAL((a * b).ToString(), "-121932631137021795226185032733622923332237463801111263526900"s);
+    ASSERT_EQUAL((b / a).ToString(), "-8"s);
+    ASSERT_EQUAL((a * b / b).ToString(), a.ToString());
+    ASSERT_EQUAL((BigInt(7) / BigInt(-2)).ToString(), "-3"s);
+    ASSERT(a - a == BigInt(0));
+    ASSERT(b < a);
+    ASSERT(-a < a);
+    ASSERT(BigInt(INT_MAX).FitsInt());
+    ASSERT(BigInt(INT_MIN).FitsInt());
+    ASSERT(!BigInt(int64_t{INT_MAX} + 1).FitsInt());
+    ASSERT_EQUAL(BigInt(INT_MIN).ToInt(), INT_MIN);
+
+    try {
+        [[maybe_unused]] BigInt q = a / BigInt(0);
+        ASSERT(false);
+    }
+    catch (const std::runtime_error&) {
+    }
+}
+
+void TestKaratsubaMatchesSchoolbook() {
+    mt19937 generator(7);
+    for (const auto& [lhs_digits, rhs_digits] : {pair{900u, 900u}, pair{2000u, 700u}, pair{5000u, 300u}, pair{3001u, 2999u}}) {
+        const BigInt lhs = BigInt::FromString(RandomDigits(generator, lhs_digits));
+        const BigInt rhs = -BigInt::FromString(RandomDigits(generator, rhs_digits));
+        ASSERT(lhs * rhs == BigInt::MultiplySchoolbook(lhs, rhs));
+        ASSERT((lhs * rhs) / rhs == lhs);
+    }
+}
+
+void TestNumberPromotesOnOverflow() {
+    DummyContext context;
+    Closure closure;
+
+    ObjectHolder product = ast::Mult(make_unique<ast::NumericConst>(INT_MAX), make_unique<ast::NumericConst>(4)).Execute(closure, context);
+    ASSERT(product.TryAs<BigNumber>() != nullptr);
+    ASSERT_EQUAL(product.TryAs<BigNumber>()->GetValue().ToString(), "8589934588"s);
+
+    closure["big"s] = product;
+    ObjectHolder back = ast::Div(make_unique<ast::VariableValue>("big"s), make_unique<ast::NumericConst>(4)).Execute(closure, context);
+    ASSERT(back.TryAs<Number>() != nullptr);
+    ASSERT_EQUAL(back.TryAs<Number>()->GetValue(), INT_MAX);
+
+    ObjectHolder sum = ast::Add(make_unique<ast::NumericConst>(INT_MAX), make_unique<ast::NumericConst>(1)).Execute(closure, context);
+    ObjectHolder difference = ast::Sub(make_unique<ast::NumericConst>(INT_MIN), make_unique<ast::NumericConst>(1)).Execute(closure, context);
+    ostringstream out;
+    sum->Print(out, context);
+    out << ' ';
+    difference->Print(out, context);
+    ASSERT_EQUAL(out.str(), "2147483648 -2147483649"s);
+
+    ASSERT(Less(ObjectHolder::Own(Number(5)), sum, context));
+    ASSERT(Greater(sum, difference, context));
+    ASSERT(Equal(product, ObjectHolder::Own(BigNumber(BigInt(8589934588))), context));
+    ASSERT(IsTrue(sum));
+
+    // Небольшие результаты остаются обычными Number
+    ObjectHolder small = ast::Add(make_unique<ast::NumericConst>(2), make_unique<ast::NumericConst>(3)).Execute(closure, context);
+    ASSERT(small.TryAs<Number>() != nullptr);
+}
+
+// Литерал больше INT_MAX разбирается в BigNumber, а не обрывает лексический анализ
+void TestOversizedIntegerLiteral() {
+    istringstream input("x = 3000000000\nprint x, x - 1000000000, -2147483648, 123456789012345678901234567890\n"s);
+    parse::Lexer lexer(input);
+    auto program = ParseProgram(lexer);
+    DummyContext context;
+    Closure closure;
+    program->Execute(closure, context);
+    ASSERT_EQUAL(context.output.str(), "3000000000 2000000000 -2147483648 123456789012345678901234567890\n"s);
+    ASSERT(closure.at("x"s).TryAs<BigNumber>() != nullptr);
+}
+
+}  // namespace
+
+void RunBigIntTests(TestRunner& tr) {
+    RUN_TEST(tr, runtime::TestBigIntStringRoundTrip);
+    RUN_TEST(tr, runtime::TestBigIntArithmetic);
+    RUN_TEST(tr, runtime::TestKaratsubaMatchesSchoolbook);
+    RUN_TEST(tr, runtime::TestNumberPromotesOnOverflow);
+    RUN_TEST(tr, runtime::TestOversizedIntegerLiteral);
+}
+
+}  // namespace runtime
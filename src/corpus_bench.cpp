@@ -0,0 +1,296 @@
+#include "lexer.h"
+#include "parse.h"
+#include "runtime.h"
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+/*
+ * Сквозной бенчмарк интерпретатора на корпусе Mython-программ (файлы .my в каталоге bench/corpus).
+ * Каждая программа запускается --runs раз, каждый запуск - в отдельном дочернем процессе,
+ * чтобы пиковое потребление памяти (peak RSS) измерялось независимо для каждого запуска.
+ * Дочерний процесс заново запускает этот же исполняемый файл (exec), поэтому peak RSS - это память
+ * самого интерпретатора, без страниц процесса бенчмарка, унаследованных при fork.
+ * Время запуска - это разбор и выполнение программы, вывод направляется в /dev/null.
+ *
+ * Параметры командной строки:
+ *   --corpus <каталог>        каталог с программами *.my (по умолчанию bench/corpus)
+ *   --runs <N>                число запусков каждой программы (по умолчанию 10)
+ *   --baseline <файл>         сравнить результаты с сохранённым базовым файлом
+ *   --threshold <проценты>    допустимое ухудшение медианы и peak RSS (по умолчанию 10)
+ *   --save-baseline <файл>    сохранить результаты как новый базовый файл
+ *
+ * Если хотя бы одна программа превысила базовое значение больше чем на threshold процентов,
+ * программа завершается с кодом 1. Время и память зависят от машины и типа сборки, поэтому базовый
+ * файл сравним только с запусками на той же машине: после смены машины или компилятора его нужно
+ * пересохранить через --save-baseline.
+ *
+ * Служебный режим дочернего процесса: --run-one <файл> выполняет одну программу и выводит в stdout
+ * "<время ns> <peak RSS KiB>".
+ */
+
+namespace {
+
+struct RunResult {
+    bool ok = false;
+    int64_t elapsed_ns = 0;
+    int64_t peak_rss_kb = 0;
+};
+
+struct ProgramResult {
+    std::string name;
+    int64_t median_ns = 0;
+    int64_t p95_ns = 0;
+    int64_t peak_rss_kb = 0;
+};
+
+// Пиковый RSS текущего процесса (VmHWM), KiB
+int64_t PeakRssKb() {
+    std::ifstream status("/proc/self/status"s);
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.rfind("VmHWM:"s, 0) == 0) {
+            return std::stoll(line.substr(6));
+        }
+    }
+    return 0;
+}
+
+// Тело дочернего процесса: разбирает и выполняет program, выводит время и peak RSS
+int RunProgram(const std::filesystem::path& program) {
+    try {
+        std::ifstream input(program, std::ios::binary);
+        std::ofstream output("/dev/null"s);
+        const auto start = std::chrono::steady_clock::now();
+
+        parse::Lexer lexer(input);
+        auto tree = ParseProgram(lexer);
+        runtime::SimpleContext context{output};
+        runtime::Closure closure;
+        tree->Execute(closure, context);
+        output.flush();
+
+        const int64_t elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        std::cout << elapsed_ns << ' ' << PeakRssKb() << std::endl;
+        return 0;
+    }
+    catch (const std::exception& e) {
+        std::cerr << program.filename().string() << ": " << e.what() << std::endl;
+        return 1;
+    }
+}
+
+RunResult RunOnce(const char* self, const std::filesystem::path& program) {
+    int pipe_fds[2];
+    if (pipe(pipe_fds) != 0) {
+        throw std::runtime_error("pipe() failed"s);
+    }
+
+    const pid_t pid = fork();
+    if (pid < 0) {
+        throw std::runtime_error("fork() failed"s);
+    }
+    if (pid == 0) {
+        close(pipe_fds[0]);
+        dup2(pipe_fds[1], STDOUT_FILENO);
+        close(pipe_fds[1]);
+        execl("/proc/self/exe", self, "--run-one", program.c_str(), static_cast<char*>(nullptr));
+        _exit(127);
+    }
+
+    close(pipe_fds[1]);
+    std::string report;
+    char buffer[64];
+    ssize_t count = 0;
+    while ((count = read(pipe_fds[0], buffer, sizeof(buffer))) > 0) {
+        report.append(buffer, static_cast<size_t>(count));
+    }
+    close(pipe_fds[0]);
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+
+    RunResult result;
+    std::istringstream fields(report);
+    result.ok = static_cast<bool>(fields >> result.elapsed_ns >> result.peak_rss_kb) && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    return result;
+}
+
+int64_t Percentile(std::vector<int64_t> values, double fraction) {
+    std::sort(values.begin(), values.end());
+    const size_t index = static_cast<size_t>(fraction * (values.size() - 1u) + 0.5);
+    return values[std::min(index, values.size() - 1u)];
+}
+
+// Формат базового файла: по строке на программу "<имя> <медиана ns> <p95 ns> <peak RSS KiB>"
+std::map<std::string, ProgramResult> LoadBaseline(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+        throw std::runtime_error("Cannot open baseline file "s + path);
+    }
+    std::map<std::string, ProgramResult> baseline;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::istringstream row(line);
+        ProgramResult result;
+        if (row >> result.name >> result.median_ns >> result.p95_ns >> result.peak_rss_kb) {
+            baseline[result.name] = result;
+        }
+    }
+    return baseline;
+}
+
+void SaveBaseline(const std::string& path, const std::vector<ProgramResult>& results) {
+    std::ofstream out(path);
+    if (!out) {
+        throw std::runtime_error("Cannot write baseline file "s + path);
+    }
+    out << "# Values depend on the machine and build type: regenerate with --save-baseline before comparing elsewhere\n";
+    out << "# program median_ns p95_ns peak_rss_kb\n";
+    for (const ProgramResult& result : results) {
+        out << result.name << ' ' << result.median_ns << ' ' << result.p95_ns << ' ' << result.peak_rss_kb << '\n';
+    }
+}
+
+// Разбирает text целиком как неотрицательное десятичное число
+template <typename T>
+bool ParseNonNegative(std::string_view text, T& value) {
+    const char* end = text.data() + text.size();
+    const auto [ptr, ec] = std::from_chars(text.data(), end, value);
+    return ec == std::errc{} && ptr == end && value >= T{};
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc == 3 && argv[1] == "--run-one"s) {
+        return RunProgram(argv[2]);
+    }
+
+    auto usage = [argv] {
+        std::cerr << "Usage: " << argv[0] << " [--corpus <dir>] [--runs <N>] [--baseline <file>] [--threshold <percent>] [--save-baseline <file>]" << std::endl;
+        return 1;
+    };
+
+    std::string corpus = "bench/corpus"s;
+    std::string baseline_path;
+    std::string save_path;
+    size_t runs = 10u;
+    double threshold = 10.0;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (arg == "--corpus"s && has_value) {
+            corpus = argv[++i];
+        }
+        else if (arg == "--runs"s && has_value) {
+            if (!ParseNonNegative(argv[++i], runs)) {
+                return usage();
+            }
+            runs = std::max<size_t>(runs, 1u);
+        }
+        else if (arg == "--baseline"s && has_value) {
+            baseline_path = argv[++i];
+        }
+        else if (arg == "--threshold"s && has_value) {
+            if (!ParseNonNegative(argv[++i], threshold)) {
+                return usage();
+            }
+        }
+        else if (arg == "--save-baseline"s && has_value) {
+            save_path = argv[++i];
+        }
+        else {
+            return usage();
+        }
+    }
+
+    try {
+        std::vector<std::filesystem::path> programs;
+        for (const auto& entry : std::filesystem::directory_iterator(corpus)) {
+            if (entry.path().extension() == ".my"s) {
+                programs.push_back(entry.path());
+            }
+        }
+        std::sort(programs.begin(), programs.end());
+
+        std::vector<ProgramResult> results;
+        bool failed = false;
+        std::cout << std::left << std::setw(20) << "program" << std::right << std::setw(14) << "median_ms" << std::setw(14) << "p95_ms" << std::setw(16) << "peak_rss_kb" << '\n';
+        for (const auto& program : programs) {
+            std::vector<int64_t> times;
+            ProgramResult result;
+            result.name = program.stem().string();
+            for (size_t run = 0; run < runs; ++run) {
+                const RunResult run_result = RunOnce(argv[0], program);
+                if (!run_result.ok) {
+                    failed = true;
+                    break;
+                }
+                times.push_back(run_result.elapsed_ns);
+                result.peak_rss_kb = std::max(result.peak_rss_kb, run_result.peak_rss_kb);
+            }
+            if (times.size() != runs) {
+                std::cout << std::left << std::setw(20) << result.name << " FAILED\n";
+                continue;
+            }
+            result.median_ns = Percentile(times, 0.5);
+            result.p95_ns = Percentile(times, 0.95);
+            results.push_back(result);
+
+            std::cout << std::left << std::setw(20) << result.name << std::right << std::fixed << std::setprecision(3)
+                      << std::setw(14) << result.median_ns / 1e6 << std::setw(14) << result.p95_ns / 1e6
+                      << std::setw(16) << result.peak_rss_kb << '\n';
+        }
+
+        if (!baseline_path.empty()) {
+            const std::map<std::string, ProgramResult> baseline = LoadBaseline(baseline_path);
+            const double limit = 1.0 + threshold / 100.0;
+            for (const ProgramResult& result : results) {
+                auto it = baseline.find(result.name);
+                if (it == baseline.end()) {
+                    std::cout << result.name << ": no baseline\n";
+                    continue;
+                }
+                const ProgramResult& base = it->second;
+                if (result.median_ns > base.median_ns * limit) {
+                    std::cout << "REGRESSION " << result.name << ": median " << result.median_ns / 1e6 << " ms vs baseline " << base.median_ns / 1e6 << " ms\n";
+                    failed = true;
+                }
+                if (result.peak_rss_kb > base.peak_rss_kb * limit) {
+                    std::cout << "REGRESSION " << result.name << ": peak RSS " << result.peak_rss_kb << " KiB vs baseline " << base.peak_rss_kb << " KiB\n";
+                    failed = true;
+                }
+            }
+        }
+
+        if (!save_path.empty()) {
+            SaveBaseline(save_path, results);
+        }
+        return failed ? 1 : 0;
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+}
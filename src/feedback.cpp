@@ -0,0 +1,204 @@
+#include "feedback.h"
+
+#include "int_array.h"
+
+#include <algorithm>
+#include <fstream>
+#include <istream>
+#include <ostream>
+#include <sstream>
+
+using namespace std;
+
+namespace runtime {
+
+namespace {
+
+TypeFeedback* recording_feedback = nullptr;
+const TypeFeedback* applied_feedback = nullptr;
+
+const string HEADER = "mython-feedback 1"s;
+
+}  // namespace
+
+TypeFeedback* TypeFeedback::Recording() {
+    return recording_feedback;
+}
+
+void TypeFeedback::SetRecording(TypeFeedback* feedback) {
+    recording_feedback = feedback;
+}
+
+const TypeFeedback* TypeFeedback::Applied() {
+    return applied_feedback;
+}
+
+void TypeFeedback::SetApplied(const TypeFeedback* feedback) {
+    applied_feedback = feedback;
+}
+
+uint8_t TypeFeedback::KindOf(const ObjectHolder& value) {
+    if (!value) {
+        return KIND_NONE;
+    }
+    if (value.TryAs<Number>()) {
+        return KIND_NUMBER;
+    }
+    if (value.TryAs<ClassInstance>()) {
+        return KIND_INSTANCE;
+    }
+    if (value.TryAs<String>()) {
+        return KIND_STRING;
+    }
+    if (value.TryAs<Bool>()) {
+        return KIND_BOOL;
+    }
+    if (value.TryAs<BigNumber>()) {
+        return KIND_BIG_NUMBER;
+    }
+    if (value.TryAs<IntArray>()) {
+        return KIND_INT_ARRAY;
+    }
+    return KIND_OTHER;
+}
+
+void TypeFeedback::RecordOperands(uint32_t site, const ObjectHolder& lhs, const ObjectHolder& rhs) {
+    OperatorSite& entry = m_operators[site];
+    entry.lhs_kinds |= KindOf(lhs);
+    entry.rhs_kinds |= KindOf(rhs);
+}
+
+void TypeFeedback::RecordReceiver(uint32_t site, const Class& cls) {
+    CallSite& entry = m_calls[site];
+    ++entry.calls;
+    if (entry.megamorphic || find(entry.receivers.begin(), entry.receivers.end(), cls.GetName()) != entry.receivers.end()) {
+        return;
+    }
+    if (entry.receivers.size() == MAX_RECEIVERS) {
+        entry.megamorphic = true;
+        return;
+    }
+    entry.receivers.push_back(cls.GetName());
+}
+
+void TypeFeedback::RecordMethodCall(const Class& cls, const Method& method) {
+    auto [it, inserted] = m_methods.try_emplace(&method);
+    if (inserted) {
+        it->second.class_name = cls.GetName();
+        it->second.method_name = method.name;
+    }
+    ++it->second.calls;
+}
+
+const TypeFeedback::OperatorSite* TypeFeedback::FindOperator(uint32_t site) const {
+    const auto it = m_operators.find(site);
+    return it == m_operators.end() ? nullptr : &it->second;
+}
+
+const TypeFeedback::CallSite* TypeFeedback::FindCall(uint32_t site) const {
+    const auto it = m_calls.find(site);
+    return it == m_calls.end() ? nullptr : &it->second;
+}
+
+vector<TypeFeedback::HotMethod> TypeFeedback::HotMethods(size_t limit) const {
+    vector<HotMethod> result = m_loaded_methods;
+    for (const auto& [method, entry] : m_methods) {
+        result.push_back(entry);
+    }
+    sort(result.begin(), result.end(), [](const HotMethod& lhs, const HotMethod& rhs) {
+        return tie(rhs.calls, lhs.class_name, lhs.method_name) < tie(lhs.calls, rhs.class_name, rhs.method_name);
+    });
+    result.resize(min(limit, result.size()));
+    return result;
+}
+
+void TypeFeedback::Write(ostream& output, uint64_t source_hash) const {
+    output << HEADER << '\n' << "source " << hex << source_hash << dec << '\n';
+
+    // Точки выводятся по возрастанию номеров, чтобы профиль одного и того же запуска не зависел от хеш-таблиц
+    vector<pair<uint32_t, OperatorSite>> operators(m_operators.begin(), m_operators.end());
+    sort(operators.begin(), operators.end(), [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+    for (const auto& [site, entry] : operators) {
+        output << "op " << site << ' ' << static_cast<unsigned>(entry.lhs_kinds) << ' ' << static_cast<unsigned>(entry.rhs_kinds) << '\n';
+    }
+    vector<pair<uint32_t, CallSite>> calls(m_calls.begin(), m_calls.end());
+    sort(calls.begin(), calls.end(), [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+    for (const auto& [site, entry] : calls) {
+        output << "call " << site << ' ' << entry.calls << ' ' << (entry.megamorphic ? 1 : 0);
+        for (const string& receiver : entry.receivers) {
+            output << ' ' << receiver;
+        }
+        output << '\n';
+    }
+    for (const HotMethod& method : HotMethods(m_methods.size() + m_loaded_methods.size())) {
+        output << "method " << method.calls << ' ' << method.class_name << ' ' << method.method_name << '\n';
+    }
+}
+
+void TypeFeedback::WriteToFile(const string& path, uint64_t source_hash) const {
+    ofstream output(path);
+    Write(output, source_hash);
+    if (!output.flush()) {
+        throw FeedbackError("Cannot write feedback profile "s + path);
+    }
+}
+
+optional<TypeFeedback> TypeFeedback::Read(istream& input, uint64_t source_hash) {
+    string line;
+    if (!getline(input, line) || line != HEADER) {
+        throw FeedbackError("Not a Mython feedback profile"s);
+    }
+    uint64_t hash = 0u;
+    if (!getline(input, line) || !(istringstream(line) >> line >> hex >> hash)) {
+        throw FeedbackError("Malformed feedback profile header"s);
+    }
+    if (hash != source_hash) {
+        return nullopt;
+    }
+
+    TypeFeedback result;
+    while (getline(input, line)) {
+        istringstream fields(line);
+        string kind;
+        fields >> kind;
+        bool parsed = true;
+        if (kind == "op"s) {
+            uint32_t site = 0u;
+            unsigned lhs = 0u;
+            unsigned rhs = 0u;
+            parsed = static_cast<bool>(fields >> site >> lhs >> rhs);
+            result.m_operators[site] = {static_cast<uint8_t>(lhs), static_cast<uint8_t>(rhs)};
+        }
+        else if (kind == "call"s) {
+            uint32_t site = 0u;
+            CallSite entry;
+            parsed = static_cast<bool>(fields >> site >> entry.calls >> entry.megamorphic);
+            for (string receiver; fields >> receiver;) {
+                entry.receivers.push_back(std::move(receiver));
+            }
+            result.m_calls[site] = std::move(entry);
+        }
+        else if (kind == "method"s) {
+            HotMethod entry;
+            parsed = static_cast<bool>(fields >> entry.calls >> entry.class_name >> entry.method_name);
+            result.m_loaded_methods.push_back(std::move(entry));
+        }
+        else if (!kind.empty()) {
+            throw FeedbackError("Unknown feedback profile entry: "s + line);
+        }
+        if (!parsed) {
+            throw FeedbackError("Malformed feedback profile entry: "s + line);
+        }
+    }
+    return result;
+}
+
+optional<TypeFeedback> TypeFeedback::ReadFromFile(const string& path, uint64_t source_hash) {
+    ifstream input(path);
+    if (!input) {
+        throw FeedbackError("Cannot open feedback profile "s + path);
+    }
+    return Read(input, source_hash);
+}
+
+}  // namespace runtime
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "runtime.h"
+
+#include <cstdint>
+#include <iosfwd>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace runtime {
+
+struct FeedbackError : std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
+/*
+ * Профиль обратной связи о типах для специализации следующего запуска.
+ *
+ * Точки наблюдения - узлы операторов (+, -, *, /, сравнения) и вызовов методов. Parser нумерует их
+ * с единицы в порядке создания, поэтому для одного и того же текста номера совпадают между запусками;
+ * профиль привязан к тексту хешем SourceHash. Во время выполнения узлы записывают в профиль
+ * Recording() виды операндов и классы получателей, а ClassInstance::Call - число вызовов методов.
+ * При разборе с профилем Applied() узлы получают подсказку о виде левого операнда, а кэши вызовов
+ * с единственным классом получателя заполняются заранее.
+ */
+class TypeFeedback {
+public:
+    // Виды значений. Наблюдения по точке накапливаются битовой маской
+    enum ValueKind : uint8_t {
+        KIND_NONE = 1u << 0,
+        KIND_NUMBER = 1u << 1,
+        KIND_BIG_NUMBER = 1u << 2,
+        KIND_STRING = 1u << 3,
+        KIND_BOOL = 1u << 4,
+        KIND_INT_ARRAY = 1u << 5,
+        KIND_INSTANCE = 1u << 6,
+        KIND_OTHER = 1u << 7,
+    };
+
+    struct OperatorSite {
+        uint8_t lhs_kinds = 0u;
+        uint8_t rhs_kinds = 0u;
+    };
+
+    struct CallSite {
+        uint64_t calls = 0u;
+        // Имена классов получателей в порядке появления, не больше MAX_RECEIVERS
+        std::vector<std::string> receivers;
+        bool megamorphic = false;
+    };
+
+    struct HotMethod {
+        std::string class_name;
+        std::string method_name;
+        uint64_t calls = 0u;
+    };
+
+    static constexpr size_t MAX_RECEIVERS = 4u;
+
+    // Профиль, в который пишут наблюдения выполняемые узлы. nullptr - запись выключена
+    [[nodiscard]] static TypeFeedback* Recording();
+    static void SetRecording(TypeFeedback* feedback);
+
+    // Профиль прошлого запуска, по которому Parser специализирует узлы. nullptr - профиля нет
+    [[nodiscard]] static const TypeFeedback* Applied();
+    static void SetApplied(const TypeFeedback* feedback);
+
+    [[nodiscard]] static uint8_t KindOf(const ObjectHolder& value);
+
+    void RecordOperands(uint32_t site, const ObjectHolder& lhs, const ObjectHolder& rhs);
+    void RecordReceiver(uint32_t site, const Class& cls);
+    void RecordMethodCall(const Class& cls, const Method& method);
+
+    // Возвращают nullptr, если по точке нет наблюдений
+    [[nodiscard]] const OperatorSite* FindOperator(uint32_t site) const;
+    [[nodiscard]] const CallSite* FindCall(uint32_t site) const;
+
+    // Не больше limit самых часто вызываемых методов по убыванию числа вызовов
+    [[nodiscard]] std::vector<HotMethod> HotMethods(size_t limit) const;
+
+    // Текстовый формат: по строке на точку наблюдения и на метод
+    void Write(std::ostream& output, uint64_t source_hash) const;
+    void WriteToFile(const std::string& path, uint64_t source_hash) const;
+
+    // Возвращают std::nullopt, если профиль снят для другого текста: такой профиль не применим,
+    // и программа выполняется без него. Бросают FeedbackError, если профиль повреждён
+    [[nodiscard]] static std::optional<TypeFeedback> Read(std::istream& input, uint64_t source_hash);
+    [[nodiscard]] static std::optional<TypeFeedback> ReadFromFile(const std::string& path, uint64_t source_hash);
+
+private:
+    std::unordered_map<uint32_t, OperatorSite> m_operators;
+    std::unordered_map<uint32_t, CallSite> m_calls;
+    // Счётчики ключуются адресом метода, имена запоминаются при первом вызове: классы могут быть
+    // уничтожены раньше, чем профиль будет записан
+    std::unordered_map<const Method*, HotMethod> m_methods;
+    // Методы, прочитанные из файла профиля
+    std::vector<HotMethod> m_loaded_methods;
+};
+
+}  // namespace runtime
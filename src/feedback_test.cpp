@@ -0,0 +1,182 @@
+#include "feedback.h"
+#include "lexer.h"
+#include "parse.h"
+#include "runtime.h"
+#include "snapshot.h"
+#include "statement.h"
+#include "test_runner_p.h"
+
+#include <sstream>
+#include <string>
+
+using namespace std;
+
+namespace runtime {
+
+namespace {
+
+// Точки наблюдения: 1 - '*' в area, 2 - '+' в add, 3..6 - вызовы s.area() и acc.add(...), 7 - '+' строк
+const string PROGRAM = R"(class Shape:
+  def __init__(side):
+    self.side = side
+
+  def area():
+    return self.side * self.side
+
+class Acc:
+  def __init__():
+    self.total = 0
+
+  def add(x):
+    self.total = self.total + x
+
+acc = Acc()
+s = Shape(3)
+acc.add(s.area())
+acc.add(s.area())
+print acc.total, "a" + "b"
+)"s;
+
+// Разбирает и выполняет program, записывая наблюдения в recording и специализируя узлы по applied
+string Run(const string& program, TypeFeedback* recording, const TypeFeedback* applied) {
+    TypeFeedback::SetRecording(recording);
+    TypeFeedback::SetApplied(applied);
+    istringstream input(program);
+    parse::Lexer lexer(input);
+    auto tree = ParseProgram(lexer);
+    DummyContext context;
+    Closure closure;
+    tree->Execute(closure, context);
+    TypeFeedback::SetRecording(nullptr);
+    TypeFeedback::SetApplied(nullptr);
+    return context.output.str();
+}
+
+string ToText(const TypeFeedback& feedback, uint64_t source_hash) {
+    ostringstream out;
+    feedback.Write(out, source_hash);
+    return out.str();
+}
+
+void TestRecordsOperandsAndReceivers() {
+    TypeFeedback feedback;
+    ASSERT_EQUAL(Run(PROGRAM, &feedback, nullptr), "18 ab\n"s);
+
+    const TypeFeedback::OperatorSite* mult = feedback.FindOperator(1u);
+    ASSERT(mult != nullptr);
+    ASSERT_EQUAL(mult->lhs_kinds, TypeFeedback::KIND_NUMBER);
+    ASSERT_EQUAL(mult->rhs_kinds, TypeFeedback::KIND_NUMBER);
+    const TypeFeedback::OperatorSite* concat = feedback.FindOperator(7u);
+    ASSERT(concat != nullptr);
+    ASSERT_EQUAL(concat->lhs_kinds, TypeFeedback::KIND_STRING);
+    ASSERT(feedback.FindOperator(8u) == nullptr);
+
+    const TypeFeedback::CallSite* area = feedback.FindCall(3u);
+    ASSERT(area != nullptr);
+    ASSERT_EQUAL(area->calls, 1u);
+    ASSERT(!area->megamorphic);
+    ASSERT_EQUAL(area->receivers, vector<string>{"Shape"s});
+    ASSERT_EQUAL(feedback.FindCall(6u)->receivers, vector<string>{"Acc"s});
+
+    const vector<TypeFeedback::HotMethod> hot = feedback.HotMethods(2u);
+    ASSERT_EQUAL(hot.size(), 2u);
+    ASSERT_EQUAL(hot[0].class_name + "."s + hot[0].method_name, "Acc.add"s);
+    ASSERT_EQUAL(hot[0].calls, 2u);
+    ASSERT_EQUAL(hot[1].class_name + "."s + hot[1].method_name, "Shape.area"s);
+}
+
+// Вызов с пятью разными классами получателей помечается как мегаморфный
+void TestMegamorphicCallSite() {
+    TypeFeedback feedback;
+    vector<ObjectHolder> classes;
+    for (const string& name : {"A"s, "B"s, "C"s, "D"s, "E"s}) {
+        classes.push_back(ObjectHolder::Own(Class(name, {}, nullptr)));
+        feedback.RecordReceiver(1u, *classes.back().TryAs<Class>());
+    }
+    feedback.RecordReceiver(1u, *classes.front().TryAs<Class>());
+    const TypeFeedback::CallSite* site = feedback.FindCall(1u);
+    ASSERT(site->megamorphic);
+    ASSERT_EQUAL(site->calls, 6u);
+    ASSERT_EQUAL(site->receivers.size(), TypeFeedback::MAX_RECEIVERS);
+}
+
+void TestProfileRoundTrip() {
+    TypeFeedback feedback;
+    Run(PROGRAM, &feedback, nullptr);
+    const uint64_t hash = SourceHash(PROGRAM);
+    const string text = ToText(feedback, hash);
+
+    istringstream input(text);
+    const TypeFeedback restored = TypeFeedback::Read(input, hash).value();
+    ASSERT_EQUAL(ToText(restored, hash), text);
+    ASSERT_EQUAL(restored.FindCall(4u)->receivers, vector<string>{"Acc"s});
+    ASSERT_EQUAL(restored.HotMethods(1u).front().method_name, "add"s);
+
+    auto expect_error = [](const string& profile, uint64_t source_hash) {
+        try {
+            istringstream in(profile);
+            [[maybe_unused]] optional<TypeFeedback> result = TypeFeedback::Read(in, source_hash);
+            ASSERT(false);
+        }
+        catch (const FeedbackError&) {
+        }
+    };
+    // Профиль другого текста не применяется, но и не считается ошибкой
+    istringstream other_source(text);
+    ASSERT(!TypeFeedback::Read(other_source, SourceHash(PROGRAM + "\n"s)).has_value());
+    expect_error("garbage\n"s, hash);
+    expect_error(text + "op 1\n"s, hash);
+    expect_error(text + "jit 1 2\n"s, hash);
+}
+
+// Профиль меняет порядок проверок и заполняет кэши заранее, но не результат программы
+void TestAppliedProfileKeepsBehaviour() {
+    TypeFeedback first;
+    const string expected = Run(PROGRAM, &first, nullptr);
+    TypeFeedback second;
+    ASSERT_EQUAL(Run(PROGRAM, &second, &first), expected);
+    // Номера точек не меняются между запусками одного и того же текста
+    ASSERT_EQUAL(ToText(second, 0u), ToText(first, 0u));
+
+    // Устаревшая подсказка только теряет ускорение
+    const string program = "x = 2 * 3\nprint x + 1, 'a' + 'b'\n"s;
+    istringstream stale_text("mython-feedback 1\nsource 0\nop 1 64 64\nop 2 8 8\nop 3 2 2\n"s);
+    const TypeFeedback stale = TypeFeedback::Read(stale_text, 0u).value();
+    ASSERT_EQUAL(Run(program, nullptr, &stale), "7 ab\n"s);
+}
+
+void TestPrefilledMethodCache() {
+    Closure classes;
+    vector<Method> methods;
+    methods.push_back({"get"s, {}, make_unique<ast::MethodBody>(make_unique<ast::Return>(make_unique<ast::NumericConst>(5)))});
+    classes["Box"s] = ObjectHolder::Own(Class("Box"s, std::move(methods), nullptr));
+    classes["Other"s] = ObjectHolder::Own(Class("Other"s, {}, nullptr));
+    const Class& box = *classes.at("Box"s).TryAs<Class>();
+
+    ast::MethodCall call(make_unique<ast::VariableValue>("b"s), "get"s, {});
+    ASSERT(call.CachedClass() == nullptr);
+    call.PrefillCache(box);
+    ASSERT(call.CachedClass() == &box);
+
+    Closure closure;
+    closure["b"s] = ObjectHolder::Own(ClassInstance(box));
+    DummyContext context;
+    ASSERT_EQUAL(call.Execute(closure, context).TryAs<Number>()->GetValue(), 5);
+
+    // Кэш, заполненный для другого класса, перестраивается при первом вызове
+    call.PrefillCache(*classes.at("Other"s).TryAs<Class>());
+    ASSERT_EQUAL(call.Execute(closure, context).TryAs<Number>()->GetValue(), 5);
+    ASSERT(call.CachedClass() == &box);
+}
+
+}  // namespace
+
+void RunFeedbackTests(TestRunner& tr) {
+    RUN_TEST(tr, runtime::TestRecordsOperandsAndReceivers);
+    RUN_TEST(tr, runtime::TestMegamorphicCallSite);
+    RUN_TEST(tr, runtime::TestProfileRoundTrip);
+    RUN_TEST(tr, runtime::TestAppliedProfileKeepsBehaviour);
+    RUN_TEST(tr, runtime::TestPrefilledMethodCache);
+}
+
+}  // namespace runtime
@@ -0,0 +1,365 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace runtime {
+
+/*
+ * Плоская хеш-таблица с открытой адресацией для коротких строковых ключей (имён переменных и полей).
+ *
+ * Пары ключ-значение хранятся подряд в порядке вставки, рядом с ними - закэшированные хеши ключей.
+ * Пока элементов не больше InlineCapacity, они лежат во внутреннем буфере объекта, поиск выполняется
+ * линейным просмотром хешей и память не выделяется. При большем числе элементов пары переезжают в кучу,
+ * а для поиска строится индекс с линейным пробированием, который перестраивается по закэшированным хешам
+ * без повторного хеширования строк.
+ *
+ * Интерфейс повторяет используемое подмножество std::unordered_map. Отличия:
+ *   - итераторы - указатели, порядок обхода совпадает с порядком вставки;
+ *   - вставка может сделать недействительными итераторы и ссылки на элементы (но не на сами объекты,
+ *     на которые ссылаются ObjectHolder);
+ *   - удаление отдельных элементов не поддерживается, только clear().
+ *
+ * Таблица целиком лежит в каждом ClassInstance, поэтому внутренний буфер невелик: четырёх элементов
+ * хватает для self с тремя параметрами и для экземпляров сценария instances из mython_memory_bench.
+ * Локальные переменные вызовов берутся из пула (см. LocalClosure) и в кадр стека не попадают.
+ */
+template <typename Value, size_t InlineCapacity = 4>
+class FlatStringMap {
+public:
+    using key_type = std::string;
+    using mapped_type = Value;
+    using value_type = std::pair<const std::string, Value>;
+    using size_type = size_t;
+    using iterator = value_type*;
+    using const_iterator = const value_type*;
+
+    // Хеш ключа. Позволяет вычислить хеш заранее и передавать его в find и operator[]
+    [[nodiscard]]
+    static uint32_t Hash(std::string_view key) {
+        // FNV-1a с финальным перемешиванием старших бит в младшие, по которым берётся позиция в индексе
+        uint32_t hash = 2166136261u;
+        for (const char ch : key) {
+            hash = (hash ^ static_cast<unsigned char>(ch)) * 16777619u;
+        }
+        return hash ^ (hash >> 15);
+    }
+
+    FlatStringMap() = default;
+
+    FlatStringMap(std::initializer_list<value_type> values) {
+        reserve(values.size());
+        for (const value_type& value : values) {
+            insert(value);
+        }
+    }
+
+    FlatStringMap(const FlatStringMap& other) {
+        reserve(other.m_size);
+        for (size_t i = 0; i < other.m_size; ++i) {
+            Append(other.m_hashes[i], other.m_entries[i].first, other.m_entries[i].second);
+        }
+    }
+
+    FlatStringMap(FlatStringMap&& other) noexcept {
+        MoveFrom(other);
+    }
+
+    FlatStringMap& operator=(const FlatStringMap& other) {
+        if (this != &other) {
+            FlatStringMap copy(other);
+            Reset();
+            MoveFrom(copy);
+        }
+        return *this;
+    }
+
+    FlatStringMap& operator=(FlatStringMap&& other) noexcept {
+        if (this != &other) {
+            Reset();
+            MoveFrom(other);
+        }
+        return *this;
+    }
+
+    ~FlatStringMap() {
+        Reset();
+    }
+
+    [[nodiscard]] iterator begin() { return m_entries; }
+    [[nodiscard]] iterator end() { return m_entries + m_size; }
+    [[nodiscard]] const_iterator begin() const { return m_entries; }
+    [[nodiscard]] const_iterator end() const { return m_entries + m_size; }
+    [[nodiscard]] const_iterator cbegin() const { return begin(); }
+    [[nodiscard]] const_iterator cend() const { return end(); }
+
+    [[nodiscard]] size_t size() const { return m_size; }
+    [[nodiscard]] bool empty() const { return m_size == 0u; }
+
+    // Число байт, занятых таблицей в куче (без учёта буферов самих ключей и значений)
+    [[nodiscard]]
+    size_t HeapBytes() const {
+        return IsInline() ? 0u : Capacity() * (sizeof(value_type) + sizeof(uint32_t)) + (m_index_mask + 1u) * sizeof(uint32_t);
+    }
+
+    void reserve(size_t count) {
+        if (count > Capacity()) {
+            Grow(count);
+        }
+    }
+
+    void clear() {
+        DestroyEntries();
+        m_size = 0u;
+        if (!IsInline()) {
+            std::fill(m_index.get(), m_index.get() + m_index_mask + 1u, 0u);
+        }
+    }
+
+    [[nodiscard]]
+    iterator find(std::string_view key, uint32_t hash) {
+        return m_entries + FindIndex(key, hash);
+    }
+
+    [[nodiscard]]
+    const_iterator find(std::string_view key, uint32_t hash) const {
+        return m_entries + FindIndex(key, hash);
+    }
+
+    [[nodiscard]]
+    iterator find(std::string_view key) {
+        return find(key, Hash(key));
+    }
+
+    [[nodiscard]]
+    const_iterator find(std::string_view key) const {
+        return find(key, Hash(key));
+    }
+
+    [[nodiscard]]
+    size_t count(std::string_view key) const {
+        return find(key) != end() ? 1u : 0u;
+    }
+
+    [[nodiscard]]
+    bool contains(std::string_view key) const {
+        return find(key) != end();
+    }
+
+    [[nodiscard]]
+    Value& at(std::string_view key) {
+        const iterator it = find(key);
+        if (it == end()) {
+            throw std::out_of_range("FlatStringMap::at: no key " + std::string(key));
+        }
+        return it->second;
+    }
+
+    [[nodiscard]]
+    const Value& at(std::string_view key) const {
+        const const_iterator it = find(key);
+        if (it == end()) {
+            throw std::out_of_range("FlatStringMap::at: no key " + std::string(key));
+        }
+        return it->second;
+    }
+
+    Value& operator[](std::string_view key) {
+        return Subscript(key, Hash(key));
+    }
+
+    // Доступ по ключу с заранее вычисленным хешем (см. Hash)
+    Value& Subscript(std::string_view key, uint32_t hash) {
+        const size_t index = FindIndex(key, hash);
+        if (index != m_size) {
+            return m_entries[index].second;
+        }
+        return Append(hash, key, Value())->second;
+    }
+
+    template <typename Key, typename... Args>
+    std::pair<iterator, bool> emplace(Key&& key, Args&&... args) {
+        const std::string_view key_view(key);
+        const uint32_t hash = Hash(key_view);
+        const size_t index = FindIndex(key_view, hash);
+        if (index != m_size) {
+            return {m_entries + index, false};
+        }
+        return {Append(hash, std::forward<Key>(key), std::forward<Args>(args)...), true};
+    }
+
+    std::pair<iterator, bool> insert(const value_type& value) {
+        return emplace(value.first, value.second);
+    }
+
+    std::pair<iterator, bool> insert(value_type&& value) {
+        return emplace(value.first, std::move(value.second));
+    }
+
+    template <typename V>
+    std::pair<iterator, bool> insert_or_assign(std::string_view key, V&& value) {
+        const uint32_t hash = Hash(key);
+        const size_t index = FindIndex(key, hash);
+        if (index != m_size) {
+            m_entries[index].second = std::forward<V>(value);
+            return {m_entries + index, false};
+        }
+        return {Append(hash, key, std::forward<V>(value)), true};
+    }
+
+private:
+    [[nodiscard]]
+    bool IsInline() const {
+        return m_entries == InlineEntries();
+    }
+
+    // Индекс заполнен не более чем наполовину, поэтому ёмкость таблицы в куче - половина его размера
+    [[nodiscard]]
+    size_t Capacity() const {
+        return IsInline() ? InlineCapacity : (m_index_mask + 1u) / 2u;
+    }
+
+    [[nodiscard]]
+    value_type* InlineEntries() const {
+        return reinterpret_cast<value_type*>(const_cast<unsigned char*>(m_inline_entries));
+    }
+
+    // Возвращает индекс элемента с ключом key либо m_size, если такого элемента нет
+    [[nodiscard]]
+    size_t FindIndex(std::string_view key, uint32_t hash) const {
+        if (IsInline()) {
+            for (size_t i = 0; i < m_size; ++i) {
+                if (m_hashes[i] == hash && m_entries[i].first == key) {
+                    return i;
+                }
+            }
+            return m_size;
+        }
+        for (size_t pos = hash & m_index_mask;; pos = (pos + 1u) & m_index_mask) {
+            const uint32_t slot = m_index[pos];
+            if (slot == 0u) {
+                return m_size;
+            }
+            if (m_hashes[slot - 1u] == hash && m_entries[slot - 1u].first == key) {
+                return slot - 1u;
+            }
+        }
+    }
+
+    template <typename Key, typename... Args>
+    iterator Append(uint32_t hash, Key&& key, Args&&... args) {
+        if (m_size == Capacity()) {
+            Grow(m_size + 1u);
+        }
+        value_type* entry = new (m_entries + m_size) value_type(std::piecewise_construct,
+                                                                std::forward_as_tuple(std::forward<Key>(key)),
+                                                                std::forward_as_tuple(std::forward<Args>(args)...));
+        m_hashes[m_size] = hash;
+        ++m_size;
+        if (!IsInline()) {
+            IndexInsert(hash, m_size);
+        }
+        return entry;
+    }
+
+    void IndexInsert(uint32_t hash, uint32_t slot) {
+        size_t pos = hash & m_index_mask;
+        while (m_index[pos] != 0u) {
+            pos = (pos + 1u) & m_index_mask;
+        }
+        m_index[pos] = slot;
+    }
+
+    // Переносит элементы в кучу с ёмкостью не меньше required и перестраивает индекс
+    void Grow(size_t required) {
+        size_t capacity = std::max<size_t>(Capacity() * 2u, InlineCapacity * 2u);
+        while (capacity < required) {
+            capacity *= 2u;
+        }
+        // Обычный operator new уже выравнивает на __STDCPP_DEFAULT_NEW_ALIGNMENT__, выровненная форма не нужна
+        static_assert(alignof(value_type) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+        auto* entries = static_cast<value_type*>(::operator new(capacity * sizeof(value_type)));
+        auto hashes = std::make_unique<uint32_t[]>(capacity);
+        const size_t index_size = capacity * 2u;
+        auto index = std::make_unique<uint32_t[]>(index_size);
+
+        for (size_t i = 0; i < m_size; ++i) {
+            new (entries + i) value_type(std::move(const_cast<std::string&>(m_entries[i].first)), std::move(m_entries[i].second));
+            hashes[i] = m_hashes[i];
+        }
+        const size_t size = m_size;
+        Reset();
+
+        m_entries = entries;
+        m_hashes = hashes.release();
+        m_index = std::move(index);
+        m_index_mask = static_cast<uint32_t>(index_size - 1u);
+        m_size = size;
+        for (size_t i = 0; i < m_size; ++i) {
+            IndexInsert(m_hashes[i], static_cast<uint32_t>(i + 1u));
+        }
+    }
+
+    void DestroyEntries() {
+        for (size_t i = 0; i < m_size; ++i) {
+            m_entries[i].~value_type();
+        }
+    }
+
+    // Уничтожает элементы, освобождает память и возвращает таблицу во внутренний буфер
+    void Reset() {
+        DestroyEntries();
+        if (!IsInline()) {
+            ::operator delete(m_entries);
+            delete[] m_hashes;
+        }
+        m_entries = InlineEntries();
+        m_hashes = m_inline_hashes;
+        m_index.reset();
+        m_index_mask = 0u;
+        m_size = 0u;
+    }
+
+    // Забирает содержимое other, оставляя other пустым. Текущая таблица должна быть пустой и во внутреннем буфере
+    void MoveFrom(FlatStringMap& other) noexcept {
+        if (other.IsInline()) {
+            for (size_t i = 0; i < other.m_size; ++i) {
+                new (m_entries + i) value_type(std::move(const_cast<std::string&>(other.m_entries[i].first)), std::move(other.m_entries[i].second));
+                m_hashes[i] = other.m_hashes[i];
+            }
+            m_size = other.m_size;
+            other.Reset();
+            return;
+        }
+        m_entries = other.m_entries;
+        m_hashes = other.m_hashes;
+        m_index = std::move(other.m_index);
+        m_index_mask = other.m_index_mask;
+        m_size = other.m_size;
+
+        other.m_entries = other.InlineEntries();
+        other.m_hashes = other.m_inline_hashes;
+        other.m_index_mask = 0u;
+        other.m_size = 0u;
+    }
+
+    value_type* m_entries = InlineEntries();
+    // Хеши ключей: внутренний буфер либо массив в куче, которым владеет таблица
+    uint32_t* m_hashes = m_inline_hashes;
+    // Индекс для таблицы в куче: номер элемента плюс один, ноль - свободная позиция
+    std::unique_ptr<uint32_t[]> m_index;
+    uint32_t m_index_mask = 0u;
+    uint32_t m_size = 0u;
+    uint32_t m_inline_hashes[InlineCapacity] = {};
+    alignas(value_type) unsigned char m_inline_entries[InlineCapacity * sizeof(value_type)];
+};
+
+}  // namespace runtime
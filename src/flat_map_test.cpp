@@ -0,0 +1,119 @@
+#include "flat_map.h"
+#include "test_runner_p.h"
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace runtime {
+
+namespace {
+
+using SmallMap = FlatStringMap<int, 4>;
+
+void TestFlatMapInlineStorage() {
+    SmallMap map;
+    {
+        AllocationCounter counter;
+        map["a"s] = 1;
+        map["b"s] = 2;
+        map.emplace("c"s, 3);
+        map.insert({"d"s, 4});
+        const size_t count = counter.Count();
+        ASSERT_EQUAL(count, 0u);
+    }
+    ASSERT_EQUAL(map.size(), 4u);
+    ASSERT_EQUAL(map.HeapBytes(), 0u);
+    ASSERT_EQUAL(map.at("c"s), 3);
+    ASSERT_EQUAL(map.count("e"s), 0u);
+    ASSERT(map.find("e"s) == map.end());
+}
+
+void TestFlatMapGrowth() {
+    SmallMap map;
+    for (int i = 0; i < 100; ++i) {
+        map["key"s + to_string(i)] = i;
+    }
+    ASSERT_EQUAL(map.size(), 100u);
+    ASSERT(map.HeapBytes() > 0u);
+
+    // Обход идёт в порядке вставки
+    int expected = 0;
+    for (const auto& [key, value] : map) {
+        ASSERT_EQUAL(key, "key"s + to_string(expected));
+        ASSERT_EQUAL(value, expected);
+        ++expected;
+    }
+    for (int i = 0; i < 100; ++i) {
+        ASSERT_EQUAL(map.at("key"s + to_string(i)), i);
+    }
+    ASSERT_EQUAL(map.count("key100"s), 0u);
+
+    map.clear();
+    ASSERT(map.empty());
+    ASSERT_EQUAL(map.count("key1"s), 0u);
+    map["key1"s] = 7;
+    ASSERT_EQUAL(map.at("key1"s), 7);
+}
+
+void TestFlatMapInsertDoesNotOverwrite() {
+    SmallMap map{{"x"s, 1}};
+    const auto [it, inserted] = map.emplace("x"s, 2);
+    ASSERT(!inserted);
+    ASSERT_EQUAL(it->second, 1);
+    map.insert_or_assign("x"s, 3);
+    ASSERT_EQUAL(map.at("x"s), 3);
+
+    try {
+        [[maybe_unused]] int value = map.at("y"s);
+        ASSERT(false);
+    }
+    catch (const std::out_of_range&) {
+    }
+}
+
+void TestFlatMapCopyAndMove() {
+    for (const int count : {3, 40}) {
+        SmallMap original;
+        for (int i = 0; i < count; ++i) {
+            original["v"s + to_string(i)] = i;
+        }
+
+        SmallMap copy = original;
+        copy["v0"s] = -1;
+        ASSERT_EQUAL(original.at("v0"s), 0);
+        ASSERT_EQUAL(copy.size(), original.size());
+
+        SmallMap moved = std::move(copy);
+        ASSERT_EQUAL(moved.size(), static_cast<size_t>(count));
+        ASSERT_EQUAL(moved.at("v0"s), -1);
+        ASSERT_EQUAL(moved.at("v"s + to_string(count - 1)), count - 1);
+
+        original = moved;
+        ASSERT_EQUAL(original.at("v0"s), -1);
+        moved = SmallMap{{"only"s, 1}};
+        ASSERT_EQUAL(moved.size(), 1u);
+        ASSERT_EQUAL(moved.at("only"s), 1);
+    }
+}
+
+void TestFlatMapPrecomputedHash() {
+    SmallMap map;
+    const uint32_t hash = SmallMap::Hash("name"s);
+    map.Subscript("name"s, hash) = 5;
+    ASSERT_EQUAL(map.find("name"s, hash)->second, 5);
+    ASSERT_EQUAL(map.at("name"s), 5);
+}
+
+}  // namespace
+
+void RunFlatMapTests(TestRunner& tr) {
+    RUN_TEST(tr, runtime::TestFlatMapInlineStorage);
+    RUN_TEST(tr, runtime::TestFlatMapGrowth);
+    RUN_TEST(tr, runtime::TestFlatMapInsertDoesNotOverwrite);
+    RUN_TEST(tr, runtime::TestFlatMapCopyAndMove);
+    RUN_TEST(tr, runtime::TestFlatMapPrecomputedHash);
+}
+
+}  // namespace runtime
@@ -0,0 +1,432 @@
+#include "heap_snapshot.h"
+#include "int_array.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+#include <unordered_map>
+
+using namespace std;
+
+namespace runtime {
+
+namespace {
+
+constexpr size_t NO_NODE = std::numeric_limits<size_t>::max();
+
+size_t g_registry_sequence = 0u;
+
+// Реестр намеренно не разрушается: объекты со статическим временем жизни могут пережить его
+std::unordered_map<const Object*, size_t>& Registry() {
+    static auto* registry = new std::unordered_map<const Object*, size_t>();
+    return *registry;
+}
+
+size_t StringHeapBytes(const std::string& str) {
+    static const size_t sso_capacity = std::string().capacity();
+    return str.capacity() > sso_capacity ? str.capacity() + 1u : 0u;
+}
+
+size_t ClosureHeapBytes(const Closure& closure) {
+    // Небольшие таблицы целиком лежат внутри объекта и в куче места не занимают
+    size_t bytes = closure.HeapBytes();
+    for (const auto& [name, value] : closure) {
+        bytes += StringHeapBytes(name);
+    }
+    return bytes;
+}
+
+void WriteJsonString(std::ostream& os, const std::string& str) {
+    os << '"';
+    for (const char ch : str) {
+        if (ch == '"' || ch == '\\') {
+            os << '\\' << ch;
+        }
+        else if (static_cast<unsigned char>(ch) < 0x20u) {
+            os << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(ch) << std::dec << std::setfill(' ');
+        }
+        else {
+            os << ch;
+        }
+    }
+    os << '"';
+}
+
+std::string SummaryKey(const HeapNode& node) {
+    return node.class_name.empty() || node.type != "ClassInstance"s ? node.type : node.class_name;
+}
+
+}  // namespace
+
+void HeapRegistry::Enable() {
+    s_enabled = true;
+    s_tracking = true;
+}
+
+void HeapRegistry::Disable() {
+    s_enabled = false;
+    s_tracking = !Registry().empty();
+}
+
+std::vector<const Object*> HeapRegistry::LiveObjects() {
+    std::vector<std::pair<size_t, const Object*>> ordered;
+    ordered.reserve(Registry().size());
+    for (const auto& [object, sequence] : Registry()) {
+        ordered.emplace_back(sequence, object);
+    }
+    std::sort(ordered.begin(), ordered.end());
+
+    std::vector<const Object*> result;
+    result.reserve(ordered.size());
+    for (const auto& [sequence, object] : ordered) {
+        result.push_back(object);
+    }
+    return result;
+}
+
+void HeapRegistry::OnCreate(const Object* object) {
+    Registry()[object] = g_registry_sequence++;
+}
+
+void HeapRegistry::OnDestroy(const Object* object) {
+    Registry().erase(object);
+    if (!s_enabled && Registry().empty()) {
+        s_tracking = false;
+    }
+}
+
+HeapSnapshot::HeapSnapshot() {
+    HeapNode root;
+    root.type = "(roots)"s;
+    m_nodes.push_back(std::move(root));
+    m_parent.push_back(NO_NODE);
+    m_parent_edge.push_back(NO_NODE);
+}
+
+size_t HeapSnapshot::AddNode(const Object* object) {
+    if (auto it = m_index.find(object); it != m_index.end()) {
+        return it->second;
+    }
+
+    HeapNode node;
+    node.object = object;
+    if (auto* instance = dynamic_cast<const ClassInstance*>(object)) {
+        node.type = "ClassInstance"s;
+        node.class_name = instance->GetClass().GetName();
+        node.self_size = sizeof(ClassInstance) + ClosureHeapBytes(instance->Fields());
+    }
+    else if (auto* cls = dynamic_cast<const Class*>(object)) {
+        node.type = "Class"s;
+        node.class_name = cls->GetName();
+        node.self_size = sizeof(Class) + StringHeapBytes(cls->GetName()) + ClosureHeapBytes(cls->Attributes());
+    }
+    else if (auto* function = dynamic_cast<const Function*>(object)) {
+        node.type = "Function"s;
+        node.self_size = sizeof(Function) + StringHeapBytes(function->GetName());
+    }
+    else if (auto* str = dynamic_cast<const String*>(object)) {
+        node.type = "String"s;
+        node.self_size = sizeof(String) + StringHeapBytes(str->GetValue());
+    }
+    else if (dynamic_cast<const Bool*>(object)) {
+        node.type = "Bool"s;
+        node.self_size = sizeof(Bool);
+    }
+    else if (dynamic_cast<const Number*>(object)) {
+        node.type = "Number"s;
+        node.self_size = sizeof(Number);
+    }
+    else if (auto* big = dynamic_cast<const BigNumber*>(object)) {
+        node.type = "BigNumber"s;
+        node.self_size = sizeof(BigNumber) + big->GetValue().LimbCount() * sizeof(uint32_t);
+    }
+    else if (auto* array = dynamic_cast<const IntArray*>(object)) {
+        node.type = "IntArray"s;
+        node.self_size = sizeof(IntArray) + array->Values().capacity() * sizeof(int64_t);
+    }
+    else {
+        node.type = "Object"s;
+        node.self_size = sizeof(Object);
+    }
+
+    const size_t index = m_nodes.size();
+    m_nodes.push_back(std::move(node));
+    m_parent.push_back(NO_NODE);
+    m_parent_edge.push_back(NO_NODE);
+    m_index.emplace(object, index);
+    return index;
+}
+
+// Обходит в ширину всё, что достижимо из from_node и ещё не посещено.
+// Обход в ширину гарантирует, что m_parent задаёт кратчайшие пути от корня
+void HeapSnapshot::Expand(size_t from_node) {
+    std::vector<size_t> queue{from_node};
+    for (size_t head = 0u; head < queue.size(); ++head) {
+        const size_t current = queue[head];
+        // Исходящие рёбра есть у экземпляров (поля) и классов (атрибуты)
+        const Closure* members = nullptr;
+        if (const auto* instance = dynamic_cast<const ClassInstance*>(m_nodes[current].object)) {
+            members = &instance->Fields();
+        }
+        else if (const auto* cls = dynamic_cast<const Class*>(m_nodes[current].object)) {
+            members = &cls->Attributes();
+        }
+        if (!members) {
+            continue;
+        }
+        for (const auto& [name, value] : *members) {
+            if (!value) {
+                continue;
+            }
+            const size_t to = AddNode(value.Get());
+            m_nodes[current].edges.push_back({name, to});
+            if (m_parent[to] == NO_NODE) {
+                m_parent[to] = current;
+                m_parent_edge[to] = m_nodes[current].edges.size() - 1u;
+                queue.push_back(to);
+            }
+        }
+    }
+}
+
+void HeapSnapshot::AddRoots(const Closure& roots) {
+    std::vector<size_t> discovered;
+    for (const auto& [name, value] : roots) {
+        if (!value) {
+            continue;
+        }
+        const size_t to = AddNode(value.Get());
+        m_nodes[0].edges.push_back({name, to});
+        if (m_parent[to] == NO_NODE) {
+            m_parent[to] = 0u;
+            m_parent_edge[to] = m_nodes[0].edges.size() - 1u;
+            discovered.push_back(to);
+        }
+    }
+    // Корни раскрываются после того, как все они получили родителя, иначе путь к корневой
+    // переменной мог бы пройти через поле другого объекта
+    for (const size_t node : discovered) {
+        Expand(node);
+    }
+}
+
+HeapSnapshot HeapSnapshot::FromClosure(const Closure& roots) {
+    HeapSnapshot snapshot;
+    snapshot.AddRoots(roots);
+    snapshot.ComputeRetainedSizes();
+    return snapshot;
+}
+
+HeapSnapshot HeapSnapshot::FromRegistry(const Closure& roots) {
+    HeapSnapshot snapshot;
+    snapshot.AddRoots(roots);
+    for (const Object* object : HeapRegistry::LiveObjects()) {
+        const size_t node = snapshot.AddNode(object);
+        if (snapshot.m_parent[node] != NO_NODE) {
+            continue;
+        }
+        snapshot.m_nodes[0].edges.push_back({"(detached)"s, node});
+        snapshot.m_parent[node] = 0u;
+        snapshot.m_parent_edge[node] = snapshot.m_nodes[0].edges.size() - 1u;
+        snapshot.Expand(node);
+    }
+    snapshot.ComputeRetainedSizes();
+    return snapshot;
+}
+
+// Удерживаемые размеры считаются по дереву доминаторов (алгоритм Cooper-Harvey-Kennedy)
+void HeapSnapshot::ComputeRetainedSizes() {
+    const size_t sz = m_nodes.size();
+
+    std::vector<size_t> postorder;
+    std::vector<size_t> post_number(sz, NO_NODE);
+    postorder.reserve(sz);
+    {
+        std::vector<bool> visited(sz, false);
+        std::vector<std::pair<size_t, size_t>> stack{{0u, 0u}};
+        visited[0] = true;
+        while (!stack.empty()) {
+            auto& [node, edge] = stack.back();
+            if (edge < m_nodes[node].edges.size()) {
+                const size_t to = m_nodes[node].edges[edge++].to;
+                if (!visited[to]) {
+                    visited[to] = true;
+                    stack.emplace_back(to, 0u);
+                }
+                continue;
+            }
+            post_number[node] = postorder.size();
+            postorder.push_back(node);
+            stack.pop_back();
+        }
+    }
+
+    std::vector<std::vector<size_t>> predecessors(sz);
+    for (size_t from = 0u; from < sz; ++from) {
+        for (const HeapEdge& edge : m_nodes[from].edges) {
+            predecessors[edge.to].push_back(from);
+        }
+    }
+
+    auto intersect = [&](size_t lhs, size_t rhs) {
+        while (lhs != rhs) {
+            while (post_number[lhs] < post_number[rhs]) {
+                lhs = m_idom[lhs];
+            }
+            while (post_number[rhs] < post_number[lhs]) {
+                rhs = m_idom[rhs];
+            }
+        }
+        return lhs;
+    };
+
+    m_idom.assign(sz, NO_NODE);
+    m_idom[0] = 0u;
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (auto it = postorder.rbegin(); it != postorder.rend(); ++it) {
+            const size_t node = *it;
+            if (node == 0u) {
+                continue;
+            }
+            size_t new_idom = NO_NODE;
+            for (const size_t pred : predecessors[node]) {
+                if (m_idom[pred] == NO_NODE) {
+                    continue;
+                }
+                new_idom = new_idom == NO_NODE ? pred : intersect(pred, new_idom);
+            }
+            if (new_idom != m_idom[node]) {
+                m_idom[node] = new_idom;
+                changed = true;
+            }
+        }
+    }
+
+    for (HeapNode& node : m_nodes) {
+        node.retained_size = node.self_size;
+    }
+    for (const size_t node : postorder) {
+        if (node != 0u) {
+            m_nodes[m_idom[node]].retained_size += m_nodes[node].retained_size;
+        }
+    }
+}
+
+const std::vector<HeapNode>& HeapSnapshot::Nodes() const {
+    return m_nodes;
+}
+
+size_t HeapSnapshot::FindNode(const Object* object) const {
+    auto it = m_index.find(object);
+    return it == m_index.end() ? m_nodes.size() : it->second;
+}
+
+std::map<std::string, HeapClassSummary> HeapSnapshot::SummaryByClass() const {
+    std::map<std::string, HeapClassSummary> result;
+
+    std::vector<std::vector<size_t>> children(m_nodes.size());
+    for (size_t node = 1u; node < m_nodes.size(); ++node) {
+        children[m_idom[node]].push_back(node);
+    }
+
+    // Удерживаемый размер экземпляра, вложенного в другой экземпляр того же класса,
+    // уже учтён во внешнем экземпляре, поэтому считается только самый верхний из них
+    std::map<std::string, size_t> active;
+    std::vector<std::pair<size_t, bool>> stack{{0u, false}};
+    while (!stack.empty()) {
+        auto [node, leaving] = stack.back();
+        stack.pop_back();
+        if (node == 0u) {
+            for (const size_t child : children[node]) {
+                stack.emplace_back(child, false);
+            }
+            continue;
+        }
+
+        const std::string key = SummaryKey(m_nodes[node]);
+        if (leaving) {
+            --active[key];
+            continue;
+        }
+
+        HeapClassSummary& summary = result[key];
+        ++summary.count;
+        summary.self_size += m_nodes[node].self_size;
+        if (active[key]++ == 0u) {
+            summary.retained_size += m_nodes[node].retained_size;
+        }
+
+        stack.emplace_back(node, true);
+        for (const size_t child : children[node]) {
+            stack.emplace_back(child, false);
+        }
+    }
+    return result;
+}
+
+std::vector<std::string> HeapSnapshot::PathTo(const Object* object) const {
+    std::vector<std::string> path;
+    size_t node = FindNode(object);
+    if (node == m_nodes.size()) {
+        return path;
+    }
+    while (node != 0u) {
+        const size_t parent = m_parent[node];
+        path.push_back(m_nodes[parent].edges[m_parent_edge[node]].name);
+        node = parent;
+    }
+    std::reverse(path.begin(), path.end());
+    return path;
+}
+
+void HeapSnapshot::Write(std::ostream& os) const {
+    os << "{\"nodes\":[";
+    for (size_t i = 0u; i < m_nodes.size(); ++i) {
+        const HeapNode& node = m_nodes[i];
+        if (i) {
+            os << ',';
+        }
+        os << "\n{\"id\":" << i << ",\"type\":";
+        WriteJsonString(os, node.type);
+        os << ",\"class\":";
+        WriteJsonString(os, node.class_name);
+        os << ",\"self_size\":" << node.self_size << ",\"retained_size\":" << node.retained_size << ",\"edges\":[";
+        for (size_t j = 0u; j < node.edges.size(); ++j) {
+            if (j) {
+                os << ',';
+            }
+            os << "{\"name\":";
+            WriteJsonString(os, node.edges[j].name);
+            os << ",\"to\":" << node.edges[j].to << '}';
+        }
+        os << "]}";
+    }
+    os << "\n]}\n";
+}
+
+void HeapSnapshot::WriteToFile(const std::string& path) const {
+    std::ofstream out(path, std::ios::binary);
+    if (!out) {
+        throw std::runtime_error("Cannot open heap snapshot file "s + path);
+    }
+    Write(out);
+}
+
+void HeapSnapshot::PrintSummary(std::ostream& os) const {
+    std::map<std::string, HeapClassSummary> summary = SummaryByClass();
+    std::vector<std::pair<std::string, HeapClassSummary>> rows(summary.begin(), summary.end());
+    std::stable_sort(rows.begin(), rows.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.second.retained_size > rhs.second.retained_size;
+    });
+
+    os << std::left << std::setw(24) << "class" << std::right << std::setw(10) << "count" << std::setw(14) << "self_size" << std::setw(16) << "retained_size" << '\n';
+    for (const auto& [name, row] : rows) {
+        os << std::left << std::setw(24) << name << std::right << std::setw(10) << row.count << std::setw(14) << row.self_size << std::setw(16) << row.retained_size << '\n';
+    }
+}
+
+}  // namespace runtime
@@ -0,0 +1,133 @@
+#pragma once
+
+#include "runtime.h"
+
+#include <cstddef>
+#include <iosfwd>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace runtime {
+
+/*
+ * Реестр живых объектов Mython.
+ * Пока учёт включён, каждый создаваемый Object запоминается в реестре, а при разрушении удаляется из него.
+ * Это позволяет строить снимок всей кучи, включая объекты, недостижимые из глобальной области видимости
+ * (например, циклы ссылок, которые уже никогда не будут освобождены).
+ */
+class HeapRegistry {
+public:
+    // Включает учёт объектов, созданных после вызова
+    static void Enable();
+
+    // Выключает учёт новых объектов. Уже учтённые объекты удаляются из реестра при разрушении
+    static void Disable();
+
+    [[nodiscard]]
+    static bool IsEnabled() {
+        return s_enabled;
+    }
+
+    // Учёт включён либо в реестре остались объекты. Пока это не так, создание и разрушение
+    // объектов не обращаются к реестру
+    [[nodiscard]]
+    static bool IsTracking() {
+        return s_tracking;
+    }
+
+    // Возвращает учтённые объекты в порядке создания
+    [[nodiscard]]
+    static std::vector<const Object*> LiveObjects();
+
+    static void OnCreate(const Object* object);
+    static void OnDestroy(const Object* object);
+
+private:
+    static inline bool s_enabled = false;
+    static inline bool s_tracking = false;
+};
+
+// Ребро снимка: именованная ссылка из одного узла на другой
+struct HeapEdge {
+    std::string name;
+    size_t to;
+};
+
+// Узел снимка: один живой объект
+struct HeapNode {
+    const Object* object = nullptr;
+    // Тип объекта: Number, String, Bool, Class, ClassInstance, Function либо Object для прочих наследников
+    std::string type;
+    // Имя класса для Class и ClassInstance, для остальных объектов пусто
+    std::string class_name;
+    // Собственный размер объекта в байтах, включая принадлежащие ему буферы
+    size_t self_size = 0;
+    // Размер памяти, которая освободится вместе с объектом
+    size_t retained_size = 0;
+    std::vector<HeapEdge> edges;
+};
+
+// Сводка по одному классу (или встроенному типу)
+struct HeapClassSummary {
+    size_t count = 0;
+    size_t self_size = 0;
+    size_t retained_size = 0;
+};
+
+/*
+ * Снимок графа объектов.
+ * Нулевой узел снимка - искусственный корень "(roots)", из которого выходят рёбра к корневым переменным.
+ */
+class HeapSnapshot {
+public:
+    // Строит снимок объектов, достижимых из переменных closure
+    [[nodiscard]]
+    static HeapSnapshot FromClosure(const Closure& roots);
+
+    /*
+     * Строит снимок всех объектов из HeapRegistry. Переменные closure считаются корнями,
+     * а объекты, недостижимые из них, подвешиваются к корню через рёбра "(detached)"
+     */
+    [[nodiscard]]
+    static HeapSnapshot FromRegistry(const Closure& roots);
+
+    [[nodiscard]]
+    const std::vector<HeapNode>& Nodes() const;
+
+    // Возвращает индекс узла объекта object либо Nodes().size(), если объект не попал в снимок
+    [[nodiscard]]
+    size_t FindNode(const Object* object) const;
+
+    // Суммарные размеры по именам классов (для экземпляров) и по типам (для остальных объектов)
+    [[nodiscard]]
+    std::map<std::string, HeapClassSummary> SummaryByClass() const;
+
+    // Кратчайший путь от корня к объекту в виде имён рёбер, например {"x", "next", "value"}.
+    // Для объектов вне снимка возвращается пустой путь
+    [[nodiscard]]
+    std::vector<std::string> PathTo(const Object* object) const;
+
+    // Записывает снимок в формате JSON
+    void Write(std::ostream& os) const;
+    void WriteToFile(const std::string& path) const;
+
+    // Выводит сводку SummaryByClass в виде таблицы, отсортированной по удерживаемому размеру
+    void PrintSummary(std::ostream& os) const;
+
+private:
+    HeapSnapshot();
+
+    size_t AddNode(const Object* object);
+    void AddRoots(const Closure& roots);
+    void Expand(size_t from_node);
+    void ComputeRetainedSizes();
+
+    std::vector<HeapNode> m_nodes;
+    std::map<const Object*, size_t> m_index;
+    std::vector<size_t> m_parent;
+    std::vector<size_t> m_parent_edge;
+    std::vector<size_t> m_idom;
+};
+
+}  // namespace runtime
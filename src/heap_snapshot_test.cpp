@@ -0,0 +1,128 @@
+#include "heap_snapshot.h"
+#include "test_runner_p.h"
+
+#include <cstdio>
+#include <fstream>
+
+using namespace std;
+
+namespace runtime {
+
+namespace {
+
+void TestSnapshotFromClosure() {
+    Class node_cls("Node"s, {}, nullptr);
+    ObjectHolder head = ObjectHolder::Own(ClassInstance{node_cls});
+    ObjectHolder tail = ObjectHolder::Own(ClassInstance{node_cls});
+    head.TryAs<ClassInstance>()->Fields()["next"s] = tail;
+    tail.TryAs<ClassInstance>()->Fields()["value"s] = ObjectHolder::Own(String{"payload"s});
+    tail.TryAs<ClassInstance>()->Fields()["empty"s] = ObjectHolder::None();
+
+    Closure globals{{"head"s, head}, {"n"s, ObjectHolder::Own(Number{5})}};
+    HeapSnapshot snapshot = HeapSnapshot::FromClosure(globals);
+
+    // (roots), head, tail, payload, 5
+    ASSERT_EQUAL(snapshot.Nodes().size(), 5u);
+
+    const Object* payload = tail.TryAs<ClassInstance>()->Fields().at("value"s).Get();
+    ASSERT_EQUAL(snapshot.PathTo(payload), (vector<string>{"head"s, "next"s, "value"s}));
+    ASSERT(snapshot.PathTo(&node_cls).empty());
+
+    const HeapNode& head_node = snapshot.Nodes()[snapshot.FindNode(head.Get())];
+    ASSERT_EQUAL(head_node.type, "ClassInstance"s);
+    ASSERT_EQUAL(head_node.class_name, "Node"s);
+    ASSERT_EQUAL(head_node.edges.size(), 1u);
+
+    const HeapNode& tail_node = snapshot.Nodes()[snapshot.FindNode(tail.Get())];
+    const HeapNode& payload_node = snapshot.Nodes()[snapshot.FindNode(payload)];
+    ASSERT_EQUAL(tail_node.retained_size, tail_node.self_size + payload_node.self_size);
+    ASSERT_EQUAL(head_node.retained_size, head_node.self_size + tail_node.retained_size);
+}
+
+void TestSummaryByClass() {
+    Class node_cls("Node"s, {}, nullptr);
+    ObjectHolder first = ObjectHolder::Own(ClassInstance{node_cls});
+    ObjectHolder second = ObjectHolder::Own(ClassInstance{node_cls});
+    first.TryAs<ClassInstance>()->Fields()["next"s] = second;
+    ObjectHolder shared = ObjectHolder::Own(String{"shared"s});
+    first.TryAs<ClassInstance>()->Fields()["s"s] = shared;
+    second.TryAs<ClassInstance>()->Fields()["s"s] = shared;
+
+    Closure globals{{"first"s, first}};
+    HeapSnapshot snapshot = HeapSnapshot::FromClosure(globals);
+    map<string, HeapClassSummary> summary = snapshot.SummaryByClass();
+
+    ASSERT_EQUAL(summary.at("Node"s).count, 2u);
+    ASSERT_EQUAL(summary.at("String"s).count, 1u);
+    // Вложенный экземпляр Node не учитывается повторно
+    const HeapNode& first_node = snapshot.Nodes()[snapshot.FindNode(first.Get())];
+    ASSERT_EQUAL(summary.at("Node"s).retained_size, first_node.retained_size);
+
+    ostringstream out;
+    snapshot.PrintSummary(out);
+    ASSERT(out.str().find("Node"s) != string::npos);
+}
+
+void TestRegistryFindsDetachedCycles() {
+    Class node_cls("Node"s, {}, nullptr);
+    HeapRegistry::Enable();
+    ObjectHolder lhs = ObjectHolder::Own(ClassInstance{node_cls});
+    ObjectHolder rhs = ObjectHolder::Own(ClassInstance{node_cls});
+    ObjectHolder reachable = ObjectHolder::Own(Number{1});
+    HeapRegistry::Disable();
+
+    lhs.TryAs<ClassInstance>()->Fields()["other"s] = rhs;
+    rhs.TryAs<ClassInstance>()->Fields()["other"s] = lhs;
+
+    Closure globals{{"x"s, reachable}};
+    HeapSnapshot snapshot = HeapSnapshot::FromRegistry(globals);
+
+    ASSERT_EQUAL(snapshot.PathTo(reachable.Get()), vector<string>{"x"s});
+    ASSERT_EQUAL(snapshot.PathTo(lhs.Get()), vector<string>{"(detached)"s});
+    ASSERT_EQUAL(snapshot.PathTo(rhs.Get()), (vector<string>{"(detached)"s, "other"s}));
+
+    lhs.TryAs<ClassInstance>()->Fields().clear();
+    rhs.TryAs<ClassInstance>()->Fields().clear();
+}
+
+// После выключения реестр следит только за уже учтёнными объектами и отключается, когда их не остаётся
+void TestRegistryStopsTrackingWhenOff() {
+    ASSERT(!HeapRegistry::IsTracking());
+    HeapRegistry::Enable();
+    ObjectHolder tracked = ObjectHolder::Own(Number{1});
+    HeapRegistry::Disable();
+    ASSERT(HeapRegistry::IsTracking());
+
+    ObjectHolder untracked = ObjectHolder::Own(Number{2});
+    ASSERT_EQUAL(HeapRegistry::LiveObjects(), vector<const Object*>{tracked.Get()});
+    tracked = ObjectHolder::None();
+    ASSERT(!HeapRegistry::IsTracking());
+    ASSERT(HeapRegistry::LiveObjects().empty());
+}
+
+void TestWriteSnapshot() {
+    Closure globals{{"greeting"s, ObjectHolder::Own(String{"hello"s})}};
+    HeapSnapshot snapshot = HeapSnapshot::FromClosure(globals);
+
+    const string path = "heap_snapshot_test.json"s;
+    snapshot.WriteToFile(path);
+    ifstream in(path);
+    const string content((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    in.close();
+    std::remove(path.c_str());
+
+    ASSERT(content.find("\"type\":\"String\""s) != string::npos);
+    ASSERT(content.find("{\"name\":\"greeting\",\"to\":1}"s) != string::npos);
+}
+
+}  // namespace
+
+void RunHeapSnapshotTests(TestRunner& tr) {
+    RUN_TEST(tr, runtime::TestSnapshotFromClosure);
+    RUN_TEST(tr, runtime::TestSummaryByClass);
+    RUN_TEST(tr, runtime::TestRegistryFindsDetachedCycles);
+    RUN_TEST(tr, runtime::TestRegistryStopsTrackingWhenOff);
+    RUN_TEST(tr, runtime::TestWriteSnapshot);
+}
+
+}  // namespace runtime
@@ -0,0 +1,171 @@
+#include "lexer.h"
+#include "parse.h"
+#include "runtime.h"
+#include "test_runner_p.h"
+
+#include <sstream>
+#include <string>
+
+using namespace std;
+
+namespace parse {
+
+namespace {
+
+const string PROGRAM = R"(class Counter:
+  def __init__():
+    self.n = 0
+
+  def add(k):
+    self.n = self.n + k
+    return self.n
+
+  def __str__():
+    return 'Counter'
+
+class Named(Counter):
+  def name():
+    return 'named'
+
+c = Counter()
+print c.add(2), c.add(3)
+x = 10
+print x * 2
+# комментарий верхнего уровня
+d = Named()
+print d.name(), d.add(7)
+if x > 5:
+  print 'big'
+else:
+  print 'small'
+print 'done'
+)"s;
+
+string RunFull(const string& program) {
+    istringstream input(program);
+    Lexer lexer(input);
+    auto tree = ParseProgram(lexer);
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    tree->Execute(closure, context);
+    return context.output.str();
+}
+
+string RunIncremental(const IncrementalProgram& program) {
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    program.Execute(closure, context);
+    return context.output.str();
+}
+
+// Применяет правку: первое вхождение from заменяется на to
+size_t Replace(IncrementalProgram& program, const string& from, const string& to) {
+    const size_t offset = program.Source().find(from);
+    ASSERT(offset != string::npos);
+    return program.Edit(offset, from.size(), to);
+}
+
+void TestEditReparsesOnlyAffectedChunks() {
+    IncrementalProgram program(PROGRAM);
+    program.EnableConsistencyCheck(true);
+    ASSERT_EQUAL(RunIncremental(program), RunFull(PROGRAM));
+
+    // Правка простой инструкции затрагивает только её фрагмент
+    ASSERT_EQUAL(Replace(program, "print x * 2"s, "print x * 3"s), 1u);
+    ASSERT_EQUAL(RunIncremental(program), RunFull(program.Source()));
+
+    // Правка класса заново разбирает его, наследника и инструкции, которые их упоминают
+    ASSERT_EQUAL(Replace(program, "self.n = self.n + k"s, "self.n = self.n + k * 10"s), 4u);
+    ASSERT_EQUAL(RunIncremental(program), RunFull(program.Source()));
+
+    // Правка наследника не трогает базовый класс и создание Counter
+    ASSERT_EQUAL(Replace(program, "return 'named'"s, "return 'renamed'"s), 2u);
+    ASSERT_EQUAL(RunIncremental(program), RunFull(program.Source()));
+
+    // Ветка else принадлежит фрагменту if
+    ASSERT_EQUAL(Replace(program, "print 'small'"s, "print 'tiny'"s), 1u);
+    ASSERT_EQUAL(Replace(program, "x = 10"s, "x = 1"s), 1u);
+    ASSERT_EQUAL(RunIncremental(program), RunFull(program.Source()));
+}
+
+void TestEditChangesChunkBoundaries() {
+    IncrementalProgram program(PROGRAM);
+    program.EnableConsistencyCheck(true);
+    const size_t chunks = program.ChunkCount();
+
+    // Новая инструкция в середине программы
+    Replace(program, "x = 10\n"s, "x = 10\ny = x + 1\nprint y\n"s);
+    ASSERT_EQUAL(program.ChunkCount(), chunks + 2u);
+    ASSERT_EQUAL(RunIncremental(program), RunFull(program.Source()));
+
+    // Новый метод в конце класса: строки с отступом присоединяются к фрагменту класса
+    Replace(program, "    return 'named'\n"s, "    return 'named'\n  def twice():\n    return self.add(2) * 2\n"s);
+    Replace(program, "print 'done'"s, "print d.twice()"s);
+    ASSERT_EQUAL(program.ChunkCount(), chunks + 2u);
+    ASSERT_EQUAL(RunIncremental(program), RunFull(program.Source()));
+
+    // Удаление нескольких инструкций целиком
+    Replace(program, "y = x + 1\nprint y\n"s, ""s);
+    ASSERT_EQUAL(program.ChunkCount(), chunks);
+    ASSERT_EQUAL(RunIncremental(program), RunFull(program.Source()));
+
+    // Полная замена текста и вставка в самое начало
+    program.SetSource("print 1\n"s);
+    program.Edit(0u, 0u, "print 0\n"s);
+    ASSERT_EQUAL(RunIncremental(program), "0\n1\n"s);
+    ASSERT_EQUAL(program.Edit(program.Source().size(), 0u, "print 2\n"s), 1u);
+    ASSERT_EQUAL(RunIncremental(program), "0\n1\n2\n"s);
+}
+
+void TestFailedEditKeepsProgram() {
+    IncrementalProgram program(PROGRAM);
+    const string expected = RunFull(PROGRAM);
+
+    for (const auto& [from, to] : {pair{"x = 10"s, "x = = 10"s}, pair{"class Named(Counter)"s, "class Named(Missing)"s},
+                                   pair{"class Named"s, "class Counter"s}}) {
+        try {
+            Replace(program, from, to);
+            ASSERT(false);
+        }
+        catch (const std::exception&) {
+        }
+        ASSERT_EQUAL(program.Source(), PROGRAM);
+        ASSERT_EQUAL(RunIncremental(program), expected);
+    }
+
+    try {
+        program.Edit(PROGRAM.size() + 1u, 0u, "x"s);
+        ASSERT(false);
+    }
+    catch (const std::out_of_range&) {
+    }
+}
+
+// Экземпляры, созданные до правки класса, продолжают работать со старой версией методов
+void TestInstancesSurviveClassEdit() {
+    IncrementalProgram program(PROGRAM);
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    program.Execute(closure, context);
+
+    Replace(program, "self.n = self.n + k"s, "self.n = self.n - k"s);
+    runtime::ObjectHolder old_counter = closure.at("c"s);
+    runtime::ClassInstance* instance = old_counter.TryAs<runtime::ClassInstance>();
+    ASSERT(instance != nullptr);
+    runtime::ObjectHolder result = instance->Call("add"s, {runtime::ObjectHolder::Own(runtime::Number(1))}, context);
+    ASSERT_EQUAL(result.TryAs<runtime::Number>()->GetValue(), 6);
+
+    program.Execute(closure, context);
+    ASSERT_EQUAL(closure.at("c"s).TryAs<runtime::ClassInstance>()->Call("add"s, {runtime::ObjectHolder::Own(runtime::Number(1))}, context).TryAs<runtime::Number>()->GetValue(), -6);
+}
+
+}  // namespace
+
+void RunIncrementalParseTests(TestRunner& tr) {
+    RUN_TEST(tr, parse::TestEditReparsesOnlyAffectedChunks);
+    RUN_TEST(tr, parse::TestEditChangesChunkBoundaries);
+    RUN_TEST(tr, parse::TestFailedEditKeepsProgram);
+    RUN_TEST(tr, parse::TestInstancesSurviveClassEdit);
+}
+
+}  // namespace parse
@@ -0,0 +1,471 @@
+#include "int_array.h"
+
+#include <algorithm>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define MYTHON_AVX2_KERNELS 1
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace runtime {
+
+namespace {
+
+/*
+ * Ядра массовых операций. Поэлементные операции получают шаг по каждому операнду:
+ * 1 - операнд является массивом, 0 - операнд является числом, повторяемым для всех элементов.
+ * Min и Max вызываются только для непустых массивов.
+ */
+struct Kernels {
+    int64_t (*sum)(const int64_t* data, size_t size);
+    int64_t (*min)(const int64_t* data, size_t size);
+    int64_t (*max)(const int64_t* data, size_t size);
+    int64_t (*dot)(const int64_t* lhs, const int64_t* rhs, size_t size);
+    void (*fill)(int64_t* data, size_t size, int64_t value);
+    void (*apply)(ArrayOp op, const int64_t* lhs, size_t lhs_step, const int64_t* rhs, size_t rhs_step, int64_t* out, size_t size);
+};
+
+// Арифметика по модулю 2^64 без неопределённого поведения при переполнении
+int64_t WrapAdd(int64_t lhs, int64_t rhs) {
+    return static_cast<int64_t>(static_cast<uint64_t>(lhs) + static_cast<uint64_t>(rhs));
+}
+
+int64_t WrapSub(int64_t lhs, int64_t rhs) {
+    return static_cast<int64_t>(static_cast<uint64_t>(lhs) - static_cast<uint64_t>(rhs));
+}
+
+int64_t WrapMul(int64_t lhs, int64_t rhs) {
+    return static_cast<int64_t>(static_cast<uint64_t>(lhs) * static_cast<uint64_t>(rhs));
+}
+
+int64_t SumScalar(const int64_t* data, size_t size) {
+    int64_t result = 0;
+    for (size_t i = 0u; i < size; ++i) {
+        result = WrapAdd(result, data[i]);
+    }
+    return result;
+}
+
+int64_t MinScalar(const int64_t* data, size_t size) {
+    return *std::min_element(data, data + size);
+}
+
+int64_t MaxScalar(const int64_t* data, size_t size) {
+    return *std::max_element(data, data + size);
+}
+
+int64_t DotScalar(const int64_t* lhs, const int64_t* rhs, size_t size) {
+    int64_t result = 0;
+    for (size_t i = 0u; i < size; ++i) {
+        result = WrapAdd(result, WrapMul(lhs[i], rhs[i]));
+    }
+    return result;
+}
+
+void FillScalar(int64_t* data, size_t size, int64_t value) {
+    std::fill(data, data + size, value);
+}
+
+void ApplyScalar(ArrayOp op, const int64_t* lhs, size_t lhs_step, const int64_t* rhs, size_t rhs_step, int64_t* out, size_t size) {
+    for (size_t i = 0u; i < size; ++i) {
+        const int64_t a = lhs[i * lhs_step];
+        const int64_t b = rhs[i * rhs_step];
+        switch (op) {
+            case ArrayOp::Add: out[i] = WrapAdd(a, b); break;
+            case ArrayOp::Sub: out[i] = WrapSub(a, b); break;
+            case ArrayOp::Mul: out[i] = WrapMul(a, b); break;
+        }
+    }
+}
+
+constexpr Kernels SCALAR_KERNELS{SumScalar, MinScalar, MaxScalar, DotScalar, FillScalar, ApplyScalar};
+
+#ifdef MYTHON_AVX2_KERNELS
+
+constexpr size_t LANES = 4u;
+
+#define MYTHON_AVX2 __attribute__((target("avx2")))
+
+MYTHON_AVX2 inline __m256i Load(const int64_t* data) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+}
+
+MYTHON_AVX2 inline void Store(int64_t* data, __m256i value) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(data), value);
+}
+
+// В AVX2 нет умножения 64-битных целых, поэтому собираем младшие 64 бита произведения
+// из трёх умножений 32x32->64: lo*lo + ((lo*hi + hi*lo) << 32)
+MYTHON_AVX2 inline __m256i Mul64(__m256i lhs, __m256i rhs) {
+    const __m256i low = _mm256_mul_epu32(lhs, rhs);
+    const __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(lhs, 32), rhs), _mm256_mul_epu32(lhs, _mm256_srli_epi64(rhs, 32)));
+    return _mm256_add_epi64(low, _mm256_slli_epi64(cross, 32));
+}
+
+MYTHON_AVX2 inline __m256i Min64(__m256i lhs, __m256i rhs) {
+    return _mm256_blendv_epi8(lhs, rhs, _mm256_cmpgt_epi64(lhs, rhs));
+}
+
+MYTHON_AVX2 inline __m256i Max64(__m256i lhs, __m256i rhs) {
+    return _mm256_blendv_epi8(rhs, lhs, _mm256_cmpgt_epi64(lhs, rhs));
+}
+
+MYTHON_AVX2 inline int64_t HorizontalSum(__m256i value) {
+    alignas(32) int64_t lanes[LANES];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), value);
+    return WrapAdd(WrapAdd(lanes[0], lanes[1]), WrapAdd(lanes[2], lanes[3]));
+}
+
+MYTHON_AVX2 int64_t SumAvx2(const int64_t* data, size_t size) {
+    // Два независимых аккумулятора скрывают задержку сложения
+    __m256i acc0 = _mm256_setzero_si256();
+    __m256i acc1 = _mm256_setzero_si256();
+    size_t i = 0u;
+    for (; i + 2u * LANES <= size; i += 2u * LANES) {
+        acc0 = _mm256_add_epi64(acc0, Load(data + i));
+        acc1 = _mm256_add_epi64(acc1, Load(data + i + LANES));
+    }
+    int64_t result = HorizontalSum(_mm256_add_epi64(acc0, acc1));
+    for (; i < size; ++i) {
+        result = WrapAdd(result, data[i]);
+    }
+    return result;
+}
+
+template <bool IsMin>
+MYTHON_AVX2 int64_t MinMaxAvx2(const int64_t* data, size_t size) {
+    size_t i = 0u;
+    int64_t result = data[0];
+    if (size >= LANES) {
+        __m256i acc = Load(data);
+        for (i = LANES; i + LANES <= size; i += LANES) {
+            acc = IsMin ? Min64(acc, Load(data + i)) : Max64(acc, Load(data + i));
+        }
+        alignas(32) int64_t lanes[LANES];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), acc);
+        result = IsMin ? *std::min_element(lanes, lanes + LANES) : *std::max_element(lanes, lanes + LANES);
+    }
+    for (; i < size; ++i) {
+        result = IsMin ? std::min(result, data[i]) : std::max(result, data[i]);
+    }
+    return result;
+}
+
+MYTHON_AVX2 int64_t MinAvx2(const int64_t* data, size_t size) {
+    return MinMaxAvx2<true>(data, size);
+}
+
+MYTHON_AVX2 int64_t MaxAvx2(const int64_t* data, size_t size) {
+    return MinMaxAvx2<false>(data, size);
+}
+
+MYTHON_AVX2 int64_t DotAvx2(const int64_t* lhs, const int64_t* rhs, size_t size) {
+    __m256i acc = _mm256_setzero_si256();
+    size_t i = 0u;
+    for (; i + LANES <= size; i += LANES) {
+        acc = _mm256_add_epi64(acc, Mul64(Load(lhs + i), Load(rhs + i)));
+    }
+    int64_t result = HorizontalSum(acc);
+    for (; i < size; ++i) {
+        result = WrapAdd(result, WrapMul(lhs[i], rhs[i]));
+    }
+    return result;
+}
+
+MYTHON_AVX2 void FillAvx2(int64_t* data, size_t size, int64_t value) {
+    const __m256i broadcast = _mm256_set1_epi64x(value);
+    size_t i = 0u;
+    for (; i + LANES <= size; i += LANES) {
+        Store(data + i, broadcast);
+    }
+    for (; i < size; ++i) {
+        data[i] = value;
+    }
+}
+
+template <ArrayOp Op>
+MYTHON_AVX2 inline __m256i ApplyLanes(__m256i lhs, __m256i rhs) {
+    if constexpr (Op == ArrayOp::Add) {
+        return _mm256_add_epi64(lhs, rhs);
+    }
+    else if constexpr (Op == ArrayOp::Sub) {
+        return _mm256_sub_epi64(lhs, rhs);
+    }
+    else {
+        return Mul64(lhs, rhs);
+    }
+}
+
+// Шаги операндов - параметры шаблона, чтобы выбор между загрузкой и размножением числа не попадал в цикл
+template <ArrayOp Op, size_t LhsStep, size_t RhsStep>
+MYTHON_AVX2 void ApplyAvx2Loop(const int64_t* lhs, const int64_t* rhs, int64_t* out, size_t size) {
+    // Операнд-массив может быть пустым, поэтому читаем первый элемент только у числа
+    const __m256i lhs_broadcast = LhsStep ? _mm256_setzero_si256() : _mm256_set1_epi64x(lhs[0]);
+    const __m256i rhs_broadcast = RhsStep ? _mm256_setzero_si256() : _mm256_set1_epi64x(rhs[0]);
+    size_t i = 0u;
+    for (; i + LANES <= size; i += LANES) {
+        const __m256i a = LhsStep ? Load(lhs + i) : lhs_broadcast;
+        const __m256i b = RhsStep ? Load(rhs + i) : rhs_broadcast;
+        Store(out + i, ApplyLanes<Op>(a, b));
+    }
+    ApplyScalar(Op, lhs + i * LhsStep, LhsStep, rhs + i * RhsStep, RhsStep, out + i, size - i);
+}
+
+template <ArrayOp Op>
+MYTHON_AVX2 void ApplyAvx2(const int64_t* lhs, size_t lhs_step, const int64_t* rhs, size_t rhs_step, int64_t* out, size_t size) {
+    if (lhs_step && rhs_step) {
+        ApplyAvx2Loop<Op, 1u, 1u>(lhs, rhs, out, size);
+    }
+    else if (lhs_step) {
+        ApplyAvx2Loop<Op, 1u, 0u>(lhs, rhs, out, size);
+    }
+    else {
+        ApplyAvx2Loop<Op, 0u, 1u>(lhs, rhs, out, size);
+    }
+}
+
+void ApplyAvx2Dispatch(ArrayOp op, const int64_t* lhs, size_t lhs_step, const int64_t* rhs, size_t rhs_step, int64_t* out, size_t size) {
+    switch (op) {
+        case ArrayOp::Add: ApplyAvx2<ArrayOp::Add>(lhs, lhs_step, rhs, rhs_step, out, size); break;
+        case ArrayOp::Sub: ApplyAvx2<ArrayOp::Sub>(lhs, lhs_step, rhs, rhs_step, out, size); break;
+        case ArrayOp::Mul: ApplyAvx2<ArrayOp::Mul>(lhs, lhs_step, rhs, rhs_step, out, size); break;
+    }
+}
+
+#undef MYTHON_AVX2
+
+constexpr Kernels AVX2_KERNELS{SumAvx2, MinAvx2, MaxAvx2, DotAvx2, FillAvx2, ApplyAvx2Dispatch};
+
+#endif  // MYTHON_AVX2_KERNELS
+
+bool DetectSimd() {
+#ifdef MYTHON_AVX2_KERNELS
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+const Kernels* SelectKernels(bool simd) {
+#ifdef MYTHON_AVX2_KERNELS
+    if (simd) {
+        return &AVX2_KERNELS;
+    }
+#endif
+    return &SCALAR_KERNELS;
+}
+
+const Kernels*& ActiveKernels() {
+    static const Kernels* kernels = SelectKernels(IntArray::SimdAvailable());
+    return kernels;
+}
+
+// Извлекает целое число из аргумента метода или операнда
+int64_t ToElement(const ObjectHolder& value, const char* what) {
+    if (auto* number = value.TryAs<Number>()) {
+        return number->GetValue();
+    }
+    if (auto* big = value.TryAs<BigNumber>(); big && big->GetValue().FitsInt64()) {
+        return big->GetValue().ToInt64();
+    }
+    throw std::runtime_error("IntArray: "s + what + " must be an integer"s);
+}
+
+bool TryGetElement(const ObjectHolder& value, int64_t& element) {
+    if (value.TryAs<Number>() || value.TryAs<BigNumber>()) {
+        element = ToElement(value, "operand");
+        return true;
+    }
+    return false;
+}
+
+size_t ToIndex(const ObjectHolder& value, size_t size) {
+    const int64_t index = ToElement(value, "index");
+    if (index < 0 || static_cast<uint64_t>(index) >= size) {
+        throw std::out_of_range("IntArray index out of range"s);
+    }
+    return static_cast<size_t>(index);
+}
+
+// Элемент как значение Mython: Number, если помещается в int, иначе BigNumber
+ObjectHolder MakeElement(int64_t value) {
+    if (value >= std::numeric_limits<int>::min() && value <= std::numeric_limits<int>::max()) {
+        return ObjectHolder::Own(Number(static_cast<int>(value)));
+    }
+    return ObjectHolder::Own(BigNumber(BigInt(value)));
+}
+
+void CheckSameSize(const IntArray& lhs, const IntArray& rhs) {
+    if (lhs.Size() != rhs.Size()) {
+        throw std::runtime_error("IntArray sizes differ: "s + std::to_string(lhs.Size()) + " and "s + std::to_string(rhs.Size()));
+    }
+}
+
+void CheckArgumentCount(const std::string& method_name, const std::vector<ObjectHolder>& args, size_t expected) {
+    if (args.size() != expected) {
+        throw std::runtime_error("IntArray."s + method_name + " takes "s + std::to_string(expected) + " arguments"s);
+    }
+}
+
+}  // namespace
+
+IntArray::IntArray(size_t size, int64_t value) : m_values(size) {
+    Fill(value);
+}
+
+IntArray::IntArray(std::vector<int64_t> values) : m_values(std::move(values)) {}
+
+size_t IntArray::Size() const {
+    return m_values.size();
+}
+
+const std::vector<int64_t>& IntArray::Values() const {
+    return m_values;
+}
+
+int64_t IntArray::Get(size_t index) const {
+    return m_values.at(index);
+}
+
+void IntArray::Set(size_t index, int64_t value) {
+    m_values.at(index) = value;
+}
+
+void IntArray::Fill(int64_t value) {
+    ActiveKernels()->fill(m_values.data(), m_values.size(), value);
+}
+
+int64_t IntArray::Sum() const {
+    return ActiveKernels()->sum(m_values.data(), m_values.size());
+}
+
+int64_t IntArray::Min() const {
+    if (m_values.empty()) {
+        throw std::runtime_error("IntArray.min of an empty array"s);
+    }
+    return ActiveKernels()->min(m_values.data(), m_values.size());
+}
+
+int64_t IntArray::Max() const {
+    if (m_values.empty()) {
+        throw std::runtime_error("IntArray.max of an empty array"s);
+    }
+    return ActiveKernels()->max(m_values.data(), m_values.size());
+}
+
+int64_t IntArray::Dot(const IntArray& other) const {
+    CheckSameSize(*this, other);
+    return ActiveKernels()->dot(m_values.data(), other.m_values.data(), m_values.size());
+}
+
+IntArray IntArray::Apply(ArrayOp op, const IntArray& lhs, const IntArray& rhs) {
+    CheckSameSize(lhs, rhs);
+    std::vector<int64_t> result(lhs.Size());
+    ActiveKernels()->apply(op, lhs.m_values.data(), 1u, rhs.m_values.data(), 1u, result.data(), result.size());
+    return IntArray(std::move(result));
+}
+
+IntArray IntArray::Apply(ArrayOp op, const IntArray& lhs, int64_t rhs) {
+    std::vector<int64_t> result(lhs.Size());
+    ActiveKernels()->apply(op, lhs.m_values.data(), 1u, &rhs, 0u, result.data(), result.size());
+    return IntArray(std::move(result));
+}
+
+IntArray IntArray::Apply(ArrayOp op, int64_t lhs, const IntArray& rhs) {
+    std::vector<int64_t> result(rhs.Size());
+    ActiveKernels()->apply(op, &lhs, 0u, rhs.m_values.data(), 1u, result.data(), result.size());
+    return IntArray(std::move(result));
+}
+
+ObjectHolder IntArray::Call(const std::string& method_name, const std::vector<ObjectHolder>& args) {
+    if (method_name == "get"sv) {
+        CheckArgumentCount(method_name, args, 1u);
+        return MakeElement(m_values[ToIndex(args[0], m_values.size())]);
+    }
+    if (method_name == "set"sv) {
+        CheckArgumentCount(method_name, args, 2u);
+        m_values[ToIndex(args[0], m_values.size())] = ToElement(args[1], "value");
+        return ObjectHolder::None();
+    }
+    if (method_name == "len"sv) {
+        CheckArgumentCount(method_name, args, 0u);
+        return MakeElement(static_cast<int64_t>(m_values.size()));
+    }
+    if (method_name == "sum"sv) {
+        CheckArgumentCount(method_name, args, 0u);
+        return MakeElement(Sum());
+    }
+    if (method_name == "min"sv) {
+        CheckArgumentCount(method_name, args, 0u);
+        return MakeElement(Min());
+    }
+    if (method_name == "max"sv) {
+        CheckArgumentCount(method_name, args, 0u);
+        return MakeElement(Max());
+    }
+    if (method_name == "dot"sv) {
+        CheckArgumentCount(method_name, args, 1u);
+        const IntArray* other = args[0].TryAs<IntArray>();
+        if (!other) {
+            throw std::runtime_error("IntArray.dot expects an IntArray"s);
+        }
+        return MakeElement(Dot(*other));
+    }
+    if (method_name == "fill"sv) {
+        CheckArgumentCount(method_name, args, 1u);
+        Fill(ToElement(args[0], "value"));
+        return ObjectHolder::None();
+    }
+    throw std::runtime_error("IntArray has no method "s + method_name);
+}
+
+void IntArray::Print(std::ostream& os, [[maybe_unused]] Context& context) {
+    os << '[';
+    for (size_t i = 0u; i < m_values.size(); ++i) {
+        if (i) {
+            os << ", "sv;
+        }
+        os << m_values[i];
+    }
+    os << ']';
+}
+
+bool IntArray::SimdAvailable() {
+    static const bool available = DetectSimd();
+    return available;
+}
+
+void IntArray::EnableSimd(bool enabled) {
+    ActiveKernels() = SelectKernels(enabled && SimdAvailable());
+}
+
+bool TryArrayOperation(ArrayOp op, const ObjectHolder& lhs, const ObjectHolder& rhs, ObjectHolder& result) {
+    const IntArray* lhs_array = lhs.TryAs<IntArray>();
+    const IntArray* rhs_array = rhs.TryAs<IntArray>();
+    int64_t scalar = 0;
+    if (lhs_array && rhs_array) {
+        result = ObjectHolder::Own(IntArray::Apply(op, *lhs_array, *rhs_array));
+    }
+    else if (lhs_array && TryGetElement(rhs, scalar)) {
+        result = ObjectHolder::Own(IntArray::Apply(op, *lhs_array, scalar));
+    }
+    else if (rhs_array && TryGetElement(lhs, scalar)) {
+        result = ObjectHolder::Own(IntArray::Apply(op, scalar, *rhs_array));
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+size_t OwnedHeapBytes(const IntArray& array) {
+    return array.Values().capacity() * sizeof(int64_t);
+}
+
+}  // namespace runtime
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "runtime.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace runtime {
+
+// Поэлементная операция над IntArray
+enum class ArrayOp {
+    Add,
+    Sub,
+    Mul,
+};
+
+/*
+ * Массив целых чисел с непрерывным хранением значений int64_t.
+ *
+ * Создаётся встроенной функцией IntArray(size) или IntArray(size, value). Методы, доступные из Mython:
+ *   get(i), set(i, value), len(), sum(), min(), max(), dot(other), fill(value).
+ * Операторы +, - и * применяются поэлементно к двум массивам одинаковой длины либо к массиву и числу.
+ *
+ * Массовые операции выполняются векторными ядрами AVX2, если процессор их поддерживает
+ * (проверяется один раз при первом обращении), иначе - скалярными циклами.
+ * Арифметика над элементами ведётся по модулю 2^64, как у беззнаковых целых, поэтому результат
+ * не зависит от выбранного ядра.
+ */
+class IntArray : public Object {
+public:
+    IntArray() = default;
+    explicit IntArray(size_t size, int64_t value = 0);
+    explicit IntArray(std::vector<int64_t> values);
+
+    [[nodiscard]] size_t Size() const;
+    [[nodiscard]] const std::vector<int64_t>& Values() const;
+
+    // Бросают std::out_of_range, если индекс вне массива
+    [[nodiscard]] int64_t Get(size_t index) const;
+    void Set(size_t index, int64_t value);
+
+    void Fill(int64_t value);
+
+    [[nodiscard]] int64_t Sum() const;
+    // Бросают std::runtime_error для пустого массива
+    [[nodiscard]] int64_t Min() const;
+    [[nodiscard]] int64_t Max() const;
+    // Бросает std::runtime_error, если длины массивов различаются
+    [[nodiscard]] int64_t Dot(const IntArray& other) const;
+
+    // Поэлементные операции. Бросают std::runtime_error, если длины массивов различаются
+    static IntArray Apply(ArrayOp op, const IntArray& lhs, const IntArray& rhs);
+    static IntArray Apply(ArrayOp op, const IntArray& lhs, int64_t rhs);
+    static IntArray Apply(ArrayOp op, int64_t lhs, const IntArray& rhs);
+
+    /*
+     * Вызывает встроенный метод массива с аргументами args.
+     * Бросает std::runtime_error, если метода нет или аргументы не подходят
+     */
+    ObjectHolder Call(const std::string& method_name, const std::vector<ObjectHolder>& args);
+
+    // Выводит элементы через запятую в квадратных скобках: [1, 2, 3]
+    void Print(std::ostream& os, Context& context) override;
+
+    // Поддерживает ли процессор векторные ядра
+    static bool SimdAvailable();
+    // Включает или отключает векторные ядра (для проверки и замеров). Без поддержки процессора не действует
+    static void EnableSimd(bool enabled);
+
+private:
+    std::vector<int64_t> m_values;
+};
+
+/*
+ * Если lhs или rhs - IntArray, а второй операнд - IntArray или целое число, записывает в result
+ * результат поэлементной операции op и возвращает true. Иначе возвращает false
+ */
+bool TryArrayOperation(ArrayOp op, const ObjectHolder& lhs, const ObjectHolder& rhs, ObjectHolder& result);
+
+size_t OwnedHeapBytes(const IntArray& array);
+
+}  // namespace runtime
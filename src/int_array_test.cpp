@@ -0,0 +1,162 @@
+#include "int_array.h"
+#include "lexer.h"
+#include "parse.h"
+#include "runtime.h"
+#include "statement.h"
+#include "test_runner_p.h"
+
+#include <climits>
+#include <random>
+#include <sstream>
+#include <string>
+
+using namespace std;
+
+namespace runtime {
+
+namespace {
+
+IntArray RandomArray(mt19937_64& generator, size_t size) {
+    vector<int64_t> values(size);
+    for (int64_t& value : values) {
+        value = static_cast<int64_t>(generator());
+    }
+    return IntArray(std::move(values));
+}
+
+string RunProgram(const string& program) {
+    istringstream input(program);
+    parse::Lexer lexer(input);
+    auto tree = ParseProgram(lexer);
+    DummyContext context;
+    Closure closure;
+    tree->Execute(closure, context);
+    return context.output.str();
+}
+
+// Векторные ядра должны совпадать со скалярными на любых длинах, включая хвосты короче вектора
+void TestSimdMatchesScalar() {
+    mt19937_64 generator(11);
+    for (size_t size : {1u, 3u, 4u, 7u, 8u, 9u, 31u, 1000u}) {
+        const IntArray lhs = RandomArray(generator, size);
+        const IntArray rhs = RandomArray(generator, size);
+        const int64_t scalar = static_cast<int64_t>(generator());
+
+        struct Results {
+            int64_t sum, min, max, dot;
+            vector<vector<int64_t>> applied;
+        };
+        auto compute = [&]() {
+            Results results{lhs.Sum(), lhs.Min(), lhs.Max(), lhs.Dot(rhs), {}};
+            for (ArrayOp op : {ArrayOp::Add, ArrayOp::Sub, ArrayOp::Mul}) {
+                results.applied.push_back(IntArray::Apply(op, lhs, rhs).Values());
+                results.applied.push_back(IntArray::Apply(op, lhs, scalar).Values());
+                results.applied.push_back(IntArray::Apply(op, scalar, rhs).Values());
+            }
+            results.applied.push_back(IntArray(size, scalar).Values());
+            return results;
+        };
+
+        IntArray::EnableSimd(false);
+        const Results scalar_results = compute();
+        IntArray::EnableSimd(true);
+        const Results simd_results = compute();
+
+        ASSERT_EQUAL(simd_results.sum, scalar_results.sum);
+        ASSERT_EQUAL(simd_results.min, scalar_results.min);
+        ASSERT_EQUAL(simd_results.max, scalar_results.max);
+        ASSERT_EQUAL(simd_results.dot, scalar_results.dot);
+        ASSERT(simd_results.applied == scalar_results.applied);
+    }
+
+    const IntArray sample(vector<int64_t>{5, -3, 9, INT64_MIN, INT64_MAX, 0});
+    ASSERT_EQUAL(sample.Min(), INT64_MIN);
+    ASSERT_EQUAL(sample.Max(), INT64_MAX);
+    ASSERT_EQUAL(IntArray::Apply(ArrayOp::Sub, 10, sample).Get(1), 13);
+    ASSERT_EQUAL(IntArray::Apply(ArrayOp::Mul, sample, -2).Get(2), -18);
+}
+
+void TestIntArrayErrors() {
+    IntArray empty;
+    ASSERT_EQUAL(empty.Sum(), 0);
+    try {
+        [[maybe_unused]] int64_t value = empty.Min();
+        ASSERT(false);
+    }
+    catch (const std::runtime_error&) {
+    }
+
+    try {
+        [[maybe_unused]] IntArray sum = IntArray::Apply(ArrayOp::Add, IntArray(2u), IntArray(3u));
+        ASSERT(false);
+    }
+    catch (const std::runtime_error&) {
+    }
+
+    IntArray array(3u);
+    try {
+        array.Call("get"s, {ObjectHolder::Own(Number(3))});
+        ASSERT(false);
+    }
+    catch (const std::out_of_range&) {
+    }
+    try {
+        array.Call("push"s, {});
+        ASSERT(false);
+    }
+    catch (const std::runtime_error&) {
+    }
+}
+
+// Элементы, помещающиеся в int, возвращаются как Number, остальные - как BigNumber
+void TestElementsBecomeNumbersWhenTheyFit() {
+    IntArray array(vector<int64_t>{INT_MAX, int64_t{INT_MAX} + 1, INT_MIN, int64_t{INT_MIN} - 1});
+    auto get = [&array](int index) {
+        return array.Call("get"s, {ObjectHolder::Own(Number(index))});
+    };
+    ASSERT_EQUAL(get(0).TryAs<Number>()->GetValue(), INT_MAX);
+    ASSERT(get(1).TryAs<BigNumber>() != nullptr);
+    ASSERT_EQUAL(get(2).TryAs<Number>()->GetValue(), INT_MIN);
+    ASSERT(get(3).TryAs<BigNumber>() != nullptr);
+    ASSERT_EQUAL(get(3).TryAs<BigNumber>()->GetValue().ToString(), "-2147483649"s);
+}
+
+void TestIntArrayInProgram() {
+    const string program = R"(
+a = IntArray(5)
+class Loop:
+  def run(arr, i, n):
+    if i < n:
+      arr.set(i, i * i)
+      self.run(arr, i + 1, n)
+
+loop = Loop()
+loop.run(a, 0, 5)
+b = IntArray(5, 2)
+print a, a.len(), a.get(4)
+print a.sum(), a.min(), a.max(), a.dot(b)
+print a + b, a - 1, 3 * a
+c = a * b
+c.fill(7)
+print c, c.sum()
+big = IntArray(2, 2000000000)
+print big.sum()
+)"s;
+    ASSERT_EQUAL(RunProgram(program),
+                 "[0, 1, 4, 9, 16] 5 16\n"
+                 "30 0 16 60\n"
+                 "[2, 3, 6, 11, 18] [-1, 0, 3, 8, 15] [0, 3, 12, 27, 48]\n"
+                 "[7, 7, 7, 7, 7] 35\n"
+                 "4000000000\n"s);
+}
+
+}  // namespace
+
+void RunIntArrayTests(TestRunner& tr) {
+    RUN_TEST(tr, runtime::TestSimdMatchesScalar);
+    RUN_TEST(tr, runtime::TestIntArrayErrors);
+    RUN_TEST(tr, runtime::TestElementsBecomeNumbersWhenTheyFit);
+    RUN_TEST(tr, runtime::TestIntArrayInProgram);
+}
+
+}  // namespace runtime
@@ -0,0 +1,129 @@
+#include "isolate_heap.h"
+
+#include <sys/mman.h>
+
+#include <cstdint>
+#include <mutex>
+#include <new>
+
+namespace runtime {
+
+namespace {
+
+thread_local IsolateHeap* current_heap = nullptr;
+
+std::mutex cage_mutex;
+bool used_slots[IsolateHeap::MAX_ISOLATES] = {};
+
+size_t RoundUp(size_t size) {
+    return (size + IsolateHeap::ALIGNMENT - 1u) & ~(IsolateHeap::ALIGNMENT - 1u);
+}
+
+}  // namespace
+
+IsolateHeap::IsolateHeap() {
+    std::lock_guard lock(cage_mutex);
+    if (s_cage == nullptr) {
+        // Резервирование никогда не освобождается. Лишняя область нужна, чтобы внутри нашлось начало,
+        // выровненное по REGION_SIZE
+        void* reservation = mmap(nullptr, CAGE_SIZE + REGION_SIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (reservation == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+        const uintptr_t address = reinterpret_cast<uintptr_t>(reservation);
+        s_cage = static_cast<char*>(reservation) + (((address + REGION_SIZE - 1u) & ~(REGION_SIZE - 1u)) - address);
+    }
+    while (m_slot < MAX_ISOLATES && used_slots[m_slot]) {
+        ++m_slot;
+    }
+    if (m_slot == MAX_ISOLATES) {
+        throw std::bad_alloc();
+    }
+    m_begin = s_cage + m_slot * REGION_SIZE;
+    if (mprotect(m_begin, REGION_SIZE, PROT_READ | PROT_WRITE) != 0) {
+        throw std::bad_alloc();
+    }
+    used_slots[m_slot] = true;
+    // В начале области хранится указатель на владеющую ей кучу
+    *reinterpret_cast<IsolateHeap**>(m_begin) = this;
+    m_top = m_begin + ALIGNMENT;
+}
+
+IsolateHeap::~IsolateHeap() {
+    // Отображаем область заново, чтобы вернуть системе её страницы; адресное пространство остаётся зарезервированным
+    mmap(m_begin, REGION_SIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0);
+    std::lock_guard lock(cage_mutex);
+    used_slots[m_slot] = false;
+}
+
+size_t IsolateHeap::SizeClass(size_t size) {
+    return RoundUp(size) / ALIGNMENT - 1u;
+}
+
+void* IsolateHeap::Allocate(size_t size) {
+    if (size == 0u || size > MAX_SMALL_SIZE) {
+        return ::operator new(size);
+    }
+    const size_t rounded = RoundUp(size);
+    FreeBlock*& free_list = m_free[SizeClass(size)];
+    void* result = free_list;
+    if (free_list) {
+        free_list = free_list->next;
+    }
+    else {
+        if (static_cast<size_t>(m_begin + REGION_SIZE - m_top) < rounded) {
+            throw std::bad_alloc();
+        }
+        result = m_top;
+        m_top += rounded;
+    }
+    m_live_bytes += rounded;
+    m_allocated_bytes += rounded;
+    return result;
+}
+
+void IsolateHeap::Deallocate(void* ptr, size_t size) {
+    if (size == 0u || size > MAX_SMALL_SIZE) {
+        ::operator delete(ptr);
+        return;
+    }
+    const uintptr_t region = reinterpret_cast<uintptr_t>(ptr) & ~(REGION_SIZE - 1u);
+    (*reinterpret_cast<IsolateHeap**>(region))->Release(ptr, size);
+}
+
+void IsolateHeap::Release(void* ptr, size_t size) {
+    m_live_bytes -= RoundUp(size);
+    FreeBlock*& free_list = m_free[SizeClass(size)];
+    free_list = new (ptr) FreeBlock{free_list};
+}
+
+bool IsolateHeap::Contains(const void* ptr) const {
+    const char* p = static_cast<const char*>(ptr);
+    return p >= m_begin && p < m_top;
+}
+
+size_t IsolateHeap::FootprintBytes() const {
+    return static_cast<size_t>(m_top - m_begin);
+}
+
+size_t IsolateHeap::LiveBytes() const {
+    return m_live_bytes;
+}
+
+size_t IsolateHeap::AllocatedBytes() const {
+    return m_allocated_bytes;
+}
+
+IsolateHeap* IsolateHeap::Current() {
+    return current_heap;
+}
+
+IsolateHeap::Scope::Scope(IsolateHeap& heap) : m_previous(current_heap) {
+    current_heap = &heap;
+}
+
+IsolateHeap::Scope::~Scope() {
+    current_heap = m_previous;
+}
+
+}  // namespace runtime
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace runtime {
+
+/*
+ * Куча изолята: непрерывная область виртуальной памяти, в которой размещаются объекты Mython
+ * одного экземпляра интерпретатора.
+ *
+ * Пока на потоке действует IsolateHeap::Scope, ObjectHolder::Own выделяет память из текущей кучи
+ * изолята, а не из общей кучи процесса. Память выделяется сдвигом указателя в зарезервированной
+ * области, освобождённые блоки возвращаются в списки свободных блоков своего размерного класса.
+ * В результате объекты программы лежат плотно и рядом друг с другом, без заголовков malloc.
+ * Блоки крупнее MAX_SMALL_SIZE выделяются обычным operator new.
+ *
+ * Области всех куч изолятов - соседние участки одного резервирования процесса размером
+ * 2^32 * ALIGNMENT байт, поэтому блок любой кучи задаётся 32-битным смещением (см. Compress).
+ * ObjectHolder хранит такое смещение вместо адреса объекта, размещённого в куче изолята.
+ *
+ * Куча должна пережить все размещённые в ней объекты. Куча не потокобезопасна:
+ * одним изолятом пользуется один поток.
+ */
+class IsolateHeap {
+public:
+    // Гранулярность и выравнивание блоков
+    static constexpr size_t ALIGNMENT = 16u;
+    static constexpr size_t MAX_SMALL_SIZE = 512u;
+    // Размер резервируемой области. Область выровнена по своему размеру, поэтому кучу, которой
+    // принадлежит блок, можно найти по адресу блока, не храня указатель на неё в каждом объекте
+    static constexpr size_t REGION_SIZE = size_t{1} << 30;
+    // Сколько куч изолятов может существовать одновременно: столько областей помещается
+    // в пространство, адресуемое 32-битным смещением
+    static constexpr size_t MAX_ISOLATES = (size_t{1} << 32) * ALIGNMENT / REGION_SIZE;
+
+    // Занимает свободную область общего резервирования. Физическая память выделяется по мере использования.
+    // Бросает std::bad_alloc, если одновременно существует MAX_ISOLATES куч
+    IsolateHeap();
+    ~IsolateHeap();
+
+    IsolateHeap(const IsolateHeap&) = delete;
+    IsolateHeap& operator=(const IsolateHeap&) = delete;
+
+    void* Allocate(size_t size);
+
+    // Освобождает блок, выделенный Allocate любой кучи изолята
+    static void Deallocate(void* ptr, size_t size);
+
+    // Выделен ли ptr из области какой-либо кучи изолята
+    [[nodiscard]]
+    static bool IsIsolateBlock(const void* ptr) {
+        return s_cage != nullptr && reinterpret_cast<uintptr_t>(ptr) - reinterpret_cast<uintptr_t>(s_cage) < CAGE_SIZE;
+    }
+
+    // Смещение блока кучи изолята в единицах ALIGNMENT от начала общего резервирования
+    [[nodiscard]]
+    static uint32_t Compress(const void* ptr) {
+        return static_cast<uint32_t>((static_cast<const char*>(ptr) - s_cage) / ALIGNMENT);
+    }
+
+    // Адрес блока по смещению, полученному от Compress
+    [[nodiscard]]
+    static void* Decompress(uint32_t offset) {
+        return s_cage + size_t{offset} * ALIGNMENT;
+    }
+
+    // Лежит ли ptr внутри области кучи
+    [[nodiscard]]
+    bool Contains(const void* ptr) const;
+
+    // Сколько байт области уже занято (включая освобождённые блоки в списках свободных)
+    [[nodiscard]]
+    size_t FootprintBytes() const;
+
+    // Сколько байт выдано и ещё не освобождено
+    [[nodiscard]]
+    size_t LiveBytes() const;
+
+    // Сколько байт выдано за всё время жизни кучи
+    [[nodiscard]]
+    size_t AllocatedBytes() const;
+
+    // Куча изолята, действующая на текущем потоке, либо nullptr
+    [[nodiscard]]
+    static IsolateHeap* Current();
+
+    // Делает heap текущей кучей потока на время жизни объекта Scope
+    class Scope {
+    public:
+        explicit Scope(IsolateHeap& heap);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        IsolateHeap* m_previous;
+    };
+
+private:
+    static constexpr size_t CAGE_SIZE = MAX_ISOLATES * REGION_SIZE;
+    static constexpr size_t SIZE_CLASSES = MAX_SMALL_SIZE / ALIGNMENT;
+
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    static size_t SizeClass(size_t size);
+    void Release(void* ptr, size_t size);
+
+    // Начало общего резервирования. Задаётся при создании первой кучи и больше не меняется
+    static inline char* s_cage = nullptr;
+
+    size_t m_slot = 0u;
+    char* m_begin = nullptr;
+    char* m_top = nullptr;
+    FreeBlock* m_free[SIZE_CLASSES] = {};
+    size_t m_live_bytes = 0u;
+    size_t m_allocated_bytes = 0u;
+};
+
+}  // namespace runtime
@@ -0,0 +1,103 @@
+#include "isolate_heap.h"
+#include "runtime.h"
+#include "test_runner_p.h"
+
+#include <vector>
+
+using namespace std;
+
+namespace runtime {
+
+namespace {
+
+void TestOwnUsesCurrentIsolateHeap() {
+    IsolateHeap heap;
+    ObjectHolder outside = ObjectHolder::Own(Number(1));
+    {
+        IsolateHeap::Scope scope(heap);
+        ASSERT_EQUAL(IsolateHeap::Current(), &heap);
+
+        AllocationCounter counter;
+        ObjectHolder inside = ObjectHolder::Own(Number(2));
+        const size_t allocations = counter.Count();
+        ASSERT_EQUAL(allocations, 0u);
+        ASSERT(heap.Contains(inside.Get()));
+        ASSERT(heap.LiveBytes() > 0u);
+        ASSERT_EQUAL(inside.TryAs<Number>()->GetValue(), 2);
+    }
+    ASSERT(IsolateHeap::Current() == nullptr);
+    ASSERT(!heap.Contains(outside.Get()));
+    ASSERT_EQUAL(heap.LiveBytes(), 0u);
+}
+
+void TestFreedBlocksAreReused() {
+    IsolateHeap heap;
+    IsolateHeap::Scope scope(heap);
+
+    vector<ObjectHolder> numbers;
+    for (int i = 0; i < 100; ++i) {
+        numbers.push_back(ObjectHolder::Own(Number(i)));
+    }
+    const size_t footprint = heap.FootprintBytes();
+    numbers.clear();
+    ASSERT_EQUAL(heap.LiveBytes(), 0u);
+
+    for (int i = 0; i < 100; ++i) {
+        numbers.push_back(ObjectHolder::Own(Number(i)));
+    }
+    ASSERT_EQUAL(heap.FootprintBytes(), footprint);
+}
+
+void TestNestedScopes() {
+    IsolateHeap outer;
+    IsolateHeap inner;
+    IsolateHeap::Scope outer_scope(outer);
+    {
+        IsolateHeap::Scope inner_scope(inner);
+        ObjectHolder value = ObjectHolder::Own(String("inner"s));
+        ASSERT(inner.Contains(value.Get()));
+    }
+    ASSERT_EQUAL(IsolateHeap::Current(), &outer);
+    ObjectHolder value = ObjectHolder::Own(String("outer"s));
+    ASSERT(outer.Contains(value.Get()));
+}
+
+void TestHolderReferencesIsolateObjectByOffset() {
+    static_assert(sizeof(ObjectHolder) == sizeof(void*));
+    IsolateHeap heap;
+    ObjectHolder copy;
+    {
+        IsolateHeap::Scope scope(heap);
+        ObjectHolder value = ObjectHolder::Own(String("compressed"s));
+        ASSERT(IsolateHeap::IsIsolateBlock(value.Get()));
+        ASSERT_EQUAL(IsolateHeap::Decompress(IsolateHeap::Compress(value.Get())), static_cast<void*>(value.Get()));
+        copy = value;
+    }
+    // Ссылка остаётся действительной и после выхода из Scope
+    ASSERT(heap.Contains(copy.Get()));
+    ASSERT_EQUAL(copy.TryAs<String>()->GetValue(), "compressed"s);
+    copy = ObjectHolder::None();
+    ASSERT_EQUAL(heap.LiveBytes(), 0u);
+}
+
+void TestHeapSlotsAreReused() {
+    // Последовательно созданных куч больше, чем областей в резервировании
+    for (size_t i = 0; i < IsolateHeap::MAX_ISOLATES + 1u; ++i) {
+        IsolateHeap heap;
+        IsolateHeap::Scope scope(heap);
+        ObjectHolder value = ObjectHolder::Own(Number(static_cast<int>(i)));
+        ASSERT(heap.Contains(value.Get()));
+    }
+}
+
+}  // namespace
+
+void RunIsolateHeapTests(TestRunner& tr) {
+    RUN_TEST(tr, runtime::TestOwnUsesCurrentIsolateHeap);
+    RUN_TEST(tr, runtime::TestFreedBlocksAreReused);
+    RUN_TEST(tr, runtime::TestNestedScopes);
+    RUN_TEST(tr, runtime::TestHolderReferencesIsolateObjectByOffset);
+    RUN_TEST(tr, runtime::TestHeapSlotsAreReused);
+}
+
+}  // namespace runtime
@@ -1,7 +1,13 @@
 #include "lexer.h"
+#include "spsc_queue.h"
 
 #include <algorithm>
+#include <atomic>
 #include <charconv>
+#include <exception>
+#include <istream>
+#include <string_view>
+#include <thread>
 #include <unordered_map>
 
 using namespace std;
@@ -20,9 +26,15 @@ bool operator==(const Token& lhs, const Token& rhs) {
     if (lhs.Is<Number>()) {
         return lhs.As<Number>().value == rhs.As<Number>().value;
     }
+    if (lhs.Is<BigNumber>()) {
+        return lhs.As<BigNumber>().value == rhs.As<BigNumber>().value;
+    }
     if (lhs.Is<String>()) {
         return lhs.As<String>().value == rhs.As<String>().value;
     }
+    if (lhs.Is<FormatString>()) {
+        return lhs.As<FormatString>().value == rhs.As<FormatString>().value;
+    }
     if (lhs.Is<Id>()) {
         return lhs.As<Id>().value == rhs.As<Id>().value;
     }
@@ -39,8 +51,10 @@ std::ostream& operator<<(std::ostream& os, const Token& rhs) {
 #define VALUED_OUTPUT(type) if (auto p = rhs.TryAs<type>()) return os << #type << '{' << p->value << '}';
 
     VALUED_OUTPUT(Number);
+    VALUED_OUTPUT(BigNumber);
     VALUED_OUTPUT(Id);
     VALUED_OUTPUT(String);
+    VALUED_OUTPUT(FormatString);
     VALUED_OUTPUT(Char);
 
 #undef VALUED_OUTPUT
@@ -51,6 +65,7 @@ std::ostream& operator<<(std::ostream& os, const Token& rhs) {
     UNVALUED_OUTPUT(Return);
     UNVALUED_OUTPUT(If);
     UNVALUED_OUTPUT(Else);
+    UNVALUED_OUTPUT(Elif);
     UNVALUED_OUTPUT(Def);
     UNVALUED_OUTPUT(Newline);
     UNVALUED_OUTPUT(Print);
@@ -66,6 +81,7 @@ std::ostream& operator<<(std::ostream& os, const Token& rhs) {
     UNVALUED_OUTPUT(None);
     UNVALUED_OUTPUT(True);
     UNVALUED_OUTPUT(False);
+    UNVALUED_OUTPUT(Is);
     UNVALUED_OUTPUT(Eof);
 
 #undef UNVALUED_OUTPUT
@@ -183,10 +199,36 @@ namespace utility {
         return false;
     }
 
+    bool TokenParser::ProcessFormatStringLiteral(State& state) {
+        if(PeekChar(state.input) != token_const::FORMAT_PREFIX) {
+            return false;
+        }
+        GetChar(state.input);
+        const char quote_ch = PeekChar(state.input);
+        if(state.input.eof() || (quote_ch != '\"' && quote_ch != '\'')) {
+            // Обычный идентификатор, начинающийся с f
+            state.input.clear();
+            state.input.putback(token_const::FORMAT_PREFIX);
+            return false;
+        }
+        GetChar(state.input);
+        std::string str = SaveCharWhile(state.input, [&quote_ch](const char ch){return ch != quote_ch;});
+        state.token_queue.push_back(token_type::FormatString{std::move(str)});
+        GetChar(state.input);
+        return true;
+    }
+
     bool TokenParser::ProcessIntLiteral(State& state) {
         if(std::isdigit(PeekChar(state.input))) {
             std::string str = SaveCharWhile(state.input, [](const char ch){return std::isdigit(ch);});
-            state.token_queue.push_back(token_type::Number{std::stoi(str)});
+            int value = 0;
+            if (std::from_chars(str.data(), str.data() + str.size(), value).ec == std::errc::result_out_of_range) {
+                // Значение станет BigNumber при разборе
+                state.token_queue.push_back(token_type::BigNumber{std::move(str)});
+            }
+            else {
+                state.token_queue.push_back(token_type::Number{value});
+            }
             return true;
         }
         return false;
@@ -205,7 +247,10 @@ namespace utility {
         static const std::function<bool(char)> is_in_special = [](const char ch) {return std::isalpha(ch) || ch == '=' || ch == '>' || ch == '<' || ch == '!';};
         if(is_in_special(PeekChar(state.input))) {
             const std::string str = SaveCharWhile(state.input, is_in_special);
-            if(token_const::SPECIAL_WORDS.count(str)) {
+            // Ключевое слово в начале идентификатора (is_empty, not_found2) остаётся частью идентификатора
+            const unsigned char next_ch = static_cast<unsigned char>(PeekChar(state.input));
+            const bool continues_id = !state.input.eof() && std::isalpha(static_cast<unsigned char>(str.front())) && (next_ch == '_' || std::isdigit(next_ch));
+            if(!continues_id && token_const::SPECIAL_WORDS.count(str)) {
                 state.token_queue.push_back(token_const::SPECIAL_WORDS.at(str));
                 return true;
             }
@@ -323,9 +368,10 @@ namespace utility {
                     size_t cut_to_pos = cut_from_pos + cut_range;
                     token_queue.erase(token_queue.cbegin() + cut_from_pos, token_queue.cbegin() + cut_to_pos);
                     token_queue.insert(token_queue.cbegin() + cut_from_pos, intent_diff, token_type::Indent{});
-                    sz -= cut_range;
-                    max_idx -= cut_range;
-                    i -= cut_range;
+                    // Вставленные лексемы тоже учитываются, иначе конец очереди обрезается вместе с инструкциями
+                    sz = sz - cut_range + intent_diff;
+                    max_idx = sz - 1u;
+                    i = cut_from_pos + intent_diff;
                 }
                 else if(intent_ct < detent_ct && intent_ct >= 1u && detent_ct > 1u) {
                     size_t intent_diff = detent_ct - intent_ct;
@@ -334,9 +380,9 @@ namespace utility {
                     size_t cut_to_pos = cut_from_pos + cut_range;
                     token_queue.erase(token_queue.cbegin() + cut_from_pos, token_queue.cbegin() + cut_to_pos);
                     token_queue.insert(token_queue.cbegin() + cut_from_pos, intent_diff, token_type::Dedent{});
-                    sz -= cut_range;
-                    max_idx -= cut_range;
-                    i -= cut_range;
+                    sz = sz - cut_range + intent_diff;
+                    max_idx = sz - 1u;
+                    i = cut_from_pos + intent_diff;
                 }
                 else if(intent_ct != 0u && detent_ct != 0u && intent_ct == detent_ct) {
                     size_t cut_from_pos = last_not_intent_pos + 2u;
@@ -381,6 +427,10 @@ namespace utility {
                     break;
                 }
 
+                if(ProcessFormatStringLiteral(current_state)) {
+                    SkipSpaces(current_state);
+                    continue;
+                }
                 if(ProcessStringLiteral(current_state)) {
                     SkipSpaces(current_state);
                 }
@@ -393,6 +443,8 @@ namespace utility {
                 }
                 if(ProcessOperator(current_state)) {
                     SkipSpaces(current_state);
+                    // За оператором может идти ключевое слово: x = True
+                    continue;
                 }
                 if(ProcessId(current_state)) {
                     SkipSpaces(current_state);
@@ -403,6 +455,160 @@ namespace utility {
 
         return result_token_queue;
     }
+
+    TopLevelChunkReader::TopLevelChunkReader(std::istream& input) : m_input(input) {}
+
+    bool TopLevelChunkReader::Next(std::string& chunk) {
+        chunk.clear();
+        if (m_has_pending) {
+            AppendLine(chunk, m_pending);
+            m_has_pending = false;
+        }
+        while (std::getline(m_input, m_pending)) {
+            if (!chunk.empty() && !m_quote && StartsTopLevelStatement(m_pending)) {
+                m_has_pending = true;
+                return true;
+            }
+            AppendLine(chunk, m_pending);
+        }
+        return !chunk.empty();
+    }
+
+    bool TopLevelChunkReader::StartsTopLevelStatement(const std::string& line) {
+        if (line.empty() || line[0] == ' ' || line[0] == '#' || line[0] == '\r') {
+            return false;
+        }
+        for (const std::string_view word : {"else"sv, "elif"sv}) {
+            if (std::string_view(line).substr(0u, word.size()) == word) {
+                // Идентификатор вроде elsewhere начинает новую инструкцию, ключевые слова else и elif - нет
+                const char next = line.size() > word.size() ? line[word.size()] : ' ';
+                return std::isalnum(static_cast<unsigned char>(next)) || next == '_';
+            }
+        }
+        return true;
+    }
+
+    void TopLevelChunkReader::AppendLine(std::string& chunk, const std::string& line) {
+        for (const char ch : line) {
+            if (m_quote) {
+                if (ch == m_quote) {
+                    m_quote = 0;
+                }
+            }
+            else if (ch == '#') {
+                break;
+            }
+            else if (ch == '"' || ch == '\'') {
+                m_quote = ch;
+            }
+        }
+        chunk += line;
+        chunk += '\n';
+    }
+
+    TokenQueue StatementTokenJoiner::Join(TokenQueue tokens) {
+        // Конец группы лексер оформляет непоследовательно: убираем завершающие Newline и Dedent
+        // и закрываем блоки явно перед следующей группой, как при разборе всего входа
+        while (!tokens.empty() && (tokens.back().Is<token_type::Newline>() || tokens.back().Is<token_type::Dedent>())) {
+            tokens.pop_back();
+        }
+        if (tokens.empty()) {
+            return tokens;
+        }
+        TokenQueue result;
+        if (!m_first) {
+            result.push_back(token_type::Newline{});
+            result.insert(result.end(), m_open_blocks, token_type::Dedent{});
+        }
+        m_first = false;
+        m_open_blocks = 0u;
+        for (Token& token : tokens) {
+            if (token.Is<token_type::Indent>()) {
+                ++m_open_blocks;
+            }
+            else if (token.Is<token_type::Dedent>()) {
+                --m_open_blocks;
+            }
+            result.push_back(std::move(token));
+        }
+        return result;
+    }
+
+    // Поток-производитель лексем для TokenizeMode::Pipelined
+    class TokenPipeline {
+    public:
+        // Вход разбирается группами инструкций верхнего уровня, размер группы растёт от FIRST_GROUP_BYTES
+        // до GROUP_BYTES байт. Лексемы группы передаются одной пачкой
+        static constexpr size_t FIRST_GROUP_BYTES = 256u;
+        static constexpr size_t GROUP_BYTES = 16u * 1024u;
+        static constexpr size_t QUEUE_BATCHES = 16u;
+
+        explicit TokenPipeline(std::istream& input) : m_queue(QUEUE_BATCHES), m_thread([this, &input] { Run(input); }) {}
+
+        ~TokenPipeline() {
+            // Если разбор прерван, производитель может ждать места в очереди: останавливаем его и
+            // освобождаем очередь
+            m_stop.store(true, std::memory_order_relaxed);
+            TokenQueue batch;
+            while (m_queue.Pop(batch)) {
+            }
+            m_thread.join();
+        }
+
+        // Возвращает false, когда лексемы закончились. Исключение производителя пробрасывается здесь
+        bool Pop(TokenQueue& batch) {
+            if (m_queue.Pop(batch)) {
+                return true;
+            }
+            if (m_error) {
+                std::rethrow_exception(std::exchange(m_error, nullptr));
+            }
+            return false;
+        }
+
+    private:
+        void Run(std::istream& input) {
+            try {
+                Produce(input);
+            }
+            catch (...) {
+                // Запись видна читателю: маркер конца публикуется в очереди после неё
+                m_error = std::current_exception();
+            }
+            m_queue.Close();
+        }
+
+        void Produce(std::istream& input) {
+            TopLevelChunkReader reader(input);
+            std::string chunk;
+            std::string group;
+            std::istringstream group_input;
+            StatementTokenJoiner joiner;
+            bool has_chunk = true;
+            // Первые группы маленькие, чтобы разбор начался как можно раньше
+            size_t group_bytes = FIRST_GROUP_BYTES;
+            while (has_chunk && !m_stop.load(std::memory_order_relaxed)) {
+                // Инструкции разбираются группами: внутри группы лексемы в точности совпадают с пакетным режимом
+                group.clear();
+                while (group.size() < group_bytes && (has_chunk = reader.Next(chunk))) {
+                    group += chunk;
+                }
+                group_bytes = std::min(group_bytes * 2u, GROUP_BYTES);
+                group_input.clear();
+                group_input.str(group);
+                TokenQueue batch = joiner.Join(TokenParser::Tokenise(group_input));
+                if (batch.empty()) {
+                    continue;
+                }
+                m_queue.Push(std::move(batch));
+            }
+        }
+
+        SpscQueue<TokenQueue> m_queue;
+        std::atomic<bool> m_stop{false};
+        std::exception_ptr m_error;
+        std::thread m_thread;
+    };
 }
 
 const Token& Lexer::CurrentToken() const {
@@ -416,10 +622,33 @@ const Token& Lexer::CurrentToken() const {
 }
 
 Token Lexer::NextToken() {
-    ++m_current_index;
+    Advance();
     return CurrentToken();
 }
 
-Lexer::Lexer(std::istream& _input) : m_tokens(utility::Tokenise(_input)) {}
+void Lexer::Refill() {
+    TokenQueue batch;
+    while (m_current_index >= m_tokens.size() && m_pipeline->Pop(batch)) {
+        // Предыдущую лексему оставляем: на неё ещё может ссылаться разбор
+        const size_t consumed = m_tokens.empty() ? 0u : m_tokens.size() - 1u;
+        m_tokens.erase(m_tokens.begin(), m_tokens.begin() + static_cast<std::ptrdiff_t>(consumed));
+        m_current_index -= consumed;
+        std::move(batch.begin(), batch.end(), std::back_inserter(m_tokens));
+    }
+}
+
+Lexer::Lexer(std::istream& _input, TokenizeMode mode) {
+    if (mode == TokenizeMode::Batch) {
+        m_tokens = utility::Tokenise(_input);
+        return;
+    }
+    m_pipeline = std::make_unique<utility::TokenPipeline>(_input);
+    Refill();
+}
+
+Lexer::Lexer(TokenQueue tokens) : m_tokens(std::move(tokens)) {
+}
+
+Lexer::~Lexer() = default;
 
 }  // namespace parse
\ No newline at end of file
@@ -7,6 +7,7 @@
 #include <deque>
 #include <iosfwd>
 #include <iterator>
+#include <memory>
 #include <optional>
 #include <sstream>
 #include <stdexcept>
@@ -24,6 +25,10 @@ namespace token_type {
         int value;   // число
     };
 
+    struct BigNumber {      // Лексема «число», не помещающееся в int
+        std::string value;  // десятичная запись числа
+    };
+
     struct Id {             // Лексема «идентификатор»
         std::string value;  // Имя идентификатора
     };
@@ -36,10 +41,15 @@ namespace token_type {
         std::string value;
     };
 
+    struct FormatString {  // Лексема «форматная строка» f"...": текст между кавычками без разбора
+        std::string value;
+    };
+
     struct Class {};    // Лексема «class»
     struct Return {};   // Лексема «return»
     struct If {};       // Лексема «if»
     struct Else {};     // Лексема «else»
+    struct Elif {};     // Лексема «elif»
     struct Def {};      // Лексема «def»
     struct Newline {};  // Лексема «конец строки»
     struct Print {};    // Лексема «print»
@@ -56,6 +66,7 @@ namespace token_type {
     struct None {};         // Лексема «None»
     struct True {};         // Лексема «True»
     struct False {};        // Лексема «False»
+    struct Is {};           // Лексема «is»
 }  // namespace token_type
 
 using TokenBase = std::variant<
@@ -82,7 +93,11 @@ using TokenBase = std::variant<
     token_type::None,       // 20
     token_type::True,       // 21
     token_type::False,      // 22
-    token_type::Eof         // 23
+    token_type::Is,         // 23
+    token_type::FormatString, // 24
+    token_type::Elif,       // 25
+    token_type::Eof,        // 26
+    token_type::BigNumber   // 27
 >;
 
 struct Token : TokenBase {
@@ -140,6 +155,8 @@ namespace token_const {
     static const std::string NEXT_METHOD("__next__"s);
     
     static const size_t INDENT_STEP = 2;
+    // Префикс форматной строки: f"x = {p.x}"
+    static const char FORMAT_PREFIX = 'f';
 
     static const std::unordered_set<char> OPERATOR_CHAR = {':', '(', ')', ',', '.', '+', '-', '*', '/', '!', '>', '<', '='};
 
@@ -152,6 +169,7 @@ namespace token_const {
         { std::string("return"), token_type::Return{}      },
         { std::string("if"),     token_type::If{}          },
         { std::string("else"),   token_type::Else{}        },
+        { std::string("elif"),   token_type::Elif{}        },
         { std::string("def"),    token_type::Def{}         },
         { std::string("print"),  token_type::Print{}       },
         { std::string("and"),    token_type::And{}         },
@@ -159,7 +177,8 @@ namespace token_const {
         { std::string("not"),    token_type::Not{}         },
         { std::string("None"),   token_type::None{}        },
         { std::string("True"),   token_type::True{}        },
-        { std::string("False"),  token_type::False{}       }
+        { std::string("False"),  token_type::False{}       },
+        { std::string("is"),     token_type::Is{}          }
     };
 } // namespace lexer_consts
 
@@ -198,6 +217,7 @@ namespace utility {
         static bool SkipSpaces(State& state);
         static bool ProcessNewLine(State& state);
         static bool ProcessStringLiteral(State& state);
+        static bool ProcessFormatStringLiteral(State& state);
         static bool ProcessIntLiteral(State& state);
         static bool ProcessOperator(State& state);
         static bool ProcessSpecialWords(State& state);
@@ -207,11 +227,76 @@ namespace utility {
     };
 
     TokenQueue Tokenise(std::istream& input);
+
+    /*
+     * Делит исходный текст на фрагменты, каждый из которых начинается с инструкции верхнего уровня.
+     * Инструкция верхнего уровня начинается в первой колонке строки. Исключения - ветка else,
+     * продолжающая if, комментарии и строки внутри многострочного строкового литерала.
+     * Из потока читается только текущий фрагмент и первая строка следующего.
+     */
+    class TopLevelChunkReader {
+    public:
+        explicit TopLevelChunkReader(std::istream& input);
+
+        // Записывает в chunk очередной фрагмент. Возвращает false, если поток закончился
+        bool Next(std::string& chunk);
+
+    private:
+        static bool StartsTopLevelStatement(const std::string& line);
+        // Добавляет строку к фрагменту, отслеживая незакрытые строковые литералы
+        void AppendLine(std::string& chunk, const std::string& line);
+
+        std::istream& m_input;
+        std::string m_pending;
+        bool m_has_pending = false;
+        char m_quote = 0;
+    };
+
+    /*
+     * Склеивает лексемы групп инструкций верхнего уровня, разобранных TokenParser по отдельности, в один
+     * поток. Завершающие Newline и Dedent группы отбрасываются, а перед следующей группой вставляются
+     * Newline и Dedent для каждого блока, оставшегося открытым.
+     */
+    class StatementTokenJoiner {
+    public:
+        // Возвращает лексемы группы вместе с закрытием блоков предыдущей. Для группы без инструкций - пустую очередь
+        TokenQueue Join(TokenQueue tokens);
+
+    private:
+        size_t m_open_blocks = 0u;
+        bool m_first = true;
+    };
+
+    class TokenPipeline;
 }
 
+// Способ разбиения входа на лексемы
+enum class TokenizeMode {
+    // Весь вход разбирается в конструкторе Lexer
+    Batch,
+    // Вход разбирается в отдельном потоке одновременно с чтением лексем из Lexer
+    Pipelined,
+};
+
+/*
+ * В режиме TokenizeMode::Pipelined лексемы готовит поток-производитель: он делит вход на группы
+ * инструкций верхнего уровня (utility::TopLevelChunkReader), разбирает каждую группу TokenParser и
+ * передаёт её лексемы пачкой через очередь SpscQueue. Между группами вставляются Newline и Dedent,
+ * закрывающие открытые блоки, поэтому последовательность лексем совпадает с пакетным режимом.
+ * Единственное отличие - пакетный режим может оставить лишний Newline после Dedent перед инструкцией
+ * верхнего уровня, который разбор всё равно пропускает. Lexer забирает
+ * следующую пачку, когда текущая прочитана, и освобождает уже пройденные лексемы.
+ * Поток ввода должен жить, пока жив Lexer.
+ */
 class Lexer {
 public:
-    explicit Lexer(std::istream& input);
+    explicit Lexer(std::istream& input, TokenizeMode mode = TokenizeMode::Batch);
+    // Читает заранее подготовленные лексемы, например сохранённые IncrementalProgram
+    explicit Lexer(TokenQueue tokens);
+    ~Lexer();
+
+    Lexer(const Lexer&) = delete;
+    Lexer& operator=(const Lexer&) = delete;
 
     // Возвращает ссылку на текущий токен или token_type::Eof, если поток токенов закончился
     [[nodiscard]] const Token& CurrentToken() const;
@@ -245,7 +330,7 @@ public:
     // В противном случае метод выбрасывает исключение LexerError
     template <typename T>
     const T& ExpectNext() {
-        ++m_current_index;
+        Advance();
         return Expect<T>();
     }
 
@@ -253,14 +338,24 @@ public:
     // В противном случае метод выбрасывает исключение LexerError
     template <typename T, typename U>
     void ExpectNext(const U& value) {
-        using namespace std::literals;
-        ++m_current_index;
+        Advance();
         return Expect<T>(value);
     }
 
 private:
+    void Advance() {
+        ++m_current_index;
+        if (m_pipeline && m_current_index >= m_tokens.size()) {
+            Refill();
+        }
+    }
+
+    // Забирает пачки лексем из конвейера, пока текущая лексема не станет доступной или вход не закончится
+    void Refill();
+
     std::deque<Token> m_tokens;
     size_t m_current_index = 0;
+    std::unique_ptr<utility::TokenPipeline> m_pipeline;
 };
 
 }  // namespace parse
\ No newline at end of file
@@ -0,0 +1,137 @@
+#include "lexer.h"
+#include "parse.h"
+#include "runtime.h"
+#include "spsc_queue.h"
+#include "test_runner_p.h"
+
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace parse {
+
+namespace {
+
+// Читает все лексемы. Newline сразу после Dedent пропускается: пакетный режим оставляет его
+// на месте пустой строки перед инструкцией верхнего уровня, а конвейер - нет
+vector<Token> ReadAll(const string& program, TokenizeMode mode) {
+    istringstream input(program);
+    Lexer lexer(input, mode);
+    vector<Token> tokens;
+    for (Token token = lexer.CurrentToken(); !token.Is<token_type::Eof>(); token = lexer.NextToken()) {
+        if (!(token.Is<token_type::Newline>() && !tokens.empty() && tokens.back().Is<token_type::Dedent>())) {
+            tokens.push_back(token);
+        }
+    }
+    return tokens;
+}
+
+string RunProgram(const string& program, TokenizeMode mode) {
+    istringstream input(program);
+    Lexer lexer(input, mode);
+    auto tree = ParseProgram(lexer);
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    tree->Execute(closure, context);
+    return context.output.str();
+}
+
+// Программа из многих инструкций верхнего уровня, чтобы лексемы передавались несколькими пачками
+string MakeLargeProgram(size_t statements) {
+    string program = R"(
+class Counter:
+  def __init__():
+    self.n = 0
+
+  def add(k):
+    if k > 0:
+      self.n = self.n + k
+    else:
+      self.n = self.n - k
+    return self.n
+
+c = Counter()
+)"s;
+    for (size_t i = 0; i < statements; ++i) {
+        program += "x = c.add(" + to_string(i % 7) + ")\n";
+        if (i % 100 == 0) {
+            program += "# checkpoint\nif x > 10:\n  print x\nelse:\n  print 'small'\n\n";
+        }
+    }
+    program += "print x\n";
+    return program;
+}
+
+void TestSpscQueuePreservesOrder() {
+    SpscQueue<int> queue(3u);
+    ASSERT_EQUAL(queue.Capacity(), 4u);
+
+    constexpr int count = 100000;
+    thread producer([&queue] {
+        for (int i = 0; i < count; ++i) {
+            queue.Push(i);
+        }
+        queue.Close();
+    });
+
+    int expected = 0;
+    for (int value = -1; queue.Pop(value); ++expected) {
+        ASSERT_EQUAL(value, expected);
+    }
+    producer.join();
+    ASSERT_EQUAL(expected, count);
+    int value = -1;
+    ASSERT(!queue.Pop(value));
+}
+
+void TestPipelinedLexerMatchesBatch() {
+    const string small = "x = 4\nif x > 3:\n  print 'big'\nelse:\n  print 'small'\ny = 'multi\nline'\nprint y\n"s;
+    ASSERT(ReadAll(small, TokenizeMode::Pipelined) == ReadAll(small, TokenizeMode::Batch));
+
+    const string large = MakeLargeProgram(5000u);
+    const vector<Token> batch_tokens = ReadAll(large, TokenizeMode::Batch);
+    ASSERT(batch_tokens.size() > 4u * 4096u);
+    ASSERT(ReadAll(large, TokenizeMode::Pipelined) == batch_tokens);
+    ASSERT_EQUAL(RunProgram(large, TokenizeMode::Pipelined), RunProgram(large, TokenizeMode::Batch));
+
+    ASSERT(ReadAll(""s, TokenizeMode::Pipelined).empty());
+    ASSERT(ReadAll("# only a comment\n\n"s, TokenizeMode::Pipelined).empty());
+}
+
+void TestPipelinedExpectNext() {
+    istringstream input("x = 1\ny = 2\n"s);
+    Lexer lexer(input, TokenizeMode::Pipelined);
+    lexer.Expect<token_type::Id>("x"s);
+    lexer.ExpectNext<token_type::Char>('=');
+    ASSERT_EQUAL(lexer.ExpectNext<token_type::Number>().value, 1);
+    lexer.ExpectNext<token_type::Newline>();
+    lexer.ExpectNext<token_type::Id>("y"s);
+    lexer.ExpectNext<token_type::Char>('=');
+    lexer.ExpectNext<token_type::Number>();
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
+}
+
+// Лексер, уничтоженный до конца входа, не должен ждать поток-производитель бесконечно
+void TestPipelinedLexerStopsEarly() {
+    const string large = MakeLargeProgram(20000u);
+    istringstream input(large);
+    {
+        Lexer lexer(input, TokenizeMode::Pipelined);
+        ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Class{}));
+    }
+}
+
+}  // namespace
+
+void RunLexerPipelineTests(TestRunner& tr) {
+    RUN_TEST(tr, parse::TestSpscQueuePreservesOrder);
+    RUN_TEST(tr, parse::TestPipelinedLexerMatchesBatch);
+    RUN_TEST(tr, parse::TestPipelinedExpectNext);
+    RUN_TEST(tr, parse::TestPipelinedLexerStopsEarly);
+}
+
+}  // namespace parse
@@ -38,10 +38,15 @@ void TestKeywords() {
     ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Not{}));
     ASSERT_EQUAL(lexer.NextToken(), Token(token_type::True{}));
     ASSERT_EQUAL(lexer.NextToken(), Token(token_type::False{}));
+
+    istringstream elif_input("elif elif_x"s);
+    Lexer elif_lexer(elif_input);
+    ASSERT_EQUAL(elif_lexer.CurrentToken(), Token(token_type::Elif{}));
+    ASSERT_EQUAL(elif_lexer.NextToken(), Token(token_type::Id{"elif_x"s}));
 }
 
 void TestNumbers() {
-    istringstream input("42 15 -53"s);
+    istringstream input("42 15 -53 2147483647 2147483648"s);
     Lexer lexer(input);
 
     ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Number{42}));
@@ -49,6 +54,9 @@ void TestNumbers() {
     // Отрицательные числа формируются на этапе синтаксического анализа
     ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'-'}));
     ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Number{53}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Number{2147483647}));
+    // Число, не помещающееся в int, остаётся десятичной записью
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::BigNumber{"2147483648"s}));
 }
 
 void TestIds() {
@@ -96,6 +104,39 @@ void TestOperations() {
     ASSERT_EQUAL(lexer.NextToken(), Token(token_type::GreaterOrEq{}));
 }
 
+void TestIdentityAndKeywordsAfterOperators() {
+    istringstream input("x is not None\nis_empty = True\nnot2 =False"s);
+    Lexer lexer(input);
+
+    ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Id{"x"s}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Is{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Not{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::None{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"is_empty"s}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'='}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::True{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"not2"s}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'='}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::False{}));
+}
+
+void TestFormatStrings() {
+    istringstream input("print f\"x={p.x}\", f'{a}', f, fx\n"s);
+    Lexer lexer(input);
+
+    ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Print{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::FormatString{"x={p.x}"s}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{','}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::FormatString{"{a}"s}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{','}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"f"s}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{','}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"fx"s}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
+}
+
 void TestIndentsAndNewlines() {
     istringstream input(R"(
 no_indent
@@ -360,6 +401,8 @@ void RunOpenLexerTests(TestRunner& tr) {
     RUN_TEST(tr, parse::TestIds);
     RUN_TEST(tr, parse::TestStrings);
     RUN_TEST(tr, parse::TestOperations);
+    RUN_TEST(tr, parse::TestIdentityAndKeywordsAfterOperators);
+    RUN_TEST(tr, parse::TestFormatStrings);
     RUN_TEST(tr, parse::TestIndentsAndNewlines);
     RUN_TEST(tr, parse::TestEmptyLinesAreIgnored);
     RUN_TEST(tr, parse::TestExpect);
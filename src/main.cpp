@@ -5,18 +5,34 @@
 #include "runtime.h"
 #include "statement.h"
 #include "test_runner_p.h"
+#include "trace.h"
 
 namespace parse {
     void RunOpenLexerTests(TestRunner& tr);
+    void RunLexerPipelineTests(TestRunner& tr);
+    void RunIncrementalParseTests(TestRunner& tr);
 }
 
 namespace runtime {
     void RunObjectHolderTests(TestRunner& tr);
     void RunObjectsTests(TestRunner& tr);
+    void RunHeapSnapshotTests(TestRunner& tr);
+    void RunFlatMapTests(TestRunner& tr);
+    void RunIsolateHeapTests(TestRunner& tr);
+    void RunMemoryQuotaTests(TestRunner& tr);
+    void RunBigIntTests(TestRunner& tr);
+    void RunIntArrayTests(TestRunner& tr);
+    void RunSnapshotTests(TestRunner& tr);
+    void RunFeedbackTests(TestRunner& tr);
 }
 
 namespace ast {
     void RunUnitTests(TestRunner& tr);
+    void RunAllocationBudgetTests(TestRunner& tr);
+}
+
+namespace trace {
+    void RunTraceTests(TestRunner& tr);
 }
 
 void TestParseProgram(TestRunner& tr);
@@ -29,6 +45,9 @@ namespace {
         runtime::SimpleContext context{output};
         runtime::Closure closure;
         program->Execute(closure, context);
+
+        output.flush();
+        MYTHON_TRACE0(output__flush);
     }
 
     void TestSimplePrints() {
@@ -112,10 +131,22 @@ print y.value
     void TestAll() {
         TestRunner tr;
         parse::RunOpenLexerTests(tr);
+        parse::RunLexerPipelineTests(tr);
         runtime::RunObjectHolderTests(tr);
         runtime::RunObjectsTests(tr);
+        runtime::RunHeapSnapshotTests(tr);
+        runtime::RunFlatMapTests(tr);
+        runtime::RunIsolateHeapTests(tr);
+        runtime::RunMemoryQuotaTests(tr);
+        runtime::RunBigIntTests(tr);
+        runtime::RunIntArrayTests(tr);
+        runtime::RunSnapshotTests(tr);
+        runtime::RunFeedbackTests(tr);
         ast::RunUnitTests(tr);
+        ast::RunAllocationBudgetTests(tr);
         TestParseProgram(tr);
+        parse::RunIncrementalParseTests(tr);
+        trace::RunTraceTests(tr);
 
         RUN_TEST(tr, TestSimplePrints);
         RUN_TEST(tr, TestAssignments);
@@ -124,10 +155,10 @@ print y.value
     }
 }  // namespace
 
+// Набор самопроверок интерпретатора. Сам интерпретатор собирается отдельно, см. mython.cpp
 int main() {
     try {
         TestAll();
-        RunMythonProgram(std::cin, std::cout);
     }
     catch (const std::exception& e) {
         std::cerr << e.what();
@@ -0,0 +1,351 @@
+#include "lexer.h"
+#include "parse.h"
+#include "runtime.h"
+#include "test_runner_p.h"
+
+#include <malloc.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+DEFINE_ALLOCATION_COUNTER_HOOKS
+
+using namespace std;
+
+/*
+ * Бенчмарк потребления памяти объектами Mython.
+ * Для каждого сценария измеряются прирост RSS, прирост живой кучи (по данным malloc, вместе со служебными
+ * заголовками блоков) и запрошенные у operator new байты. Запрошенные байты раскладываются по статьям:
+ * заголовок ClassInstance, накладные расходы таблицы полей, служебные байты блоков ObjectHolder::Own,
+ * сами значения и буферы std::string. Результаты выводятся в stdout в формате JSON.
+ *
+ * Параметры командной строки:
+ *   --objects <N>   число создаваемых объектов (по умолчанию 100000)
+ *   --fields <K>    число полей у каждого экземпляра класса (по умолчанию 4)
+ *   --isolate-heap  размещать объекты в куче изолята (см. IsolateHeap)
+ *
+ * Сценарии:
+ *   instances - N экземпляров класса с K числовыми полями
+ *   strings   - N строк длиной 32 символа (не помещаются во внутренний буфер std::string)
+ *   numbers   - N чисел
+ *   program   - Mython-программа, создающая N экземпляров с K+1 полями в глобальных переменных
+ *   program_class_attributes - та же программа, но K полей объявлены атрибутами класса
+ *                              и хранятся один раз, у экземпляров остаётся одно поле
+ */
+
+namespace {
+
+using runtime::Closure;
+using runtime::ObjectHolder;
+
+struct MemoryUsage {
+    size_t allocations = 0;
+    size_t requested_bytes = 0;
+    long long live_heap_bytes = 0;
+    long long rss_bytes = 0;
+};
+
+struct ScenarioResult {
+    std::string name;
+    size_t objects = 0;
+    size_t fields = 0;
+    MemoryUsage usage;
+    // Разбивка запрошенных байтов по статьям
+    std::vector<std::pair<std::string, size_t>> breakdown;
+};
+
+long long LiveHeapBytes() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    const auto info = mallinfo2();
+    return static_cast<long long>(info.uordblks + info.hblkhd);
+#else
+    return 0;
+#endif
+}
+
+long long ResidentBytes() {
+    std::ifstream statm("/proc/self/statm"s);
+    long long size = 0;
+    long long resident = 0;
+    statm >> size >> resident;
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+// Измеряет память, выделенную при выполнении action. Созданные объекты action должна сохранить живыми
+// Память, выделенная из кучи изолята, учитывается вместе с общей кучей процесса
+template <typename Action>
+MemoryUsage MeasureMemory(Action action) {
+    const runtime::IsolateHeap* isolate = runtime::IsolateHeap::Current();
+    const size_t isolate_allocated_before = isolate ? isolate->AllocatedBytes() : 0u;
+    const size_t isolate_live_before = isolate ? isolate->LiveBytes() : 0u;
+    const long long heap_before = LiveHeapBytes();
+    const long long rss_before = ResidentBytes();
+    AllocationCounter counter;
+    action();
+    MemoryUsage usage;
+    usage.allocations = counter.Count();
+    usage.requested_bytes = counter.Bytes();
+    usage.live_heap_bytes = LiveHeapBytes() - heap_before;
+    usage.rss_bytes = ResidentBytes() - rss_before;
+    if (isolate) {
+        usage.requested_bytes += isolate->AllocatedBytes() - isolate_allocated_before;
+        usage.live_heap_bytes += static_cast<long long>(isolate->LiveBytes()) - static_cast<long long>(isolate_live_before);
+    }
+    return usage;
+}
+
+void Accumulate(MemoryUsage& total, const MemoryUsage& part) {
+    total.allocations += part.allocations;
+    total.requested_bytes += part.requested_bytes;
+    total.live_heap_bytes += part.live_heap_bytes;
+    total.rss_bytes += part.rss_bytes;
+}
+
+// Сколько байт ObjectHolder::Own выделяет сверх размера объекта типа T
+template <typename T>
+size_t BlockOverheadBytes(T prototype) {
+    ObjectHolder holder;
+    const MemoryUsage usage = MeasureMemory([&] {
+        holder = ObjectHolder::Own(std::move(prototype));
+    });
+    return usage.requested_bytes - sizeof(T);
+}
+
+// Запрошенные байты, не попавшие ни в одну статью, - временные объекты, уже освобождённые к концу замера
+void AddTransientBytes(ScenarioResult& result) {
+    size_t accounted = 0u;
+    for (const auto& [name, bytes] : result.breakdown) {
+        accounted += bytes;
+    }
+    result.breakdown.emplace_back("transient (freed)"s, result.usage.requested_bytes - accounted);
+}
+
+// Возвращает размер буфера строки в куче или 0, если строка хранится во внутреннем буфере
+size_t StringHeapCapacity(const std::string& value) {
+    const char* data = value.data();
+    const char* self = reinterpret_cast<const char*>(&value);
+    if (data >= self && data < self + sizeof(std::string)) {
+        return 0u;
+    }
+    return value.capacity() + 1u;
+}
+
+ScenarioResult MeasureInstances(size_t objects, size_t fields) {
+    runtime::Class cls("Point"s, {}, nullptr);
+    std::vector<std::string> field_names;
+    for (size_t i = 0; i < fields; ++i) {
+        field_names.push_back("f"s + std::to_string(i));
+    }
+    std::vector<ObjectHolder> instances;
+    instances.reserve(objects);
+    const ObjectHolder placeholder = ObjectHolder::Own(runtime::Number(0));
+
+    ScenarioResult result{"instances"s, objects, fields, {}, {}};
+    // Экземпляры с пустой таблицей полей: только заголовки объектов
+    const MemoryUsage headers = MeasureMemory([&] {
+        for (size_t i = 0; i < objects; ++i) {
+            instances.push_back(ObjectHolder::Own(runtime::ClassInstance(cls)));
+        }
+    });
+    // Поля, ссылающиеся на один и тот же объект: только накладные расходы таблицы полей
+    const MemoryUsage field_tables = MeasureMemory([&] {
+        for (ObjectHolder& instance : instances) {
+            Closure& instance_fields = instance.TryAs<runtime::ClassInstance>()->Fields();
+            for (const std::string& name : field_names) {
+                instance_fields[name] = placeholder;
+            }
+        }
+    });
+    // Собственные значения полей
+    const MemoryUsage values = MeasureMemory([&] {
+        int counter = 0;
+        for (ObjectHolder& instance : instances) {
+            Closure& instance_fields = instance.TryAs<runtime::ClassInstance>()->Fields();
+            for (const std::string& name : field_names) {
+                instance_fields[name] = ObjectHolder::Own(runtime::Number(++counter));
+            }
+        }
+    });
+    Accumulate(result.usage, headers);
+    Accumulate(result.usage, field_tables);
+    Accumulate(result.usage, values);
+
+    const size_t header_bytes = objects * sizeof(runtime::ClassInstance);
+    const size_t number_bytes = objects * fields * sizeof(runtime::Number);
+    result.breakdown = {
+        {"ClassInstance header"s, header_bytes},
+        {"field map overhead"s, field_tables.requested_bytes},
+        {"Number values"s, number_bytes},
+        {"Own block overhead"s, objects * BlockOverheadBytes(runtime::ClassInstance(cls)) + objects * fields * BlockOverheadBytes(runtime::Number(0))},
+    };
+    AddTransientBytes(result);
+    return result;
+}
+
+ScenarioResult MeasureStrings(size_t objects) {
+    std::vector<ObjectHolder> strings;
+    strings.reserve(objects);
+    const std::string prototype(32u, 'x');
+
+    ScenarioResult result{"strings"s, objects, 0u, {}, {}};
+    result.usage = MeasureMemory([&] {
+        for (size_t i = 0; i < objects; ++i) {
+            strings.push_back(ObjectHolder::Own(runtime::String(prototype)));
+        }
+    });
+
+    size_t capacity_bytes = 0u;
+    for (const ObjectHolder& holder : strings) {
+        capacity_bytes += StringHeapCapacity(holder.TryAs<runtime::String>()->GetValue());
+    }
+    const size_t header_bytes = objects * sizeof(runtime::String);
+    result.breakdown = {
+        {"String header"s, header_bytes},
+        {"std::string capacity"s, capacity_bytes},
+        {"Own block overhead"s, objects * BlockOverheadBytes(runtime::String(std::string()))},
+    };
+    AddTransientBytes(result);
+    return result;
+}
+
+ScenarioResult MeasureNumbers(size_t objects) {
+    std::vector<ObjectHolder> numbers;
+    numbers.reserve(objects);
+
+    ScenarioResult result{"numbers"s, objects, 0u, {}, {}};
+    result.usage = MeasureMemory([&] {
+        for (size_t i = 0; i < objects; ++i) {
+            numbers.push_back(ObjectHolder::Own(runtime::Number(static_cast<int>(i))));
+        }
+    });
+
+    const size_t value_bytes = objects * sizeof(runtime::Number);
+    result.breakdown = {
+        {"Number values"s, value_bytes},
+        {"Own block overhead"s, objects * BlockOverheadBytes(runtime::Number(0))},
+    };
+    AddTransientBytes(result);
+    return result;
+}
+
+// Программа без циклов: N присваиваний глобальным переменным o0, o1, ..., каждое создаёт экземпляр.
+// Если class_attributes, K полей объявляются в теле класса, иначе присваиваются в __init__
+std::string MakeProgram(size_t objects, size_t fields, bool class_attributes) {
+    std::ostringstream program;
+    program << "class Item:\n";
+    if (class_attributes) {
+        for (size_t i = 0; i < fields; ++i) {
+            program << "  f" << i << " = " << i << "\n";
+        }
+    }
+    program << "  def __init__(value):\n    self.value = value\n";
+    if (!class_attributes) {
+        for (size_t i = 0; i < fields; ++i) {
+            program << "    self.f" << i << " = value + " << i << "\n";
+        }
+    }
+    program << "\n";
+    for (size_t i = 0; i < objects; ++i) {
+        program << "o" << i << " = Item(" << i << ")\n";
+    }
+    return program.str();
+}
+
+ScenarioResult MeasureProgram(size_t objects, size_t fields, bool class_attributes) {
+    std::istringstream input(MakeProgram(objects, fields, class_attributes));
+    std::ostringstream output;
+    runtime::SimpleContext context{output};
+    Closure closure;
+    std::unique_ptr<runtime::Executable> program;
+
+    ScenarioResult result{class_attributes ? "program_class_attributes"s : "program"s, objects, fields, {}, {}};
+    const MemoryUsage ast = MeasureMemory([&] {
+        parse::Lexer lexer(input);
+        program = ParseProgram(lexer);
+    });
+    const MemoryUsage heap = MeasureMemory([&] {
+        program->Execute(closure, context);
+    });
+    Accumulate(result.usage, ast);
+    Accumulate(result.usage, heap);
+    result.breakdown = {
+        {"tokens and AST (still live)"s, static_cast<size_t>(std::max(0ll, ast.live_heap_bytes))},
+        {"objects (requested)"s, heap.requested_bytes},
+    };
+    return result;
+}
+
+void WriteJson(std::ostream& os, const std::vector<ScenarioResult>& results) {
+    os << "{\n  \"scenarios\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const ScenarioResult& result = results[i];
+        const double per_object = result.objects ? static_cast<double>(result.objects) : 1.0;
+        os << (i ? ",\n" : "\n");
+        os << "    {\"name\": \"" << result.name << "\", \"objects\": " << result.objects << ", \"fields\": " << result.fields
+           << ", \"rss_bytes\": " << result.usage.rss_bytes << ", \"live_heap_bytes\": " << result.usage.live_heap_bytes
+           << ", \"requested_bytes\": " << result.usage.requested_bytes << ", \"allocations\": " << result.usage.allocations
+           << ", \"live_heap_bytes_per_object\": " << result.usage.live_heap_bytes / per_object
+           << ",\n     \"breakdown\": {";
+        for (size_t j = 0; j < result.breakdown.size(); ++j) {
+            os << (j ? ", " : "") << "\"" << result.breakdown[j].first << "\": " << result.breakdown[j].second;
+        }
+        os << "}}";
+    }
+    os << "\n  ]\n}\n";
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    size_t objects = 100000u;
+    size_t fields = 4u;
+    bool use_isolate_heap = false;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--objects"s && i + 1 < argc) {
+            objects = std::stoul(argv[++i]);
+        }
+        else if (arg == "--fields"s && i + 1 < argc) {
+            fields = std::stoul(argv[++i]);
+        }
+        else if (arg == "--isolate-heap"s) {
+            use_isolate_heap = true;
+        }
+        else {
+            std::cerr << "Usage: " << argv[0] << " [--objects <N>] [--fields <K>] [--isolate-heap]" << std::endl;
+            return 1;
+        }
+    }
+
+    try {
+        std::cerr << "sizeof: Object " << sizeof(runtime::Object) << ", ClassInstance " << sizeof(runtime::ClassInstance)
+                  << ", ObjectHolder " << sizeof(ObjectHolder) << ", Closure " << sizeof(Closure)
+                  << ", Number " << sizeof(runtime::Number) << ", String " << sizeof(runtime::String) << std::endl;
+
+        runtime::IsolateHeap isolate;
+        std::optional<runtime::IsolateHeap::Scope> isolate_scope;
+        if (use_isolate_heap) {
+            isolate_scope.emplace(isolate);
+        }
+
+        // Каждый сценарий выполняется в собственной области, чтобы его объекты были освобождены до следующего
+        std::vector<ScenarioResult> results;
+        results.push_back(MeasureInstances(objects, fields));
+        results.push_back(MeasureStrings(objects));
+        results.push_back(MeasureNumbers(objects));
+        results.push_back(MeasureProgram(objects, fields, false));
+        results.push_back(MeasureProgram(objects, fields, true));
+        WriteJson(std::cout, results);
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
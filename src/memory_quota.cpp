@@ -0,0 +1,106 @@
+#include "memory_quota.h"
+
+#include <algorithm>
+#include <utility>
+
+using namespace std;
+
+namespace runtime {
+
+namespace {
+
+thread_local MemoryQuota* current_quota = nullptr;
+
+}  // namespace
+
+MemoryQuota::MemoryQuota(size_t hard_limit) : m_hard_limit(hard_limit) {}
+
+void MemoryQuota::SetSoftLimit(size_t soft_limit, SoftLimitHandler handler) {
+    m_soft_limit = soft_limit;
+    m_soft_limit_handler = std::move(handler);
+    m_soft_limit_reached = m_current_bytes > m_soft_limit;
+}
+
+void MemoryQuota::ThrowLimitExceeded(size_t bytes) const {
+    throw MemoryLimitError("Memory limit exceeded: "s + to_string(bytes) + " bytes requested, "s + to_string(m_current_bytes) + " of "s + to_string(m_hard_limit) + " bytes in use"s);
+}
+
+void MemoryQuota::ReachSoftLimit() {
+    m_soft_limit_reached = true;
+    if (m_soft_limit_handler) {
+        m_soft_limit_handler(*this);
+    }
+}
+
+MemoryQuota* MemoryQuota::Current() {
+    return current_quota;
+}
+
+MemoryQuota::Scope::Scope(MemoryQuota& quota) : m_previous(current_quota) {
+    current_quota = &quota;
+}
+
+MemoryQuota::Scope::~Scope() {
+    current_quota = m_previous;
+}
+
+MemoryCharge::MemoryCharge() : m_quota(MemoryQuota::Current()) {}
+
+MemoryCharge::MemoryCharge([[maybe_unused]] const MemoryCharge& other) : MemoryCharge() {}
+
+MemoryCharge::MemoryCharge(MemoryCharge&& other) noexcept : m_quota(other.m_quota), m_bytes(std::exchange(other.m_bytes, 0u)) {}
+
+// Записанные байты относятся к буферам владельца, а не к значению, поэтому копирование их не меняет
+MemoryCharge& MemoryCharge::operator=([[maybe_unused]] const MemoryCharge& other) {
+    return *this;
+}
+
+MemoryCharge& MemoryCharge::operator=(MemoryCharge&& other) noexcept {
+    if (this != &other) {
+        if (m_quota != nullptr) {
+            m_quota->Release(m_bytes);
+        }
+        m_quota = other.m_quota;
+        m_bytes = std::exchange(other.m_bytes, 0u);
+    }
+    return *this;
+}
+
+MemoryCharge::~MemoryCharge() {
+    if (m_quota != nullptr) {
+        m_quota->Release(m_bytes);
+    }
+}
+
+void MemoryCharge::Update(size_t bytes) {
+    if (bytes > m_bytes) {
+        m_quota->Charge(bytes - m_bytes);
+    }
+    else {
+        m_quota->Release(m_bytes - bytes);
+    }
+    m_bytes = bytes;
+}
+
+OutputBuffer::int_type OutputBuffer::overflow(int_type ch) {
+    if (traits_type::eq_int_type(ch, traits_type::eof())) {
+        return traits_type::not_eof(ch);
+    }
+    const char c = traits_type::to_char_type(ch);
+    return xsputn(&c, 1) == 1 ? ch : traits_type::eof();
+}
+
+streamsize OutputBuffer::xsputn(const char* s, streamsize count) {
+    const size_t size = m_text.size() + static_cast<size_t>(count);
+    if (size > m_text.capacity()) {
+        // Рост записывается до выделения памяти, чтобы вывод сверх квоты не попал в буфер
+        const size_t capacity = max(size, m_text.capacity() * 2u);
+        m_charge.Resize(capacity);
+        m_text.reserve(capacity);
+        m_charge.Resize(m_text.capacity());
+    }
+    m_text.append(s, static_cast<size_t>(count));
+    return count;
+}
+
+}  // namespace runtime
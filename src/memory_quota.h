@@ -0,0 +1,165 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+
+namespace runtime {
+
+// Выполнение прервано: превышен жёсткий предел квоты памяти
+struct MemoryLimitError : std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
+/*
+ * Квота памяти одного запуска программы.
+ *
+ * Пока на потоке действует MemoryQuota::Scope, на текущую квоту записываются:
+ *  - объекты, создаваемые ObjectHolder::Own, вместе с заголовком блока и буферами строк,
+ *    длинных чисел и массивов;
+ *  - таблицы полей экземпляров классов по мере их роста;
+ *  - узлы синтаксического дерева (без их внутренних буферов);
+ *  - вывод, накапливаемый в OutputBuffer.
+ * Каждое выделение помнит свою квоту и при освобождении возвращает байты ей, даже если Scope уже
+ * закончился. Поэтому квота должна пережить всё, что на неё записано (как IsolateHeap - свои объекты).
+ *
+ * Превышение мягкого предела один раз вызывает обработчик; следующий вызов возможен, только когда
+ * использование опустится ниже предела. Выделение сверх жёсткого предела не выполняется: Charge
+ * бросает MemoryLimitError, и программа завершается через обычный путь исключений.
+ * Учёт сводится к сложению и двум сравнениям на выделение, квота не потокобезопасна.
+ */
+class MemoryQuota {
+public:
+    using SoftLimitHandler = std::function<void(const MemoryQuota& quota)>;
+
+    static constexpr size_t NO_LIMIT = std::numeric_limits<size_t>::max();
+
+    explicit MemoryQuota(size_t hard_limit = NO_LIMIT);
+
+    MemoryQuota(const MemoryQuota&) = delete;
+    MemoryQuota& operator=(const MemoryQuota&) = delete;
+
+    void SetSoftLimit(size_t soft_limit, SoftLimitHandler handler);
+
+    // Записывает bytes на квоту. Бросает MemoryLimitError, не изменяя использование,
+    // если после этого был бы превышен жёсткий предел
+    void Charge(size_t bytes) {
+        if (bytes > m_hard_limit - m_current_bytes) {
+            ThrowLimitExceeded(bytes);
+        }
+        m_current_bytes += bytes;
+        if (m_current_bytes > m_peak_bytes) {
+            m_peak_bytes = m_current_bytes;
+        }
+        if (m_current_bytes > m_soft_limit && !m_soft_limit_reached) {
+            ReachSoftLimit();
+        }
+    }
+
+    void Release(size_t bytes) noexcept {
+        m_current_bytes -= bytes;
+        if (m_current_bytes <= m_soft_limit) {
+            m_soft_limit_reached = false;
+        }
+    }
+
+    [[nodiscard]] size_t CurrentBytes() const {
+        return m_current_bytes;
+    }
+
+    [[nodiscard]] size_t PeakBytes() const {
+        return m_peak_bytes;
+    }
+
+    [[nodiscard]] size_t SoftLimit() const {
+        return m_soft_limit;
+    }
+
+    [[nodiscard]] size_t HardLimit() const {
+        return m_hard_limit;
+    }
+
+    // Квота, действующая на текущем потоке, либо nullptr
+    [[nodiscard]]
+    static MemoryQuota* Current();
+
+    // Делает quota текущей квотой потока на время жизни объекта Scope
+    class Scope {
+    public:
+        explicit Scope(MemoryQuota& quota);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        MemoryQuota* m_previous;
+    };
+
+private:
+    [[noreturn]] void ThrowLimitExceeded(size_t bytes) const;
+    void ReachSoftLimit();
+
+    size_t m_current_bytes = 0u;
+    size_t m_peak_bytes = 0u;
+    size_t m_soft_limit = NO_LIMIT;
+    size_t m_hard_limit;
+    bool m_soft_limit_reached = false;
+    SoftLimitHandler m_soft_limit_handler;
+};
+
+/*
+ * Байты, записанные на квоту, действовавшую при создании объекта (если её не было, учёт не ведётся).
+ * При разрушении возвращаются квоте. Копия начинает без записанных байт
+ */
+class MemoryCharge {
+public:
+    MemoryCharge();
+    MemoryCharge(const MemoryCharge& other);
+    MemoryCharge(MemoryCharge&& other) noexcept;
+    MemoryCharge& operator=(const MemoryCharge& other);
+    MemoryCharge& operator=(MemoryCharge&& other) noexcept;
+    ~MemoryCharge();
+
+    // Доводит записанное до bytes. Бросает MemoryLimitError, если квота не позволяет вырасти
+    void Resize(size_t bytes) {
+        if (m_quota != nullptr && bytes != m_bytes) {
+            Update(bytes);
+        }
+    }
+
+    [[nodiscard]] size_t Bytes() const {
+        return m_bytes;
+    }
+
+private:
+    void Update(size_t bytes);
+
+    MemoryQuota* m_quota;
+    size_t m_bytes = 0u;
+};
+
+/*
+ * Буфер вывода, накапливающий текст в памяти и записывающий его на квоту, действовавшую
+ * при создании буфера. std::ostream перехватывает исключения буфера, поэтому MemoryLimitError
+ * доходит до программы, только если у потока включены исключения для badbit (см. BufferedContext)
+ */
+class OutputBuffer : public std::streambuf {
+public:
+    [[nodiscard]] const std::string& Text() const {
+        return m_text;
+    }
+
+protected:
+    int_type overflow(int_type ch) override;
+    std::streamsize xsputn(const char* s, std::streamsize count) override;
+
+private:
+    std::string m_text;
+    MemoryCharge m_charge;
+};
+
+}  // namespace runtime
@@ -0,0 +1,182 @@
+#include "lexer.h"
+#include "memory_quota.h"
+#include "parse.h"
+#include "runtime.h"
+#include "test_runner_p.h"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace runtime {
+
+namespace {
+
+// Программа, строящая список из n узлов
+const string LIST_PROGRAM = R"(class Node:
+  def __init__(next):
+    self.next = next
+
+class Builder:
+  def build(n, head):
+    if n > 0:
+      return self.build(n - 1, Node(head))
+    return head
+
+b = Builder()
+print "start"
+x = b.build(2000, 0)
+print "done"
+)"s;
+
+void TestOwnChargesQuota() {
+    MemoryQuota quota;
+    {
+        MemoryQuota::Scope scope(quota);
+        ASSERT_EQUAL(MemoryQuota::Current(), &quota);
+        ObjectHolder number = ObjectHolder::Own(Number(1));
+        const size_t number_bytes = quota.CurrentBytes();
+        ASSERT(number_bytes >= sizeof(Number));
+
+        ObjectHolder text = ObjectHolder::Own(String(string(1000u, 'x')));
+        ASSERT(quota.CurrentBytes() >= number_bytes + sizeof(String) + 1000u);
+        text = ObjectHolder::None();
+        ASSERT_EQUAL(quota.CurrentBytes(), number_bytes);
+    }
+    ASSERT(MemoryQuota::Current() == nullptr);
+    ASSERT_EQUAL(quota.CurrentBytes(), 0u);
+    ASSERT(quota.PeakBytes() >= 1000u);
+}
+
+// Объекты и узлы возвращают байты своей квоте, даже если освобождаются после конца Scope
+void TestProgramReleasesEverything() {
+    MemoryQuota quota;
+    {
+        unique_ptr<Executable> program;
+        Closure closure;
+        BufferedContext context;
+        {
+            MemoryQuota::Scope scope(quota);
+            istringstream input(LIST_PROGRAM);
+            parse::Lexer lexer(input);
+            program = ParseProgram(lexer);
+            const size_t ast_bytes = quota.CurrentBytes();
+            ASSERT(ast_bytes > 0u);
+            program->Execute(closure, context);
+            // Экземпляр с полем стоит больше самого узла ClassInstance
+            ASSERT(quota.CurrentBytes() > ast_bytes + 2000u * sizeof(ClassInstance));
+        }
+        ASSERT_EQUAL(context.Output(), "start\ndone\n"s);
+    }
+    ASSERT_EQUAL(quota.CurrentBytes(), 0u);
+}
+
+void TestHardLimitAbortsScript() {
+    MemoryQuota quota(64u * 1024u);
+    {
+        MemoryQuota::Scope scope(quota);
+        istringstream input(LIST_PROGRAM);
+        parse::Lexer lexer(input);
+        auto program = ParseProgram(lexer);
+        Closure closure;
+        BufferedContext context;
+        try {
+            program->Execute(closure, context);
+            ASSERT(false);
+        }
+        catch (const MemoryLimitError&) {
+        }
+        ASSERT_EQUAL(context.Output(), "start\n"s);
+        ASSERT(quota.PeakBytes() <= quota.HardLimit());
+    }
+    ASSERT_EQUAL(quota.CurrentBytes(), 0u);
+}
+
+void TestSoftLimitHandler() {
+    MemoryQuota quota;
+    vector<size_t> reached;
+    quota.SetSoftLimit(100u, [&reached](const MemoryQuota& q) {
+        reached.push_back(q.CurrentBytes());
+    });
+    quota.Charge(60u);
+    quota.Charge(60u);
+    quota.Charge(60u);
+    ASSERT_EQUAL(reached, vector<size_t>{120u});
+    quota.Release(100u);
+    quota.Charge(50u);
+    ASSERT_EQUAL(reached, (vector<size_t>{120u, 130u}));
+    quota.Release(130u);
+    ASSERT_EQUAL(quota.PeakBytes(), 180u);
+}
+
+// Превышение жёсткого предела не меняет использование
+void TestChargeOverLimitKeepsUsage() {
+    MemoryQuota quota(100u);
+    quota.Charge(90u);
+    try {
+        quota.Charge(11u);
+        ASSERT(false);
+    }
+    catch (const MemoryLimitError&) {
+    }
+    ASSERT_EQUAL(quota.CurrentBytes(), 90u);
+    quota.Charge(10u);
+    ASSERT_EQUAL(quota.PeakBytes(), 100u);
+    quota.Release(100u);
+}
+
+void TestBufferedOutputIsCharged() {
+    MemoryQuota quota(256u);
+    MemoryQuota::Scope scope(quota);
+    {
+        BufferedContext context;
+        context.GetOutputStream() << string(100u, 'a');
+        ASSERT(quota.CurrentBytes() >= 100u);
+        try {
+            context.GetOutputStream() << string(300u, 'b');
+            ASSERT(false);
+        }
+        catch (const MemoryLimitError&) {
+        }
+        ASSERT_EQUAL(context.Output(), string(100u, 'a'));
+    }
+    ASSERT_EQUAL(quota.CurrentBytes(), 0u);
+}
+
+// Рост таблицы полей записывается на квоту экземпляра, копия экземпляра начинает с нуля
+void TestInstanceFieldsAreCharged() {
+    MemoryQuota quota;
+    MemoryQuota::Scope scope(quota);
+    Class cls("Wide"s, {}, nullptr);
+    {
+        ClassInstance instance(cls);
+        for (int i = 0; i < 64; ++i) {
+            instance.Fields()["f"s + to_string(i)] = ObjectHolder::None();
+        }
+        instance.AccountFields();
+        ASSERT_EQUAL(quota.CurrentBytes(), instance.Fields().HeapBytes());
+        ASSERT(quota.CurrentBytes() > 0u);
+        {
+            ClassInstance copy = instance;
+            ASSERT_EQUAL(quota.CurrentBytes(), instance.Fields().HeapBytes());
+        }
+        ASSERT_EQUAL(quota.CurrentBytes(), instance.Fields().HeapBytes());
+    }
+    ASSERT_EQUAL(quota.CurrentBytes(), 0u);
+}
+
+}  // namespace
+
+void RunMemoryQuotaTests(TestRunner& tr) {
+    RUN_TEST(tr, runtime::TestOwnChargesQuota);
+    RUN_TEST(tr, runtime::TestProgramReleasesEverything);
+    RUN_TEST(tr, runtime::TestHardLimitAbortsScript);
+    RUN_TEST(tr, runtime::TestSoftLimitHandler);
+    RUN_TEST(tr, runtime::TestChargeOverLimitKeepsUsage);
+    RUN_TEST(tr, runtime::TestBufferedOutputIsCharged);
+    RUN_TEST(tr, runtime::TestInstanceFieldsAreCharged);
+}
+
+}  // namespace runtime
@@ -0,0 +1,364 @@
+#include "feedback.h"
+#include "lexer.h"
+#include "parse.h"
+#include "runtime.h"
+#include "snapshot.h"
+#include "trace.h"
+
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/*
+ * Интерпретатор Mython без встроенного набора самопроверок (они собираются в mython_tests).
+ *
+ *   mython [--stats] [--isolate-heap] [--stream] [--pipeline] [--snapshot file]
+ *          [--profile-out file] [--profile-in file] [--memory-limit bytes] [--memory-soft-limit bytes]
+ *          [script.my ...]
+ *
+ * Скрипты выполняются по очереди, каждый в собственной глобальной области видимости.
+ * Если скрипты не указаны, программа читается из стандартного ввода.
+ * С флагом --stats по завершении в stderr выводятся метрики запуска: время чтения исходного
+ * текста, разбора, выполнения и время от входа в main до первого байта вывода.
+ * С флагом --isolate-heap объекты программы размещаются в куче изолята (см. IsolateHeap).
+ * С флагом --stream скрипт не загружается целиком: инструкции верхнего уровня разбираются и выполняются
+ * по одной (см. ExecuteProgramStreaming). В этом режиме время чтения и разбора входит в время выполнения.
+ * С флагом --pipeline лексический анализ выполняется в отдельном потоке одновременно с разбором,
+ * а вместе с --stream - и с выполнением (см. TokenizeMode::Pipelined).
+ * С флагом --snapshot пролог программы до строки "# @snapshot" выполняется один раз, а куча после него
+ * сохраняется в file; следующие запуски того же пролога восстанавливают кучу из file вместо выполнения
+ * (см. ExecuteProgramWithSnapshot). В этом режиме разбор входит в время выполнения.
+ * С флагом --profile-out по завершении скрипта в file записывается профиль типов (см. TypeFeedback),
+ * с флагом --profile-in скрипт разбирается с профилем прошлого запуска того же текста. Флаги профиля
+ * принимают один скрипт и не сочетаются с --stream и --snapshot: точки наблюдения нумеруются
+ * при разборе всей программы. Профиль, снятый для другого текста, не применяется: в stderr выводится
+ * предупреждение, и скрипт выполняется без профиля. С --stats выводятся самые часто вызываемые методы.
+ * С флагом --memory-limit объекты, синтаксическое дерево и поля экземпляров записываются на квоту памяти
+ * (см. MemoryQuota): при превышении предела выполнение прерывается с ошибкой. Превышение
+ * --memory-soft-limit выводит в stderr предупреждение. С --stats выводится пиковое использование квоты.
+ */
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Читает файл целиком одним блоком, без посимвольного разбора потока
+std::string ReadFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) {
+        throw std::runtime_error("Cannot open "s + path);
+    }
+    std::string text(static_cast<size_t>(in.tellg()), '\0');
+    in.seekg(0);
+    in.read(text.data(), static_cast<std::streamsize>(text.size()));
+    return text;
+}
+
+std::string ReadStdin() {
+    std::string text;
+    char buffer[1u << 16];
+    size_t read = 0u;
+    while ((read = std::fread(buffer, 1u, sizeof(buffer), stdin)) > 0u) {
+        text.append(buffer, read);
+    }
+    return text;
+}
+
+// Прозрачная обёртка буфера вывода, запоминающая момент записи первого байта
+class FirstByteTimer : public std::streambuf {
+public:
+    explicit FirstByteTimer(std::streambuf* target) : m_target(target) {}
+
+    [[nodiscard]] const std::optional<Clock::time_point>& FirstByte() const {
+        return m_first_byte;
+    }
+
+protected:
+    int_type overflow(int_type ch) override {
+        if (traits_type::eq_int_type(ch, traits_type::eof())) {
+            return traits_type::not_eof(ch);
+        }
+        Mark();
+        return m_target->sputc(traits_type::to_char_type(ch));
+    }
+
+    std::streamsize xsputn(const char* s, std::streamsize count) override {
+        Mark();
+        return m_target->sputn(s, count);
+    }
+
+    int sync() override {
+        return m_target->pubsync();
+    }
+
+private:
+    void Mark() {
+        if (!m_first_byte) {
+            m_first_byte = Clock::now();
+        }
+    }
+
+    std::streambuf* m_target;
+    std::optional<Clock::time_point> m_first_byte;
+};
+
+struct Stats {
+    Clock::duration read{};
+    Clock::duration parse{};
+    Clock::duration execute{};
+    size_t warm_starts = 0u;
+    std::vector<runtime::TypeFeedback::HotMethod> hot_methods;
+};
+
+// Число самых часто вызываемых методов в выводе --stats
+constexpr size_t HOT_METHODS_SHOWN = 5u;
+
+void RunScript(std::string source, std::ostream& output, Stats& stats, parse::TokenizeMode mode) {
+    auto start = Clock::now();
+    std::istringstream input(std::move(source));
+    parse::Lexer lexer(input, mode);
+    auto program = ParseProgram(lexer);
+    auto parsed = Clock::now();
+    stats.parse += parsed - start;
+
+    runtime::SimpleContext context{output};
+    runtime::Closure closure;
+    program->Execute(closure, context);
+    stats.execute += Clock::now() - parsed;
+}
+
+void RunScriptWithSnapshot(const std::string& source, const std::string& snapshot_path, std::ostream& output, Stats& stats) {
+    auto start = Clock::now();
+    runtime::SimpleContext context{output};
+    runtime::Closure closure;
+    if (ExecuteProgramWithSnapshot(source, snapshot_path, closure, context)) {
+        ++stats.warm_starts;
+    }
+    stats.execute += Clock::now() - start;
+}
+
+void StreamScript(std::istream& input, std::ostream& output, Stats& stats, parse::TokenizeMode mode) {
+    auto start = Clock::now();
+    runtime::SimpleContext context{output};
+    runtime::Closure closure;
+    ExecuteProgramStreaming(input, closure, context, mode);
+    stats.execute += Clock::now() - start;
+}
+
+const std::string USAGE = "Usage: mython [--stats] [--isolate-heap] [--stream] [--pipeline] [--snapshot file] [--profile-out file] [--profile-in file] [--memory-limit bytes] [--memory-soft-limit bytes] [script.my ...]"s;
+
+// Число байт для флага flag: строка целиком из десятичных цифр, без знака
+size_t ParseByteCount(const std::string& flag, const std::string& text) {
+    size_t value = 0u;
+    const char* end = text.data() + text.size();
+    const auto [ptr, ec] = std::from_chars(text.data(), end, value);
+    if (text.empty() || text.front() == '-' || ec != std::errc{} || ptr != end) {
+        throw std::invalid_argument(flag + " expects a byte count, got '"s + text + "'\n"s + USAGE);
+    }
+    return value;
+}
+
+double ToMicroseconds(Clock::duration duration) {
+    return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    const auto started = Clock::now();
+    std::ios::sync_with_stdio(false);
+
+    bool print_stats = false;
+    bool use_isolate_heap = false;
+    bool stream = false;
+    parse::TokenizeMode tokenize_mode = parse::TokenizeMode::Batch;
+    std::optional<std::string> snapshot_path;
+    std::optional<std::string> profile_out;
+    std::optional<std::string> profile_in;
+    std::optional<std::string> memory_limit_arg;
+    std::optional<std::string> memory_soft_limit_arg;
+    std::vector<std::string> scripts;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--stats"s) {
+            print_stats = true;
+        }
+        else if (arg == "--isolate-heap"s) {
+            use_isolate_heap = true;
+        }
+        else if (arg == "--stream"s) {
+            stream = true;
+        }
+        else if (arg == "--pipeline"s) {
+            tokenize_mode = parse::TokenizeMode::Pipelined;
+        }
+        else if (arg == "--snapshot"s && i + 1 < argc) {
+            snapshot_path = argv[++i];
+        }
+        else if (arg == "--profile-out"s && i + 1 < argc) {
+            profile_out = argv[++i];
+        }
+        else if (arg == "--profile-in"s && i + 1 < argc) {
+            profile_in = argv[++i];
+        }
+        else if (arg == "--memory-limit"s && i + 1 < argc) {
+            memory_limit_arg = argv[++i];
+        }
+        else if (arg == "--memory-soft-limit"s && i + 1 < argc) {
+            memory_soft_limit_arg = argv[++i];
+        }
+        else if (!arg.empty() && arg.front() == '-') {
+            // Неизвестный флаг либо флаг, за которым не осталось значения
+            std::cerr << "Unknown option or missing value: "s << arg << '\n' << USAGE << std::endl;
+            return 1;
+        }
+        else {
+            scripts.push_back(arg);
+        }
+    }
+
+    size_t memory_limit = runtime::MemoryQuota::NO_LIMIT;
+    std::optional<size_t> memory_soft_limit;
+    try {
+        if (memory_limit_arg) {
+            memory_limit = ParseByteCount("--memory-limit"s, *memory_limit_arg);
+        }
+        if (memory_soft_limit_arg) {
+            memory_soft_limit = ParseByteCount("--memory-soft-limit"s, *memory_soft_limit_arg);
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    FirstByteTimer timer(std::cout.rdbuf());
+    std::ostream output(print_stats ? static_cast<std::streambuf*>(&timer) : std::cout.rdbuf());
+    Stats stats;
+
+    // Куча изолята объявлена раньше программы и её переменных и поэтому переживает их
+    std::optional<runtime::IsolateHeap> isolate;
+    std::optional<runtime::IsolateHeap::Scope> isolate_scope;
+    if (use_isolate_heap) {
+        isolate.emplace();
+        isolate_scope.emplace(*isolate);
+    }
+    // Квота, как и куча изолята, переживает всё, что на неё записано
+    const bool use_quota = memory_limit != runtime::MemoryQuota::NO_LIMIT || memory_soft_limit;
+    runtime::MemoryQuota quota(memory_limit);
+    std::optional<runtime::MemoryQuota::Scope> quota_scope;
+    if (use_quota) {
+        if (memory_soft_limit) {
+            quota.SetSoftLimit(*memory_soft_limit, [](const runtime::MemoryQuota& q) {
+                std::cerr << "warning: memory soft limit of " << q.SoftLimit() << " bytes exceeded (" << q.CurrentBytes() << " bytes in use)" << std::endl;
+            });
+        }
+        quota_scope.emplace(quota);
+    }
+
+    const bool use_profile = profile_out || profile_in;
+    auto run = [&](std::string source) {
+        if (snapshot_path) {
+            RunScriptWithSnapshot(source, *snapshot_path, output, stats);
+            return;
+        }
+        if (!use_profile) {
+            RunScript(std::move(source), output, stats, tokenize_mode);
+            return;
+        }
+        const uint64_t source_hash = runtime::SourceHash(source);
+        std::optional<runtime::TypeFeedback> applied;
+        if (profile_in) {
+            applied = runtime::TypeFeedback::ReadFromFile(*profile_in, source_hash);
+            if (!applied) {
+                std::cerr << "warning: feedback profile " << *profile_in << " was recorded for a different source text, running without it" << std::endl;
+            }
+        }
+        runtime::TypeFeedback recorded;
+        runtime::TypeFeedback::SetApplied(applied ? &*applied : nullptr);
+        runtime::TypeFeedback::SetRecording(profile_out ? &recorded : nullptr);
+        try {
+            RunScript(std::move(source), output, stats, tokenize_mode);
+        }
+        catch (...) {
+            runtime::TypeFeedback::SetApplied(nullptr);
+            runtime::TypeFeedback::SetRecording(nullptr);
+            throw;
+        }
+        runtime::TypeFeedback::SetApplied(nullptr);
+        runtime::TypeFeedback::SetRecording(nullptr);
+        if (profile_out) {
+            recorded.WriteToFile(*profile_out, source_hash);
+        }
+        if (profile_out || applied) {
+            stats.hot_methods = (profile_out ? recorded : *applied).HotMethods(HOT_METHODS_SHOWN);
+        }
+    };
+
+    try {
+        if (use_profile && (stream || snapshot_path || scripts.size() > 1u)) {
+            throw std::runtime_error("Profile flags take a single script and cannot be combined with --stream or --snapshot"s);
+        }
+        if (stream) {
+            if (scripts.empty()) {
+                StreamScript(std::cin, output, stats, tokenize_mode);
+            }
+            for (const std::string& path : scripts) {
+                std::ifstream input(path);
+                if (!input) {
+                    throw std::runtime_error("Cannot open "s + path);
+                }
+                StreamScript(input, output, stats, tokenize_mode);
+            }
+        }
+        else if (scripts.empty()) {
+            auto read_start = Clock::now();
+            std::string source = ReadStdin();
+            stats.read += Clock::now() - read_start;
+            run(std::move(source));
+        }
+        else {
+            for (const std::string& path : scripts) {
+                auto read_start = Clock::now();
+                std::string source = ReadFile(path);
+                stats.read += Clock::now() - read_start;
+                run(std::move(source));
+            }
+        }
+        output.flush();
+        MYTHON_TRACE0(output__flush);
+    }
+    catch (const std::exception& e) {
+        output.flush();
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    if (print_stats) {
+        std::cerr << "read_us " << ToMicroseconds(stats.read) << '\n'
+                  << "parse_us " << ToMicroseconds(stats.parse) << '\n'
+                  << "execute_us " << ToMicroseconds(stats.execute) << '\n';
+        if (snapshot_path) {
+            std::cerr << "snapshot_warm_starts " << stats.warm_starts << '\n';
+        }
+        if (use_quota) {
+            std::cerr << "memory_peak_bytes " << quota.PeakBytes() << '\n';
+        }
+        for (const runtime::TypeFeedback::HotMethod& method : stats.hot_methods) {
+            std::cerr << "hot_method " << method.class_name << '.' << method.method_name << ' ' << method.calls << '\n';
+        }
+        if (timer.FirstByte()) {
+            std::cerr << "first_output_us " << ToMicroseconds(*timer.FirstByte() - started) << '\n';
+        }
+        std::cerr << "total_us " << ToMicroseconds(Clock::now() - started) << std::endl;
+    }
+    return 0;
+}
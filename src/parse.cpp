@@ -1,8 +1,20 @@
 #include "parse.h"
 
+#include "feedback.h"
 #include "lexer.h"
 #include "runtime.h"
+#include "snapshot.h"
 #include "statement.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <istream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <unordered_set>
 
 using namespace std;
 
@@ -20,7 +32,18 @@ bool operator!=(const parse::Token& token, char c) {
 
 class Parser {
 public:
-    explicit Parser(parse::Lexer& lexer) : m_lexer(lexer) {}
+    // Объявленные классы и функции хранятся в declared_classes, чтобы на них могли ссылаться инструкции,
+    // разобранные другим экземпляром Parser (см. ExecuteProgramStreaming)
+    Parser(parse::Lexer& lexer, runtime::Closure& declared_classes) : m_lexer(lexer), m_declared_classes(declared_classes) {}
+
+    // Новые методы уже объявленного класса, собранные при разборе с перезагрузкой классов
+    struct ClassReload {
+        runtime::Class* cls;
+        vector<runtime::Method> methods;
+    };
+
+    // Повторное объявление класса не считается ошибкой: его методы добавляются в reloads (см. ReloadClasses)
+    Parser(parse::Lexer& lexer, runtime::Closure& declared_classes, vector<ClassReload>& reloads) : m_lexer(lexer), m_declared_classes(declared_classes), m_reloads(&reloads) {}
 
     // Program -> eps
     //          | Statement \n Program
@@ -33,12 +56,39 @@ public:
             }
             result->AddStatement(ParseStatement());
         }
+        // Классы получателей из профиля ищутся после разбора всей программы: вызов может стоять
+        // в методе раньше объявления класса получателя
+        for (const auto& [call, class_name] : m_pending_prefills) {
+            if (runtime::Closure::iterator it = m_declared_classes.find(class_name); it != m_declared_classes.end()) {
+                if (const runtime::Class* cls = it->second.TryAs<runtime::Class>()) {
+                    call->PrefillCache(*cls);
+                }
+            }
+        }
+        m_pending_prefills.clear();
+        // load может восстанавливать экземпляры классов, объявленных ниже вызова
+        for (ast::Load* load : m_pending_loads) {
+            load->SetClasses(m_declared_classes);
+        }
+        m_pending_loads.clear();
 
         return result;
     }
 
+    // Разбирает очередную инструкцию верхнего уровня. Возвращает nullptr, если токены закончились
+    unique_ptr<runtime::Executable> ParseNextStatement() {
+        while (m_lexer.CurrentToken().Is<TokenType::Newline>()) {
+            m_lexer.NextToken();
+        }
+        if (m_lexer.CurrentToken().Is<TokenType::Eof>()) {
+            return nullptr;
+        }
+        return ParseStatement();
+    }
+
 private:
     // Suite -> NEWLINE INDENT (Statement)+ DEDENT
+    // Лексер отбрасывает завершающие DEDENT в конце входа, поэтому блок может закончиться и на EOF
     unique_ptr<runtime::Executable> ParseSuite() {
         m_lexer.Expect<TokenType::Newline>();
         m_lexer.ExpectNext<TokenType::Indent>();
@@ -46,45 +96,87 @@ private:
         m_lexer.NextToken();
 
         std::unique_ptr<ast::Compound> result = make_unique<ast::Compound>();
-        while (!m_lexer.CurrentToken().Is<TokenType::Dedent>()) {
+        while (!m_lexer.CurrentToken().Is<TokenType::Dedent>() && !m_lexer.CurrentToken().Is<TokenType::Eof>()) {
             result->AddStatement(ParseStatement());
         }
-
-        m_lexer.Expect<TokenType::Dedent>();
-        m_lexer.NextToken();
+        SkipBlockEnd();
 
         return result;
     }
 
-    // Methods -> [def id(Params) : Suite]*
-    vector<runtime::Method> ParseMethods() {
-        vector<runtime::Method> result;
+    // Пропускает DEDENT, закрывающий блок, если вход не закончился раньше
+    void SkipBlockEnd() {
+        if (!m_lexer.CurrentToken().Is<TokenType::Eof>()) {
+            m_lexer.Expect<TokenType::Dedent>();
+            m_lexer.NextToken();
+        }
+    }
 
-        while (m_lexer.CurrentToken().Is<TokenType::Def>()) {
-            runtime::Method m;
+    // Method -> def id(Params) : Suite
+    runtime::Method ParseMethod() {
+        runtime::Method m = ParseSignature();
+        m.body = std::make_unique<ast::MethodBody>(ParseSuite());
+        return m;
+    }
 
-            m.name = m_lexer.ExpectNext<TokenType::Id>().value;
-            m_lexer.ExpectNext<TokenType::Char>('(');
+    // Signature -> def id(Params) :
+    // Возвращает метод без тела, текущей лексемой становится перевод строки перед телом
+    runtime::Method ParseSignature() {
+        runtime::Method m;
 
-            if (m_lexer.NextToken().Is<TokenType::Id>()) {
-                m.formal_params.push_back(m_lexer.Expect<TokenType::Id>().value);
-                while (m_lexer.NextToken() == ',') {
-                    m.formal_params.push_back(m_lexer.ExpectNext<TokenType::Id>().value);
-                }
-            }
+        m.name = m_lexer.ExpectNext<TokenType::Id>().value;
+        m_lexer.ExpectNext<TokenType::Char>('(');
 
-            m_lexer.Expect<TokenType::Char>(')');
-            m_lexer.ExpectNext<TokenType::Char>(':');
-            m_lexer.NextToken();
+        if (m_lexer.NextToken().Is<TokenType::Id>()) {
+            m.formal_params.push_back(m_lexer.Expect<TokenType::Id>().value);
+            while (m_lexer.NextToken() == ',') {
+                m.formal_params.push_back(m_lexer.ExpectNext<TokenType::Id>().value);
+            }
+        }
 
-            m.body = std::make_unique<ast::MethodBody>(ParseSuite());
+        m_lexer.Expect<TokenType::Char>(')');
+        m_lexer.ExpectNext<TokenType::Char>(':');
+        m_lexer.NextToken();
+        return m;
+    }
 
-            result.push_back(std::move(m));
+    // FunctionDefinition -> def id(Params) : Suite
+    // Функция объявляется до разбора тела, чтобы тело могло вызывать её рекурсивно
+    unique_ptr<runtime::Executable> ParseFunctionDefinition() {
+        runtime::Method signature = ParseSignature();
+        auto [it, inserted] = m_declared_classes.insert({signature.name, runtime::ObjectHolder::Own(runtime::Function(signature.name, std::move(signature.formal_params)))});
+        if (!inserted) {
+            throw ParseError("Name "s + signature.name + " is already declared"s);
         }
-        return result;
+        runtime::ObjectHolder function = it->second;
+        function.TryAs<runtime::Function>()->SetBody(std::make_unique<ast::MethodBody>(ParseSuite()));
+        return make_unique<ast::FunctionDefinition>(std::move(function));
     }
 
-    // ClassDefinition -> Id ['(' Id ')'] : new_line indent MethodList dedent
+    // ClassBody -> [Method | id = Test new_line]+
+    void ParseClassBody(vector<runtime::Method>& methods, vector<pair<string, unique_ptr<runtime::Executable>>>& attributes) {
+        do {
+            if (m_lexer.CurrentToken().Is<TokenType::Id>()) {
+                string name = m_lexer.CurrentToken().As<TokenType::Id>().value;
+                m_lexer.ExpectNext<TokenType::Char>('=');
+                m_lexer.NextToken();
+                attributes.emplace_back(std::move(name), ParseTest());
+                // Как и в ParseStatement, перевод строки в конце входа может быть отброшен
+                if (m_lexer.CurrentToken().Is<TokenType::Newline>()) {
+                    m_lexer.NextToken();
+                }
+                else if (!m_lexer.CurrentToken().Is<TokenType::Eof>() && !m_lexer.CurrentToken().Is<TokenType::Dedent>()) {
+                    m_lexer.Expect<TokenType::Newline>();
+                }
+            }
+            else {
+                m_lexer.Expect<TokenType::Def>();
+                methods.push_back(ParseMethod());
+            }
+        } while (m_lexer.CurrentToken().Is<TokenType::Def>() || m_lexer.CurrentToken().Is<TokenType::Id>());
+    }
+
+    // ClassDefinition -> Id ['(' Id ')'] : new_line indent ClassBody dedent
     unique_ptr<runtime::Executable> ParseClassDefinition() {
         string class_name = m_lexer.Expect<TokenType::Id>().value;
 
@@ -97,20 +189,31 @@ private:
             m_lexer.NextToken();
 
             runtime::Closure::iterator it = m_declared_classes.find(name);
-            if (it == m_declared_classes.end()) {
+            if (it == m_declared_classes.end() || it->second.TryAs<runtime::Class>() == nullptr) {
                 throw ParseError("Base class "s + name + " not found for class "s + class_name);
             }
-            base_class = static_cast<const runtime::Class*>(it->second.Get());
+            base_class = it->second.TryAs<runtime::Class>();
         }
 
         m_lexer.Expect<TokenType::Char>(':');
         m_lexer.ExpectNext<TokenType::Newline>();
         m_lexer.ExpectNext<TokenType::Indent>();
-        m_lexer.ExpectNext<TokenType::Def>();
-        vector<runtime::Method> methods = ParseMethods();
-
-        m_lexer.Expect<TokenType::Dedent>();
         m_lexer.NextToken();
+        vector<runtime::Method> methods;
+        vector<pair<string, unique_ptr<runtime::Executable>>> attributes;
+        ParseClassBody(methods, attributes);
+        SkipBlockEnd();
+
+        if (m_reloads != nullptr) {
+            if (runtime::Closure::iterator it = m_declared_classes.find(class_name); it != m_declared_classes.end() && it->second.TryAs<runtime::Class>() != nullptr) {
+                runtime::Class* cls = it->second.TryAs<runtime::Class>();
+                if (cls->GetParent() != base_class) {
+                    throw ParseError("Base class of "s + class_name + " cannot be changed on reload"s);
+                }
+                m_reloads->push_back({cls, std::move(methods)});
+                return make_unique<ast::ClassDefinition>(it->second, std::move(attributes));
+            }
+        }
 
         auto [it, inserted] = m_declared_classes.insert({class_name, runtime::ObjectHolder::Own(runtime::Class(class_name, std::move(methods), base_class))});
 
@@ -118,7 +221,7 @@ private:
             throw ParseError("Class "s + class_name + " already exists"s);
         }
 
-        return make_unique<ast::ClassDefinition>(it->second);
+        return make_unique<ast::ClassDefinition>(it->second, std::move(attributes));
     }
 
     vector<string> ParseDottedIds() {
@@ -151,10 +254,6 @@ private:
         m_lexer.Expect<TokenType::Char>('(');
         m_lexer.NextToken();
 
-        if (id_list.empty()) {
-            throw ParseError("Mython doesn't support functions, only methods: "s + last_name);
-        }
-
         vector<unique_ptr<runtime::Executable>> args;
         if (m_lexer.CurrentToken() != ')') {
             args = ParseTestList();
@@ -162,7 +261,111 @@ private:
         m_lexer.Expect<TokenType::Char>(')');
         m_lexer.NextToken();
 
-        return make_unique<ast::MethodCall>(make_unique<ast::VariableValue>(std::move(id_list)), std::move(last_name), std::move(args));
+        if (id_list.empty()) {
+            return MakeCall(last_name, std::move(args));
+        }
+        return WithFeedback(make_unique<ast::MethodCall>(make_unique<ast::VariableValue>(std::move(id_list)), std::move(last_name), std::move(args)));
+    }
+
+    // Нумерует узел как точку наблюдения профиля и специализирует его по профилю runtime::TypeFeedback::Applied()
+    template <typename Operation>
+    unique_ptr<runtime::Executable> WithFeedback(unique_ptr<Operation> node) {
+        const uint32_t site = ++m_next_site;
+        uint8_t lhs_hint = 0u;
+        if (const runtime::TypeFeedback* feedback = runtime::TypeFeedback::Applied()) {
+            // Подсказка даётся, только если в прошлом запуске левый операнд был одного вида
+            if (const runtime::TypeFeedback::OperatorSite* entry = feedback->FindOperator(site); entry != nullptr && std::has_single_bit(entry->lhs_kinds)) {
+                lhs_hint = entry->lhs_kinds;
+            }
+        }
+        node->SetFeedbackSite(site, lhs_hint);
+        return node;
+    }
+
+    unique_ptr<runtime::Executable> WithFeedback(unique_ptr<ast::MethodCall> node) {
+        const uint32_t site = ++m_next_site;
+        node->SetFeedbackSite(site);
+        if (const runtime::TypeFeedback* feedback = runtime::TypeFeedback::Applied()) {
+            if (const runtime::TypeFeedback::CallSite* entry = feedback->FindCall(site); entry != nullptr && !entry->megamorphic && entry->receivers.size() == 1u) {
+                m_pending_prefills.emplace_back(node.get(), entry->receivers.front());
+            }
+        }
+        return node;
+    }
+
+    /*
+     * FSTRING -> [literal | '{{' | '}}' | '{' Test '}']*
+     * Текст форматной строки делится на литералы и подстановки один раз, при разборе.
+     * Выражение подстановки разбирается отдельным лексером, но тем же набором классов и с общей
+     * нумерацией точек наблюдения профиля
+     */
+    unique_ptr<runtime::Executable> ParseFormatString(const string& text) {
+        vector<string> literals(1);
+        vector<unique_ptr<runtime::Executable>> slots;
+        for (size_t pos = 0; pos < text.size(); ++pos) {
+            const char ch = text[pos];
+            if ((ch == '{' || ch == '}') && pos + 1u < text.size() && text[pos + 1u] == ch) {
+                literals.back() += ch;
+                ++pos;
+            }
+            else if (ch == '{') {
+                const size_t end = FindSlotEnd(text, pos + 1u);
+                slots.push_back(ParseFormatSlot(text.substr(pos + 1u, end - pos - 1u)));
+                literals.emplace_back();
+                pos = end;
+            }
+            else if (ch == '}') {
+                throw ParseError("Single '}' is not allowed in format string: "s + text);
+            }
+            else {
+                literals.back() += ch;
+            }
+        }
+        if (slots.empty()) {
+            return make_unique<ast::StringConst>(std::move(literals.front()));
+        }
+        return make_unique<ast::FormatString>(std::move(literals), std::move(slots));
+    }
+
+    // Позиция '}', закрывающей подстановку, начатую перед begin. Скобки внутри строковых литералов не считаются
+    static size_t FindSlotEnd(const string& text, size_t begin) {
+        char quote = 0;
+        for (size_t pos = begin; pos < text.size(); ++pos) {
+            const char ch = text[pos];
+            if (quote != 0) {
+                quote = ch == quote ? 0 : quote;
+            }
+            else if (ch == '"' || ch == '\'') {
+                quote = ch;
+            }
+            else if (ch == '{') {
+                break;
+            }
+            else if (ch == '}') {
+                return pos;
+            }
+        }
+        throw ParseError("Unterminated '{' in format string: "s + text);
+    }
+
+    unique_ptr<runtime::Executable> ParseFormatSlot(const string& source) {
+        const size_t first = source.find_first_not_of(' ');
+        if (first == string::npos) {
+            throw ParseError("Empty expression in format string"s);
+        }
+        // Пробелы в начале лексер принял бы за отступ
+        istringstream input(source.substr(first));
+        parse::Lexer lexer(input);
+        Parser parser(lexer, m_declared_classes);
+        parser.m_next_site = m_next_site;
+        unique_ptr<runtime::Executable> result = parser.ParseTest();
+        if (!lexer.CurrentToken().Is<TokenType::Newline>() && !lexer.CurrentToken().Is<TokenType::Eof>()) {
+            throw ParseError("Unexpected token in format string expression: "s + source);
+        }
+        m_next_site = parser.m_next_site;
+        std::move(parser.m_pending_prefills.begin(), parser.m_pending_prefills.end(), std::back_inserter(m_pending_prefills));
+        std::move(parser.m_pending_loads.begin(), parser.m_pending_loads.end(), std::back_inserter(m_pending_loads));
+        return result;
     }
 
     // Expr -> Adder ['+'/'-' Adder]*
@@ -174,9 +377,9 @@ private:
             m_lexer.NextToken();
 
             if (op == '+') {
-                result = make_unique<ast::Add>(std::move(result), ParseAdder());
+                result = WithFeedback(make_unique<ast::Add>(std::move(result), ParseAdder()));
             } else {
-                result = make_unique<ast::Sub>(std::move(result), ParseAdder());
+                result = WithFeedback(make_unique<ast::Sub>(std::move(result), ParseAdder()));
             }
         }
         return result;
@@ -190,9 +393,9 @@ private:
             m_lexer.NextToken();
 
             if (op == '*') {
-                result = make_unique<ast::Mult>(std::move(result), ParseMult());
+                result = WithFeedback(make_unique<ast::Mult>(std::move(result), ParseMult()));
             } else {
-                result = make_unique<ast::Div>(std::move(result), ParseMult());
+                result = WithFeedback(make_unique<ast::Div>(std::move(result), ParseMult()));
             }
         }
         return result;
@@ -202,6 +405,7 @@ private:
     //       | NUMBER
     //       | '-' Mult
     //       | STRING
+    //       | FSTRING
     //       | NONE
     //       | TRUE
     //       | FALSE
@@ -217,18 +421,28 @@ private:
         }
         if (m_lexer.CurrentToken() == '-') {
             m_lexer.NextToken();
-            return make_unique<ast::Mult>(ParseMult(), make_unique<ast::NumericConst>(-1));
+            return WithFeedback(make_unique<ast::Mult>(ParseMult(), make_unique<ast::NumericConst>(-1)));
         }
         if (const TokenType::Number* num = m_lexer.CurrentToken().TryAs<TokenType::Number>()) {
             int result = num->value;
             m_lexer.NextToken();
             return make_unique<ast::NumericConst>(result);
         }
+        if (const TokenType::BigNumber* num = m_lexer.CurrentToken().TryAs<TokenType::BigNumber>()) {
+            runtime::BigInt result = runtime::BigInt::FromString(num->value);
+            m_lexer.NextToken();
+            return make_unique<ast::BigNumericConst>(runtime::BigNumber(std::move(result)));
+        }
         if (const TokenType::String* str = m_lexer.CurrentToken().TryAs<TokenType::String>()) {
             string result = str->value;
             m_lexer.NextToken();
             return make_unique<ast::StringConst>(std::move(result));
         }
+        if (const TokenType::FormatString* str = m_lexer.CurrentToken().TryAs<TokenType::FormatString>()) {
+            string text = str->value;
+            m_lexer.NextToken();
+            return ParseFormatString(text);
+        }
         if (m_lexer.CurrentToken().Is<TokenType::True>()) {
             m_lexer.NextToken();
             return make_unique<ast::BoolConst>(runtime::Bool(true));
@@ -261,20 +475,59 @@ private:
             names.pop_back();
 
             if (!names.empty()) {
-                return make_unique<ast::MethodCall>(make_unique<ast::VariableValue>(std::move(names)), std::move(method_name), std::move(args));
+                return WithFeedback(make_unique<ast::MethodCall>(make_unique<ast::VariableValue>(std::move(names)), std::move(method_name), std::move(args)));
             }
-            if (runtime::Closure::iterator it = m_declared_classes.find(method_name); it != m_declared_classes.end()) {
-                return make_unique<ast::NewInstance>(static_cast<const runtime::Class&>(*it->second), std::move(args));
+            return MakeCall(method_name, std::move(args));
+        }
+        return make_unique<ast::VariableValue>(std::move(names));
+    }
+
+    // Вызов без получателя: создание экземпляра класса, функция верхнего уровня или встроенная функция
+    unique_ptr<runtime::Executable> MakeCall(const string& name, vector<unique_ptr<runtime::Executable>> args) {
+        if (runtime::Closure::iterator it = m_declared_classes.find(name); it != m_declared_classes.end()) {
+            if (const runtime::Class* cls = it->second.TryAs<runtime::Class>()) {
+                return make_unique<ast::NewInstance>(*cls, std::move(args));
             }
-            if (method_name == "str"sv) {
-                if (args.size() != 1) {
-                    throw ParseError("Function str takes exactly one argument"s);
-                }
-                return make_unique<ast::Stringify>(std::move(args.front()));
+            const runtime::Function& function = *it->second.TryAs<runtime::Function>();
+            if (function.GetFormalParams().size() != args.size()) {
+                throw ParseError("Function "s + name + " takes "s + to_string(function.GetFormalParams().size()) + " arguments, "s + to_string(args.size()) + " given"s);
             }
-            throw ParseError("Unknown call to "s + method_name + "()"s);
+            return make_unique<ast::FunctionCall>(function, std::move(args));
         }
-        return make_unique<ast::VariableValue>(std::move(names));
+        if (name == "str"sv) {
+            if (args.size() != 1) {
+                throw ParseError("Function str takes exactly one argument"s);
+            }
+            return make_unique<ast::Stringify>(std::move(args.front()));
+        }
+        if (name == "copy"sv || name == "deepcopy"sv) {
+            if (args.size() != 1) {
+                throw ParseError("Function "s + name + " takes exactly one argument"s);
+            }
+            return make_unique<ast::Copy>(std::move(args.front()), name == "deepcopy"sv);
+        }
+        if (name == "save"sv) {
+            if (args.size() != 2) {
+                throw ParseError("Function save takes exactly two arguments"s);
+            }
+            return make_unique<ast::Save>(std::move(args[0]), std::move(args[1]));
+        }
+        if (name == "load"sv) {
+            if (args.size() != 1) {
+                throw ParseError("Function load takes exactly one argument"s);
+            }
+            auto load = make_unique<ast::Load>(std::move(args.front()));
+            load->SetClasses(m_declared_classes);
+            m_pending_loads.push_back(load.get());
+            return load;
+        }
+        if (name == "IntArray"sv) {
+            if (args.empty() || args.size() > 2) {
+                throw ParseError("Function IntArray takes one or two arguments"s);
+            }
+            return make_unique<ast::NewIntArray>(std::move(args));
+        }
+        throw ParseError("Unknown call to "s + name + "()"s);
     }
 
     vector<unique_ptr<runtime::Executable>> ParseTestList() {
@@ -289,16 +542,31 @@ private:
     }
 
     // Condition -> if LogicalExpr: Suite [else: Suite]
+    // Condition -> if Test : Suite [elif Test : Suite]* [else : Suite]
     unique_ptr<runtime::Executable> ParseCondition() {
         m_lexer.Expect<TokenType::If>();
-        m_lexer.NextToken();
 
-        unique_ptr<runtime::Executable> condition = ParseTest();
-
-        m_lexer.Expect<TokenType::Char>(':');
-        m_lexer.NextToken();
+        vector<ast::IfElse::Arm> arms;
+        // Ключи ветвей, пока все условия имеют вид subject == константа (см. ast::Switch)
+        vector<runtime::ObjectHolder> keys;
+        const vector<string>* subject = nullptr;
+        bool switchable = true;
+        do {
+            m_lexer.NextToken();
+            m_last_case = {};
+            unique_ptr<runtime::Executable> condition = ParseTest();
+            if (switchable && m_last_case.node == condition.get() && (subject == nullptr || (*subject == *m_last_case.subject && SameKind(keys.front(), m_last_case.key)))) {
+                subject = m_last_case.subject;
+                keys.push_back(m_last_case.key);
+            }
+            else {
+                switchable = false;
+            }
 
-        unique_ptr<runtime::Executable> if_body = ParseSuite();
+            m_lexer.Expect<TokenType::Char>(':');
+            m_lexer.NextToken();
+            arms.emplace_back(std::move(condition), ParseSuite());
+        } while (m_lexer.CurrentToken().Is<TokenType::Elif>());
 
         unique_ptr<runtime::Executable> else_body;
         if (m_lexer.CurrentToken().Is<TokenType::Else>()) {
@@ -307,7 +575,35 @@ private:
             else_body = ParseSuite();
         }
 
-        return make_unique<ast::IfElse>(std::move(condition), std::move(if_body), std::move(else_body));
+        if (switchable && arms.size() >= ast::Switch::MIN_ARMS) {
+            auto switch_subject = make_unique<ast::VariableValue>(*subject);
+            return make_unique<ast::Switch>(std::move(switch_subject), keys, make_unique<ast::IfElse>(std::move(arms), std::move(else_body)));
+        }
+        return make_unique<ast::IfElse>(std::move(arms), std::move(else_body));
+    }
+
+    static bool SameKind(const runtime::ObjectHolder& lhs, const runtime::ObjectHolder& rhs) {
+        return (lhs.TryAs<runtime::Number>() != nullptr) == (rhs.TryAs<runtime::Number>() != nullptr);
+    }
+
+    // Запоминает сравнение node вида id1.id2 == константа (или константа == id1.id2), где константа -
+    // целое число, помещающееся в Number, либо строка
+    void RememberCase(const runtime::Executable* node, const runtime::Executable& lhs, const runtime::Executable& rhs) {
+        const auto* variable = dynamic_cast<const ast::VariableValue*>(&lhs);
+        const runtime::Executable* constant = &rhs;
+        if (variable == nullptr) {
+            variable = dynamic_cast<const ast::VariableValue*>(&rhs);
+            constant = &lhs;
+        }
+        if (variable == nullptr) {
+            return;
+        }
+        if (const auto* number = dynamic_cast<const ast::NumericConst*>(constant)) {
+            m_last_case = {node, &variable->GetDottedIds(), number->GetValue()};
+        }
+        else if (const auto* str = dynamic_cast<const ast::StringConst*>(constant)) {
+            m_last_case = {node, &variable->GetDottedIds(), str->GetValue()};
+        }
     }
 
     // LogicalExpr -> AndTest [OR AndTest]
@@ -341,6 +637,7 @@ private:
     }
 
     // Comparison -> Expr [COMP_OP Expr]
+    //             | Expr is [not] Expr
     unique_ptr<runtime::Executable> ParseComparison() {
         unique_ptr<runtime::Executable> result = ParseExpression();
 
@@ -348,37 +645,54 @@ private:
 
         if (tok == '<') {
             m_lexer.NextToken();
-            return make_unique<ast::Comparison>(runtime::Less, std::move(result), ParseExpression());
+            return WithFeedback(make_unique<ast::Comparison>(runtime::Less, std::move(result), ParseExpression()));
         }
         if (tok == '>') {
             m_lexer.NextToken();
-            return make_unique<ast::Comparison>(runtime::Greater, std::move(result), ParseExpression());
+            return WithFeedback(make_unique<ast::Comparison>(runtime::Greater, std::move(result), ParseExpression()));
         }
         if (tok.Is<TokenType::Eq>()) {
             m_lexer.NextToken();
-            return make_unique<ast::Comparison>(runtime::Equal, std::move(result), ParseExpression());
+            unique_ptr<runtime::Executable> rhs = ParseExpression();
+            const runtime::Executable& lhs_ref = *result;
+            const runtime::Executable& rhs_ref = *rhs;
+            unique_ptr<runtime::Executable> comparison = WithFeedback(make_unique<ast::Comparison>(runtime::Equal, std::move(result), std::move(rhs)));
+            RememberCase(comparison.get(), lhs_ref, rhs_ref);
+            return comparison;
         }
         if (tok.Is<TokenType::NotEq>()) {
             m_lexer.NextToken();
-            return make_unique<ast::Comparison>(runtime::NotEqual, std::move(result), ParseExpression());
+            return WithFeedback(make_unique<ast::Comparison>(runtime::NotEqual, std::move(result), ParseExpression()));
         }
         if (tok.Is<TokenType::LessOrEq>()) {
             m_lexer.NextToken();
-            return make_unique<ast::Comparison>(runtime::LessOrEqual, std::move(result), ParseExpression());
+            return WithFeedback(make_unique<ast::Comparison>(runtime::LessOrEqual, std::move(result), ParseExpression()));
         }
         if (tok.Is<TokenType::GreaterOrEq>()) {
             m_lexer.NextToken();
-            return make_unique<ast::Comparison>(runtime::GreaterOrEqual, std::move(result), ParseExpression());
+            return WithFeedback(make_unique<ast::Comparison>(runtime::GreaterOrEqual, std::move(result), ParseExpression()));
+        }
+        if (tok.Is<TokenType::Is>()) {
+            const bool negated = m_lexer.NextToken().Is<TokenType::Not>();
+            if (negated) {
+                m_lexer.NextToken();
+            }
+            return make_unique<ast::Identity>(std::move(result), ParseExpression(), negated);
         }
         return result;
     }
 
     // Statement -> SimpleStatement Newline
     //           | class ClassDefinition
-    //           | if Condition
+    //           | FunctionDefinition
+    //           | Condition
     unique_ptr<runtime::Executable> ParseStatement() {
         const parse::Token& tok = m_lexer.CurrentToken();
 
+        if (tok.Is<TokenType::Def>()) {
+            return ParseFunctionDefinition();
+        }
+
         if (tok.Is<TokenType::Class>()) {
             m_lexer.NextToken();
             return ParseClassDefinition();
@@ -387,7 +701,8 @@ private:
             return ParseCondition();
         }
         unique_ptr<runtime::Executable> result = ParseSimpleStatement();
-        if(m_lexer.CurrentToken().Is<TokenType::Eof>()) {
+        // Перевод строки перед DEDENT в конце входа лексер может отбросить
+        if(m_lexer.CurrentToken().Is<TokenType::Eof>() || m_lexer.CurrentToken().Is<TokenType::Dedent>()) {
             return result;
         }
         m_lexer.Expect<TokenType::Newline>();
@@ -417,11 +732,332 @@ private:
     }
 
     parse::Lexer& m_lexer;
-    runtime::Closure m_declared_classes;
+    runtime::Closure& m_declared_classes;
+    vector<ClassReload>* m_reloads = nullptr;
+    // Точки наблюдения профиля нумеруются с единицы в порядке создания узлов
+    uint32_t m_next_site = 0u;
+    // Вызовы методов, кэши которых заполняются по профилю в конце ParseProgram
+    vector<pair<ast::MethodCall*, string>> m_pending_prefills;
+    // Вызовы load, которым в конце ParseProgram передаются все классы программы
+    vector<ast::Load*> m_pending_loads;
+
+    // Последнее разобранное сравнение переменной с константой (см. ParseCondition)
+    struct CaseTest {
+        const runtime::Executable* node = nullptr;
+        const vector<string>* subject = nullptr;
+        runtime::ObjectHolder key;
+    };
+    CaseTest m_last_case;
 };
 
 }  // namespace
 
 unique_ptr<runtime::Executable> ParseProgram(parse::Lexer& lexer) {
-    return Parser{lexer}.ParseProgram();
-}
\ No newline at end of file
+    MYTHON_TRACE0(parse__start);
+    runtime::Closure declared_classes;
+    unique_ptr<runtime::Executable> program = Parser{lexer, declared_classes}.ParseProgram();
+    MYTHON_TRACE0(parse__done);
+    return program;
+}
+
+unique_ptr<runtime::Executable> ParseProgram(parse::Lexer& lexer, runtime::Closure& declared_classes) {
+    MYTHON_TRACE0(parse__start);
+    unique_ptr<runtime::Executable> program = Parser{lexer, declared_classes}.ParseProgram();
+    MYTHON_TRACE0(parse__done);
+    return program;
+}
+
+bool ExecuteProgramWithSnapshot(std::string_view source, const std::string& snapshot_path, runtime::Closure& closure, runtime::Context& context) {
+    static constexpr std::string_view MARKER = "# @snapshot"sv;
+    size_t marker = 0u;
+    while (source.compare(marker, MARKER.size(), MARKER) != 0) {
+        marker = source.find('\n', marker);
+        if (marker == std::string_view::npos) {
+            throw std::runtime_error("Program has no snapshot marker line "s + std::string(MARKER));
+        }
+        ++marker;
+    }
+    const std::string_view prologue = source.substr(0, marker);
+    const size_t rest_begin = source.find('\n', marker);
+    const std::string_view rest = rest_begin == std::string_view::npos ? std::string_view{} : source.substr(rest_begin + 1u);
+
+    // Классы пролога нужны в любом случае: на них ссылаются снимок и основная часть программы
+    runtime::Closure declared_classes;
+    istringstream prologue_input{std::string(prologue)};
+    parse::Lexer prologue_lexer(prologue_input);
+    unique_ptr<runtime::Executable> prologue_program = ParseProgram(prologue_lexer, declared_classes);
+
+    const uint64_t hash = runtime::SourceHash(prologue);
+    bool warm = true;
+    try {
+        closure = runtime::LoadSnapshot(snapshot_path, hash, declared_classes);
+    }
+    catch (const runtime::SnapshotError&) {
+        warm = false;
+        prologue_program->Execute(closure, context);
+        runtime::SaveSnapshot(snapshot_path, closure, hash);
+    }
+
+    istringstream rest_input{std::string(rest)};
+    parse::Lexer rest_lexer(rest_input);
+    ParseProgram(rest_lexer, declared_classes)->Execute(closure, context);
+    return warm;
+}
+
+void ExecuteProgramStreaming(std::istream& input, runtime::Closure& closure, runtime::Context& context, parse::TokenizeMode mode) {
+    // Классы переживают разобранные фрагменты: на них ссылаются экземпляры и последующие инструкции
+    runtime::Closure declared_classes;
+    if (mode == parse::TokenizeMode::Pipelined) {
+        // Конвейерный лексер сам делит вход на инструкции и освобождает прочитанные лексемы
+        parse::Lexer lexer(input, mode);
+        Parser parser(lexer, declared_classes);
+        while (unique_ptr<runtime::Executable> statement = parser.ParseNextStatement()) {
+            statement->Execute(closure, context);
+        }
+        return;
+    }
+    parse::utility::TopLevelChunkReader reader(input);
+    std::string chunk;
+    std::istringstream chunk_input;
+    while (reader.Next(chunk)) {
+        chunk_input.clear();
+        chunk_input.str(chunk);
+        parse::Lexer lexer(chunk_input);
+        Parser parser(lexer, declared_classes);
+        while (unique_ptr<runtime::Executable> statement = parser.ParseNextStatement()) {
+            statement->Execute(closure, context);
+        }
+    }
+}
+size_t ReloadClasses(std::istream& input, runtime::Closure& closure) {
+    runtime::Closure declared_classes;
+    for (const auto& [name, value] : closure) {
+        // Функции нужны, чтобы новые методы могли их вызывать
+        if (value.TryAs<runtime::Class>() != nullptr || value.TryAs<runtime::Function>() != nullptr) {
+            declared_classes.insert({name, value});
+        }
+    }
+    const size_t known_classes = declared_classes.size();
+
+    // Сначала разбирается весь вход: при ошибке ни один класс не меняется
+    vector<Parser::ClassReload> reloads;
+    vector<unique_ptr<runtime::Executable>> definitions;
+    parse::Lexer lexer(input);
+    Parser parser(lexer, declared_classes, reloads);
+    while (unique_ptr<runtime::Executable> statement = parser.ParseNextStatement()) {
+        if (dynamic_cast<ast::ClassDefinition*>(statement.get()) == nullptr) {
+            throw ParseError("Only class definitions can be reloaded"s);
+        }
+        definitions.push_back(std::move(statement));
+    }
+
+    for (Parser::ClassReload& reload : reloads) {
+        reload.cls->Redefine(std::move(reload.methods));
+    }
+    for (auto it = declared_classes.begin() + known_classes; it != declared_classes.end(); ++it) {
+        closure[it->first] = it->second;
+    }
+    // Атрибуты классов вычисляются заново; вывод при их вычислении отбрасывается
+    runtime::DummyContext context;
+    for (const unique_ptr<runtime::Executable>& definition : definitions) {
+        definition->Execute(closure, context);
+    }
+    return reloads.size();
+}
+
+namespace parse {
+
+namespace {
+
+vector<string> SplitTopLevel(const string& source) {
+    istringstream input(source);
+    utility::TopLevelChunkReader reader(input);
+    vector<string> chunks;
+    string chunk;
+    while (reader.Next(chunk)) {
+        chunks.push_back(std::move(chunk));
+    }
+    return chunks;
+}
+
+// Приводит поток лексем к виду, не зависящему от разбиения на фрагменты
+vector<Token> Normalize(const TokenQueue& tokens) {
+    vector<Token> result;
+    result.reserve(tokens.size());
+    for (const Token& token : tokens) {
+        if (!(token.Is<token_type::Newline>() && !result.empty() && result.back().Is<token_type::Dedent>())) {
+            result.push_back(token);
+        }
+    }
+    while (!result.empty() && (result.back().Is<token_type::Newline>() || result.back().Is<token_type::Dedent>())) {
+        result.pop_back();
+    }
+    return result;
+}
+
+bool MentionsAny(const TokenQueue& tokens, const unordered_set<string>& names) {
+    return any_of(tokens.begin(), tokens.end(), [&names](const Token& token) {
+        const token_type::Id* id = token.TryAs<token_type::Id>();
+        return id != nullptr && names.count(id->value) > 0;
+    });
+}
+
+}  // namespace
+
+IncrementalProgram::IncrementalProgram(std::string source) {
+    SetSource(std::move(source));
+}
+
+size_t IncrementalProgram::Edit(size_t offset, size_t length, std::string_view replacement) {
+    if (offset > m_source.size()) {
+        throw std::out_of_range("Edit offset "s + to_string(offset) + " is past the end of the source"s);
+    }
+    string source = m_source;
+    source.replace(offset, length, replacement);
+    return SetSource(std::move(source));
+}
+
+size_t IncrementalProgram::SetSource(std::string source) {
+    vector<string> texts = SplitTopLevel(source);
+
+    // Совпадающие фрагменты в начале и в конце переиспользуются
+    const size_t common = min(texts.size(), m_chunks.size());
+    size_t prefix = 0;
+    while (prefix < common && texts[prefix] == m_chunks[prefix].text) {
+        ++prefix;
+    }
+    size_t suffix = 0;
+    while (suffix < common - prefix && texts[texts.size() - 1 - suffix] == m_chunks[m_chunks.size() - 1 - suffix].text) {
+        ++suffix;
+    }
+    const size_t old_middle_end = m_chunks.size() - suffix;
+
+    unordered_set<string> changed_classes;
+    for (size_t i = prefix; i < old_middle_end; ++i) {
+        for (const auto& [name, class_holder] : m_chunks[i].classes) {
+            changed_classes.insert(name);
+        }
+    }
+
+    // Новые фрагменты строятся отдельно, чтобы при ошибке разбора программа осталась прежней.
+    // reused[i] - индекс переиспользуемого старого фрагмента для i-го нового
+    runtime::Closure declared_classes;
+    vector<Chunk> parsed;
+    vector<size_t> reused(texts.size(), SIZE_MAX);
+    auto declare = [&declared_classes](const Chunk& chunk) {
+        for (const auto& [name, class_holder] : chunk.classes) {
+            if (!declared_classes.insert({name, class_holder}).second) {
+                throw ParseError("Class "s + name + " already exists"s);
+            }
+        }
+    };
+    auto parse_chunk = [&](size_t i) {
+        parsed.push_back(ParseChunk(std::move(texts[i]), declared_classes));
+        for (const auto& [name, class_holder] : parsed.back().classes) {
+            changed_classes.insert(name);
+        }
+    };
+
+    for (size_t i = 0; i < prefix; ++i) {
+        reused[i] = i;
+        declare(m_chunks[i]);
+    }
+    for (size_t i = prefix; i < texts.size() - suffix; ++i) {
+        parse_chunk(i);
+    }
+    for (size_t i = texts.size() - suffix; i < texts.size(); ++i) {
+        const size_t old_index = i - texts.size() + m_chunks.size();
+        if (MentionsAny(m_chunks[old_index].tokens, changed_classes)) {
+            parse_chunk(i);
+        }
+        else {
+            reused[i] = old_index;
+            declare(m_chunks[old_index]);
+        }
+    }
+
+    // Разбор удался: собираем программу из старых и новых фрагментов
+    vector<Chunk> chunks;
+    chunks.reserve(texts.size());
+    auto next_parsed = parsed.begin();
+    for (size_t i = 0; i < texts.size(); ++i) {
+        chunks.push_back(reused[i] == SIZE_MAX ? std::move(*next_parsed++) : std::move(m_chunks[reused[i]]));
+    }
+    for (Chunk& chunk : m_chunks) {
+        for (auto& [name, class_holder] : chunk.classes) {
+            m_retired_classes.push_back(std::move(class_holder));
+        }
+    }
+    m_chunks = std::move(chunks);
+    m_source = std::move(source);
+
+    if (m_check) {
+        CheckAgainstFullParse();
+    }
+    return parsed.size();
+}
+
+const std::string& IncrementalProgram::Source() const {
+    return m_source;
+}
+
+size_t IncrementalProgram::ChunkCount() const {
+    return m_chunks.size();
+}
+
+TokenQueue IncrementalProgram::Tokens() const {
+    utility::StatementTokenJoiner joiner;
+    TokenQueue result;
+    for (const Chunk& chunk : m_chunks) {
+        TokenQueue tokens = joiner.Join(chunk.tokens);
+        std::move(tokens.begin(), tokens.end(), std::back_inserter(result));
+    }
+    return result;
+}
+
+void IncrementalProgram::Execute(runtime::Closure& closure, runtime::Context& context) const {
+    for (const Chunk& chunk : m_chunks) {
+        for (const unique_ptr<runtime::Executable>& statement : chunk.statements) {
+            statement->Execute(closure, context);
+        }
+    }
+}
+
+void IncrementalProgram::CheckAgainstFullParse() const {
+    istringstream input(m_source);
+    TokenQueue full_tokens = utility::Tokenise(input);
+    if (Normalize(full_tokens) != Normalize(Tokens())) {
+        throw std::logic_error("Incremental token stream differs from full re-parse"s);
+    }
+    try {
+        Lexer lexer(std::move(full_tokens));
+        [[maybe_unused]] unique_ptr<runtime::Executable> program = ::ParseProgram(lexer);
+    }
+    catch (const std::exception& error) {
+        throw std::logic_error("Full re-parse failed where incremental parse succeeded: "s + error.what());
+    }
+}
+
+void IncrementalProgram::EnableConsistencyCheck(bool enabled) {
+    m_check = enabled;
+}
+
+IncrementalProgram::Chunk IncrementalProgram::ParseChunk(std::string text, runtime::Closure& declared_classes) {
+    Chunk chunk;
+    istringstream input(text);
+    chunk.tokens = utility::Tokenise(input);
+    chunk.text = std::move(text);
+
+    const size_t declared_before = declared_classes.size();
+    Lexer lexer(chunk.tokens);
+    Parser parser(lexer, declared_classes);
+    while (unique_ptr<runtime::Executable> statement = parser.ParseNextStatement()) {
+        chunk.statements.push_back(std::move(statement));
+    }
+    for (auto it = declared_classes.begin() + declared_before; it != declared_classes.end(); ++it) {
+        chunk.classes.emplace_back(it->first, it->second);
+    }
+    return chunk;
+}
+
+}  // namespace parse
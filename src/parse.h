@@ -1,18 +1,131 @@
 #pragma once
 
+#include "lexer.h"
+#include "runtime.h"
+
+#include <iosfwd>
 #include <memory>
 #include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+struct ParseError : std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
+std::unique_ptr<runtime::Executable> ParseProgram(parse::Lexer& lexer);
+
+// Разбирает программу, продолжающую уже разобранную часть: её классы и функции верхнего уровня берутся
+// из declared_classes, а новые добавляются туда же. Вызов функции должен стоять после её объявления
+std::unique_ptr<runtime::Executable> ParseProgram(parse::Lexer& lexer, runtime::Closure& declared_classes);
+
+/*
+ * Выполняет программу source с тёплым стартом. Строка "# @snapshot" в первой колонке делит программу
+ * на пролог и основную часть и должна стоять между инструкциями верхнего уровня.
+ * Если snapshot_path содержит снимок кучи, сделанный для того же текста пролога, пролог только
+ * разбирается (ради классов), а переменные closure восстанавливаются из снимка. Иначе пролог
+ * выполняется, и после него в snapshot_path записывается новый снимок (см. runtime::SaveSnapshot).
+ * Вывод пролога при тёплом старте не повторяется. Возвращает true, если снимок был использован.
+ * Бросает std::runtime_error, если в программе нет строки-маркера
+ */
+bool ExecuteProgramWithSnapshot(std::string_view source, const std::string& snapshot_path, runtime::Closure& closure, runtime::Context& context);
+
+/*
+ * Разбирает и выполняет программу из input по одной инструкции верхнего уровня: очередная инструкция
+ * выполняется в closure сразу после разбора, после чего её токены и синтаксическое дерево освобождаются.
+ * Пиковый расход памяти определяется самой большой инструкцией, а не размером программы.
+ * Вывод совпадает с пакетным режимом (ParseProgram и Execute), но ошибка разбора обнаруживается
+ * только после выполнения предшествующих ей инструкций.
+ * В режиме TokenizeMode::Pipelined лексемы для следующих инструкций готовятся в отдельном потоке,
+ * пока выполняются текущие.
+ */
+void ExecuteProgramStreaming(std::istream& input, runtime::Closure& closure, runtime::Context& context, parse::TokenizeMode mode = parse::TokenizeMode::Batch);
+
+/*
+ * Горячая перезагрузка классов: input должен содержать только объявления классов. Новые методы могут
+ * вызывать функции верхнего уровня, лежащие в closure. Класс, который уже
+ * лежит в closure под тем же именем, получает новые методы через runtime::Class::Redefine - его
+ * экземпляры и их поля сохраняются, а атрибуты класса заменяются вычисленными по новому телу.
+ * Остальные классы добавляются в closure как новые.
+ * Базовый класс перезагружаемого класса менять нельзя. Вход разбирается целиком до изменения классов,
+ * поэтому при ошибке разбора (ParseError или LexerError) ни один класс не меняется.
+ * Вызывается между инструкциями программы. Возвращает число перезагруженных классов
+ */
+size_t ReloadClasses(std::istream& input, runtime::Closure& closure);
 
 namespace parse {
-class Lexer;
-}
 
-namespace runtime {
-class Executable;
-}
+/*
+ * Программа, которая после правки текста заново разбирает только затронутые инструкции верхнего уровня.
+ *
+ * Текст хранится фрагментами utility::TopLevelChunkReader, у каждого фрагмента - его лексемы и
+ * синтаксические деревья. Правка делит новый текст на фрагменты (просмотр строк без разбора лексем),
+ * оставляет совпадающие по тексту фрагменты в начале и в конце программы и заново разбирает только
+ * фрагменты между ними. Фрагменты из конца, в лексемах которых встречается имя класса, объявленного
+ * в изменённой части, тоже разбираются заново: узлы дерева ссылаются на конкретный объект класса.
+ *
+ * При ошибке разбора правка не применяется: исключение вылетает, а программа остаётся прежней.
+ * Прежние версии классов живут, пока жив IncrementalProgram, - на них могут ссылаться экземпляры,
+ * созданные предыдущими запусками.
+ */
+class IncrementalProgram {
+public:
+    explicit IncrementalProgram(std::string source = {});
 
-struct ParseError : std::runtime_error {
-    using std::runtime_error::runtime_error;
+    IncrementalProgram(const IncrementalProgram&) = delete;
+    IncrementalProgram& operator=(const IncrementalProgram&) = delete;
+
+    /*
+     * Заменяет length символов текста, начиная с offset, на replacement.
+     * Возвращает число заново разобранных фрагментов. Бросает std::out_of_range, если offset за концом текста
+     */
+    size_t Edit(size_t offset, size_t length, std::string_view replacement);
+
+    // Заменяет весь текст программы. Возвращает число заново разобранных фрагментов
+    size_t SetSource(std::string source);
+
+    [[nodiscard]] const std::string& Source() const;
+
+    // Число фрагментов, на которые делится текст
+    [[nodiscard]] size_t ChunkCount() const;
+
+    // Лексемы всей программы, склеенные из лексем фрагментов
+    [[nodiscard]] TokenQueue Tokens() const;
+
+    // Выполняет инструкции программы по порядку
+    void Execute(runtime::Closure& closure, runtime::Context& context) const;
+
+    /*
+     * Сверяет состояние с полным разбором текста: лексемы фрагментов должны совпасть с лексемами всего
+     * текста (без учёта лишних Newline после Dedent), а ParseProgram - завершиться без ошибки.
+     * Бросает std::logic_error при расхождении
+     */
+    void CheckAgainstFullParse() const;
+
+    // Включает CheckAgainstFullParse после каждой правки (для отладки встраивающих приложений)
+    void EnableConsistencyCheck(bool enabled);
+
+private:
+    struct Chunk {
+        Chunk() = default;
+        Chunk(Chunk&&) = default;
+        Chunk& operator=(Chunk&&) = default;
+
+        std::string text;
+        TokenQueue tokens;
+        std::vector<std::unique_ptr<runtime::Executable>> statements;
+        // Классы, объявленные фрагментом, в порядке объявления
+        std::vector<std::pair<std::string, runtime::ObjectHolder>> classes;
+    };
+
+    static Chunk ParseChunk(std::string text, runtime::Closure& declared_classes);
+
+    std::string m_source;
+    std::vector<Chunk> m_chunks;
+    std::vector<runtime::ObjectHolder> m_retired_classes;
+    bool m_check = false;
 };
 
-std::unique_ptr<runtime::Executable> ParseProgram(parse::Lexer& lexer);
\ No newline at end of file
+}  // namespace parse
@@ -4,6 +4,12 @@
 #include "statement.h"
 #include "test_runner_p.h"
 
+#include <cstdio>
+#include <exception>
+#include <functional>
+
+#include <pthread.h>
+
 using namespace std;
 
 namespace parse {
@@ -174,6 +180,74 @@ print x.call_count
     ASSERT_EQUAL(context.output.str(), "17\n1\n115\n"s);
 }
 
+// Выполняет action в потоке со стеком stack_bytes, чтобы глубина рекурсии не зависела от ulimit -s.
+// Исключение из action пробрасывается в вызывающий поток
+void RunWithStack(size_t stack_bytes, const function<void()>& action) {
+    struct Task {
+        const function<void()>* action;
+        exception_ptr error;
+    } task{&action, nullptr};
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, stack_bytes);
+    pthread_t thread;
+    const int created = pthread_create(&thread, &attr, [](void* arg) -> void* {
+        Task& task = *static_cast<Task*>(arg);
+        try {
+            (*task.action)();
+        }
+        catch (...) {
+            task.error = current_exception();
+        }
+        return nullptr;
+    }, &task);
+    pthread_attr_destroy(&attr);
+    ASSERT_EQUAL(created, 0);
+    pthread_join(thread, nullptr);
+    if (task.error) {
+        rethrow_exception(task.error);
+    }
+}
+
+// Локальные переменные вызова не лежат в кадре стека (см. LocalClosure), поэтому в стеке 8 МиБ
+// отладочная сборка выдерживает столько же уровней рекурсии, сколько с прежней unordered_map
+// (около 9700 для методов). Санитайзер адресов увеличивает кадры, ему даётся стек больше
+void TestDeepRecursion() {
+    constexpr int DEPTH = 9000;
+#if defined(__SANITIZE_ADDRESS__)
+    constexpr size_t STACK_BYTES = 64u << 20;
+#else
+    constexpr size_t STACK_BYTES = 8u << 20;
+#endif
+    string program = R"(
+class Counter:
+  def down(n, acc):
+    if n > 0:
+      return self.down(n - 1, acc + 1)
+    return acc
+
+def down(n, acc):
+  if n > 0:
+    return down(n - 1, acc + 1)
+  return acc
+
+c = Counter()
+print c.down(DEPTH, 0), down(DEPTH, 0)
+)"s;
+
+    program.replace(program.find("DEPTH"s), 5u, to_string(DEPTH));
+    program.replace(program.find("DEPTH"s), 5u, to_string(DEPTH));
+
+    runtime::DummyContext context;
+    RunWithStack(STACK_BYTES, [&] {
+        runtime::Closure closure;
+        auto tree = ParseProgramFromString(program);
+        tree->Execute(closure, context);
+    });
+
+    ASSERT_EQUAL(context.output.str(), to_string(DEPTH) + " "s + to_string(DEPTH) + "\n"s);
+}
+
 void TestComplexLogicalExpression() {
     const string program = R"(
 a = 1
@@ -266,6 +340,444 @@ x = X(xh)
     ASSERT_EQUAL(xh->Fields().at("x"s).Get(), closure.at("x"s).Get());
 }
 
+// Обход списка до сторожевого None без вызова __eq__
+void TestIdentityOperators() {
+    const string program = R"(
+class Node:
+  def __init__(value, next):
+    self.value = value
+    self.next = next
+
+class List:
+  def sum(node):
+    if node is None:
+      return 0
+    return node.value + self.sum(node.next)
+
+  def last(node):
+    if node.next is not None:
+      return self.last(node.next)
+    return node
+
+head = Node(1, Node(2, Node(3, None)))
+l = List()
+tail = l.last(head)
+same = tail is head.next.next
+print l.sum(head), tail.value, same, head is tail, None == None, tail.next is None
+)";
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    ParseProgramFromString(program)->Execute(closure, context);
+    ASSERT_EQUAL(context.output.str(), "6 3 True False True True\n"s);
+}
+
+// Атрибуты из тела класса общие для экземпляров и наследников, поле экземпляра их скрывает
+void TestClassAttributes() {
+    const string program = R"(
+scale = 10
+class Shape:
+  sides = 0
+  unit = scale * 2
+
+  def describe():
+    return self.name() + " " + str(self.sides) + " " + str(self.unit)
+
+  def name():
+    return "shape"
+
+class Square(Shape):
+  sides = 4
+  def name():
+    return "square"
+
+s = Shape()
+q = Square()
+r = Square()
+print s.describe(), q.describe(), Square.unit
+q.sides = 5
+print q.sides, Square.sides, r.sides, s.sides
+)";
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    ParseProgramFromString(program)->Execute(closure, context);
+    ASSERT_EQUAL(context.output.str(), "shape 0 20 square 4 20 20\n5 4 4 0\n"s);
+    ASSERT(closure.at("q"s).TryAs<runtime::ClassInstance>()->Fields().size() == 1u);
+
+    try {
+        ParseProgramFromString("print s.missing\n"s)->Execute(closure, context);
+        ASSERT(false);
+    }
+    catch (const std::runtime_error&) {
+    }
+
+    // Перезагрузка вычисляет атрибуты по новому телу класса
+    istringstream reload("class Square(Shape):\n  sides = scale - 3\n  def name():\n    return \"square\"\n"s);
+    ASSERT_EQUAL(ReloadClasses(reload, closure), 1u);
+    ParseProgramFromString("print r.sides, q.sides\n"s)->Execute(closure, context);
+    ASSERT_EQUAL(context.output.str(), "shape 0 20 square 4 20 20\n5 4 4 0\n7 5\n"s);
+}
+
+void TestFormatStrings() {
+    const string program = R"(
+class Point:
+  def __init__(x, y):
+    self.x = x
+    self.y = y
+
+  def __str__():
+    return f"<{self.x}, {self.y}>"
+
+p = Point(3, "four")
+label = "p"
+print f"{label}={p}, sum={p.x + 1 * 2} {{literal}}", f'{p.y + "!"}', f"no slots"
+print f"{p.x}" == str(p.x), f"{ p.x > 2 and p.y != 'x' }"
+)";
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    ParseProgramFromString(program)->Execute(closure, context);
+    ASSERT_EQUAL(context.output.str(), "p=<3, four>, sum=5 {literal} four! no slots\nTrue True\n"s);
+
+    for (const string& bad : {"print f\"{1\"\n"s, "print f\"a}\"\n"s, "print f\"{}\"\n"s, "print f\"{1 2}\"\n"s}) {
+        try {
+            ParseProgramFromString(bad);
+            ASSERT(false);
+        }
+        catch (const ParseError&) {
+        }
+    }
+}
+
+// Функции верхнего уровня: рекурсия, вызов из методов и из других функций, вызов как инструкция
+void TestTopLevelFunctions() {
+    const string program = R"(
+def fib(n):
+  if n < 2:
+    return n
+  return fib(n - 1) + fib(n - 2)
+
+def describe(x):
+  print f"fib={fib(x)}"
+
+class Sequence:
+  def at(n):
+    return fib(n)
+
+describe(10)
+s = Sequence()
+print s.at(7), fib, fib(0)
+)";
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    ParseProgramFromString(program)->Execute(closure, context);
+    ASSERT_EQUAL(context.output.str(), "fib=55\n13 Function fib 0\n"s);
+    ASSERT(closure.at("fib"s).TryAs<runtime::Function>() != nullptr);
+
+    // Вызов связывается при разборе: функция должна быть объявлена раньше, число аргументов проверяется сразу
+    for (const string& bad : {"print g(1)\ndef g(x):\n  return x\n"s,
+                              "def g(x):\n  return x\nprint g(1, 2)\n"s,
+                              "def g():\n  return 1\nclass g:\n  def m():\n    return 1\n"s,
+                              "def g():\n  return 1\nclass C(g):\n  def m():\n    return 1\n"s}) {
+        try {
+            ParseProgramFromString(bad);
+            ASSERT(false);
+        }
+        catch (const ParseError&) {
+        }
+    }
+}
+
+// Потоковый режим должен печатать то же, что и пакетный: классы, наследование, if/else на верхнем
+// уровне, комментарии и многострочные строковые литералы не должны разрываться между фрагментами
+// elif и цепочки сравнений с константами: таблица выбирает ту же ветвь, что и последовательная проверка
+void TestElifChains() {
+    const string program = R"(
+class Code:
+  def __init__(v):
+    self.v = v
+
+  def __eq__(other):
+    return self.v == other
+
+def name(x):
+  if x == 1:
+    return "one"
+  elif x == 2:
+    return "two"
+  elif 3 == x:
+    return "three"
+  elif x == 2:
+    return "again"
+  elif x == 100:
+    return "hundred"
+  else:
+    return "other"
+
+def op(s):
+  if s == "add":
+    return 1
+  elif s == "sub":
+    return 2
+  elif s == "mul":
+    return 3
+  elif s == "div":
+    return 4
+  return 0
+
+def mixed(x):
+  if x == 1:
+    return "one"
+  elif x < 10:
+    return "small"
+  elif x == 10:
+    return "ten"
+  elif x == 11:
+    return "eleven"
+  return "big"
+
+print name(1), name(2), name(3), name(100), name(0), op("mul"), op("mod"), mixed(5), mixed(11), mixed(12)
+c = Code(2)
+if c == 1:
+  print "c1"
+elif c == 2:
+  print "c2"
+elif c == 3:
+  print "c3"
+elif c == 4:
+  print "c4"
+x = 5
+if x < 3:
+  print "small"
+elif x < 10:
+  print "medium"
+else:
+  print "large"
+)"s;
+    const string expected = "one two three hundred other 3 0 small eleven big\nc2\nmedium\n"s;
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    ParseProgramFromString(program)->Execute(closure, context);
+    ASSERT_EQUAL(context.output.str(), expected);
+
+    // Строки elif в первой колонке продолжают инструкцию, а не начинают новую
+    runtime::DummyContext stream_context;
+    runtime::Closure stream_closure;
+    istringstream input(program);
+    ExecuteProgramStreaming(input, stream_closure, stream_context);
+    ASSERT_EQUAL(stream_context.output.str(), expected);
+
+    try {
+        ParseProgramFromString("x = 1\nelif x == 1:\n  print x\n"s);
+        ASSERT(false);
+    }
+    catch (const std::exception&) {
+    }
+}
+
+// copy и deepcopy вызываются как встроенные функции; функция программы с тем же именем их заменяет
+void TestCopyBuiltins() {
+    const string program = R"(
+class Config:
+  def __init__(name, parent):
+    self.name = name
+    self.parent = parent
+    self.limits = IntArray(2, 7)
+
+base = Config("base", None)
+child = Config("child", base)
+a = copy(child)
+b = deepcopy(child)
+a.name = "a"
+b.parent.name = "copied base"
+b.limits.fill(1)
+print a.name, child.name, a.parent is base, b.parent is base, base.name, b.parent.name, child.limits.sum(), b.limits.sum()
+print copy(5), deepcopy("text"), deepcopy(None)
+)"s;
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    ParseProgramFromString(program)->Execute(closure, context);
+    ASSERT_EQUAL(context.output.str(), "a child True False base copied base 14 2\n5 text None\n"s);
+
+    runtime::DummyContext shadow_context;
+    runtime::Closure shadow_closure;
+    ParseProgramFromString("def copy(x):\n  return x + 1\n\nprint copy(1)\n"s)->Execute(shadow_closure, shadow_context);
+    ASSERT_EQUAL(shadow_context.output.str(), "2\n"s);
+
+    try {
+        ParseProgramFromString("x = deepcopy(1, 2)\n"s);
+        ASSERT(false);
+    }
+    catch (const ParseError&) {
+    }
+}
+
+// save и load передают граф объектов между запусками; классы ищутся по имени в загружающей программе
+void TestSaveLoadBuiltins() {
+    const string path = "/tmp/mython_parse_test_"s + to_string(reinterpret_cast<uintptr_t>(&path)) + ".value"s;
+    const string writer = R"(
+class Item:
+  def __init__(name, count):
+    self.name = name
+    self.count = count
+
+class Order:
+  def __init__(first, second):
+    self.first = first
+    self.second = second
+    self.note = None
+    self.paid = True
+
+item = Item("tea", 3)
+order = Order(item, item)
+order.first.owner = order
+save(order, path)
+)"s;
+    runtime::DummyContext write_context;
+    runtime::Closure write_closure;
+    write_closure["path"s] = runtime::ObjectHolder::Own(runtime::String(path));
+    ParseProgramFromString(writer)->Execute(write_closure, write_context);
+
+    // Загрузка из метода: класс Order объявлен после класса, в котором стоит вызов
+    const string reader = R"(
+class Loader:
+  def run(path):
+    return load(path)
+
+class Item:
+  def total():
+    return self.count * 2
+
+class Order:
+  def describe():
+    return f"{self.first.name} x{self.first.total()} {self.first is self.second} {self.first.owner is self} {self.note} {self.paid}"
+
+loader = Loader()
+order = loader.run(path)
+print order.describe()
+)"s;
+    runtime::DummyContext read_context;
+    runtime::Closure read_closure;
+    read_closure["path"s] = runtime::ObjectHolder::Own(runtime::String(path));
+    ParseProgramFromString(reader)->Execute(read_closure, read_context);
+    ASSERT_EQUAL(read_context.output.str(), "tea x6 True True None True\n"s);
+    read_closure.at("order"s).TryAs<runtime::ClassInstance>()->Fields().at("first"s).TryAs<runtime::ClassInstance>()->Fields()["owner"s] = runtime::ObjectHolder::None();
+    write_closure.at("item"s).TryAs<runtime::ClassInstance>()->Fields()["owner"s] = runtime::ObjectHolder::None();
+
+    runtime::DummyContext error_context;
+    runtime::Closure error_closure;
+    try {
+        ParseProgramFromString("x = load(1)\n"s)->Execute(error_closure, error_context);
+        ASSERT(false);
+    }
+    catch (const std::runtime_error&) {
+    }
+    try {
+        ParseProgramFromString("save(1)\n"s);
+        ASSERT(false);
+    }
+    catch (const ParseError&) {
+    }
+    std::remove(path.c_str());
+}
+
+void TestStreamingMatchesBatch() {
+    const string program = R"(
+# comment at the top
+class Counter:
+  def __init__():
+    self.n = 0
+
+  def add(k):
+    self.n = self.n + k
+    return self.n
+class Named(Counter):
+  def __str__():
+    return "Named " + str(self.n)
+
+c = Named()
+if c.add(5) > 3:
+  print "big"
+else:
+  print "small"
+x = 'multi
+line'
+print x, c
+if c.add(1) > 100:
+  print "huge"
+print c
+)"s;
+
+    runtime::DummyContext batch_context;
+    runtime::Closure batch_closure;
+    ParseProgramFromString(program)->Execute(batch_closure, batch_context);
+
+    runtime::DummyContext stream_context;
+    runtime::Closure stream_closure;
+    istringstream input(program);
+    ExecuteProgramStreaming(input, stream_closure, stream_context);
+
+    ASSERT_EQUAL(stream_context.output.str(), batch_context.output.str());
+    ASSERT_EQUAL(stream_context.output.str(), "big\nmulti\nline Named 5\nNamed 6\n"s);
+}
+
+// Перезагрузка класса меняет поведение живых экземпляров и наследников, сохраняя их поля
+void TestReloadClasses() {
+    const string program = R"(
+class Counter:
+  def __init__():
+    self.n = 0
+
+  def add(k):
+    self.n = self.n + k
+    return self.n
+class Named(Counter):
+  def __str__():
+    return "Named " + str(self.n)
+
+c = Counter()
+d = Named()
+)"s;
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    istringstream input(program);
+    ExecuteProgramStreaming(input, closure, context);
+
+    // Один и тот же узел MethodCall до и после перезагрузки: кэш поиска метода должен промахнуться
+    auto calls = ParseProgramFromString("print c.add(1), d.add(2), d\n"s);
+    calls->Execute(closure, context);
+
+    istringstream reload(R"(
+class Counter:
+  def add(k):
+    self.n = self.n + k * 10
+    return self.n
+class Fresh(Counter):
+  def __str__():
+    return "Fresh"
+)"s);
+    ASSERT_EQUAL(ReloadClasses(reload, closure), 1u);
+    calls->Execute(closure, context);
+    ASSERT_EQUAL(context.output.str(), "1 2 Named 2\n11 22 Named 22\n"s);
+    ASSERT(closure.at("Fresh"s).TryAs<runtime::Class>() != nullptr);
+    ASSERT_EQUAL(closure.at("Fresh"s).TryAs<runtime::Class>()->GetParent(), closure.at("Counter"s).TryAs<runtime::Class>());
+
+    // Ошибочная перезагрузка не меняет ни одного класса
+    for (const string& bad : {"class Counter:\n  def add(k):\n    return 0\nclass Named:\n  def x():\n    return 1\n"s,
+                              "class Counter:\n  def add(k):\n    return 0\nx = 1\n"s,
+                              "class Counter:\n  def add(k):\n    return 0\nclass Broken:\n  def x(:\n    return 1\n"s}) {
+        istringstream bad_input(bad);
+        try {
+            ReloadClasses(bad_input, closure);
+            ASSERT(false);
+        }
+        catch (const ParseError&) {
+        }
+        catch (const LexerError&) {
+        }
+    }
+    calls->Execute(closure, context);
+    ASSERT_EQUAL(context.output.str(), "1 2 Named 2\n11 22 Named 22\n21 42 Named 42\n"s);
+}
+
 }  // namespace parse
 
 void TestParseProgram(TestRunner& tr) {
@@ -275,7 +787,17 @@ void TestParseProgram(TestRunner& tr) {
     RUN_TEST(tr, parse::TestReturnFromIf);
     RUN_TEST(tr, parse::TestRecursion);
     RUN_TEST(tr, parse::TestRecursion2);
+    RUN_TEST(tr, parse::TestDeepRecursion);
     RUN_TEST(tr, parse::TestComplexLogicalExpression);
     RUN_TEST(tr, parse::TestClassicalPolymorphism);
     RUN_TEST(tr, parse::TestSelfInConstructor);
+    RUN_TEST(tr, parse::TestIdentityOperators);
+    RUN_TEST(tr, parse::TestClassAttributes);
+    RUN_TEST(tr, parse::TestFormatStrings);
+    RUN_TEST(tr, parse::TestTopLevelFunctions);
+    RUN_TEST(tr, parse::TestElifChains);
+    RUN_TEST(tr, parse::TestCopyBuiltins);
+    RUN_TEST(tr, parse::TestSaveLoadBuiltins);
+    RUN_TEST(tr, parse::TestStreamingMatchesBatch);
+    RUN_TEST(tr, parse::TestReloadClasses);
 }
\ No newline at end of file
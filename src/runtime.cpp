@@ -1,23 +1,185 @@
 #include "runtime.h"
+#include "feedback.h"
+#include "heap_snapshot.h"
+#include "int_array.h"
 #include "lexer.h"
+#include "trace.h"
 
 #include <cassert>
+#include <cstddef>
 #include <optional>
 #include <sstream>
+#include <unordered_map>
 
 using namespace std;
 
 namespace runtime {
 
-ObjectHolder::ObjectHolder(std::shared_ptr<Object> data) : m_data(std::move(data)) {}
+Object::Object() {
+    if (HeapRegistry::IsEnabled()) {
+        HeapRegistry::OnCreate(this);
+    }
+}
+
+Object::Object([[maybe_unused]] const Object& other) : Object() {}
+
+Object::~Object() {
+    if (HeapRegistry::IsTracking()) {
+        HeapRegistry::OnDestroy(this);
+    }
+}
+
+namespace {
+
+// Столько очищенных таблиц локальных переменных пул хранит для следующих вызовов.
+// Таблицы более глубоких рекурсивных вызовов освобождаются
+constexpr size_t MAX_POOLED_CLOSURES = 64u;
+
+std::vector<std::unique_ptr<Closure>>& ClosurePool() {
+    thread_local std::vector<std::unique_ptr<Closure>> pool;
+    return pool;
+}
+
+}  // namespace
+
+LocalClosure::LocalClosure() {
+    std::vector<std::unique_ptr<Closure>>& pool = ClosurePool();
+    if (pool.empty()) {
+        m_closure = std::make_unique<Closure>();
+    }
+    else {
+        m_closure = std::move(pool.back());
+        pool.pop_back();
+    }
+}
+
+LocalClosure::~LocalClosure() {
+    m_closure->clear();
+    std::vector<std::unique_ptr<Closure>>& pool = ClosurePool();
+    if (pool.size() < MAX_POOLED_CLOSURES) {
+        pool.push_back(std::move(m_closure));
+    }
+}
+
+namespace {
+
+// Заголовок блока узла: квота, на которую он записан. Размер сохраняет выравнивание узла
+constexpr size_t EXECUTABLE_HEADER = alignof(std::max_align_t);
+
+}  // namespace
+
+void* Executable::operator new(size_t size) {
+    MemoryQuota* quota = MemoryQuota::Current();
+    if (quota != nullptr) {
+        quota->Charge(size + EXECUTABLE_HEADER);
+    }
+    char* block = static_cast<char*>(::operator new(size + EXECUTABLE_HEADER));
+    *reinterpret_cast<MemoryQuota**>(block) = quota;
+    return block + EXECUTABLE_HEADER;
+}
+
+void Executable::operator delete(void* ptr, size_t size) {
+    char* block = static_cast<char*>(ptr) - EXECUTABLE_HEADER;
+    if (MemoryQuota* quota = *reinterpret_cast<MemoryQuota**>(block)) {
+        quota->Release(size + EXECUTABLE_HEADER);
+    }
+    ::operator delete(block);
+}
+
+namespace {
+
+// Флаги Object::m_block; размер блока хранится в старших битах
+constexpr uint32_t ISOLATE_BLOCK = 1u;
+constexpr uint32_t QUOTA_HEADER = 2u;
+constexpr uint32_t BLOCK_FLAG_BITS = 2u;
+
+// Заголовок блока объекта, созданного под квотой: квота и записанные на неё байты
+struct QuotaHeader {
+    MemoryQuota* quota;
+    size_t charged_bytes;
+};
+
+static_assert(sizeof(QuotaHeader) == IsolateHeap::ALIGNMENT);
+
+}  // namespace
+
+ObjectHolder::Block ObjectHolder::AllocateBlock(size_t size, size_t extra_bytes) {
+    MemoryQuota* quota = MemoryQuota::Current();
+    const size_t block_size = size + (quota != nullptr ? sizeof(QuotaHeader) : 0u);
+    if (quota != nullptr) {
+        quota->Charge(block_size + extra_bytes);
+    }
+    IsolateHeap* isolate = IsolateHeap::Current();
+    char* memory = nullptr;
+    try {
+        memory = static_cast<char*>(isolate != nullptr ? isolate->Allocate(block_size) : ::operator new(block_size));
+    }
+    catch (...) {
+        if (quota != nullptr) {
+            quota->Release(block_size + extra_bytes);
+        }
+        throw;
+    }
+    uint32_t info = static_cast<uint32_t>(block_size) << BLOCK_FLAG_BITS;
+    if (isolate != nullptr) {
+        info |= ISOLATE_BLOCK;
+    }
+    if (quota != nullptr) {
+        *reinterpret_cast<QuotaHeader*>(memory) = QuotaHeader{quota, block_size + extra_bytes};
+        memory += sizeof(QuotaHeader);
+        info |= QUOTA_HEADER;
+    }
+    return Block{memory, info};
+}
+
+void ObjectHolder::FreeBlock(void* memory, uint32_t info) noexcept {
+    char* block = static_cast<char*>(memory);
+    const QuotaHeader* header = nullptr;
+    if (info & QUOTA_HEADER) {
+        block -= sizeof(QuotaHeader);
+        header = reinterpret_cast<const QuotaHeader*>(block);
+    }
+    MemoryQuota* quota = header != nullptr ? header->quota : nullptr;
+    const size_t charged_bytes = header != nullptr ? header->charged_bytes : 0u;
+    if (info & ISOLATE_BLOCK) {
+        IsolateHeap::Deallocate(block, info >> BLOCK_FLAG_BITS);
+    }
+    else {
+        ::operator delete(block);
+    }
+    if (quota != nullptr) {
+        quota->Release(charged_bytes);
+    }
+}
+
+ObjectHolder ObjectHolder::Adopt(Object* object, uint32_t info) noexcept {
+    object->m_refs = 1u;
+    object->m_block = info;
+    ObjectHolder result;
+    if (IsolateHeap::IsIsolateBlock(object)) {
+        result.m_ref = (uintptr_t{IsolateHeap::Compress(object)} << 32u) | COMPRESSED | OWNED;
+    }
+    else {
+        result.m_ref = reinterpret_cast<uintptr_t>(object) | OWNED;
+    }
+    return result;
+}
+
+void ObjectHolder::Destroy(Object* object) noexcept {
+    const uint32_t info = object->m_block;
+    object->~Object();
+    FreeBlock(object, info);
+}
 
 void ObjectHolder::AssertIsValid() const {
-    assert(m_data != nullptr);
+    assert(m_ref != 0u);
 }
 
 ObjectHolder ObjectHolder::Share(Object& object) {
-    // Возвращаем невладеющий shared_ptr (его deleter ничего не делает)
-    return ObjectHolder(std::shared_ptr<Object>(&object, [](auto* /*p*/) { /* do nothing */ }));
+    // Невладеющая ссылка хранит адрес без флагов и не меняет счётчик объекта
+    ObjectHolder result;
+    result.m_ref = reinterpret_cast<uintptr_t>(&object);
+    return result;
 }
 
 ObjectHolder ObjectHolder::None() {
@@ -34,12 +196,8 @@ Object* ObjectHolder::operator->() const {
     return Get();
 }
 
-Object* ObjectHolder::Get() const {
-    return m_data.get();
-}
-
 ObjectHolder::operator bool() const {
-    return Get() != nullptr;
+    return m_ref != 0u;
 }
 
 bool IsTrue(const ObjectHolder& object) {
@@ -55,6 +213,37 @@ bool IsTrue(const ObjectHolder& object) {
     if (auto p = object.TryAs<Bool>()) {
         return p->GetValue() != false;
     }
+    if (auto p = object.TryAs<BigNumber>()) {
+        return !p->GetValue().IsZero();
+    }
+    return false;
+}
+
+size_t OwnedHeapBytes(const String& value) {
+    static const size_t sso_capacity = std::string().capacity();
+    return value.GetValue().capacity() > sso_capacity ? value.GetValue().capacity() + 1u : 0u;
+}
+
+size_t OwnedHeapBytes(const BigNumber& value) {
+    return value.GetValue().LimbCount() * sizeof(uint32_t);
+}
+
+ObjectHolder MakeInteger(BigInt value) {
+    if (value.FitsInt()) {
+        return ObjectHolder::Own(Number(value.ToInt()));
+    }
+    return ObjectHolder::Own(BigNumber(std::move(value)));
+}
+
+bool TryGetInteger(const ObjectHolder& object, BigInt& value) {
+    if (auto p = object.TryAs<Number>()) {
+        value = BigInt(p->GetValue());
+        return true;
+    }
+    if (auto p = object.TryAs<BigNumber>()) {
+        value = p->GetValue();
+        return true;
+    }
     return false;
 }
 
@@ -65,11 +254,46 @@ void Bool::Print(std::ostream& os, [[maybe_unused]] Context& context) {
 Class::Class(std::string name, std::vector<Method> methods, const Class* parent) : m_name(name)
                                                                                  , m_parent(parent)
 {
-    const size_t sz = methods.size();
-    m_methods.reserve(sz);
-    for(size_t i = 0u; i < sz; ++i) {
-        m_methods[methods[i].name] = std::move(methods[i]);
+    Redefine(std::move(methods));
+}
+
+Class::~Class() {
+    // Адрес класса может достаться новому классу: кэши, запомнившие этот, должны промахнуться
+    ++s_method_epoch;
+}
+
+uint64_t Class::s_method_epoch = 0u;
+
+void Class::Redefine(std::vector<Method> methods) {
+    std::unordered_map<std::string, Method> table;
+    table.reserve(methods.size());
+    for (Method& method : methods) {
+        table[method.name] = std::move(method);
+    }
+    m_methods = std::move(table);
+    ++s_method_epoch;
+}
+
+uint64_t Class::MethodEpoch() {
+    return s_method_epoch;
+}
+
+const Closure& Class::Attributes() const {
+    return m_attributes;
+}
+
+void Class::SetAttributes(Closure attributes) {
+    m_attributes_charge.Resize(attributes.HeapBytes());
+    m_attributes = std::move(attributes);
+}
+
+const ObjectHolder* Class::FindAttribute(std::string_view name, uint32_t hash) const {
+    for (const Class* cls = this; cls != nullptr; cls = cls->m_parent) {
+        if (const auto it = cls->m_attributes.find(name, hash); it != cls->m_attributes.end()) {
+            return &it->second;
+        }
     }
+    return nullptr;
 }
 
 const Method* Class::GetMethod(const std::string& name) const {
@@ -90,6 +314,10 @@ const std::string& Class::GetName() const {
     return m_name;
 }
 
+const Class* Class::GetParent() const {
+    return m_parent;
+}
+
 ClassInstance::ClassInstance(const Class& cls) : m_type(cls) {}
 
 void ClassInstance::Print(std::ostream& os, Context& context) {
@@ -118,26 +346,78 @@ const Closure& ClassInstance::Fields() const {
     return m_closure;
 }
 
+const Class& ClassInstance::GetClass() const {
+    return m_type;
+}
+
+void ClassInstance::AccountFields() {
+    m_fields_charge.Resize(m_closure.HeapBytes());
+}
+
 const std::vector<ObjectHolder> ClassInstance::NOPARAMS = {};
 
 ObjectHolder ClassInstance::Call(const std::string& method_name, const std::vector<ObjectHolder>& actual_args, Context& context) {
     if (HasMethod(method_name, actual_args.size())) {
-        const Method* method_ptr = m_type.GetMethod(method_name);
-        Closure local_closure = MixinLocalClosure(method_ptr->formal_params, actual_args);
-        return method_ptr->body->Execute(local_closure, context);
+        return Call(*m_type.GetMethod(method_name), actual_args, context);
     }
     throw std::runtime_error("Class does not have a method named as "s + method_name);
 }
 
-Closure ClassInstance::MixinLocalClosure(const std::vector<std::string>& formal_params, const std::vector<ObjectHolder>& actual_args) {
+ObjectHolder ClassInstance::Call(const Method& method, const std::vector<ObjectHolder>& actual_args, Context& context) {
+    if (TypeFeedback* feedback = TypeFeedback::Recording()) {
+        feedback->RecordMethodCall(m_type, method);
+    }
+    LocalClosure local_closure;
+    MixinLocalClosure(local_closure.Get(), method.formal_params, actual_args);
+    MYTHON_TRACE2(method__entry, m_type.GetName().c_str(), method.name.c_str());
+    ObjectHolder result = method.body->Execute(local_closure.Get(), context);
+    MYTHON_TRACE2(method__return, m_type.GetName().c_str(), method.name.c_str());
+    return result;
+}
+
+void ClassInstance::MixinLocalClosure(Closure& closure, const std::vector<std::string>& formal_params, const std::vector<ObjectHolder>& actual_args) {
     assert(formal_params.size() == actual_args.size());
 
-    Closure closure;
     closure.emplace(parse::token_const::SELF, ObjectHolder::Share(*this));
     for (size_t i = 0; i < formal_params.size(); ++i) {
         closure.emplace(formal_params.at(i), actual_args.at(i));
     }
-    return closure;
+}
+
+Function::Function(std::string name, std::vector<std::string> formal_params) : m_name(std::move(name)), m_formal_params(std::move(formal_params)) {}
+
+const std::string& Function::GetName() const {
+    return m_name;
+}
+
+const std::vector<std::string>& Function::GetFormalParams() const {
+    return m_formal_params;
+}
+
+void Function::SetBody(std::unique_ptr<Executable> body) {
+    m_body = std::move(body);
+}
+
+ObjectHolder Function::Call(Closure& locals, Context& context) const {
+    if (!m_body) {
+        throw std::runtime_error("Function "s + m_name + " has no body"s);
+    }
+    return m_body->Execute(locals, context);
+}
+
+ObjectHolder Function::Call(const std::vector<ObjectHolder>& actual_args, Context& context) const {
+    if (actual_args.size() != m_formal_params.size()) {
+        throw std::runtime_error("Function "s + m_name + " takes "s + std::to_string(m_formal_params.size()) + " arguments"s);
+    }
+    LocalClosure locals;
+    for (size_t i = 0; i < m_formal_params.size(); ++i) {
+        locals.Get().emplace(m_formal_params[i], actual_args[i]);
+    }
+    return Call(locals.Get(), context);
+}
+
+void Function::Print(std::ostream& os, [[maybe_unused]] Context& context) {
+    os << "Function "sv << m_name;
 }
 
 template <typename Compare>
@@ -158,6 +438,10 @@ bool MakeComparison(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& c
         return alt_cmp(lhs.TryAs<Number>()->GetValue(), rhs.TryAs<Number>()->GetValue());
     }
 
+    if (BigInt lhs_value, rhs_value; TryGetInteger(lhs, lhs_value) && TryGetInteger(rhs, rhs_value)) {
+        return alt_cmp(lhs_value, rhs_value);
+    }
+
     if (lhs.TryAs<Bool>() && rhs.TryAs<Bool>()) {
         return alt_cmp(lhs.TryAs<Bool>()->GetValue(), rhs.TryAs<Bool>()->GetValue());
     }
@@ -166,6 +450,9 @@ bool MakeComparison(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& c
 }
 
 bool Equal(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
+    if (!lhs && !rhs) {
+        return true;
+    }
     return MakeComparison(lhs, rhs, context, parse::token_const::EQ_METHOD, std::equal_to{});
 }
 
@@ -189,4 +476,60 @@ bool GreaterOrEqual(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& c
     return !Less(lhs, rhs, context);
 }
 
+namespace {
+
+// Копия экземпляра с теми же значениями полей. Таблица полей копии сразу получает размер таблицы
+// оригинала и записывается на квоту памяти
+ObjectHolder CopyInstance(const ClassInstance& instance) {
+    ObjectHolder copy = ObjectHolder::Own(ClassInstance(instance));
+    copy.TryAs<ClassInstance>()->AccountFields();
+    return copy;
+}
+
+}  // namespace
+
+ObjectHolder ShallowCopy(const ObjectHolder& object) {
+    if (const auto* instance = object.TryAs<ClassInstance>()) {
+        return CopyInstance(*instance);
+    }
+    if (const auto* array = object.TryAs<IntArray>()) {
+        return ObjectHolder::Own(IntArray(*array));
+    }
+    return object;
+}
+
+ObjectHolder DeepCopy(const ObjectHolder& object) {
+    std::unordered_map<const Object*, ObjectHolder> copies;
+    // Скопированные экземпляры, поля которых ещё ссылаются на оригиналы
+    std::vector<ClassInstance*> pending;
+    auto copy_of = [&copies, &pending](const ObjectHolder& value) -> ObjectHolder {
+        const auto* instance = value.TryAs<ClassInstance>();
+        const auto* array = instance == nullptr ? value.TryAs<IntArray>() : nullptr;
+        if (instance == nullptr && array == nullptr) {
+            return value;
+        }
+        auto [it, inserted] = copies.try_emplace(value.Get());
+        if (inserted) {
+            if (instance != nullptr) {
+                it->second = CopyInstance(*instance);
+                pending.push_back(it->second.TryAs<ClassInstance>());
+            }
+            else {
+                it->second = ObjectHolder::Own(IntArray(*array));
+            }
+        }
+        return it->second;
+    };
+
+    ObjectHolder result = copy_of(object);
+    while (!pending.empty()) {
+        ClassInstance* instance = pending.back();
+        pending.pop_back();
+        for (auto& [name, value] : instance->Fields()) {
+            value = copy_of(value);
+        }
+    }
+    return result;
+}
+
 }  // namespace runtime
\ No newline at end of file
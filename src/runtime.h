@@ -1,8 +1,16 @@
 #pragma once
 
+#include "bigint.h"
+#include "flat_map.h"
+#include "isolate_heap.h"
+#include "memory_quota.h"
+
+#include <cstdint>
 #include <memory>
+#include <new>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -22,30 +30,94 @@ protected:
 // Базовый класс для всех объектов языка Mython
 class Object {
 public:
-    virtual ~Object() = default;
-    
+    Object();
+    Object(const Object& other);
+    // Счётчик ссылок и сведения о блоке относятся к месту объекта в памяти и при присваивании не переносятся
+    Object& operator=([[maybe_unused]] const Object& other) {
+        return *this;
+    }
+    virtual ~Object();
+
     // выводит в os своё представление в виде строки
     virtual void Print(std::ostream& os, Context& context) = 0;
+
+private:
+    friend class ObjectHolder;
+
+    // Число владеющих ObjectHolder. Объекты, созданные не через ObjectHolder::Own, не считаются
+    uint32_t m_refs = 0u;
+    // Размер блока объекта и то, откуда он выделен (см. ObjectHolder::Own)
+    uint32_t m_block = 0u;
 };
 
-// Специальный класс-обёртка, предназначенный для хранения объекта в Mython-программе
+// Байты буферов, которыми владеет объект вне собственного размера. Учитываются квотой памяти
+// при создании объекта; объекты, чьи буферы растут позже, учитывают рост сами (см. ClassInstance)
+inline size_t OwnedHeapBytes([[maybe_unused]] const Object& object) {
+    return 0u;
+}
+
+/*
+ * Специальный класс-обёртка, предназначенный для хранения объекта в Mython-программе.
+ *
+ * Ссылка занимает одно слово. Владеющие ссылки считаются в самом объекте (Object::m_refs),
+ * поэтому отдельного управляющего блока нет. Объект из кучи изолята задаётся 32-битным смещением
+ * (см. IsolateHeap::Compress), остальные - адресом. Счётчик не атомарный: объектами
+ * одной программы пользуется один поток
+ */
 class ObjectHolder {
 public:
     // Создаёт пустое значение
     ObjectHolder() = default;
-    ObjectHolder(const ObjectHolder&) = default;
-    ObjectHolder(ObjectHolder&&) = default;
-    ObjectHolder& operator=(const ObjectHolder&) = default;
-    ObjectHolder& operator=(ObjectHolder&&) = default;
 
+    ObjectHolder(const ObjectHolder& other) noexcept : m_ref(other.m_ref) {
+        if (m_ref & OWNED) {
+            ++Get()->m_refs;
+        }
+    }
+
+    ObjectHolder(ObjectHolder&& other) noexcept : m_ref(std::exchange(other.m_ref, 0u)) {}
+
+    ObjectHolder& operator=(const ObjectHolder& other) noexcept {
+        ObjectHolder copy(other);
+        std::swap(m_ref, copy.m_ref);
+        return *this;
+    }
+
+    ObjectHolder& operator=(ObjectHolder&& other) noexcept {
+        ObjectHolder moved(std::move(other));
+        std::swap(m_ref, moved.m_ref);
+        return *this;
+    }
+
+    ~ObjectHolder() {
+        if (m_ref & OWNED) {
+            Object* object = Get();
+            if (--object->m_refs == 0u) {
+                Destroy(object);
+            }
+        }
+    }
 
     // Возвращает ObjectHolder, владеющий объектом типа T
     // Тип T - конкретный класс-наследник Object.
-    // object копируется или перемещается в кучу
+    // object копируется или перемещается в кучу: в кучу текущего изолята, если она задана (см. IsolateHeap),
+    // иначе в общую кучу процесса. Если задана квота памяти, объект и его буферы записываются на неё
+    // (см. MemoryQuota)
     template <typename T>
     [[nodiscard]]
     static ObjectHolder Own(T&& object) {
-        return ObjectHolder(std::make_shared<T>(std::forward<T>(object)));
+        static_assert(alignof(T) <= IsolateHeap::ALIGNMENT);
+        const size_t extra_bytes = MemoryQuota::Current() ? OwnedHeapBytes(object) : 0u;
+        const Block block = AllocateBlock(sizeof(T), extra_bytes);
+        Object* result = nullptr;
+        try {
+            result = new (block.memory) T(std::forward<T>(object));
+        }
+        catch (...) {
+            FreeBlock(block.memory, block.info);
+            throw;
+        }
+        return Adopt(result, block.info);
     }
 
     // Создаёт ObjectHolder, не владеющий объектом (аналог слабой ссылки)
@@ -63,7 +135,12 @@ public:
     Object* operator->() const;
 
     [[nodiscard]]
-    Object* Get() const;
+    Object* Get() const {
+        if (m_ref & COMPRESSED) {
+            return static_cast<Object*>(IsolateHeap::Decompress(static_cast<uint32_t>(m_ref >> 32u)));
+        }
+        return reinterpret_cast<Object*>(m_ref & ~TAG_MASK);
+    }
 
     // Возвращает указатель на объект типа T либо nullptr, если внутри ObjectHolder не хранится
     // объект данного типа
@@ -77,24 +154,62 @@ public:
     explicit operator bool() const;
 
 private:
-    explicit ObjectHolder(std::shared_ptr<Object> data);
+    // Младшие биты слова ссылки (объекты выровнены не меньше чем на 8 байт):
+    // OWNED - ссылка владеющая; COMPRESSED - в старших 32 битах смещение объекта в куче изолята
+    static constexpr uintptr_t OWNED = 1u;
+    static constexpr uintptr_t COMPRESSED = 2u;
+    static constexpr uintptr_t TAG_MASK = 3u;
+
+    // Память под объект и сведения для её освобождения (см. Object::m_block)
+    struct Block {
+        void* memory;
+        uint32_t info;
+    };
+
+    static Block AllocateBlock(size_t size, size_t extra_bytes);
+    static void FreeBlock(void* memory, uint32_t info) noexcept;
+    // Создаёт первую владеющую ссылку на объект, только что построенный в блоке с info
+    static ObjectHolder Adopt(Object* object, uint32_t info) noexcept;
+    static void Destroy(Object* object) noexcept;
     void AssertIsValid() const;
 
-    std::shared_ptr<Object> m_data;
+    uintptr_t m_ref = 0u;
 };
 
 // Таблица символов, связывающая имя объекта с его значением
-using Closure = std::unordered_map<std::string, ObjectHolder>;
+using Closure = FlatStringMap<ObjectHolder>;
+
+/*
+ * Таблица локальных переменных одного вызова метода или функции.
+ * Сама таблица берётся из пула потока и возвращается в него очищенной, поэтому в кадре стека
+ * остаётся только указатель (Closure со встроенным буфером занимает сотни байт и ограничивала бы
+ * глубину рекурсии), а повторные вызовы не выделяют память
+ */
+class LocalClosure {
+public:
+    LocalClosure();
+    ~LocalClosure();
+
+    LocalClosure(const LocalClosure&) = delete;
+    LocalClosure& operator=(const LocalClosure&) = delete;
+
+    [[nodiscard]] Closure& Get() {
+        return *m_closure;
+    }
+
+private:
+    std::unique_ptr<Closure> m_closure;
+};
 
 // Проверяет, содержится ли в object значение, приводимое к True
-// Для отличных от нуля чисел, True и непустых строк возвращается true. В остальных случаях - false.
+// Для отличных от нуля чисел (Number и BigNumber), True и непустых строк возвращается true. В остальных случаях - false.
 bool IsTrue(const ObjectHolder& object);
 
 // Объект-значение, хранящий значение типа T
 template <typename T>
 class ValueObject : public Object {
 public:
-    ValueObject(T v) : m_value(v) {}
+    ValueObject(T v) : m_value(std::move(v)) {}
 
     void Print(std::ostream& os, [[maybe_unused]] Context& context) override {
         os << m_value;
@@ -115,6 +230,19 @@ using String = ValueObject<std::string>;
 // Числовое значение
 using Number = ValueObject<int>;
 
+// Целое значение, не помещающееся в int. Арифметика над Number переходит к нему при переполнении
+using BigNumber = ValueObject<BigInt>;
+
+size_t OwnedHeapBytes(const String& value);
+size_t OwnedHeapBytes(const BigNumber& value);
+
+// Возвращает целое значение: Number, если value помещается в int, иначе BigNumber
+[[nodiscard]]
+ObjectHolder MakeInteger(BigInt value);
+
+// Если object - Number или BigNumber, записывает его значение в value и возвращает true
+bool TryGetInteger(const ObjectHolder& object, BigInt& value);
+
 // Логическое значение
 class Bool : public ValueObject<bool> {
 public:
@@ -133,6 +261,11 @@ class Executable {
 public:
     virtual ~Executable() = default;
 
+    // Узлы, созданные в new-выражении, записываются на текущую квоту памяти (см. MemoryQuota).
+    // Квота запоминается в заголовке блока, чтобы освобождение вернуло байты ей же
+    static void* operator new(size_t size);
+    static void operator delete(void* ptr, size_t size);
+
     // Выполняет действие над объектами внутри closure, используя context
     // Возвращает результирующее значение либо None
     virtual ObjectHolder Execute(Closure& closure, Context& context) = 0;
@@ -156,6 +289,8 @@ public:
     // Создаёт класс с именем name и набором методов methods, унаследованный от класса parent
     // Если parent равен nullptr, то создаётся базовый класс
     explicit Class(std::string name, std::vector<Method> methods, const Class* parent);
+    Class(Class&&) = default;
+    ~Class() override;
 
     // Возвращает указатель на метод name или nullptr, если метод с таким именем отсутствует
     [[nodiscard]]
@@ -165,13 +300,49 @@ public:
     [[nodiscard]]
     const std::string& GetName() const;
 
+    // Возвращает родительский класс или nullptr для базового класса
+    [[nodiscard]]
+    const Class* GetParent() const;
+
+    /*
+     * Заменяет все методы класса на methods (горячая перезагрузка). Существующие экземпляры и их поля
+     * сохраняются, следующие вызовы методов - в том числе у наследников - находят новые тела.
+     * Вызывается между инструкциями: ни один метод класса в этот момент не должен выполняться
+     */
+    void Redefine(std::vector<Method> methods);
+
+    // Возвращает атрибуты, объявленные в теле класса. Они хранятся один раз и общие для всех экземпляров
+    [[nodiscard]]
+    const Closure& Attributes() const;
+
+    // Заменяет атрибуты класса на attributes. Вызывается при выполнении объявления класса
+    void SetAttributes(Closure attributes);
+
+    /*
+     * Ищет атрибут name (hash - его Closure::Hash) у класса, затем у родительских классов.
+     * Возвращает nullptr, если атрибута нет. Поле экземпляра с тем же именем скрывает атрибут класса
+     */
+    [[nodiscard]]
+    const ObjectHolder* FindAttribute(std::string_view name, uint32_t hash) const;
+
+    /*
+     * Поколение методов всех классов. Увеличивается при каждом Redefine и уничтожении класса, поэтому
+     * кэш поиска метода, запомнивший класс и поколение, действителен, пока поколение не изменилось
+     */
+    [[nodiscard]]
+    static uint64_t MethodEpoch();
+
     // Выводит в os строку "Class <имя класса>", например "Class cat"
     void Print(std::ostream& os, Context& context) override;
 
 private:
+    static uint64_t s_method_epoch;
+
     std::string m_name;
     std::unordered_map<std::string, Method> m_methods;
     const Class* m_parent;
+    Closure m_attributes;
+    MemoryCharge m_attributes_charge;
 };
 
 // Экземпляр класса
@@ -193,6 +364,9 @@ public:
      */
     ObjectHolder Call(const std::string& method_name, const std::vector<ObjectHolder>& actual_args, Context& context);
 
+    // Вызывает у объекта найденный заранее метод method. Число actual_args должно совпадать с числом параметров
+    ObjectHolder Call(const Method& method, const std::vector<ObjectHolder>& actual_args, Context& context);
+
     // Возвращает true, если объект имеет метод method, принимающий argument_count параметров
     [[nodiscard]]
     bool HasMethod(const std::string& method_name, size_t argument_count) const;
@@ -205,13 +379,56 @@ public:
     [[nodiscard]]
     const Closure& Fields() const;
 
+    // Возвращает класс, экземпляром которого является объект
+    [[nodiscard]]
+    const Class& GetClass() const;
+
+    // Записывает на квоту памяти текущий размер таблицы полей. Вызывается после добавления полей
+    void AccountFields();
+
 private:
-    Closure MixinLocalClosure(const std::vector<std::string>& formal_params, const std::vector<ObjectHolder>& actual_args);
+    void MixinLocalClosure(Closure& closure, const std::vector<std::string>& formal_params, const std::vector<ObjectHolder>& actual_args);
 
     static const std::vector<ObjectHolder> NOPARAMS;
 
     const Class& m_type;
     Closure m_closure;
+    MemoryCharge m_fields_charge;
+};
+
+/*
+ * Функция верхнего уровня (def вне класса). Вызовы связываются с ней при разборе, поэтому вызов
+ * не ищет метод и не создаёт получателя: локальное окружение содержит только параметры
+ */
+class Function : public Object {
+public:
+    Function(std::string name, std::vector<std::string> formal_params);
+
+    [[nodiscard]]
+    const std::string& GetName() const;
+
+    [[nodiscard]]
+    const std::vector<std::string>& GetFormalParams() const;
+
+    // Задаёт тело функции. Parser вызывает его после разбора тела, в котором функция уже может вызывать себя
+    void SetBody(std::unique_ptr<Executable> body);
+
+    // Выполняет тело в окружении locals, куда уже записаны значения параметров
+    ObjectHolder Call(Closure& locals, Context& context) const;
+
+    /*
+     * Вызывает функцию с параметрами actual_args. Если их число не совпадает с числом формальных
+     * параметров, выбрасывает исключение runtime_error
+     */
+    ObjectHolder Call(const std::vector<ObjectHolder>& actual_args, Context& context) const;
+
+    // Выводит в os строку "Function <имя функции>"
+    void Print(std::ostream& os, Context& context) override;
+
+private:
+    std::string m_name;
+    std::vector<std::string> m_formal_params;
+    std::unique_ptr<Executable> m_body;
 };
 
 /*
@@ -242,6 +459,22 @@ bool LessOrEqual(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& cont
 // Возвращает значение, противоположное Less(lhs, rhs, context)
 bool GreaterOrEqual(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context);
 
+/*
+ * Встроенная функция copy(object): экземпляр класса копируется в новый экземпляр того же класса,
+ * поля которого ссылаются на те же значения, IntArray - в новый массив. Числа, строки и Bool
+ * не изменяются, поэтому, как и классы, функции и None, возвращаются без копирования
+ */
+[[nodiscard]]
+ObjectHolder ShallowCopy(const ObjectHolder& object);
+
+/*
+ * Встроенная функция deepcopy(object): копирует экземпляры классов и IntArray, достижимые из object
+ * через поля. Каждый объект копируется один раз (карта идентичности «оригинал - копия»), поэтому общие
+ * ссылки и циклы воспроизводятся в копии. Обход идёт по явному стеку, глубина графа не ограничена стеком вызовов
+ */
+[[nodiscard]]
+ObjectHolder DeepCopy(const ObjectHolder& object);
+
 // Контекст-заглушка, применяется в тестах.
 // В этом контексте весь вывод перенаправляется в строковый поток вывода output
 struct DummyContext : Context {
@@ -252,6 +485,27 @@ struct DummyContext : Context {
     std::ostringstream output;
 };
 
+// Контекст, накапливающий вывод в памяти. Вывод записывается на квоту памяти (см. OutputBuffer),
+// превышение жёсткого предела прерывает print исключением MemoryLimitError
+class BufferedContext : public Context {
+public:
+    BufferedContext() {
+        m_output.exceptions(std::ios::badbit);
+    }
+
+    std::ostream& GetOutputStream() override {
+        return m_output;
+    }
+
+    [[nodiscard]] const std::string& Output() const {
+        return m_buffer.Text();
+    }
+
+private:
+    OutputBuffer m_buffer;
+    std::ostream m_output{&m_buffer};
+};
+
 // Простой контекст, в нём вывод происходит в поток output, переданный в конструктор
 class SimpleContext : public runtime::Context {
 public:
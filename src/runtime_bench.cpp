@@ -0,0 +1,668 @@
+#include "feedback.h"
+#include "int_array.h"
+#include "lexer.h"
+#include "parse.h"
+#include "runtime.h"
+#include "snapshot.h"
+#include "statement.h"
+#include "test_runner_p.h"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+DEFINE_ALLOCATION_COUNTER_HOOKS
+
+using namespace std;
+
+/*
+ * Микробенчмарки примитивов runtime.
+ * Результаты выводятся в stdout в формате JSON: время (ns/op), число выделений памяти (allocs/op)
+ * и запрошенные байты (bytes/op) на одну операцию, а для бенчмарков, обрабатывающих данные
+ * известного объёма, ещё и пропускная способность (MB/s). Параметры командной строки:
+ *   --filter <подстрока>   запускать только бенчмарки, в имени которых есть подстрока
+ *   --min-time-ms <N>      минимальная длительность замера одного бенчмарка (по умолчанию 100)
+ * Сравнивать имеет смысл только сборки с одинаковым CMAKE_BUILD_TYPE (обычно Release).
+ */
+
+namespace {
+
+using runtime::Closure;
+using runtime::ObjectHolder;
+
+template <typename T>
+inline void DoNotOptimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &value;
+#endif
+}
+
+struct Benchmark {
+    std::string name;
+    // Выполняет операцию iterations раз
+    std::function<void(size_t iterations)> run;
+    // Объём данных, обрабатываемых одной операцией. Если не 0, в результат добавляется пропускная способность
+    size_t payload_bytes = 0;
+};
+
+struct BenchmarkResult {
+    std::string name;
+    size_t iterations = 0;
+    double ns_per_op = 0.0;
+    double allocs_per_op = 0.0;
+    double bytes_per_op = 0.0;
+    double mb_per_s = 0.0;
+};
+
+BenchmarkResult Measure(const Benchmark& benchmark, std::chrono::nanoseconds min_time) {
+    using Clock = std::chrono::steady_clock;
+
+    benchmark.run(1u);
+    size_t iterations = 1u;
+    while (true) {
+        AllocationCounter counter;
+        const auto start = Clock::now();
+        benchmark.run(iterations);
+        const auto elapsed = Clock::now() - start;
+        const size_t allocations = counter.Count();
+        const size_t bytes = counter.Bytes();
+
+        if (elapsed >= min_time || iterations >= (size_t{1} << 40)) {
+            BenchmarkResult result;
+            result.name = benchmark.name;
+            result.iterations = iterations;
+            result.ns_per_op = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) / iterations;
+            result.allocs_per_op = static_cast<double>(allocations) / iterations;
+            result.bytes_per_op = static_cast<double>(bytes) / iterations;
+            // Байт за наносекунду - это тысяча мегабайт в секунду
+            result.mb_per_s = static_cast<double>(benchmark.payload_bytes) / result.ns_per_op * 1000.0;
+            return result;
+        }
+        // Подбираем число итераций так, чтобы следующий замер занял около min_time
+        const double elapsed_ns = std::max<double>(1.0, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+        const double scale = std::clamp(1.4 * min_time.count() / elapsed_ns, 2.0, 100.0);
+        iterations = static_cast<size_t>(iterations * scale);
+    }
+}
+
+void WriteJson(std::ostream& os, const std::vector<BenchmarkResult>& results) {
+    os << "{\n  \"benchmarks\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchmarkResult& result = results[i];
+        os << (i ? ",\n" : "\n");
+        os << "    {\"name\": \"" << result.name << "\", \"iterations\": " << result.iterations
+           << ", \"ns_per_op\": " << result.ns_per_op << ", \"allocs_per_op\": " << result.allocs_per_op
+           << ", \"bytes_per_op\": " << result.bytes_per_op;
+        if (result.mb_per_s > 0.0) {
+            os << ", \"mb_per_s\": " << result.mb_per_s;
+        }
+        os << "}";
+    }
+    os << "\n  ]\n}\n";
+}
+
+// Тело метода, возвращающее заранее заданное значение
+class ConstBody : public runtime::Executable {
+public:
+    explicit ConstBody(ObjectHolder value) : m_value(std::move(value)) {}
+
+    ObjectHolder Execute([[maybe_unused]] Closure& closure, [[maybe_unused]] runtime::Context& context) override {
+        return m_value;
+    }
+
+private:
+    ObjectHolder m_value;
+};
+
+runtime::Method MakeMethod(const std::string& name, size_t arg_count, ObjectHolder result) {
+    runtime::Method method;
+    method.name = name;
+    for (size_t i = 0; i < arg_count; ++i) {
+        method.formal_params.push_back("arg"s + std::to_string(i));
+    }
+    method.body = std::make_unique<ConstBody>(std::move(result));
+    return method;
+}
+
+// Классы, используемые бенчмарками. Живут всё время работы программы
+struct Fixture {
+    Fixture() {
+        std::vector<runtime::Method> methods;
+        for (size_t arg_count = 0; arg_count <= 5u; ++arg_count) {
+            methods.push_back(MakeMethod("call"s + std::to_string(arg_count), arg_count, ObjectHolder::None()));
+        }
+        methods.push_back(MakeMethod(parse::token_const::EQ_METHOD, 1u, ObjectHolder::Own(runtime::Bool(true))));
+        methods.push_back(MakeMethod(parse::token_const::LT_METHOD, 1u, ObjectHolder::Own(runtime::Bool(false))));
+        methods.push_back(MakeMethod(parse::token_const::STR_METHOD, 0u, ObjectHolder::Own(runtime::String("instance"s))));
+        methods.push_back(MakeMethod(parse::token_const::ADD_METHOD, 1u, ObjectHolder::Own(runtime::Number(1))));
+        hierarchy.push_back(std::make_unique<runtime::Class>("Base"s, std::move(methods), nullptr));
+
+        for (size_t depth = 1; depth < MAX_DEPTH; ++depth) {
+            hierarchy.push_back(std::make_unique<runtime::Class>("Derived"s + std::to_string(depth), std::vector<runtime::Method>{}, hierarchy.back().get()));
+        }
+    }
+
+    const runtime::Class& AtDepth(size_t depth) const {
+        return *hierarchy.at(depth - 1u);
+    }
+
+    static constexpr size_t MAX_DEPTH = 16;
+    std::vector<std::unique_ptr<runtime::Class>> hierarchy;
+};
+
+std::vector<Benchmark> MakeBenchmarks(const Fixture& fixture) {
+    std::vector<Benchmark> benchmarks;
+
+    benchmarks.push_back({"ObjectHolder/copy"s, [](size_t n) {
+        ObjectHolder source = ObjectHolder::Own(runtime::Number(1));
+        for (size_t i = 0; i < n; ++i) {
+            ObjectHolder copy = source;
+            DoNotOptimize(copy);
+        }
+    }});
+    benchmarks.push_back({"ObjectHolder/move"s, [](size_t n) {
+        ObjectHolder lhs = ObjectHolder::Own(runtime::Number(1));
+        ObjectHolder rhs;
+        for (size_t i = 0; i < n; ++i) {
+            rhs = std::move(lhs);
+            lhs = std::move(rhs);
+            DoNotOptimize(lhs);
+        }
+    }});
+
+    // Учёт в квоте памяти добавляет к созданию объекта сложение и два сравнения
+    for (const bool quota_enabled : {false, true}) {
+        benchmarks.push_back({"ObjectHolder/own/quota:"s + (quota_enabled ? "on"s : "off"s), [quota_enabled](size_t n) {
+            runtime::MemoryQuota quota;
+            std::optional<runtime::MemoryQuota::Scope> scope;
+            if (quota_enabled) {
+                scope.emplace(quota);
+            }
+            for (size_t i = 0; i < n; ++i) {
+                DoNotOptimize(ObjectHolder::Own(runtime::Number(static_cast<int>(i))));
+            }
+        }});
+    }
+
+    benchmarks.push_back({"TryAs/hit"s, [](size_t n) {
+        ObjectHolder value = ObjectHolder::Own(runtime::Number(1));
+        for (size_t i = 0; i < n; ++i) {
+            DoNotOptimize(value.TryAs<runtime::Number>());
+        }
+    }});
+    benchmarks.push_back({"TryAs/miss"s, [](size_t n) {
+        ObjectHolder value = ObjectHolder::Own(runtime::Number(1));
+        for (size_t i = 0; i < n; ++i) {
+            DoNotOptimize(value.TryAs<runtime::ClassInstance>());
+        }
+    }});
+
+    const std::vector<std::pair<std::string, std::function<ObjectHolder()>>> values = {
+        {"Number"s, [] { return ObjectHolder::Own(runtime::Number(42)); }},
+        {"String"s, [] { return ObjectHolder::Own(runtime::String("forty two"s)); }},
+        {"Bool"s, [] { return ObjectHolder::Own(runtime::Bool(true)); }},
+        {"None"s, [] { return ObjectHolder::None(); }},
+        {"ClassInstance"s, [&fixture] { return ObjectHolder::Own(runtime::ClassInstance(fixture.AtDepth(1))); }},
+    };
+
+    for (const auto& [type, make] : values) {
+        benchmarks.push_back({"IsTrue/"s + type, [make = make](size_t n) {
+            ObjectHolder value = make();
+            for (size_t i = 0; i < n; ++i) {
+                DoNotOptimize(runtime::IsTrue(value));
+            }
+        }});
+    }
+
+    // Сравнимые пары типов: одинаковые значения и экземпляр класса с __eq__/__lt__ слева
+    const std::vector<std::pair<std::string, std::pair<std::function<ObjectHolder()>, std::function<ObjectHolder()>>>> pairs = {
+        {"Number,Number"s, {values[0].second, values[0].second}},
+        {"String,String"s, {values[1].second, values[1].second}},
+        {"Bool,Bool"s, {values[2].second, values[2].second}},
+        {"None,None"s, {values[3].second, values[3].second}},
+        {"ClassInstance,Number"s, {values[4].second, values[0].second}},
+        {"ClassInstance,ClassInstance"s, {values[4].second, values[4].second}},
+    };
+    for (const auto& [type_pair, make] : pairs) {
+        benchmarks.push_back({"Equal/"s + type_pair, [make = make](size_t n) {
+            ObjectHolder lhs = make.first();
+            ObjectHolder rhs = make.second();
+            runtime::DummyContext context;
+            for (size_t i = 0; i < n; ++i) {
+                try {
+                    DoNotOptimize(runtime::Equal(lhs, rhs, context));
+                }
+                catch (const std::runtime_error&) {
+                    // Если Equal считает пару несравнимой, замеряется стоимость выброса исключения
+                }
+            }
+        }});
+        if (type_pair == "None,None"s) {
+            continue;
+        }
+        benchmarks.push_back({"Less/"s + type_pair, [make = make](size_t n) {
+            ObjectHolder lhs = make.first();
+            ObjectHolder rhs = make.second();
+            runtime::DummyContext context;
+            for (size_t i = 0; i < n; ++i) {
+                DoNotOptimize(runtime::Less(lhs, rhs, context));
+            }
+        }});
+    }
+
+    // Проверка на None узлом is против сравнения экземпляров через __eq__
+    benchmarks.push_back({"Identity/ClassInstance,None"s, [&fixture](size_t n) {
+        Closure closure;
+        closure["obj"s] = ObjectHolder::Own(runtime::ClassInstance(fixture.AtDepth(1)));
+        ast::Identity is_none(std::make_unique<ast::VariableValue>("obj"s), std::make_unique<ast::None>(), false);
+        runtime::DummyContext context;
+        for (size_t i = 0; i < n; ++i) {
+            DoNotOptimize(is_none.Execute(closure, context));
+        }
+    }});
+    benchmarks.push_back({"Comparison/eq/ClassInstance,ClassInstance"s, [&fixture](size_t n) {
+        Closure closure;
+        closure["obj"s] = ObjectHolder::Own(runtime::ClassInstance(fixture.AtDepth(1)));
+        ast::Comparison equal(runtime::Equal, std::make_unique<ast::VariableValue>("obj"s), std::make_unique<ast::VariableValue>("obj"s));
+        runtime::DummyContext context;
+        for (size_t i = 0; i < n; ++i) {
+            DoNotOptimize(equal.Execute(closure, context));
+        }
+    }});
+
+    for (const size_t depth : {1u, 2u, 4u, 8u, 16u}) {
+        benchmarks.push_back({"Class::GetMethod/depth:"s + std::to_string(depth), [&fixture, depth](size_t n) {
+            const runtime::Class& cls = fixture.AtDepth(depth);
+            const std::string name = "call0"s;
+            for (size_t i = 0; i < n; ++i) {
+                DoNotOptimize(cls.GetMethod(name));
+            }
+        }});
+    }
+
+    for (size_t arg_count = 0; arg_count <= 5u; ++arg_count) {
+        benchmarks.push_back({"ClassInstance::Call/args:"s + std::to_string(arg_count), [&fixture, arg_count](size_t n) {
+            runtime::ClassInstance instance(fixture.AtDepth(1));
+            const std::string name = "call"s + std::to_string(arg_count);
+            const std::vector<ObjectHolder> args(arg_count, ObjectHolder::Own(runtime::Number(1)));
+            runtime::DummyContext context;
+            for (size_t i = 0; i < n; ++i) {
+                DoNotOptimize(instance.Call(name, args, context));
+            }
+        }});
+    }
+
+    // Узел MethodCall кэширует найденный метод, поэтому глубина иерархии не должна влиять на время вызова
+    for (const size_t depth : {1u, 16u}) {
+        benchmarks.push_back({"MethodCall/depth:"s + std::to_string(depth), [&fixture, depth](size_t n) {
+            Closure closure;
+            closure["obj"s] = ObjectHolder::Own(runtime::ClassInstance(fixture.AtDepth(depth)));
+            ast::MethodCall call(std::make_unique<ast::VariableValue>("obj"s), "call0"s, {});
+            runtime::DummyContext context;
+            for (size_t i = 0; i < n; ++i) {
+                DoNotOptimize(call.Execute(closure, context));
+            }
+        }});
+    }
+
+    benchmarks.push_back({"Field/get"s, [&fixture](size_t n) {
+        runtime::ClassInstance instance(fixture.AtDepth(1));
+        instance.Fields()["x"s] = ObjectHolder::Own(runtime::Number(1));
+        instance.Fields()["y"s] = ObjectHolder::Own(runtime::Number(2));
+        const std::string name = "y"s;
+        for (size_t i = 0; i < n; ++i) {
+            DoNotOptimize(instance.Fields().at(name));
+        }
+    }});
+    // obj.y через VariableValue: поле экземпляра и атрибут класса, объявленный у самого класса или у родителя
+    for (const std::string& where : {"field"s, "class_attribute"s, "parent_attribute"s}) {
+        benchmarks.push_back({"VariableValue/"s + where, [where](size_t n) {
+            Closure attributes;
+            attributes["y"s] = ObjectHolder::Own(runtime::Number(2));
+            runtime::Class base("Base"s, {}, nullptr);
+            runtime::Class derived("Derived"s, {}, &base);
+            (where == "parent_attribute"s ? base : derived).SetAttributes(std::move(attributes));
+            Closure closure;
+            closure["obj"s] = ObjectHolder::Own(runtime::ClassInstance(derived));
+            runtime::ClassInstance& instance = *closure.at("obj"s).TryAs<runtime::ClassInstance>();
+            instance.Fields()["x"s] = ObjectHolder::Own(runtime::Number(1));
+            if (where == "field"s) {
+                instance.Fields()["y"s] = ObjectHolder::Own(runtime::Number(2));
+            }
+            ast::VariableValue value(std::vector<std::string>{"obj"s, "y"s});
+            runtime::DummyContext context;
+            for (size_t i = 0; i < n; ++i) {
+                DoNotOptimize(value.Execute(closure, context));
+            }
+        }});
+    }
+    benchmarks.push_back({"Field/set"s, [&fixture](size_t n) {
+        runtime::ClassInstance instance(fixture.AtDepth(1));
+        instance.Fields()["x"s] = ObjectHolder::Own(runtime::Number(1));
+        const ObjectHolder value = ObjectHolder::Own(runtime::Number(2));
+        const std::string name = "y"s;
+        for (size_t i = 0; i < n; ++i) {
+            instance.Fields()[name] = value;
+            DoNotOptimize(instance);
+        }
+    }});
+
+    const std::vector<std::pair<std::string, std::function<ObjectHolder()>>> printable = {
+        values[0], values[1], values[2], values[4],
+        {"Class"s, [&fixture] { return ObjectHolder::Share(const_cast<runtime::Class&>(fixture.AtDepth(1))); }},
+    };
+    for (const auto& [type, make] : printable) {
+        benchmarks.push_back({"Print/"s + type, [make = make](size_t n) {
+            ObjectHolder value = make();
+            runtime::DummyContext context;
+            std::ostream null_output(nullptr);
+            for (size_t i = 0; i < n; ++i) {
+                value->Print(null_output, context);
+            }
+        }});
+    }
+
+    for (const size_t digits : {100u, 1000u, 10000u}) {
+        const runtime::BigInt lhs = runtime::BigInt::FromString(std::string(digits, '7'));
+        const runtime::BigInt rhs = runtime::BigInt::FromString(std::string(digits, '3'));
+        benchmarks.push_back({"BigInt/mul/digits:"s + std::to_string(digits), [lhs, rhs](size_t n) {
+            for (size_t i = 0; i < n; ++i) {
+                DoNotOptimize(lhs * rhs);
+            }
+        }});
+        benchmarks.push_back({"BigInt/mul_schoolbook/digits:"s + std::to_string(digits), [lhs, rhs](size_t n) {
+            for (size_t i = 0; i < n; ++i) {
+                DoNotOptimize(runtime::BigInt::MultiplySchoolbook(lhs, rhs));
+            }
+        }});
+    }
+    for (const size_t digits : {1000u, 100000u}) {
+        benchmarks.push_back({"BigInt/to_string/digits:"s + std::to_string(digits), [value = runtime::BigInt::FromString(std::string(digits, '9'))](size_t n) {
+            for (size_t i = 0; i < n; ++i) {
+                DoNotOptimize(value.ToString());
+            }
+        }});
+    }
+    for (const bool simd : {false, true}) {
+        const std::string suffix = simd ? "/simd"s : "/scalar"s;
+        benchmarks.push_back({"IntArray/sum/size:65536"s + suffix, [simd](size_t n) {
+            runtime::IntArray::EnableSimd(simd);
+            const runtime::IntArray array(65536u, 3);
+            for (size_t i = 0; i < n; ++i) {
+                DoNotOptimize(array.Sum());
+            }
+            runtime::IntArray::EnableSimd(true);
+        }});
+        benchmarks.push_back({"IntArray/dot/size:65536"s + suffix, [simd](size_t n) {
+            runtime::IntArray::EnableSimd(simd);
+            const runtime::IntArray lhs(65536u, 3);
+            const runtime::IntArray rhs(65536u, 5);
+            for (size_t i = 0; i < n; ++i) {
+                DoNotOptimize(lhs.Dot(rhs));
+            }
+            runtime::IntArray::EnableSimd(true);
+        }});
+        benchmarks.push_back({"IntArray/mul/size:65536"s + suffix, [simd](size_t n) {
+            runtime::IntArray::EnableSimd(simd);
+            const runtime::IntArray lhs(65536u, 3);
+            const runtime::IntArray rhs(65536u, 5);
+            for (size_t i = 0; i < n; ++i) {
+                DoNotOptimize(runtime::IntArray::Apply(runtime::ArrayOp::Mul, lhs, rhs));
+            }
+            runtime::IntArray::EnableSimd(true);
+        }});
+    }
+    benchmarks.push_back({"Number/add_checked"s, [](size_t n) {
+        runtime::DummyContext context;
+        Closure closure;
+        ast::Add add(std::make_unique<ast::NumericConst>(2), std::make_unique<ast::NumericConst>(3));
+        for (size_t i = 0; i < n; ++i) {
+            DoNotOptimize(add.Execute(closure, context));
+        }
+    }});
+
+    // Подсказка профиля для '+' над экземплярами пропускает проверки чисел, строк и массивов
+    for (const uint8_t hint : {uint8_t{0u}, uint8_t{runtime::TypeFeedback::KIND_INSTANCE}}) {
+        benchmarks.push_back({"Add/instance/hint:"s + (hint ? "instance"s : "none"s), [&fixture, hint](size_t n) {
+            runtime::DummyContext context;
+            Closure closure;
+            closure["obj"s] = ObjectHolder::Own(runtime::ClassInstance(fixture.AtDepth(1)));
+            ast::Add add(std::make_unique<ast::VariableValue>("obj"s), std::make_unique<ast::NumericConst>(3));
+            add.SetFeedbackSite(1u, hint);
+            for (size_t i = 0; i < n; ++i) {
+                DoNotOptimize(add.Execute(closure, context));
+            }
+        }});
+    }
+    // Цена записи профиля: с выключенной записью узел только проверяет указатель
+    for (const bool recording : {false, true}) {
+        benchmarks.push_back({"Add/number/recording:"s + (recording ? "on"s : "off"s), [recording](size_t n) {
+            runtime::DummyContext context;
+            Closure closure;
+            ast::Add add(std::make_unique<ast::NumericConst>(2), std::make_unique<ast::NumericConst>(3));
+            add.SetFeedbackSite(1u, 0u);
+            runtime::TypeFeedback feedback;
+            runtime::TypeFeedback::SetRecording(recording ? &feedback : nullptr);
+            for (size_t i = 0; i < n; ++i) {
+                DoNotOptimize(add.Execute(closure, context));
+            }
+            runtime::TypeFeedback::SetRecording(nullptr);
+        }});
+    }
+
+    // Строка отчёта: цепочка + и str() против форматной строки, собираемой в один буфер
+    const std::vector<std::pair<std::string, std::string>> formats = {
+        {"concat"s, "r = \"x=\" + str(p.x) + \", y=\" + str(p.y) + \", name=\" + p.name\n"s},
+        {"fstring"s, "r = f\"x={p.x}, y={p.y}, name={p.name}\"\n"s},
+    };
+    for (const auto& [kind, source] : formats) {
+        benchmarks.push_back({"Format/"s + kind, [&fixture, source = source](size_t n) {
+            std::istringstream input(source);
+            parse::Lexer lexer(input);
+            const std::unique_ptr<runtime::Executable> statement = ParseProgram(lexer);
+            Closure closure;
+            closure["p"s] = ObjectHolder::Own(runtime::ClassInstance(fixture.AtDepth(1)));
+            Closure& fields = closure.at("p"s).TryAs<runtime::ClassInstance>()->Fields();
+            fields["x"s] = ObjectHolder::Own(runtime::Number(1234));
+            fields["y"s] = ObjectHolder::Own(runtime::Number(-56));
+            fields["name"s] = ObjectHolder::Own(runtime::String("point"s));
+            runtime::DummyContext context;
+            for (size_t i = 0; i < n; ++i) {
+                DoNotOptimize(statement->Execute(closure, context));
+            }
+        }});
+    }
+
+    // Вспомогательная функция: def против метода временного экземпляра класса без полей
+    const std::string helpers = "def square(x):\n  return x * x\n\nclass Helpers:\n  def square(x):\n    return x * x\n\n"s;
+    const std::vector<std::pair<std::string, std::string>> calls = {
+        {"function"s, "r = square(7)\n"s},
+        {"dummy_instance"s, "h = Helpers()\nr = h.square(7)\n"s},
+    };
+    for (const auto& [kind, source] : calls) {
+        benchmarks.push_back({"Call/"s + kind, [helpers, source = source](size_t n) {
+            Closure declared;
+            std::istringstream prologue_input(helpers);
+            parse::Lexer prologue_lexer(prologue_input);
+            const std::unique_ptr<runtime::Executable> prologue = ParseProgram(prologue_lexer, declared);
+            std::istringstream input(source);
+            parse::Lexer lexer(input);
+            const std::unique_ptr<runtime::Executable> statement = ParseProgram(lexer, declared);
+            Closure closure;
+            runtime::DummyContext context;
+            prologue->Execute(closure, context);
+            for (size_t i = 0; i < n; ++i) {
+                DoNotOptimize(statement->Execute(closure, context));
+            }
+        }});
+    }
+
+    // Список из 100 узлов: копирование методом clone, пересоздающим узлы через конструктор, против deepcopy
+    const std::string nodes = "class Node:\n  def __init__(v, next):\n    self.v = v\n    self.next = next\n\n"
+                              "class Builder:\n  def build(n, head):\n    if n > 0:\n      return self.build(n - 1, Node(n, head))\n    return head\n\n"
+                              "  def clone(node):\n    if node.next is None:\n      return Node(node.v, None)\n    return Node(node.v, self.clone(node.next))\n\n"
+                              "b = Builder()\nhead = b.build(100, None)\n"s;
+    const std::vector<std::pair<std::string, std::string>> copies = {
+        {"method_clone"s, "r = b.clone(head)\n"s},
+        {"deepcopy"s, "r = deepcopy(head)\n"s},
+    };
+    for (const auto& [kind, source] : copies) {
+        benchmarks.push_back({"Copy/"s + kind + "/nodes:100"s, [nodes, source = source](size_t n) {
+            Closure declared;
+            std::istringstream prologue_input(nodes);
+            parse::Lexer prologue_lexer(prologue_input);
+            const std::unique_ptr<runtime::Executable> prologue = ParseProgram(prologue_lexer, declared);
+            std::istringstream input(source);
+            parse::Lexer lexer(input);
+            const std::unique_ptr<runtime::Executable> statement = ParseProgram(lexer, declared);
+            Closure closure;
+            runtime::DummyContext context;
+            prologue->Execute(closure, context);
+            for (size_t i = 0; i < n; ++i) {
+                DoNotOptimize(statement->Execute(closure, context));
+            }
+        }});
+    }
+
+    // Сохранение и загрузка списка из 10000 экземпляров со строкой, числом, Bool и None в полях
+    {
+        auto classes = std::make_shared<Closure>();
+        (*classes)["Item"s] = ObjectHolder::Own(runtime::Class("Item"s, {}, nullptr));
+        const runtime::Class& item_class = *classes->at("Item"s).TryAs<runtime::Class>();
+        ObjectHolder head;
+        for (int i = 0; i < 10000; ++i) {
+            ObjectHolder item = ObjectHolder::Own(runtime::ClassInstance(item_class));
+            Closure& fields = item.TryAs<runtime::ClassInstance>()->Fields();
+            fields["name"s] = ObjectHolder::Own(runtime::String("item "s + std::to_string(i)));
+            fields["count"s] = ObjectHolder::Own(runtime::Number(i));
+            fields["paid"s] = ObjectHolder::Own(runtime::Bool(i % 2 == 0));
+            fields["note"s] = ObjectHolder::None();
+            fields["next"s] = head;
+            head = item;
+        }
+        const std::string path = (std::filesystem::temp_directory_path() / "mython_bench_value.bin").string();
+        runtime::SaveValue(path, head);
+        const size_t file_bytes = std::filesystem::file_size(path);
+        benchmarks.push_back({"Value/save/items:10000"s, [classes, head, path](size_t n) {
+            for (size_t i = 0; i < n; ++i) {
+                runtime::SaveValue(path, head);
+            }
+        }, file_bytes});
+        benchmarks.push_back({"Value/load/items:10000"s, [classes, head, path](size_t n) {
+            for (size_t i = 0; i < n; ++i) {
+                DoNotOptimize(runtime::LoadValue(path, *classes));
+            }
+        }, file_bytes});
+    }
+
+    // Диспетчеризация по 128 значениям: вложенные if/else (как писали без elif) против цепочки elif,
+    // собранной в таблицу. Искомое значение - последнее в цепочке
+    constexpr int dispatch_cases = 128;
+    for (const std::string& kind : {"nested_else"s, "elif_table"s}) {
+        std::string source;
+        for (int i = 0; i < dispatch_cases; ++i) {
+            const std::string indent(kind == "nested_else"s ? static_cast<size_t>(i) * 2u : 0u, ' ');
+            source += indent + (i == 0 || kind == "nested_else"s ? "if"s : "elif"s) + " x == "s + std::to_string(i) + ":\n"s;
+            source += indent + "  r = "s + std::to_string(i) + "\n"s;
+            if (kind == "nested_else"s && i + 1 < dispatch_cases) {
+                source += indent + "else:\n"s;
+            }
+        }
+        benchmarks.push_back({"Dispatch/"s + kind + "/cases:"s + std::to_string(dispatch_cases), [source](size_t n) {
+            std::istringstream input(source);
+            parse::Lexer lexer(input);
+            const std::unique_ptr<runtime::Executable> statement = ParseProgram(lexer);
+            Closure closure;
+            closure["x"s] = ObjectHolder::Own(runtime::Number(dispatch_cases - 1));
+            runtime::DummyContext context;
+            for (size_t i = 0; i < n; ++i) {
+                DoNotOptimize(statement->Execute(closure, context));
+            }
+        }});
+    }
+
+    // Программа из класса и множества инструкций: правка тела метода против полного разбора
+    std::string program = "class Counter:\n  def add(k):\n    return k + 1\n\n"s;
+    for (size_t i = 0; i < 2000u; ++i) {
+        program += "x = "s + std::to_string(i) + "\nprint x + 1\n"s;
+    }
+    benchmarks.push_back({"Parse/full/statements:4000"s, [program](size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            std::istringstream input(program);
+            parse::Lexer lexer(input);
+            DoNotOptimize(ParseProgram(lexer));
+        }
+    }});
+    benchmarks.push_back({"Parse/incremental_edit/statements:4000"s, [program](size_t n) {
+        parse::IncrementalProgram incremental(program);
+        const size_t offset = program.find("k + 1"s);
+        for (size_t i = 0; i < n; ++i) {
+            DoNotOptimize(incremental.Edit(offset, 5u, i % 2 == 0 ? "k + 2"s : "k + 1"s));
+        }
+    }});
+
+    return benchmarks;
+}
+
+// Разбирает text целиком как неотрицательное десятичное число
+bool ParseNonNegative(std::string_view text, int& value) {
+    const char* end = text.data() + text.size();
+    const auto [ptr, ec] = std::from_chars(text.data(), end, value);
+    return ec == std::errc{} && ptr == end && value >= 0;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    auto usage = [argv] {
+        std::cerr << "Usage: " << argv[0] << " [--filter <substring>] [--min-time-ms <N>]" << std::endl;
+        return 1;
+    };
+
+    std::string filter;
+    std::chrono::milliseconds min_time{100};
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--filter"s && i + 1 < argc) {
+            filter = argv[++i];
+        }
+        else if (arg == "--min-time-ms"s && i + 1 < argc) {
+            int milliseconds = 0;
+            if (!ParseNonNegative(argv[++i], milliseconds)) {
+                return usage();
+            }
+            min_time = std::chrono::milliseconds(milliseconds);
+        }
+        else {
+            return usage();
+        }
+    }
+
+    const Fixture fixture;
+    std::vector<BenchmarkResult> results;
+    for (const Benchmark& benchmark : MakeBenchmarks(fixture)) {
+        if (!filter.empty() && benchmark.name.find(filter) == std::string::npos) {
+            continue;
+        }
+        results.push_back(Measure(benchmark, min_time));
+        std::cerr << results.back().name << ": " << results.back().ns_per_op << " ns/op";
+        if (results.back().mb_per_s > 0.0) {
+            std::cerr << ", " << results.back().mb_per_s << " MB/s";
+        }
+        std::cerr << std::endl;
+    }
+    WriteJson(std::cout, results);
+    return 0;
+}
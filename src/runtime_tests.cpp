@@ -1,4 +1,5 @@
 #include "runtime.h"
+#include "int_array.h"
 #include "test_runner_p.h"
 
 #include <functional>
@@ -518,6 +519,58 @@ void TestClassInstance() {
     ASSERT_THROWS(instance.Call("missing_method"s, {}, ctx), runtime_error);
 }
 
+// Граф root -> {left, right}, left и right ссылаются на общий shared, shared - обратно на root
+void TestCopy() {
+    Class cls{"Node"s, {}, nullptr};
+    ObjectHolder root = ObjectHolder::Own(ClassInstance{cls});
+    ObjectHolder left = ObjectHolder::Own(ClassInstance{cls});
+    ObjectHolder right = ObjectHolder::Own(ClassInstance{cls});
+    ObjectHolder shared = ObjectHolder::Own(ClassInstance{cls});
+    root.TryAs<ClassInstance>()->Fields()["left"s] = left;
+    root.TryAs<ClassInstance>()->Fields()["right"s] = right;
+    root.TryAs<ClassInstance>()->Fields()["name"s] = ObjectHolder::Own(String{"root"s});
+    root.TryAs<ClassInstance>()->Fields()["values"s] = ObjectHolder::Own(IntArray{vector<int64_t>{1, 2, 3}});
+    left.TryAs<ClassInstance>()->Fields()["next"s] = shared;
+    right.TryAs<ClassInstance>()->Fields()["next"s] = shared;
+    shared.TryAs<ClassInstance>()->Fields()["next"s] = root;
+    shared.TryAs<ClassInstance>()->Fields()["end"s] = ObjectHolder::None();
+
+    auto field = [](const ObjectHolder& object, const string& name) {
+        return object.TryAs<ClassInstance>()->Fields().at(name);
+    };
+
+    const ObjectHolder shallow = ShallowCopy(root);
+    ASSERT(shallow.Get() != root.Get());
+    ASSERT(&shallow.TryAs<ClassInstance>()->GetClass() == &cls);
+    ASSERT_EQUAL(shallow.TryAs<ClassInstance>()->Fields().size(), 4u);
+    ASSERT(field(shallow, "left"s).Get() == left.Get());
+    ASSERT(field(shallow, "values"s).Get() == field(root, "values"s).Get());
+
+    const ObjectHolder deep = DeepCopy(root);
+    ASSERT(deep.Get() != root.Get());
+    const ObjectHolder deep_left = field(deep, "left"s);
+    const ObjectHolder deep_shared = field(deep_left, "next"s);
+    ASSERT(deep_left.Get() != left.Get());
+    ASSERT(deep_shared.Get() != shared.Get());
+    ASSERT(field(field(deep, "right"s), "next"s).Get() == deep_shared.Get());
+    ASSERT(field(deep_shared, "next"s).Get() == deep.Get());
+    ASSERT(!field(deep_shared, "end"s));
+    // Неизменяемые значения разделяются, массив копируется
+    ASSERT(field(deep, "name"s).Get() == field(root, "name"s).Get());
+    const IntArray* deep_values = field(deep, "values"s).TryAs<IntArray>();
+    ASSERT(deep_values != field(root, "values"s).TryAs<IntArray>());
+    ASSERT_EQUAL(deep_values->Values(), (vector<int64_t>{1, 2, 3}));
+
+    const ObjectHolder number = ObjectHolder::Own(Number{5});
+    ASSERT(ShallowCopy(number).Get() == number.Get());
+    ASSERT(DeepCopy(number).Get() == number.Get());
+    ASSERT(!DeepCopy(ObjectHolder::None()));
+
+    // Циклы владеющих ссылок разрываются вручную, иначе объекты не освободятся
+    shared.TryAs<ClassInstance>()->Fields()["next"s] = ObjectHolder::None();
+    deep_shared.TryAs<ClassInstance>()->Fields()["next"s] = ObjectHolder::None();
+}
+
 }  // namespace
 
 void RunObjectsTests(TestRunner& tr) {
@@ -529,6 +582,7 @@ void RunObjectsTests(TestRunner& tr) {
     RUN_TEST(tr, runtime::TestComparison);
     RUN_TEST(tr, runtime::TestClass);
     RUN_TEST(tr, runtime::TestClassInstance);
+    RUN_TEST(tr, runtime::TestCopy);
 }
 
 void RunObjectHolderTests(TestRunner& tr) {
@@ -0,0 +1,452 @@
+#include "snapshot.h"
+
+#include "int_array.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <ostream>
+#include <type_traits>
+#include <typeinfo>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace runtime {
+
+namespace {
+
+// Сигнатура и версия формата
+constexpr char MAGIC[8] = {'M', 'Y', 'S', 'N', 'A', 'P', '\0', '\2'};
+// Номер объекта, обозначающий None
+constexpr uint32_t NONE_REF = numeric_limits<uint32_t>::max();
+// Файл значения (SaveValue) - снимок с единственной переменной, не привязанный к тексту программы
+constexpr uint64_t VALUE_SOURCE_HASH = 0u;
+const string VALUE_ROOT = "value"s;
+
+enum class Tag : uint8_t {
+    Number,
+    BigNumber,
+    String,
+    Bool,
+    IntArray,
+    Class,
+    ClassInstance,
+    Function,
+};
+
+void AppendU32(string& buffer, uint32_t value) {
+    buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void AppendU64(string& buffer, uint64_t value) {
+    buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+class SnapshotWriter {
+public:
+    explicit SnapshotWriter(const Closure& globals) {
+        WriteU32(static_cast<uint32_t>(globals.size()));
+        for (const auto& [name, value] : globals) {
+            WriteString(name);
+            WriteU32(Ref(value));
+        }
+        m_roots = std::exchange(m_buffer, {});
+    }
+
+    /*
+     * Объекты записываются в порядке номеров, поля экземпляров добавляют новые объекты в конец очереди.
+     * В поток с позиционированием (файл, строковый поток) объекты уходят частями по CHUNK_BYTES по мере
+     * обхода, а их число, известное только в конце, дописывается в заголовок. В поток без
+     * позиционирования (канал) снимок записывается одним куском после обхода
+     */
+    void WriteTo(ostream& output, uint64_t source_hash) {
+        const streampos start = output.tellp();
+        const bool seekable = start != streampos(-1);
+        string header(MAGIC, sizeof(MAGIC));
+        AppendU64(header, source_hash);
+        const size_t count_offset = header.size();
+        AppendU32(header, 0u);
+        if (seekable) {
+            output.write(header.data(), static_cast<streamsize>(header.size()));
+        }
+        for (size_t i = 0; i < m_objects.size(); ++i) {
+            WriteObject(*m_objects[i]);
+            if (seekable && m_buffer.size() >= CHUNK_BYTES) {
+                output.write(m_buffer.data(), static_cast<streamsize>(m_buffer.size()));
+                m_buffer.clear();
+            }
+        }
+        const uint32_t object_count = static_cast<uint32_t>(m_objects.size());
+        memcpy(header.data() + count_offset, &object_count, sizeof(object_count));
+        if (!seekable) {
+            output.write(header.data(), static_cast<streamsize>(header.size()));
+        }
+        output.write(m_buffer.data(), static_cast<streamsize>(m_buffer.size()));
+        output.write(m_roots.data(), static_cast<streamsize>(m_roots.size()));
+        if (seekable) {
+            const streampos end = output.tellp();
+            output.seekp(start + static_cast<streamoff>(count_offset));
+            output.write(reinterpret_cast<const char*>(&object_count), sizeof(object_count));
+            output.seekp(end);
+        }
+    }
+
+private:
+    uint32_t Ref(const ObjectHolder& value) {
+        if (!value) {
+            return NONE_REF;
+        }
+        auto [it, inserted] = m_index.emplace(value.Get(), static_cast<uint32_t>(m_objects.size()));
+        if (inserted) {
+            m_objects.push_back(value.Get());
+        }
+        return it->second;
+    }
+
+    // Экземпляры проверяются первыми: в графах значений их больше всего
+    void WriteObject(const Object& object) {
+        if (const auto* instance = dynamic_cast<const ClassInstance*>(&object)) {
+            WriteTag(Tag::ClassInstance);
+            WriteString(instance->GetClass().GetName());
+            WriteMembers(instance->Fields());
+        }
+        else if (const auto* number = dynamic_cast<const Number*>(&object)) {
+            WriteTag(Tag::Number);
+            WriteU32(static_cast<uint32_t>(number->GetValue()));
+        }
+        else if (const auto* big = dynamic_cast<const BigNumber*>(&object)) {
+            WriteTag(Tag::BigNumber);
+            WriteString(big->GetValue().ToString());
+        }
+        else if (const auto* str = dynamic_cast<const String*>(&object)) {
+            WriteTag(Tag::String);
+            WriteString(str->GetValue());
+        }
+        else if (const auto* boolean = dynamic_cast<const Bool*>(&object)) {
+            WriteTag(Tag::Bool);
+            m_buffer.push_back(boolean->GetValue() ? '\1' : '\0');
+        }
+        else if (const auto* array = dynamic_cast<const IntArray*>(&object)) {
+            WriteTag(Tag::IntArray);
+            WriteU32(static_cast<uint32_t>(array->Size()));
+            m_buffer.append(reinterpret_cast<const char*>(array->Values().data()), array->Size() * sizeof(int64_t));
+        }
+        else if (const auto* cls = dynamic_cast<const Class*>(&object)) {
+            WriteTag(Tag::Class);
+            WriteString(cls->GetName());
+            WriteMembers(cls->Attributes());
+        }
+        else if (const auto* function = dynamic_cast<const Function*>(&object)) {
+            WriteTag(Tag::Function);
+            WriteString(function->GetName());
+        }
+        else {
+            throw SnapshotError("Snapshot does not support objects of type "s + typeid(object).name());
+        }
+    }
+
+    // Поля экземпляра или атрибуты класса: число, затем пары «имя - номер объекта»
+    void WriteMembers(const Closure& members) {
+        WriteU32(static_cast<uint32_t>(members.size()));
+        for (const auto& [name, value] : members) {
+            WriteString(name);
+            WriteU32(Ref(value));
+        }
+    }
+
+    void WriteTag(Tag tag) {
+        m_buffer.push_back(static_cast<char>(tag));
+    }
+
+    void WriteU32(uint32_t value) {
+        AppendU32(m_buffer, value);
+    }
+
+    void WriteString(const string& str) {
+        AppendU32(m_buffer, static_cast<uint32_t>(str.size()));
+        m_buffer += str;
+    }
+
+    static constexpr size_t CHUNK_BYTES = 64u * 1024u;
+
+    unordered_map<const Object*, uint32_t> m_index;
+    vector<const Object*> m_objects;
+    string m_buffer;
+    string m_roots;
+};
+
+// Что делать с атрибутами классов, записанными в снимке
+enum class StoredAttributes {
+    // Снимок кучи той же программы: атрибуты живых классов заменяются сохранёнными
+    Restore,
+    // Файл значения: классы только ищутся по имени, их атрибуты не меняются
+    Skip,
+};
+
+class SnapshotReader {
+public:
+    SnapshotReader(string_view data, const Closure& classes, StoredAttributes attributes)
+        : m_data(data), m_classes(classes), m_attributes(attributes) {}
+
+    Closure Read(uint64_t source_hash) {
+        if (m_data.size() < sizeof(MAGIC) || memcmp(m_data.data(), MAGIC, sizeof(MAGIC)) != 0) {
+            throw SnapshotError("Not a Mython heap snapshot"s);
+        }
+        m_pos = sizeof(MAGIC);
+        if (ReadU64() != source_hash) {
+            throw SnapshotError("Snapshot was taken for a different source text"s);
+        }
+
+        // Сначала создаются все объекты, затем заполняются поля экземпляров и атрибуты классов
+        const uint32_t object_count = ReadCount(1u);
+        m_objects.reserve(object_count);
+        for (uint32_t i = 0; i < object_count; ++i) {
+            m_objects.push_back(ReadObject());
+        }
+        for (auto& [instance, fields] : m_pending_fields) {
+            for (auto& [name, ref] : fields) {
+                instance->Fields()[name] = Resolve(ref);
+            }
+            instance->AccountFields();
+        }
+        for (auto& [cls, members] : m_pending_attributes) {
+            Closure attributes;
+            for (auto& [name, ref] : members) {
+                attributes[name] = Resolve(ref);
+            }
+            cls->SetAttributes(std::move(attributes));
+        }
+
+        Closure globals;
+        const uint32_t root_count = ReadCount(2u * sizeof(uint32_t));
+        for (uint32_t i = 0; i < root_count; ++i) {
+            string name = ReadString();
+            globals[name] = Resolve(ReadU32());
+        }
+        if (m_pos != m_data.size()) {
+            throw SnapshotError("Unexpected data after the end of snapshot"s);
+        }
+        return globals;
+    }
+
+private:
+    // Имена и номера объектов полей экземпляра или атрибутов класса
+    using Members = vector<pair<string, uint32_t>>;
+
+    ObjectHolder ReadObject() {
+        switch (static_cast<Tag>(ReadBytes(1u)[0])) {
+        case Tag::Number:
+            return ObjectHolder::Own(Number(static_cast<int>(ReadU32())));
+        case Tag::BigNumber:
+            return ObjectHolder::Own(BigNumber(BigInt::FromString(ReadString())));
+        case Tag::String:
+            return ObjectHolder::Own(String(ReadString()));
+        case Tag::Bool:
+            return ObjectHolder::Own(Bool(ReadBytes(1u)[0] != '\0'));
+        case Tag::IntArray: {
+            const size_t size = ReadU32();
+            const char* bytes = ReadBytes(size * sizeof(int64_t));
+            vector<int64_t> values(size);
+            memcpy(values.data(), bytes, size * sizeof(int64_t));
+            return ObjectHolder::Own(IntArray(std::move(values)));
+        }
+        case Tag::Class: {
+            ObjectHolder holder = FindDeclared<Class>(ReadString());
+            Members members = ReadMembers();
+            if (m_attributes == StoredAttributes::Restore) {
+                m_pending_attributes.emplace_back(holder.TryAs<Class>(), std::move(members));
+            }
+            return holder;
+        }
+        case Tag::ClassInstance: {
+            const Class& cls = *FindDeclared<Class>(ReadString()).TryAs<Class>();
+            ObjectHolder holder = ObjectHolder::Own(ClassInstance(cls));
+            m_pending_fields.emplace_back(holder.TryAs<ClassInstance>(), ReadMembers());
+            return holder;
+        }
+        case Tag::Function:
+            return FindDeclared<Function>(ReadString());
+        }
+        throw SnapshotError("Unknown object tag in snapshot"s);
+    }
+
+    Members ReadMembers() {
+        Members members(ReadCount(2u * sizeof(uint32_t)));
+        for (auto& [name, ref] : members) {
+            name = ReadString();
+            ref = ReadU32();
+        }
+        return members;
+    }
+
+    // Класс или функция, объявленные программой
+    template <typename T>
+    ObjectHolder FindDeclared(const string& name) const {
+        const auto it = m_classes.find(name);
+        if (it == m_classes.end() || it->second.TryAs<T>() == nullptr) {
+            throw SnapshotError("Snapshot refers to unknown "s + (is_same_v<T, Class> ? "class "s : "function "s) + name);
+        }
+        return it->second;
+    }
+
+    ObjectHolder Resolve(uint32_t ref) const {
+        if (ref == NONE_REF) {
+            return ObjectHolder::None();
+        }
+        if (ref >= m_objects.size()) {
+            throw SnapshotError("Snapshot object reference is out of range"s);
+        }
+        return m_objects[ref];
+    }
+
+    const char* ReadBytes(size_t count) {
+        if (m_data.size() - m_pos < count) {
+            throw SnapshotError("Snapshot is truncated"s);
+        }
+        const char* result = m_data.data() + m_pos;
+        m_pos += count;
+        return result;
+    }
+
+    uint32_t ReadU32() {
+        uint32_t value = 0;
+        memcpy(&value, ReadBytes(sizeof(value)), sizeof(value));
+        return value;
+    }
+
+    uint64_t ReadU64() {
+        uint64_t value = 0;
+        memcpy(&value, ReadBytes(sizeof(value)), sizeof(value));
+        return value;
+    }
+
+    // Читает число элементов, каждый из которых занимает не меньше item_bytes байт.
+    // Проверка до выделения памяти защищает от огромных размеров в повреждённом снимке
+    uint32_t ReadCount(size_t item_bytes) {
+        const uint32_t count = ReadU32();
+        if ((m_data.size() - m_pos) / item_bytes < count) {
+            throw SnapshotError("Snapshot is truncated"s);
+        }
+        return count;
+    }
+
+    string ReadString() {
+        const uint32_t size = ReadU32();
+        return string(ReadBytes(size), size);
+    }
+
+    string_view m_data;
+    size_t m_pos = 0;
+    const Closure& m_classes;
+    StoredAttributes m_attributes;
+    vector<ObjectHolder> m_objects;
+    // Поля и атрибуты заполняются после создания всех объектов: они могут ссылаться на объекты дальше в снимке
+    vector<pair<ClassInstance*, Members>> m_pending_fields;
+    vector<pair<Class*, Members>> m_pending_attributes;
+};
+
+// Отображение файла только для чтения, освобождаемое при разрушении
+class MappedFile {
+public:
+    explicit MappedFile(const string& path) {
+        const int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw SnapshotError("Cannot open snapshot "s + path);
+        }
+        struct stat info {};
+        if (fstat(fd, &info) == 0 && info.st_size > 0) {
+            m_size = static_cast<size_t>(info.st_size);
+            m_data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        close(fd);
+        if (m_data == MAP_FAILED) {
+            throw SnapshotError("Cannot map snapshot "s + path);
+        }
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        if (m_data != MAP_FAILED) {
+            munmap(m_data, m_size);
+        }
+    }
+
+    [[nodiscard]] string_view Data() const {
+        return m_data == MAP_FAILED ? string_view{} : string_view(static_cast<const char*>(m_data), m_size);
+    }
+
+private:
+    void* m_data = MAP_FAILED;
+    size_t m_size = 0;
+};
+
+}  // namespace
+
+uint64_t SourceHash(string_view source) {
+    uint64_t hash = 14695981039346656037ull;
+    for (const char ch : source) {
+        hash = (hash ^ static_cast<unsigned char>(ch)) * 1099511628211ull;
+    }
+    return hash;
+}
+
+void WriteSnapshot(ostream& output, const Closure& globals, uint64_t source_hash) {
+    SnapshotWriter(globals).WriteTo(output, source_hash);
+}
+
+void SaveSnapshot(const string& path, const Closure& globals, uint64_t source_hash) {
+    // Снимок пишется потоком во временный файл, который заменяет старый только после успешной записи
+    const string temp_path = path + ".tmp"s;
+    try {
+        SnapshotWriter writer(globals);
+        ofstream output(temp_path, ios::binary | ios::trunc);
+        writer.WriteTo(output, source_hash);
+        if (!output.flush()) {
+            throw SnapshotError("Cannot write snapshot "s + path);
+        }
+    }
+    catch (...) {
+        remove(temp_path.c_str());
+        throw;
+    }
+    if (rename(temp_path.c_str(), path.c_str()) != 0) {
+        remove(temp_path.c_str());
+        throw SnapshotError("Cannot write snapshot "s + path);
+    }
+}
+
+Closure ReadSnapshot(string_view data, uint64_t source_hash, const Closure& classes) {
+    return SnapshotReader(data, classes, StoredAttributes::Restore).Read(source_hash);
+}
+
+Closure LoadSnapshot(const string& path, uint64_t source_hash, const Closure& classes) {
+    const MappedFile file(path);
+    return ReadSnapshot(file.Data(), source_hash, classes);
+}
+
+void SaveValue(const string& path, const ObjectHolder& value) {
+    SaveSnapshot(path, Closure{{VALUE_ROOT, value}}, VALUE_SOURCE_HASH);
+}
+
+ObjectHolder LoadValue(const string& path, const Closure& classes) {
+    const MappedFile file(path);
+    Closure roots = SnapshotReader(file.Data(), classes, StoredAttributes::Skip).Read(VALUE_SOURCE_HASH);
+    const auto it = roots.find(VALUE_ROOT);
+    if (roots.size() != 1u || it == roots.end()) {
+        throw SnapshotError("Not a Mython value file: "s + path);
+    }
+    return it->second;
+}
+
+}  // namespace runtime
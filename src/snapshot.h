@@ -0,0 +1,61 @@
+#pragma once
+
+#include "runtime.h"
+
+#include <cstdint>
+#include <iosfwd>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace runtime {
+
+struct SnapshotError : std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
+// 64-битный хеш FNV-1a исходного текста, которым снимок привязывается к программе
+[[nodiscard]]
+uint64_t SourceHash(std::string_view source);
+
+/*
+ * Снимок кучи для тёплого старта.
+ *
+ * Сохраняются переменные globals и все достижимые из них объекты: Number, BigNumber, String, Bool,
+ * IntArray, экземпляры классов с полями, сами классы и функции. Каждый объект записывается один раз
+ * (карта идентичности «адрес - номер»), поэтому общие ссылки и циклы восстанавливаются как были.
+ * Классы записываются по имени вместе с атрибутами, функции - только по имени: их тела - синтаксические
+ * деревья, которые восстанавливает разбор той же программы. Прочие объекты сохранить нельзя - WriteSnapshot бросает SnapshotError.
+ *
+ * Формат двоичный, целые числа записываются в порядке байт платформы: снимок читается только
+ * сборкой для той же архитектуры.
+ * SaveSnapshot пишет объекты частями по мере обхода во временный файл и подменяет им path только
+ * после успешной записи, поэтому при ошибке старый снимок сохраняется.
+ */
+void WriteSnapshot(std::ostream& output, const Closure& globals, uint64_t source_hash);
+void SaveSnapshot(const std::string& path, const Closure& globals, uint64_t source_hash);
+
+/*
+ * Восстанавливает переменные из снимка. Классы и функции ищутся по имени в classes.
+ * Бросает SnapshotError, если снимок повреждён, сделан для другого исходного текста (source_hash)
+ * или ссылается на класс, которого нет в classes
+ */
+[[nodiscard]]
+Closure ReadSnapshot(std::string_view data, uint64_t source_hash, const Closure& classes);
+
+// Отображает файл в память и читает снимок прямо из отображения. Если файла нет, бросает SnapshotError
+[[nodiscard]]
+Closure LoadSnapshot(const std::string& path, uint64_t source_hash, const Closure& classes);
+
+/*
+ * Встроенные функции save(value, path) и load(path): value и всё, что достижимо из него через поля,
+ * сохраняется в формате снимка кучи, поэтому общие ссылки и циклы восстанавливаются как были.
+ * Файл значения не привязан к тексту программы: load ищет классы по имени в classes и бросает
+ * SnapshotError, если класса нет или файл повреждён. Атрибуты классов, записанные в файле,
+ * пропускаются: загрузка данных не меняет классы работающей программы
+ */
+void SaveValue(const std::string& path, const ObjectHolder& value);
+[[nodiscard]]
+ObjectHolder LoadValue(const std::string& path, const Closure& classes);
+
+}  // namespace runtime
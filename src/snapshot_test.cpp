@@ -0,0 +1,283 @@
+#include "int_array.h"
+#include "parse.h"
+#include "runtime.h"
+#include "snapshot.h"
+#include "test_runner_p.h"
+
+#include <cstdio>
+#include <sstream>
+#include <string>
+
+using namespace std;
+
+namespace runtime {
+
+namespace {
+
+const string PROLOGUE = R"(def twice(x):
+  return x * 2
+
+class Node:
+  def __init__(value):
+    self.value = value
+
+  def __str__():
+    return "Node " + str(self.value)
+
+class Table:
+  def __init__():
+    self.size = 0
+
+  def grow(n):
+    if n > 0:
+      self.size = self.size + 1
+      self.grow(n - 1)
+
+a = Node(1)
+b = Node(2)
+a.next = b
+b.next = a
+table = Table()
+table.grow(50)
+name = "prologue"
+big = 2000000000 * 3
+flag = a.value < b.value
+print "prologue ran"
+)"s;
+
+const string PROGRAM = PROLOGUE + "# @snapshot\n"s + R"(c = Node(3)
+c.next = a
+print c.next.next, table.size, name, big, flag, twice(table.size), twice
+)"s;
+
+string TempSnapshotPath() {
+    return "/tmp/mython_snapshot_test_"s + to_string(reinterpret_cast<uintptr_t>(&PROLOGUE)) + ".bin"s;
+}
+
+// Общие ссылки, циклы и классы восстанавливаются с той же структурой
+void TestSnapshotRoundTrip() {
+    Closure classes;
+    classes["Node"s] = ObjectHolder::Own(Class("Node"s, {}, nullptr));
+    Class& node_class = *classes.at("Node"s).TryAs<Class>();
+    Closure attributes;
+    attributes["limit"s] = ObjectHolder::Own(Number(10));
+    node_class.SetAttributes(std::move(attributes));
+
+    Closure globals;
+    ObjectHolder first = ObjectHolder::Own(ClassInstance(node_class));
+    ObjectHolder second = ObjectHolder::Own(ClassInstance(node_class));
+    first.TryAs<ClassInstance>()->Fields()["next"s] = second;
+    second.TryAs<ClassInstance>()->Fields()["next"s] = first;
+    second.TryAs<ClassInstance>()->Fields()["empty"s] = ObjectHolder::None();
+    globals["first"s] = first;
+    globals["alias"s] = second;
+    globals["cls"s] = classes.at("Node"s);
+    globals["text"s] = ObjectHolder::Own(String("hello"s));
+    globals["number"s] = ObjectHolder::Own(Number(-42));
+    globals["big"s] = ObjectHolder::Own(BigNumber(BigInt::FromString("123456789012345678901234567890"s)));
+    globals["yes"s] = ObjectHolder::Own(Bool(true));
+    globals["array"s] = ObjectHolder::Own(IntArray(vector<int64_t>{1, -2, INT64_MAX}));
+    globals["none"s] = ObjectHolder::None();
+
+    ostringstream out;
+    WriteSnapshot(out, globals, 7u);
+    // Атрибуты класса берутся из снимка, а не из разобранной программы
+    node_class.SetAttributes({});
+    Closure restored = ReadSnapshot(out.str(), 7u, classes);
+    ASSERT_EQUAL(node_class.Attributes().at("limit"s).TryAs<Number>()->GetValue(), 10);
+
+    ASSERT_EQUAL(restored.size(), globals.size());
+    ClassInstance* restored_first = restored.at("first"s).TryAs<ClassInstance>();
+    ASSERT(restored_first != nullptr);
+    ASSERT(restored_first != first.TryAs<ClassInstance>());
+    ASSERT_EQUAL(&restored_first->GetClass(), &node_class);
+    ASSERT_EQUAL(restored.at("alias"s).Get(), restored_first->Fields().at("next"s).Get());
+    ASSERT_EQUAL(restored.at("alias"s).TryAs<ClassInstance>()->Fields().at("next"s).Get(), static_cast<Object*>(restored_first));
+    ASSERT(!restored.at("alias"s).TryAs<ClassInstance>()->Fields().at("empty"s));
+    ASSERT_EQUAL(restored.at("cls"s).Get(), classes.at("Node"s).Get());
+    ASSERT_EQUAL(restored.at("text"s).TryAs<String>()->GetValue(), "hello"s);
+    ASSERT_EQUAL(restored.at("number"s).TryAs<Number>()->GetValue(), -42);
+    ASSERT_EQUAL(restored.at("big"s).TryAs<BigNumber>()->GetValue().ToString(), "123456789012345678901234567890"s);
+    ASSERT(restored.at("yes"s).TryAs<Bool>()->GetValue());
+    ASSERT(restored.at("array"s).TryAs<IntArray>()->Values() == (vector<int64_t>{1, -2, INT64_MAX}));
+    ASSERT(!restored.at("none"s));
+}
+
+void TestSnapshotRejectsMismatch() {
+    Closure classes;
+    classes["Node"s] = ObjectHolder::Own(Class("Node"s, {}, nullptr));
+    Closure globals;
+    globals["n"s] = ObjectHolder::Own(ClassInstance(*classes.at("Node"s).TryAs<Class>()));
+    ostringstream out;
+    WriteSnapshot(out, globals, SourceHash("prologue"s));
+    const string data = out.str();
+
+    auto expect_error = [](auto read) {
+        try {
+            read();
+            ASSERT(false);
+        }
+        catch (const SnapshotError&) {
+        }
+    };
+    expect_error([&] { [[maybe_unused]] Closure c = ReadSnapshot(data, SourceHash("prologue2"s), classes); });
+    expect_error([&] { [[maybe_unused]] Closure c = ReadSnapshot(data, SourceHash("prologue"s), Closure{}); });
+    expect_error([&] { [[maybe_unused]] Closure c = ReadSnapshot(data.substr(0, data.size() - 1u), SourceHash("prologue"s), classes); });
+    expect_error([&] { [[maybe_unused]] Closure c = ReadSnapshot("garbage"s, SourceHash("prologue"s), classes); });
+    expect_error([&] { [[maybe_unused]] Closure c = LoadSnapshot("/nonexistent/snapshot.bin"s, 0u, classes); });
+    ASSERT_EQUAL(ReadSnapshot(data, SourceHash("prologue"s), classes).size(), 1u);
+}
+
+// Второй запуск восстанавливает кучу из снимка, не выполняя пролог, и печатает то же самое
+void TestWarmStartMatchesColdRun() {
+    const string path = TempSnapshotPath();
+    std::remove(path.c_str());
+
+    DummyContext cold_context;
+    Closure cold_closure;
+    ASSERT(!ExecuteProgramWithSnapshot(PROGRAM, path, cold_closure, cold_context));
+    ASSERT_EQUAL(cold_context.output.str(), "prologue ran\nNode 2 50 prologue 6000000000 True 100 Function twice\n"s);
+
+    DummyContext warm_context;
+    Closure warm_closure;
+    ASSERT(ExecuteProgramWithSnapshot(PROGRAM, path, warm_closure, warm_context));
+    ASSERT_EQUAL(warm_context.output.str(), "Node 2 50 prologue 6000000000 True 100 Function twice\n"s);
+
+    // Основная часть может меняться, а правка пролога делает снимок недействительным
+    DummyContext other_context;
+    Closure other_closure;
+    ASSERT(ExecuteProgramWithSnapshot(PROLOGUE + "# @snapshot\nprint b.next\n"s, path, other_closure, other_context));
+    ASSERT_EQUAL(other_context.output.str(), "Node 1\n"s);
+    ASSERT(!ExecuteProgramWithSnapshot("x = 1\n"s + PROGRAM, path, other_closure, other_context));
+
+    std::remove(path.c_str());
+}
+
+// Буфер без позиционирования, как у канала: tellp возвращает -1
+class PipeBuffer : public std::stringbuf {
+protected:
+    pos_type seekoff([[maybe_unused]] off_type off, [[maybe_unused]] std::ios_base::seekdir dir, [[maybe_unused]] std::ios_base::openmode which) override {
+        return pos_type(off_type(-1));
+    }
+};
+
+// Снимок, записанный частями с дописыванием заголовка, совпадает с записанным одним куском
+void TestStreamingWriteMatchesBuffered() {
+    Closure classes;
+    classes["Node"s] = ObjectHolder::Own(Class("Node"s, {}, nullptr));
+    const Class& node_class = *classes.at("Node"s).TryAs<Class>();
+    // Список длиннее одной части записи
+    ObjectHolder head;
+    for (int i = 0; i < 5000; ++i) {
+        ObjectHolder node = ObjectHolder::Own(ClassInstance(node_class));
+        node.TryAs<ClassInstance>()->Fields()["value"s] = ObjectHolder::Own(String("item "s + to_string(i)));
+        node.TryAs<ClassInstance>()->Fields()["next"s] = head;
+        head = node;
+    }
+    Closure globals;
+    globals["head"s] = head;
+
+    ostringstream seekable;
+    seekable << "prefix"s;
+    WriteSnapshot(seekable, globals, 3u);
+    PipeBuffer pipe_buffer;
+    ostream pipe(&pipe_buffer);
+    WriteSnapshot(pipe, globals, 3u);
+    ASSERT(seekable.str().size() > 64u * 1024u);
+    ASSERT_EQUAL(seekable.str().substr(6u), pipe_buffer.str());
+
+    const Closure restored = ReadSnapshot(pipe_buffer.str(), 3u, classes);
+    size_t length = 0;
+    for (ObjectHolder node = restored.at("head"s); node; node = node.TryAs<ClassInstance>()->Fields().at("next"s)) {
+        ++length;
+    }
+    ASSERT_EQUAL(length, 5000u);
+}
+
+// Объект, который снимок сохранить не может
+struct Opaque : Object {
+    void Print(std::ostream& os, [[maybe_unused]] Context& context) override {
+        os << "Opaque"sv;
+    }
+};
+
+// Файл значения хранит один граф и не привязан к тексту программы
+void TestSaveLoadValue() {
+    Closure classes;
+    classes["Pair"s] = ObjectHolder::Own(Class("Pair"s, {}, nullptr));
+    const Class& pair_class = *classes.at("Pair"s).TryAs<Class>();
+    ObjectHolder root = ObjectHolder::Own(ClassInstance(pair_class));
+    ObjectHolder shared = ObjectHolder::Own(String("shared"s));
+    root.TryAs<ClassInstance>()->Fields()["left"s] = shared;
+    root.TryAs<ClassInstance>()->Fields()["right"s] = shared;
+    root.TryAs<ClassInstance>()->Fields()["self"s] = root;
+    root.TryAs<ClassInstance>()->Fields()["flag"s] = ObjectHolder::Own(Bool(false));
+
+    const string path = TempSnapshotPath() + ".value"s;
+    SaveValue(path, root);
+    ObjectHolder loaded = LoadValue(path, classes);
+    ClassInstance* instance = loaded.TryAs<ClassInstance>();
+    ASSERT(instance != nullptr);
+    ASSERT(&instance->GetClass() == &pair_class);
+    ASSERT(instance->Fields().at("left"s).Get() == instance->Fields().at("right"s).Get());
+    ASSERT_EQUAL(instance->Fields().at("left"s).TryAs<String>()->GetValue(), "shared"s);
+    ASSERT(instance->Fields().at("self"s).Get() == loaded.Get());
+    ASSERT(!IsTrue(instance->Fields().at("flag"s)));
+
+    SaveValue(path, ObjectHolder::None());
+    ASSERT(!LoadValue(path, classes));
+
+    // Снимок программы не читается как значение, неизвестный класс - ошибка
+    SaveSnapshot(path, Closure{{"x"s, ObjectHolder::Own(Number(1))}}, SourceHash("x = 1"s));
+    ASSERT_THROWS((void)LoadValue(path, classes), SnapshotError);
+    SaveValue(path, root);
+    ASSERT_THROWS((void)LoadValue(path, Closure{}), SnapshotError);
+
+    // Несохраняемый объект не портит уже записанный файл
+    std::remove(path.c_str());
+    SaveValue(path, ObjectHolder::Own(Number(7)));
+    ASSERT_THROWS(SaveValue(path, ObjectHolder::Own(Opaque{})), SnapshotError);
+    ASSERT_EQUAL(LoadValue(path, classes).TryAs<Number>()->GetValue(), 7);
+
+    instance->Fields()["self"s] = ObjectHolder::None();
+    root.TryAs<ClassInstance>()->Fields()["self"s] = ObjectHolder::None();
+    std::remove(path.c_str());
+}
+
+// Атрибуты класса, записанные в файле значения, не меняют одноимённый класс загружающей программы
+void TestLoadValueKeepsClassAttributes() {
+    Class writer_class("Config"s, {}, nullptr);
+    writer_class.SetAttributes(Closure{{"limit"s, ObjectHolder::Own(Number(1))}});
+    ObjectHolder root = ObjectHolder::Own(ClassInstance(writer_class));
+    root.TryAs<ClassInstance>()->Fields()["kind"s] = ObjectHolder::Share(writer_class);
+
+    const string path = TempSnapshotPath() + ".value"s;
+    SaveValue(path, root);
+
+    Closure classes;
+    classes["Config"s] = ObjectHolder::Own(Class("Config"s, {}, nullptr));
+    Class& live_class = *classes.at("Config"s).TryAs<Class>();
+    live_class.SetAttributes(Closure{{"limit"s, ObjectHolder::Own(Number(2))}});
+
+    ObjectHolder loaded = LoadValue(path, classes);
+    ClassInstance* instance = loaded.TryAs<ClassInstance>();
+    ASSERT(instance != nullptr);
+    ASSERT(&instance->GetClass() == &live_class);
+    ASSERT(instance->Fields().at("kind"s).Get() == &live_class);
+    ASSERT_EQUAL(live_class.Attributes().size(), 1u);
+    ASSERT_EQUAL(live_class.Attributes().at("limit"s).TryAs<Number>()->GetValue(), 2);
+    std::remove(path.c_str());
+}
+
+}  // namespace
+
+void RunSnapshotTests(TestRunner& tr) {
+    RUN_TEST(tr, runtime::TestSnapshotRoundTrip);
+    RUN_TEST(tr, runtime::TestSnapshotRejectsMismatch);
+    RUN_TEST(tr, runtime::TestWarmStartMatchesColdRun);
+    RUN_TEST(tr, runtime::TestStreamingWriteMatchesBuffered);
+    RUN_TEST(tr, runtime::TestSaveLoadValue);
+    RUN_TEST(tr, runtime::TestLoadValueKeepsClassAttributes);
+}
+
+}  // namespace runtime
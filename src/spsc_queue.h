@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace parse {
+
+/*
+ * Ограниченная очередь без блокировок для одного писателя и одного читателя.
+ *
+ * Элементы лежат в кольцевом буфере, ёмкость округляется вверх до степени двойки. Писатель продвигает
+ * только m_tail, читатель - только m_head, поэтому синхронизация сводится к паре атомарных
+ * загрузок и сохранений. Полная очередь блокирует Push, пустая - Pop: поток засыпает на
+ * std::atomic::wait до изменения индекса другой стороны, не занимая процессор.
+ *
+ * Close() ставит в очередь маркер конца: после того как читатель извлечёт все элементы, Pop
+ * возвращает false. Писатель не должен вызывать Push после Close.
+ */
+template <typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(size_t capacity) : m_slots(RoundUpToPowerOfTwo(capacity)), m_mask(m_slots.size() - 1u) {}
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // Вызывается только писателем
+    void Push(T value) {
+        Publish(std::optional<T>(std::move(value)));
+    }
+
+    // Вызывается только писателем
+    void Close() {
+        Publish(std::nullopt);
+    }
+
+    // Вызывается только читателем. Возвращает false, если очередь закрыта и все элементы извлечены
+    bool Pop(T& value) {
+        if (m_finished) {
+            return false;
+        }
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        size_t tail = m_tail.load(std::memory_order_acquire);
+        while (tail == head) {
+            m_tail.wait(tail, std::memory_order_acquire);
+            tail = m_tail.load(std::memory_order_acquire);
+        }
+        std::optional<T>& slot = m_slots[head & m_mask];
+        m_finished = !slot.has_value();
+        if (!m_finished) {
+            value = std::move(*slot);
+        }
+        slot.reset();
+        m_head.store(head + 1u, std::memory_order_release);
+        m_head.notify_one();
+        return !m_finished;
+    }
+
+    [[nodiscard]] size_t Capacity() const {
+        return m_slots.size();
+    }
+
+private:
+    static size_t RoundUpToPowerOfTwo(size_t value) {
+        size_t result = 1u;
+        while (result < value) {
+            result <<= 1u;
+        }
+        return result;
+    }
+
+    void Publish(std::optional<T> value) {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        size_t head = m_head.load(std::memory_order_acquire);
+        while (tail - head == m_slots.size()) {
+            m_head.wait(head, std::memory_order_acquire);
+            head = m_head.load(std::memory_order_acquire);
+        }
+        m_slots[tail & m_mask] = std::move(value);
+        m_tail.store(tail + 1u, std::memory_order_release);
+        m_tail.notify_one();
+    }
+
+    std::vector<std::optional<T>> m_slots;
+    const size_t m_mask;
+    // Индексы растут монотонно; писатель и читатель изменяют их в разных строках кэша
+    alignas(64) std::atomic<size_t> m_head{0u};
+    alignas(64) std::atomic<size_t> m_tail{0u};
+    // Состояние читателя: маркер конца уже извлечён
+    bool m_finished = false;
+};
+
+}  // namespace parse
@@ -0,0 +1,148 @@
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+/*
+ * Бенчмарк времени запуска интерпретатора: от создания процесса до первого байта вывода.
+ *
+ *   mython_startup_bench [--interpreter <путь>] [--runs <N>] [script.my]
+ *
+ * По умолчанию запускается исполняемый файл mython из того же каталога, что и бенчмарк,
+ * а если скрипт не указан, интерпретатору через стандартный ввод передаётся программа "print 1".
+ * Время отсчитывается от вызова fork и до момента, когда из канала вывода прочитан первый байт;
+ * оставшийся вывод дочитывается и в замер не входит.
+ */
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const char TRIVIAL_PROGRAM[] = "print 1\n";
+
+// Возвращает время до первого байта вывода в наносекундах или -1, если вывода не было
+int64_t MeasureOnce(const std::string& interpreter, const std::string& script) {
+    int out_fds[2];
+    int in_fds[2];
+    if (pipe(out_fds) != 0 || pipe(in_fds) != 0) {
+        throw std::runtime_error("pipe() failed"s);
+    }
+
+    const auto start = Clock::now();
+    const pid_t pid = fork();
+    if (pid < 0) {
+        throw std::runtime_error("fork() failed"s);
+    }
+    if (pid == 0) {
+        dup2(in_fds[0], STDIN_FILENO);
+        dup2(out_fds[1], STDOUT_FILENO);
+        close(in_fds[0]);
+        close(in_fds[1]);
+        close(out_fds[0]);
+        close(out_fds[1]);
+        if (script.empty()) {
+            execl(interpreter.c_str(), interpreter.c_str(), static_cast<char*>(nullptr));
+        }
+        else {
+            execl(interpreter.c_str(), interpreter.c_str(), script.c_str(), static_cast<char*>(nullptr));
+        }
+        _exit(127);
+    }
+
+    close(in_fds[0]);
+    close(out_fds[1]);
+    if (script.empty()) {
+        [[maybe_unused]] ssize_t written = write(in_fds[1], TRIVIAL_PROGRAM, sizeof(TRIVIAL_PROGRAM) - 1u);
+    }
+    close(in_fds[1]);
+
+    char buffer[4096];
+    int64_t elapsed_ns = -1;
+    if (read(out_fds[0], buffer, 1u) == 1) {
+        elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+    }
+    while (read(out_fds[0], buffer, sizeof(buffer)) > 0) {
+    }
+    close(out_fds[0]);
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        return -1;
+    }
+    return elapsed_ns;
+}
+
+// Разбирает text целиком как неотрицательное десятичное число
+bool ParseNonNegative(std::string_view text, size_t& value) {
+    const char* end = text.data() + text.size();
+    const auto [ptr, ec] = std::from_chars(text.data(), end, value);
+    return ec == std::errc{} && ptr == end;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    auto usage = [argv] {
+        std::cerr << "Usage: " << argv[0] << " [--interpreter <path>] [--runs <N>] [script.my]" << std::endl;
+        return 1;
+    };
+
+    std::string interpreter = (std::filesystem::path(argv[0]).parent_path() / "mython").string();
+    std::string script;
+    size_t runs = 50u;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (arg == "--interpreter"s && has_value) {
+            interpreter = argv[++i];
+        }
+        else if (arg == "--runs"s && has_value) {
+            if (!ParseNonNegative(argv[++i], runs)) {
+                return usage();
+            }
+            runs = std::max<size_t>(runs, 1u);
+        }
+        else if (!arg.empty() && arg[0] != '-') {
+            script = arg;
+        }
+        else {
+            return usage();
+        }
+    }
+
+    try {
+        std::vector<int64_t> times;
+        for (size_t run = 0; run < runs; ++run) {
+            const int64_t elapsed_ns = MeasureOnce(interpreter, script);
+            if (elapsed_ns < 0) {
+                std::cerr << interpreter << " failed or produced no output" << std::endl;
+                return 1;
+            }
+            times.push_back(elapsed_ns);
+        }
+        std::sort(times.begin(), times.end());
+        const auto at = [&times](double fraction) {
+            return times[static_cast<size_t>(fraction * (times.size() - 1u) + 0.5)] / 1e3;
+        };
+        std::cout << std::fixed << std::setprecision(1)
+                  << "startup_to_first_byte_us min " << at(0.0) << " median " << at(0.5) << " p95 " << at(0.95) << '\n';
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
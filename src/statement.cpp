@@ -1,8 +1,15 @@
 #include "statement.h"
+#include "feedback.h"
+#include "int_array.h"
 #include "lexer.h"
+#include "snapshot.h"
 #include "test_runner_p.h"
+#include "trace.h"
 
+#include <algorithm>
+#include <charconv>
 #include <iostream>
+#include <limits>
 #include <sstream>
 #include <utility>
 
@@ -14,54 +21,136 @@ using runtime::Closure;
 using runtime::Context;
 using runtime::ObjectHolder;
 
-VariableValue::VariableValue(const std::string& var_name) : m_id_seq{var_name} {
+namespace {
+
+std::vector<uint32_t> HashIds(const std::vector<std::string>& ids) {
+    std::vector<uint32_t> hashes;
+    hashes.reserve(ids.size());
+    for (const std::string& id : ids) {
+        hashes.push_back(Closure::Hash(id));
+    }
+    return hashes;
+}
+
+// Дописывает к out то, что напечатал бы value->Print. Строки, числа, Bool и None - без потока вывода
+void AppendPrinted(std::string& out, const ObjectHolder& value) {
+    if (!value) {
+        out += "None"sv;
+    }
+    else if (const auto* str = value.TryAs<runtime::String>()) {
+        out += str->GetValue();
+    }
+    else if (const auto* number = value.TryAs<runtime::Number>()) {
+        char digits[std::numeric_limits<int>::digits10 + 2];
+        const auto [end, ec] = std::to_chars(std::begin(digits), std::end(digits), number->GetValue());
+        out.append(digits, end);
+    }
+    else if (const auto* boolean = value.TryAs<runtime::Bool>()) {
+        out += boolean->GetValue() ? parse::token_const::TRUE : parse::token_const::FALSE;
+    }
+    else {
+        static runtime::DummyContext empty;
+        std::ostringstream ss;
+        value->Print(ss, empty);
+        out += ss.str();
+    }
+}
+
+// Дописывает к out результат str(value): у экземпляра с методом __str__ - значение, которое он вернул
+void AppendStr(std::string& out, ObjectHolder value, Context& context) {
+    if (auto* instance_ptr = value.TryAs<runtime::ClassInstance>()) {
+        if (instance_ptr->HasMethod(parse::token_const::STR_METHOD, 0)) {
+            value = instance_ptr->Call(parse::token_const::STR_METHOD, {}, context);
+        }
+    }
+    AppendPrinted(out, value);
+}
+
+// Путь к файлу в аргументе встроенной функции function
+const std::string& PathArgument(const ObjectHolder& path, std::string_view function) {
+    const runtime::String* str = path.TryAs<runtime::String>();
+    if (str == nullptr) {
+        throw std::runtime_error(std::string(function) + " path must be a string"s);
+    }
+    return str->GetValue();
+}
+
+// Конкатенация строк с буфером ровно под результат. lhs + rhs копирует lhs и дописывает rhs,
+// удваивая буфер, а String хранит перемещённую строку вместе с запасом
+ObjectHolder ConcatStrings(const std::string& lhs, const std::string& rhs) {
+    std::string result;
+    result.reserve(lhs.size() + rhs.size());
+    result += lhs;
+    result += rhs;
+    return ObjectHolder::Own(runtime::String(std::move(result)));
+}
+
+}  // namespace
+
+VariableValue::VariableValue(const std::string& var_name) : m_id_seq{var_name}, m_id_hashes{Closure::Hash(var_name)} {
     ASSERT_EQUAL(var_name.size() > 0u, true);
 }
 
-VariableValue::VariableValue(std::vector<std::string> dotted_ids) : m_id_seq(std::move(dotted_ids)) {
+VariableValue::VariableValue(std::vector<std::string> dotted_ids) : m_id_seq(std::move(dotted_ids)), m_id_hashes(HashIds(m_id_seq)) {
     ASSERT_EQUAL(m_id_seq.size() > 0u, true);
 }
 
 ObjectHolder VariableValue::Execute(Closure& closure, Context& context) {
-    if(!closure.count(m_id_seq[0])) {
+    auto it = closure.find(m_id_seq[0], m_id_hashes[0]);
+    if (it == closure.end()) {
         throw std::runtime_error("Closure doesn't have variable with name: "s + m_id_seq[0]);
     }
+    const ObjectHolder* value = &it->second;
+    const size_t sz = m_id_seq.size();
+    for (size_t i = 1u; i < sz; ++i) {
+        value = FindMember(*value, i);
+    }
+    return *value;
+}
 
-    const runtime::Closure* closure_ptr = &closure;
-    size_t i = 1u;
-    size_t sz = m_id_seq.size();
-    for(; i < sz; ++i) {
-        const std::string& id_name = m_id_seq[i - 1u];
-        runtime::ClassInstance* instance_ptr = closure_ptr->at(id_name).TryAs<runtime::ClassInstance>();
-        if(instance_ptr) {
-            closure_ptr = &instance_ptr->Fields();
-            continue;
+// Поле экземпляра, затем атрибут его класса или родителей. У самого класса - только атрибуты
+const ObjectHolder* VariableValue::FindMember(const ObjectHolder& object, size_t index) const {
+    const runtime::Class* cls = nullptr;
+    if (runtime::ClassInstance* instance_ptr = object.TryAs<runtime::ClassInstance>()) {
+        const Closure& fields = instance_ptr->Fields();
+        if (auto it = fields.find(m_id_seq[index], m_id_hashes[index]); it != fields.end()) {
+            return &it->second;
         }
-        ++i;
-        break;
+        cls = &instance_ptr->GetClass();
     }
-    if(i != sz) {
-        throw std::runtime_error("Closure doesn't have variable with name: "s + m_id_seq[i - 1u]);
+    else {
+        cls = object.TryAs<runtime::Class>();
+    }
+    if (cls != nullptr) {
+        if (const ObjectHolder* attribute = cls->FindAttribute(m_id_seq[index], m_id_hashes[index])) {
+            return attribute;
+        }
     }
-    return closure_ptr->at(m_id_seq[i - 1u]);
+    throw std::runtime_error("Closure doesn't have variable with name: "s + m_id_seq[index]);
 }
 
-Assignment::Assignment(std::string var, std::unique_ptr<runtime::Executable> rv) : m_var_to_assign(std::move(var)), m_stm_to_execute(std::move(rv)) {}
+Assignment::Assignment(std::string var, std::unique_ptr<runtime::Executable> rv) : m_var_to_assign(std::move(var)), m_var_hash(Closure::Hash(m_var_to_assign)), m_stm_to_execute(std::move(rv)) {}
 
 ObjectHolder Assignment::Execute(Closure& closure, Context& context) {
-    closure[m_var_to_assign] = m_stm_to_execute->Execute(closure, context);
-    return closure[m_var_to_assign];
+    ObjectHolder value = m_stm_to_execute->Execute(closure, context);
+    return closure.Subscript(m_var_to_assign, m_var_hash) = std::move(value);
 }
 
-FieldAssignment::FieldAssignment(VariableValue object, std::string field_name, std::unique_ptr<runtime::Executable> rv) : m_object_to_store(std::move(object)), m_field_name(std::move(field_name)), m_stm_to_execute(std::move(rv)) {
+FieldAssignment::FieldAssignment(VariableValue object, std::string field_name, std::unique_ptr<runtime::Executable> rv) : m_object_to_store(std::move(object)), m_field_name(std::move(field_name)), m_field_hash(Closure::Hash(m_field_name)), m_stm_to_execute(std::move(rv)) {
     ASSERT_EQUAL(m_field_name.size() > 0, true);
 }
 
 ObjectHolder FieldAssignment::Execute(Closure& closure, Context& context) {
     runtime::ObjectHolder var_to_store = m_object_to_store.Execute(closure, context);
     if(runtime::ClassInstance* instance_ptr = var_to_store.TryAs<runtime::ClassInstance>()) {
-        instance_ptr->Fields()[m_field_name] = m_stm_to_execute->Execute(closure, context);
-        return instance_ptr->Fields()[m_field_name];
+        ObjectHolder value = m_stm_to_execute->Execute(closure, context);
+        Closure& fields = instance_ptr->Fields();
+        const size_t field_count = fields.size();
+        ObjectHolder& field = fields.Subscript(m_field_name, m_field_hash);
+        if (fields.size() != field_count) {
+            instance_ptr->AccountFields();
+        }
+        return field = std::move(value);
     }
     return runtime::ObjectHolder::None();
 }
@@ -99,68 +188,197 @@ ObjectHolder Print::Execute(Closure& closure, Context& context) {
 
 MethodCall::MethodCall(std::unique_ptr<runtime::Executable> object, std::string method, std::vector<std::unique_ptr<runtime::Executable>> args) : m_object(std::move(object)), m_method(std::move(method)), m_args(std::move(args)) {}
 
+void MethodCall::SetFeedbackSite(uint32_t site) {
+    m_site = site;
+}
+
+void MethodCall::PrefillCache(const runtime::Class& cls) {
+    m_cached_class = &cls;
+    m_cached_method = cls.GetMethod(m_method);
+    m_cached_epoch = runtime::Class::MethodEpoch();
+}
+
+const runtime::Class* MethodCall::CachedClass() const {
+    return m_cached_class;
+}
+
 ObjectHolder MethodCall::Execute(Closure& closure, Context& context) {
     runtime::ObjectHolder class_instance_holder = m_object->Execute(closure, context);
-    if(runtime::ClassInstance* class_instance_ptr = class_instance_holder.TryAs<runtime::ClassInstance>()) {
-        std::vector<ObjectHolder> args_values;
-        args_values.reserve(m_args.size());
-        for (const std::unique_ptr<runtime::Executable>& arg_smt : m_args) {
-            args_values.push_back(arg_smt->Execute(closure, context));
-        }
-        return class_instance_ptr->Call(m_method, args_values, context);
+    runtime::ClassInstance* class_instance_ptr = class_instance_holder.TryAs<runtime::ClassInstance>();
+    runtime::IntArray* array_ptr = class_instance_ptr ? nullptr : class_instance_holder.TryAs<runtime::IntArray>();
+    if (!class_instance_ptr && !array_ptr) {
+        return {};
     }
-    return {};
+    std::vector<ObjectHolder> args_values;
+    args_values.reserve(m_args.size());
+    for (const std::unique_ptr<runtime::Executable>& arg_smt : m_args) {
+        args_values.push_back(arg_smt->Execute(closure, context));
+    }
+    if (array_ptr) {
+        return array_ptr->Call(m_method, args_values);
+    }
+    const runtime::Class& cls = class_instance_ptr->GetClass();
+    if (runtime::TypeFeedback* feedback = runtime::TypeFeedback::Recording(); feedback != nullptr && m_site != 0u) {
+        feedback->RecordReceiver(m_site, cls);
+    }
+    if (&cls != m_cached_class || m_cached_epoch != runtime::Class::MethodEpoch()) {
+        m_cached_class = &cls;
+        m_cached_method = cls.GetMethod(m_method);
+        m_cached_epoch = runtime::Class::MethodEpoch();
+    }
+    if (m_cached_method == nullptr || m_cached_method->formal_params.size() != args_values.size()) {
+        throw std::runtime_error("Class does not have a method named as "s + m_method);
+    }
+    return class_instance_ptr->Call(*m_cached_method, args_values, context);
 }
 
-NewInstance::NewInstance(const runtime::Class& class_) : m_instance(class_) {}
+NewInstance::NewInstance(const runtime::Class& class_) : m_class(class_) {}
 
-NewInstance::NewInstance(const runtime::Class& class_, std::vector<std::unique_ptr<runtime::Executable>> args) : m_instance(class_), m_ctx_args(std::move(args)) {}
+NewInstance::NewInstance(const runtime::Class& class_, std::vector<std::unique_ptr<runtime::Executable>> args) : m_class(class_), m_ctx_args(std::move(args)) {}
 
 ObjectHolder NewInstance::Execute(Closure& closure, Context& context) {
-    if(m_instance.HasMethod(parse::token_const::INIT_METHOD, m_ctx_args.size())) {
+    MYTHON_TRACE1(instance__new, m_class.GetName().c_str());
+    ObjectHolder instance_holder = ObjectHolder::Own(runtime::ClassInstance(m_class));
+    runtime::ClassInstance* instance_ptr = instance_holder.TryAs<runtime::ClassInstance>();
+    if(instance_ptr->HasMethod(parse::token_const::INIT_METHOD, m_ctx_args.size())) {
         std::vector<ObjectHolder> args_values;
         args_values.reserve(m_ctx_args.size());
         for (const std::unique_ptr<runtime::Executable>& arg_smt : m_ctx_args) {
             args_values.push_back(arg_smt->Execute(closure, context));
         }
-        m_instance.Call(parse::token_const::INIT_METHOD, args_values, context);
+        instance_ptr->Call(parse::token_const::INIT_METHOD, args_values, context);
+    }
+    return instance_holder;
+}
+
+
+FunctionCall::FunctionCall(const runtime::Function& function, std::vector<std::unique_ptr<runtime::Executable>> args) : m_function(function), m_args(std::move(args)), m_param_hashes(HashIds(function.GetFormalParams())) {
+    ASSERT_EQUAL(m_args.size(), m_param_hashes.size());
+}
+
+ObjectHolder FunctionCall::Execute(Closure& closure, Context& context) {
+    const std::vector<std::string>& params = m_function.GetFormalParams();
+    runtime::LocalClosure locals;
+    for (size_t i = 0; i < m_args.size(); ++i) {
+        locals.Get().Subscript(params[i], m_param_hashes[i]) = m_args[i]->Execute(closure, context);
     }
-    return runtime::ObjectHolder::Share(m_instance);
+    return m_function.Call(locals.Get(), context);
 }
 
+NewIntArray::NewIntArray(std::vector<std::unique_ptr<runtime::Executable>> args) : m_args(std::move(args)) {}
+
+ObjectHolder NewIntArray::Execute(Closure& closure, Context& context) {
+    runtime::BigInt size, value;
+    if (!runtime::TryGetInteger(m_args[0]->Execute(closure, context), size) || size.IsNegative() || !size.FitsInt64()) {
+        throw std::runtime_error("IntArray size must be a non-negative integer"s);
+    }
+    if (m_args.size() > 1u && (!runtime::TryGetInteger(m_args[1]->Execute(closure, context), value) || !value.FitsInt64())) {
+        throw std::runtime_error("IntArray value must be an integer"s);
+    }
+    return ObjectHolder::Own(runtime::IntArray(static_cast<size_t>(size.ToInt64()), value.ToInt64()));
+}
+
+ObjectHolder Copy::Execute(Closure& closure, Context& context) {
+    const ObjectHolder value = m_arg->Execute(closure, context);
+    return m_deep ? runtime::DeepCopy(value) : runtime::ShallowCopy(value);
+}
+
+Save::Save(std::unique_ptr<runtime::Executable> value, std::unique_ptr<runtime::Executable> path) : m_value(std::move(value)), m_path(std::move(path)) {}
+
+ObjectHolder Save::Execute(Closure& closure, Context& context) {
+    const ObjectHolder value = m_value->Execute(closure, context);
+    runtime::SaveValue(PathArgument(m_path->Execute(closure, context), "save"sv), value);
+    return {};
+}
+
+void Load::SetClasses(Closure classes) {
+    m_classes = std::move(classes);
+}
+
+ObjectHolder Load::Execute(Closure& closure, Context& context) {
+    return runtime::LoadValue(PathArgument(m_arg->Execute(closure, context), "load"sv), m_classes);
+}
 
 ObjectHolder Stringify::Execute(Closure& closure, Context& context) {
-    ObjectHolder value_holder = m_arg->Execute(closure, context);
-    if (auto* instance_ptr = value_holder.TryAs<runtime::ClassInstance>()) {
-        if (instance_ptr->HasMethod(parse::token_const::STR_METHOD, 0)) {
-            value_holder = instance_ptr->Call(parse::token_const::STR_METHOD, {}, context);
-        }
+    std::string value;
+    AppendStr(value, m_arg->Execute(closure, context), context);
+    return ObjectHolder::Own(runtime::String(std::move(value)));
+}
+
+FormatString::FormatString(std::vector<std::string> literals, std::vector<std::unique_ptr<runtime::Executable>> slots) : m_literals(std::move(literals)), m_slots(std::move(slots)) {
+    ASSERT_EQUAL(m_literals.size(), m_slots.size() + 1u);
+    for (const std::string& literal : m_literals) {
+        m_literal_bytes += literal.size();
     }
-    std::string value("None"s);
-    if (value_holder) {
-        static runtime::DummyContext empty;
-        std::stringstream ss;
-        value_holder->Print(ss, empty);
-        value = ss.str();
+    m_size_hint = m_literal_bytes;
+}
+
+ObjectHolder FormatString::Execute(Closure& closure, Context& context) {
+    std::string result;
+    result.reserve(m_size_hint);
+    result += m_literals.front();
+    for (size_t i = 0; i < m_slots.size(); ++i) {
+        AppendStr(result, m_slots[i]->Execute(closure, context), context);
+        result += m_literals[i + 1u];
+    }
+    // Следующее выполнение той же строки скорее всего даст результат того же размера
+    m_size_hint = std::max(m_literal_bytes, result.size());
+    return ObjectHolder::Own(runtime::String(std::move(result)));
+}
+
+void BinaryOperation::SetFeedbackSite(uint32_t site, uint8_t lhs_hint) {
+    m_site = site;
+    m_lhs_hint = lhs_hint;
+}
+
+void BinaryOperation::RecordOperands(const ObjectHolder& lhs, const ObjectHolder& rhs) const {
+    if (runtime::TypeFeedback* feedback = runtime::TypeFeedback::Recording(); feedback != nullptr && m_site != 0u) {
+        feedback->RecordOperands(m_site, lhs, rhs);
     }
-    return ObjectHolder::Own(runtime::String(value));
 }
 
 ObjectHolder Add::Execute(Closure& closure, Context& context) {
     ObjectHolder lhs_value_holder = m_lhs_stm->Execute(closure, context);
     ObjectHolder rhs_value_holder = m_rhs_stm->Execute(closure, context);
+    RecordOperands(lhs_value_holder, rhs_value_holder);
+
+    // Варианты взаимоисключающие, поэтому подсказка профиля меняет только порядок проверок
+    if (m_lhs_hint == runtime::TypeFeedback::KIND_INSTANCE) {
+        if (runtime::ClassInstance* lhs_instance = lhs_value_holder.TryAs<runtime::ClassInstance>()) {
+            return lhs_instance->Call(parse::token_const::ADD_METHOD, { rhs_value_holder }, context);
+        }
+    }
+    else if (m_lhs_hint == runtime::TypeFeedback::KIND_STRING) {
+        if (runtime::String* lhs_str_ptr = lhs_value_holder.TryAs<runtime::String>()) {
+            if (runtime::String* rhs_str_ptr = rhs_value_holder.TryAs<runtime::String>()) {
+                return ConcatStrings(lhs_str_ptr->GetValue(), rhs_str_ptr->GetValue());
+            }
+        }
+    }
 
     if (runtime::Number* lhs_num_ptr = lhs_value_holder.TryAs<runtime::Number>()) {
         if(runtime::Number* rhs_num_ptr = rhs_value_holder.TryAs<runtime::Number>()) {
-            return ObjectHolder::Own(runtime::Number(lhs_num_ptr->GetValue() + rhs_num_ptr->GetValue()));
+            int result;
+            if (!__builtin_add_overflow(lhs_num_ptr->GetValue(), rhs_num_ptr->GetValue(), &result)) {
+                return ObjectHolder::Own(runtime::Number(result));
+            }
+            return runtime::MakeInteger(runtime::BigInt(lhs_num_ptr->GetValue()) + runtime::BigInt(rhs_num_ptr->GetValue()));
         }
     }
 
+    if (runtime::BigInt lhs_value, rhs_value; runtime::TryGetInteger(lhs_value_holder, lhs_value) && runtime::TryGetInteger(rhs_value_holder, rhs_value)) {
+        return runtime::MakeInteger(lhs_value + rhs_value);
+    }
+
     if (runtime::String* lhs_str_ptr = lhs_value_holder.TryAs<runtime::String>()) {
         if(runtime::String* rhs_str_ptr = rhs_value_holder.TryAs<runtime::String>()) {
-            return ObjectHolder::Own(runtime::String(lhs_str_ptr->GetValue() + rhs_str_ptr->GetValue()));
+            return ConcatStrings(lhs_str_ptr->GetValue(), rhs_str_ptr->GetValue());
         }
     }
+    if (ObjectHolder result; runtime::TryArrayOperation(runtime::ArrayOp::Add, lhs_value_holder, rhs_value_holder, result)) {
+        return result;
+    }
+
     if (runtime::ClassInstance* lhs_instance = lhs_value_holder.TryAs<runtime::ClassInstance>()) {
         return lhs_instance->Call(parse::token_const::ADD_METHOD, { rhs_value_holder }, context);
     }
@@ -170,13 +388,32 @@ ObjectHolder Add::Execute(Closure& closure, Context& context) {
 ObjectHolder Sub::Execute(Closure& closure, Context& context) {
     ObjectHolder lhs_value_holder = m_lhs_stm->Execute(closure, context);
     ObjectHolder rhs_value_holder = m_rhs_stm->Execute(closure, context);
+    RecordOperands(lhs_value_holder, rhs_value_holder);
+
+    if (m_lhs_hint == runtime::TypeFeedback::KIND_INSTANCE) {
+        if (runtime::ClassInstance* lhs_instance = lhs_value_holder.TryAs<runtime::ClassInstance>()) {
+            return lhs_instance->Call(parse::token_const::SUB_METHOD, { rhs_value_holder }, context);
+        }
+    }
 
     if (runtime::Number* lhs_num_ptr = lhs_value_holder.TryAs<runtime::Number>()) {
         if(runtime::Number* rhs_num_ptr = rhs_value_holder.TryAs<runtime::Number>()) {
-            return ObjectHolder::Own(runtime::Number(lhs_num_ptr->GetValue() - rhs_num_ptr->GetValue()));
+            int result;
+            if (!__builtin_sub_overflow(lhs_num_ptr->GetValue(), rhs_num_ptr->GetValue(), &result)) {
+                return ObjectHolder::Own(runtime::Number(result));
+            }
+            return runtime::MakeInteger(runtime::BigInt(lhs_num_ptr->GetValue()) - runtime::BigInt(rhs_num_ptr->GetValue()));
         }
     }
 
+    if (runtime::BigInt lhs_value, rhs_value; runtime::TryGetInteger(lhs_value_holder, lhs_value) && runtime::TryGetInteger(rhs_value_holder, rhs_value)) {
+        return runtime::MakeInteger(lhs_value - rhs_value);
+    }
+
+    if (ObjectHolder result; runtime::TryArrayOperation(runtime::ArrayOp::Sub, lhs_value_holder, rhs_value_holder, result)) {
+        return result;
+    }
+
     if (runtime::ClassInstance* lhs_instance = lhs_value_holder.TryAs<runtime::ClassInstance>()) {
         return lhs_instance->Call(parse::token_const::SUB_METHOD, { rhs_value_holder }, context);
     }
@@ -186,13 +423,32 @@ ObjectHolder Sub::Execute(Closure& closure, Context& context) {
 ObjectHolder Mult::Execute(Closure& closure, Context& context) {
     ObjectHolder lhs_value_holder = m_lhs_stm->Execute(closure, context);
     ObjectHolder rhs_value_holder = m_rhs_stm->Execute(closure, context);
+    RecordOperands(lhs_value_holder, rhs_value_holder);
+
+    if (m_lhs_hint == runtime::TypeFeedback::KIND_INSTANCE) {
+        if (runtime::ClassInstance* lhs_instance = lhs_value_holder.TryAs<runtime::ClassInstance>()) {
+            return lhs_instance->Call(parse::token_const::MUL_METHOD, { rhs_value_holder }, context);
+        }
+    }
 
     if (runtime::Number* lhs_num_ptr = lhs_value_holder.TryAs<runtime::Number>()) {
         if(runtime::Number* rhs_num_ptr = rhs_value_holder.TryAs<runtime::Number>()) {
-            return ObjectHolder::Own(runtime::Number(lhs_num_ptr->GetValue() * rhs_num_ptr->GetValue()));
+            int result;
+            if (!__builtin_mul_overflow(lhs_num_ptr->GetValue(), rhs_num_ptr->GetValue(), &result)) {
+                return ObjectHolder::Own(runtime::Number(result));
+            }
+            return runtime::MakeInteger(runtime::BigInt(lhs_num_ptr->GetValue()) * runtime::BigInt(rhs_num_ptr->GetValue()));
         }
     }
 
+    if (runtime::BigInt lhs_value, rhs_value; runtime::TryGetInteger(lhs_value_holder, lhs_value) && runtime::TryGetInteger(rhs_value_holder, rhs_value)) {
+        return runtime::MakeInteger(lhs_value * rhs_value);
+    }
+
+    if (ObjectHolder result; runtime::TryArrayOperation(runtime::ArrayOp::Mul, lhs_value_holder, rhs_value_holder, result)) {
+        return result;
+    }
+
     if (runtime::ClassInstance* lhs_instance = lhs_value_holder.TryAs<runtime::ClassInstance>()) {
         return lhs_instance->Call(parse::token_const::MUL_METHOD, { rhs_value_holder }, context);
     }
@@ -202,13 +458,32 @@ ObjectHolder Mult::Execute(Closure& closure, Context& context) {
 ObjectHolder Div::Execute(Closure& closure, Context& context) {
     ObjectHolder lhs_value_holder = m_lhs_stm->Execute(closure, context);
     ObjectHolder rhs_value_holder = m_rhs_stm->Execute(closure, context);
+    RecordOperands(lhs_value_holder, rhs_value_holder);
+
+    if (m_lhs_hint == runtime::TypeFeedback::KIND_INSTANCE) {
+        if (runtime::ClassInstance* lhs_instance = lhs_value_holder.TryAs<runtime::ClassInstance>()) {
+            return lhs_instance->Call(parse::token_const::DIV_METHOD, { rhs_value_holder }, context);
+        }
+    }
 
     if (runtime::Number* lhs_num_ptr = lhs_value_holder.TryAs<runtime::Number>()) {
         if(runtime::Number* rhs_num_ptr = rhs_value_holder.TryAs<runtime::Number>()) {
-            return ObjectHolder::Own(runtime::Number(lhs_num_ptr->GetValue() / rhs_num_ptr->GetValue()));
+            const int lhs = lhs_num_ptr->GetValue();
+            const int rhs = rhs_num_ptr->GetValue();
+            if (rhs == 0) {
+                throw std::runtime_error("Division by zero"s);
+            }
+            if (lhs == std::numeric_limits<int>::min() && rhs == -1) {
+                return runtime::MakeInteger(-runtime::BigInt(lhs));
+            }
+            return ObjectHolder::Own(runtime::Number(lhs / rhs));
         }
     }
 
+    if (runtime::BigInt lhs_value, rhs_value; runtime::TryGetInteger(lhs_value_holder, lhs_value) && runtime::TryGetInteger(rhs_value_holder, rhs_value)) {
+        return runtime::MakeInteger(lhs_value / rhs_value);
+    }
+
     if (runtime::ClassInstance* lhs_instance = lhs_value_holder.TryAs<runtime::ClassInstance>()) {
         return lhs_instance->Call(parse::token_const::DIV_METHOD, { rhs_value_holder }, context);
     }
@@ -295,24 +570,42 @@ ObjectHolder Return::Execute(Closure& closure, Context& context) {
 
 ClassDefinition::ClassDefinition(ObjectHolder cls) : m_class(cls) {}
 
+ClassDefinition::ClassDefinition(ObjectHolder cls, std::vector<std::pair<std::string, std::unique_ptr<runtime::Executable>>> attributes) : m_class(cls), m_attributes(std::move(attributes)) {}
+
 ObjectHolder ClassDefinition::Execute(Closure& closure, Context& context) {
     runtime::Class* ptr_cls = m_class.TryAs<runtime::Class>();
+    // Значения вычисляются до изменения класса: при ошибке у класса остаются прежние атрибуты
+    Closure attributes;
+    for (const auto& [name, value] : m_attributes) {
+        attributes[name] = value->Execute(closure, context);
+    }
+    ptr_cls->SetAttributes(std::move(attributes));
     closure.emplace(ptr_cls->GetName(), m_class);
     return {};
 }
 
+FunctionDefinition::FunctionDefinition(ObjectHolder function) : m_function(std::move(function)) {}
+
+ObjectHolder FunctionDefinition::Execute(Closure& closure, [[maybe_unused]] Context& context) {
+    closure.emplace(m_function.TryAs<runtime::Function>()->GetName(), m_function);
+    return {};
+}
+
 IfElse::IfElse(std::unique_ptr<runtime::Executable> condition,
                std::unique_ptr<runtime::Executable> if_body,
-               std::unique_ptr<runtime::Executable> else_body) : m_condition(std::move(condition))
-                                                               , m_if_body(std::move(if_body))
-                                                               , m_else_body(std::move(else_body)) {}
+               std::unique_ptr<runtime::Executable> else_body) : m_else_body(std::move(else_body)) {
+    m_arms.emplace_back(std::move(condition), std::move(if_body));
+}
+
+IfElse::IfElse(std::vector<Arm> arms, std::unique_ptr<runtime::Executable> else_body) : m_arms(std::move(arms)), m_else_body(std::move(else_body)) {}
 
 ObjectHolder IfElse::Execute(Closure& closure, Context& context) {
-    ObjectHolder result_holder = m_condition->Execute(closure, context);
-    if (runtime::IsTrue(result_holder)) {
-        return m_if_body->Execute(closure, context);
+    for (const auto& [condition, body] : m_arms) {
+        if (runtime::IsTrue(condition->Execute(closure, context))) {
+            return body->Execute(closure, context);
+        }
     }
-    
+
     if (m_else_body) {
         return m_else_body->Execute(closure, context);
     }
@@ -320,6 +613,76 @@ ObjectHolder IfElse::Execute(Closure& closure, Context& context) {
     return {};
 }
 
+ObjectHolder IfElse::ExecuteBranch(size_t index, Closure& closure, Context& context) {
+    if (index < m_arms.size()) {
+        return m_arms[index].second->Execute(closure, context);
+    }
+    if (m_else_body) {
+        return m_else_body->Execute(closure, context);
+    }
+    return {};
+}
+
+Switch::Switch(std::unique_ptr<VariableValue> subject, const std::vector<ObjectHolder>& keys, std::unique_ptr<IfElse> chain) : m_subject(std::move(subject)), m_chain(std::move(chain)) {
+    ASSERT_EQUAL(keys.size(), m_chain->ArmCount());
+    m_string_keys = !keys.empty() && keys.front().TryAs<runtime::String>() != nullptr;
+    if (m_string_keys) {
+        m_strings.reserve(keys.size());
+        for (size_t i = 0; i < keys.size(); ++i) {
+            m_strings.emplace(keys[i].TryAs<runtime::String>()->GetValue(), static_cast<uint32_t>(i));
+        }
+        return;
+    }
+
+    int64_t min_key = std::numeric_limits<int64_t>::max();
+    int64_t max_key = std::numeric_limits<int64_t>::min();
+    for (const ObjectHolder& key : keys) {
+        const int value = key.TryAs<runtime::Number>()->GetValue();
+        min_key = std::min<int64_t>(min_key, value);
+        max_key = std::max<int64_t>(max_key, value);
+    }
+    // Плотная таблица допускается, пока пропуски занимают не больше половины её ячеек
+    if (!keys.empty() && max_key - min_key < static_cast<int64_t>(keys.size()) * 2) {
+        m_dense_base = static_cast<int>(min_key);
+        m_dense.assign(static_cast<size_t>(max_key - min_key + 1), static_cast<uint32_t>(keys.size()));
+        for (size_t i = keys.size(); i-- > 0;) {
+            m_dense[static_cast<size_t>(keys[i].TryAs<runtime::Number>()->GetValue() - min_key)] = static_cast<uint32_t>(i);
+        }
+        return;
+    }
+    m_numbers.reserve(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        m_numbers.emplace(keys[i].TryAs<runtime::Number>()->GetValue(), static_cast<uint32_t>(i));
+    }
+}
+
+size_t Switch::FindNumber(int value) const {
+    if (!m_dense.empty()) {
+        const int64_t offset = static_cast<int64_t>(value) - m_dense_base;
+        return offset >= 0 && offset < static_cast<int64_t>(m_dense.size()) ? m_dense[static_cast<size_t>(offset)] : m_chain->ArmCount();
+    }
+    const auto it = m_numbers.find(value);
+    return it != m_numbers.end() ? it->second : m_chain->ArmCount();
+}
+
+size_t Switch::FindString(const std::string& value) const {
+    const auto it = m_strings.find(value);
+    return it != m_strings.end() ? it->second : m_chain->ArmCount();
+}
+
+ObjectHolder Switch::Execute(Closure& closure, Context& context) {
+    const ObjectHolder value = m_subject->Execute(closure, context);
+    if (m_string_keys) {
+        if (const runtime::String* str = value.TryAs<runtime::String>()) {
+            return m_chain->ExecuteBranch(FindString(str->GetValue()), closure, context);
+        }
+    }
+    else if (const runtime::Number* number = value.TryAs<runtime::Number>()) {
+        return m_chain->ExecuteBranch(FindNumber(number->GetValue()), closure, context);
+    }
+    return m_chain->Execute(closure, context);
+}
+
 Comparison::Comparison(Comparator cmp,
                        unique_ptr<runtime::Executable> lhs,
                        unique_ptr<runtime::Executable> rhs) : BinaryOperation(std::move(lhs), std::move(rhs))
@@ -328,10 +691,25 @@ Comparison::Comparison(Comparator cmp,
 ObjectHolder Comparison::Execute(Closure& closure, Context& context) {
     ObjectHolder lhs_value_holder = m_lhs_stm->Execute(closure, context);
     ObjectHolder rhs_value_holder = m_rhs_stm->Execute(closure, context);
+    RecordOperands(lhs_value_holder, rhs_value_holder);
     if(m_comparator(lhs_value_holder, rhs_value_holder, context)) {
         return runtime::obj_const::OBJECT_HOLDER_TRUE;
     }
     return runtime::obj_const::OBJECT_HOLDER_FALSE;
 }
 
+Identity::Identity(std::unique_ptr<runtime::Executable> lhs, std::unique_ptr<runtime::Executable> rhs, bool negated) : BinaryOperation(std::move(lhs), std::move(rhs)), m_negated(negated) {}
+
+ObjectHolder Identity::Execute(Closure& closure, Context& context) {
+    const ObjectHolder lhs_value_holder = m_lhs_stm->Execute(closure, context);
+    const ObjectHolder rhs_value_holder = m_rhs_stm->Execute(closure, context);
+    bool same = lhs_value_holder.Get() == rhs_value_holder.Get();
+    if (!same && lhs_value_holder && rhs_value_holder) {
+        const runtime::Bool* lhs_bool = lhs_value_holder.TryAs<runtime::Bool>();
+        const runtime::Bool* rhs_bool = lhs_bool ? rhs_value_holder.TryAs<runtime::Bool>() : nullptr;
+        same = rhs_bool != nullptr && lhs_bool->GetValue() == rhs_bool->GetValue();
+    }
+    return same != m_negated ? runtime::obj_const::OBJECT_HOLDER_TRUE : runtime::obj_const::OBJECT_HOLDER_FALSE;
+}
+
 }  // namespace ast
\ No newline at end of file
@@ -2,9 +2,11 @@
 
 #include "runtime.h"
 
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -23,21 +25,29 @@ private:
 };
 
 // Выражение, возвращающее значение типа T,
-// используется как основа для создания констант
+// используется как основа для создания констант.
+// Значение создаётся один раз при разборе и разделяется всеми результатами выполнения: оно переживает
+// само выражение, поэтому переменные, которым присвоена константа, остаются корректными и после
+// освобождения синтаксического дерева (см. ExecuteProgramStreaming)
 template <typename T>
 class ValueStatement : public runtime::Executable {
 public:
-    explicit ValueStatement(T v) : m_value(std::move(v)) {}
+    explicit ValueStatement(T v) : m_value(runtime::ObjectHolder::Own(std::move(v))) {}
 
-    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override {
-        return runtime::ObjectHolder::Share(m_value);
+    runtime::ObjectHolder Execute([[maybe_unused]] runtime::Closure& closure, [[maybe_unused]] runtime::Context& context) override {
+        return m_value;
+    }
+
+    [[nodiscard]] const runtime::ObjectHolder& GetValue() const {
+        return m_value;
     }
 
 private:
-    T m_value;
+    runtime::ObjectHolder m_value;
 };
 
 using NumericConst = ValueStatement<runtime::Number>;
+using BigNumericConst = ValueStatement<runtime::BigNumber>;
 using StringConst = ValueStatement<runtime::String>;
 using BoolConst = ValueStatement<runtime::Bool>;
 
@@ -53,8 +63,16 @@ public:
 
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 
+    [[nodiscard]] const std::vector<std::string>& GetDottedIds() const {
+        return m_id_seq;
+    }
+
 private:
+    const runtime::ObjectHolder* FindMember(const runtime::ObjectHolder& object, size_t index) const;
+
     std::vector<std::string> m_id_seq;
+    // Хеши имён из m_id_seq, вычисленные при разборе, чтобы не хешировать строки при каждом выполнении
+    std::vector<uint32_t> m_id_hashes;
 };
 
 // Присваивает переменной, имя которой задано в параметре var, значение выражения rv
@@ -66,6 +84,7 @@ public:
 
 private:
     std::string m_var_to_assign;
+    uint32_t m_var_hash;
     std::unique_ptr<runtime::Executable> m_stm_to_execute;
 };
 
@@ -79,6 +98,7 @@ public:
 private:
     VariableValue m_object_to_store;
     std::string m_field_name;
+    uint32_t m_field_hash;
     std::unique_ptr<runtime::Executable> m_stm_to_execute;
 };
 
@@ -116,10 +136,24 @@ public:
 
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 
+    // Номер точки наблюдения в профиле runtime::TypeFeedback; 0 - точка не наблюдается
+    void SetFeedbackSite(uint32_t site);
+
+    // Заранее заполняет кэш поиска метода для получателя класса cls (по профилю прошлого запуска)
+    void PrefillCache(const runtime::Class& cls);
+
+    [[nodiscard]] const runtime::Class* CachedClass() const;
+
 private:
     std::unique_ptr<runtime::Executable> m_object;
     std::string m_method;
     std::vector<std::unique_ptr<runtime::Executable>> m_args;
+    // Кэш поиска метода: класс последнего получателя, найденный у него метод и поколение методов
+    // (runtime::Class::MethodEpoch) на момент поиска
+    const runtime::Class* m_cached_class = nullptr;
+    const runtime::Method* m_cached_method = nullptr;
+    uint64_t m_cached_epoch = 0u;
+    uint32_t m_site = 0u;
 };
 
 /*
@@ -144,10 +178,38 @@ public:
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 
 private:
-    runtime::ClassInstance m_instance;
+    const runtime::Class& m_class;
     std::vector<std::unique_ptr<runtime::Executable>> m_ctx_args;
 };
 
+/*
+ * Вызов функции верхнего уровня, найденной при разборе. Значения аргументов записываются прямо
+ * в локальное окружение вызова по хешам имён параметров, вычисленным при разборе.
+ * Число аргументов проверяет Parser
+ */
+class FunctionCall : public runtime::Executable {
+public:
+    FunctionCall(const runtime::Function& function, std::vector<std::unique_ptr<runtime::Executable>> args);
+
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+private:
+    const runtime::Function& m_function;
+    std::vector<std::unique_ptr<runtime::Executable>> m_args;
+    std::vector<uint32_t> m_param_hashes;
+};
+
+// Создаёт IntArray заданной длины: IntArray(size) заполняет его нулями, IntArray(size, value) - значением value
+class NewIntArray : public runtime::Executable {
+public:
+    explicit NewIntArray(std::vector<std::unique_ptr<runtime::Executable>> args);
+
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+private:
+    std::vector<std::unique_ptr<runtime::Executable>> m_args;
+};
+
 // Базовый класс для унарных операций
 class UnaryOperation : public runtime::Executable {
 public:
@@ -164,14 +226,81 @@ public:
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 };
 
+// Встроенные функции copy и deepcopy (см. runtime::ShallowCopy и runtime::DeepCopy)
+class Copy : public UnaryOperation {
+public:
+    Copy(std::unique_ptr<runtime::Executable> argument, bool deep) : UnaryOperation(std::move(argument)), m_deep(deep) {}
+
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+private:
+    bool m_deep;
+};
+
+// Встроенная функция save(value, path): сохраняет граф объектов value в файл path (см. runtime::SaveValue)
+class Save : public runtime::Executable {
+public:
+    Save(std::unique_ptr<runtime::Executable> value, std::unique_ptr<runtime::Executable> path);
+
+    // Возвращает None. Бросает runtime_error, если path - не строка
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+private:
+    std::unique_ptr<runtime::Executable> m_value;
+    std::unique_ptr<runtime::Executable> m_path;
+};
+
+// Встроенная функция load(path): восстанавливает граф объектов, сохранённый save (см. runtime::LoadValue)
+class Load : public UnaryOperation {
+public:
+    using UnaryOperation::UnaryOperation;
+
+    // Классы программы, по именам которых восстанавливаются экземпляры. Parser передаёт объявленные
+    // к моменту разбора вызова классы и обновляет их после разбора всей программы
+    void SetClasses(runtime::Closure classes);
+
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+private:
+    runtime::Closure m_classes;
+};
+
+/*
+ * Форматная строка f"x={p.x}, y={p.y}". Разбивка на части делается при разборе: literals - текст между
+ * подстановками (на один больше, чем slots), slots - выражения подстановок. Каждая подстановка
+ * преобразуется в строку как str(...), и результат собирается за один проход в буфер, размер которого
+ * взят из прошлого выполнения, без промежуточных объектов String
+ */
+class FormatString : public runtime::Executable {
+public:
+    FormatString(std::vector<std::string> literals, std::vector<std::unique_ptr<runtime::Executable>> slots);
+
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+private:
+    std::vector<std::string> m_literals;
+    std::vector<std::unique_ptr<runtime::Executable>> m_slots;
+    size_t m_literal_bytes = 0u;
+    size_t m_size_hint = 0u;
+};
+
 // Родительский класс Бинарная операция с аргументами lhs и rhs
 class BinaryOperation : public runtime::Executable {
 public:
     BinaryOperation(std::unique_ptr<runtime::Executable> lhs, std::unique_ptr<runtime::Executable> rhs) : m_lhs_stm(std::move(lhs)), m_rhs_stm(std::move(rhs)) {}
 
+    // site - номер точки наблюдения в профиле runtime::TypeFeedback (0 - точка не наблюдается),
+    // lhs_hint - вид левого операнда (runtime::TypeFeedback::ValueKind), единственный в прошлом запуске.
+    // По подсказке операция первым проверяет соответствующий вариант; результат от неё не зависит
+    void SetFeedbackSite(uint32_t site, uint8_t lhs_hint);
+
 protected:
+    void RecordOperands(const runtime::ObjectHolder& lhs, const runtime::ObjectHolder& rhs) const;
+
     std::unique_ptr<runtime::Executable> m_lhs_stm;
     std::unique_ptr<runtime::Executable> m_rhs_stm;
+    uint32_t m_site = 0u;
+    uint8_t m_lhs_hint = 0u;
 };
 
 // Возвращает результат операции + над аргументами lhs и rhs
@@ -309,29 +438,88 @@ class ClassDefinition : public runtime::Executable {
 public:
     // Гарантируется, что ObjectHolder содержит объект типа runtime::Class
     explicit ClassDefinition(runtime::ObjectHolder cls);
+    // attributes - атрибуты из тела класса: имя и выражение для значения, в порядке объявления
+    ClassDefinition(runtime::ObjectHolder cls, std::vector<std::pair<std::string, std::unique_ptr<runtime::Executable>>> attributes);
 
-    // Создаёт внутри closure новый объект, совпадающий с именем класса и значением, переданным в
-    // конструктор
+    // Вычисляет в closure значения атрибутов и записывает их в класс, затем создаёт внутри closure
+    // новый объект, совпадающий с именем класса и значением, переданным в конструктор
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 
 private:
     runtime::ObjectHolder m_class;
+    std::vector<std::pair<std::string, std::unique_ptr<runtime::Executable>>> m_attributes;
 };
 
-// Инструкция if <condition> <if_body> else <else_body>
+// Объявление функции верхнего уровня. Гарантируется, что ObjectHolder содержит объект типа runtime::Function
+class FunctionDefinition : public runtime::Executable {
+public:
+    explicit FunctionDefinition(runtime::ObjectHolder function);
+
+    // Создаёт внутри closure переменную с именем функции, как ClassDefinition - с именем класса
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+private:
+    runtime::ObjectHolder m_function;
+};
+
+// Инструкция if <condition> <if_body> [elif <condition> <body>]* [else <else_body>]
 class IfElse : public runtime::Executable {
 public:
+    // Условие и тело ветви if либо elif
+    using Arm = std::pair<std::unique_ptr<runtime::Executable>, std::unique_ptr<runtime::Executable>>;
+
     // Параметр else_body может быть равен nullptr
     IfElse(std::unique_ptr<runtime::Executable> condition, std::unique_ptr<runtime::Executable> if_body, std::unique_ptr<runtime::Executable> else_body);
+    // Условия проверяются по порядку в одном кадре, без вложенных IfElse
+    IfElse(std::vector<Arm> arms, std::unique_ptr<runtime::Executable> else_body);
 
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 
+    // Выполняет тело ветви index без проверки условий; index, равный ArmCount(), означает else
+    runtime::ObjectHolder ExecuteBranch(size_t index, runtime::Closure& closure, runtime::Context& context);
+
+    [[nodiscard]] size_t ArmCount() const {
+        return m_arms.size();
+    }
+
 private:
-    std::unique_ptr<runtime::Executable> m_condition;
-    std::unique_ptr<runtime::Executable> m_if_body;
+    std::vector<Arm> m_arms;
     std::unique_ptr<runtime::Executable> m_else_body;
 };
 
+/*
+ * Цепочка if/elif, в которой каждое условие - сравнение одной и той же переменной с константой,
+ * причём все константы целые либо все строковые: if x == 1: ... elif x == 2: ... else: ...
+ * Если значение переменной - Number (соответственно String), ветвь находится по таблице за O(1):
+ * плотной, если ключи лежат в узком диапазоне, иначе хеш-таблицей. Для значений других видов
+ * (экземпляров с __eq__, BigNumber, None) выполняется исходная цепочка chain, поэтому результат
+ * и ошибки сравнения не меняются. При повторе ключа побеждает первая ветвь, как и в цепочке.
+ */
+class Switch : public runtime::Executable {
+public:
+    // keys[i] - константа условия ветви i цепочки chain, все ключи - Number либо все - String
+    Switch(std::unique_ptr<VariableValue> subject, const std::vector<runtime::ObjectHolder>& keys, std::unique_ptr<IfElse> chain);
+
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+    // Самое короткое число ветвей, для которого Parser строит таблицу
+    static constexpr size_t MIN_ARMS = 4u;
+
+private:
+    // Номер ветви для ключа либо m_chain->ArmCount(), если ключа нет
+    [[nodiscard]] size_t FindNumber(int value) const;
+    [[nodiscard]] size_t FindString(const std::string& value) const;
+
+    std::unique_ptr<VariableValue> m_subject;
+    std::unique_ptr<IfElse> m_chain;
+    bool m_string_keys = false;
+    // Плотная таблица: m_dense[value - m_dense_base] - номер ветви
+    int m_dense_base = 0;
+    std::vector<uint32_t> m_dense;
+    std::unordered_map<int, uint32_t> m_numbers;
+    runtime::FlatStringMap<uint32_t> m_strings;
+};
+
 // Операция сравнения
 class Comparison : public BinaryOperation {
 public:
@@ -348,4 +536,17 @@ private:
     Comparator m_comparator;
 };
 
+// Проверка идентичности: lhs is rhs либо, если negated, lhs is not rhs.
+// Сравниваются адреса объектов, методы не вызываются; None равен только None.
+// Логические значения в Mython существуют в двух экземплярах по смыслу, поэтому Bool сравниваются по значению
+class Identity : public BinaryOperation {
+public:
+    Identity(std::unique_ptr<runtime::Executable> lhs, std::unique_ptr<runtime::Executable> rhs, bool negated);
+
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+private:
+    bool m_negated;
+};
+
 }  // namespace ast
\ No newline at end of file
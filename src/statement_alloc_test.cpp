@@ -0,0 +1,165 @@
+#include "statement.h"
+#include "test_runner_p.h"
+
+DEFINE_ALLOCATION_COUNTER_HOOKS
+
+using namespace std;
+
+namespace ast {
+
+using runtime::Closure;
+using runtime::ObjectHolder;
+
+namespace {
+
+// Контекст, вывод которого никуда не попадает и не занимает память
+struct NullContext : runtime::Context {
+    std::ostream& GetOutputStream() override {
+        return output;
+    }
+
+    std::ostream output{nullptr};
+};
+
+// Бюджеты выделений памяти на одно выполнение операции.
+// Если изменение увеличивает число выделений на горячем пути, тест падает;
+// если уменьшает - бюджет следует понизить до нового значения
+constexpr size_t INT_ADD_BUDGET = 1;
+// Бюджеты вызова метода с 0, 1, 2 и 3 аргументами
+constexpr size_t METHOD_CALL_BUDGETS[] = {1, 2, 2, 2};
+constexpr size_t FIELD_READ_BUDGET = 0;
+constexpr size_t FIELD_WRITE_BUDGET = 0;
+constexpr size_t COMPARISON_BUDGET = 0;
+constexpr size_t PRINT_NUMBER_BUDGET = 0;
+constexpr size_t STRINGIFY_BUDGET = 1;
+
+void Warmup(runtime::Executable& statement, Closure& closure, runtime::Context& context) {
+    // Первое выполнение может инициализировать статические данные, их не учитываем
+    statement.Execute(closure, context);
+}
+
+void TestAllocationHooksInstalled() {
+    ASSERT(AllocationCounter::IsHooked());
+    AllocationCounter counter;
+    auto ptr = make_unique<int>(1);
+    const size_t count = counter.Count();
+    const size_t bytes = counter.Bytes();
+    ASSERT_EQUAL(count, 1u);
+    ASSERT_EQUAL(bytes, sizeof(int));
+}
+
+// Выровненные и nothrow-формы operator new тоже считаются
+void TestAllocationHooksCoverAllForms() {
+    struct alignas(64) Wide {
+        char data[64];
+    };
+    AllocationCounter counter;
+    auto wide = make_unique<Wide>();
+    int* plain = new (std::nothrow) int(1);
+    delete plain;
+    void* raw = ::operator new(24u, std::align_val_t{32}, std::nothrow);
+    ::operator delete(raw, std::align_val_t{32});
+    const size_t count = counter.Count();
+    const size_t bytes = counter.Bytes();
+    ASSERT(reinterpret_cast<uintptr_t>(wide.get()) % alignof(Wide) == 0u);
+    ASSERT_EQUAL(count, 3u);
+    ASSERT_EQUAL(bytes, sizeof(Wide) + sizeof(int) + 24u);
+}
+
+void TestIntegerAddBudget() {
+    NullContext context;
+    Closure closure;
+    Add add(make_unique<NumericConst>(2), make_unique<NumericConst>(3));
+    Warmup(add, closure, context);
+    ASSERT_ALLOCATIONS_AT_MOST(add.Execute(closure, context), INT_ADD_BUDGET);
+}
+
+void TestMethodCallBudget() {
+    vector<runtime::Method> methods;
+    for (size_t arg_count = 0u; arg_count <= 3u; ++arg_count) {
+        runtime::Method method;
+        method.name = "m"s + to_string(arg_count);
+        for (size_t i = 0u; i < arg_count; ++i) {
+            method.formal_params.push_back("a"s + to_string(i));
+        }
+        method.body = make_unique<MethodBody>(make_unique<Return>(make_unique<None>()));
+        methods.push_back(std::move(method));
+    }
+    runtime::Class cls("Callee"s, std::move(methods), nullptr);
+    runtime::ClassInstance instance(cls);
+
+    NullContext context;
+    Closure closure{{"obj"s, ObjectHolder::Share(instance)}};
+    for (size_t arg_count = 0u; arg_count <= 3u; ++arg_count) {
+        vector<unique_ptr<runtime::Executable>> args;
+        for (size_t i = 0u; i < arg_count; ++i) {
+            args.push_back(make_unique<NumericConst>(static_cast<int>(i)));
+        }
+        MethodCall call(make_unique<VariableValue>("obj"s), "m"s + to_string(arg_count), std::move(args));
+        Warmup(call, closure, context);
+        ASSERT_ALLOCATIONS_AT_MOST(call.Execute(closure, context), METHOD_CALL_BUDGETS[arg_count]);
+    }
+}
+
+void TestFieldReadBudget() {
+    runtime::Class cls("Point"s, {}, nullptr);
+    runtime::ClassInstance instance(cls);
+    instance.Fields()["x"s] = ObjectHolder::Own(runtime::Number(1));
+
+    NullContext context;
+    Closure closure{{"p"s, ObjectHolder::Share(instance)}};
+    VariableValue read(vector<string>{"p"s, "x"s});
+    Warmup(read, closure, context);
+    ASSERT_ALLOCATIONS_AT_MOST(read.Execute(closure, context), FIELD_READ_BUDGET);
+}
+
+void TestFieldWriteBudget() {
+    runtime::Class cls("Point"s, {}, nullptr);
+    runtime::ClassInstance instance(cls);
+
+    NullContext context;
+    Closure closure{{"p"s, ObjectHolder::Share(instance)}};
+    FieldAssignment write(VariableValue{"p"s}, "x"s, make_unique<NumericConst>(5));
+    Warmup(write, closure, context);
+    ASSERT_ALLOCATIONS_AT_MOST(write.Execute(closure, context), FIELD_WRITE_BUDGET);
+}
+
+void TestComparisonBudget() {
+    NullContext context;
+    Closure closure;
+    Comparison less(runtime::Less, make_unique<NumericConst>(2), make_unique<NumericConst>(3));
+    Warmup(less, closure, context);
+    ASSERT_ALLOCATIONS_AT_MOST(less.Execute(closure, context), COMPARISON_BUDGET);
+}
+
+void TestPrintNumberBudget() {
+    NullContext context;
+    Closure closure;
+    Print print(make_unique<NumericConst>(12345));
+    Warmup(print, closure, context);
+    ASSERT_ALLOCATIONS_AT_MOST(print.Execute(closure, context), PRINT_NUMBER_BUDGET);
+}
+
+void TestStringifyBudget() {
+    NullContext context;
+    Closure closure;
+    Stringify str(make_unique<NumericConst>(12345));
+    Warmup(str, closure, context);
+    ASSERT_ALLOCATIONS_AT_MOST(str.Execute(closure, context), STRINGIFY_BUDGET);
+}
+
+}  // namespace
+
+void RunAllocationBudgetTests(TestRunner& tr) {
+    RUN_TEST(tr, ast::TestAllocationHooksInstalled);
+    RUN_TEST(tr, ast::TestAllocationHooksCoverAllForms);
+    RUN_TEST(tr, ast::TestIntegerAddBudget);
+    RUN_TEST(tr, ast::TestMethodCallBudget);
+    RUN_TEST(tr, ast::TestFieldReadBudget);
+    RUN_TEST(tr, ast::TestFieldWriteBudget);
+    RUN_TEST(tr, ast::TestComparisonBudget);
+    RUN_TEST(tr, ast::TestPrintNumberBudget);
+    RUN_TEST(tr, ast::TestStringifyBudget);
+}
+
+}  // namespace ast
@@ -234,6 +234,19 @@ void TestStringsAddition() {
     ASSERT(context.output.str().empty());
 }
 
+void TestStringsAdditionKeepsNoSpareCapacity() {
+    runtime::DummyContext context;
+
+    Add sum(make_unique<StringConst>(string(1000u, 'a')), make_unique<StringConst>(","s));
+
+    Closure empty;
+    const ObjectHolder result = sum.Execute(empty, context);
+    const string& value = result.TryAs<runtime::String>()->GetValue();
+    ASSERT_EQUAL(value.size(), 1001u);
+    // Результат хранится в объекте программы, запас буфера в нём занимал бы память до конца жизни строки
+    ASSERT(value.capacity() < 1100u);
+}
+
 void TestBadAddition() {
     runtime::DummyContext context;
 
@@ -418,6 +431,142 @@ void TestNot() {
     test_not(false);
 }
 
+void TestIdentity() {
+    Closure closure;
+    closure["a"s] = ObjectHolder::Own(runtime::Number(1));
+    closure["b"s] = ObjectHolder::Own(runtime::Number(1));
+    closure["alias"s] = closure.at("a"s);
+    closure["none"s] = ObjectHolder::None();
+    runtime::DummyContext context;
+
+    auto is = [&](unique_ptr<runtime::Executable> lhs, unique_ptr<runtime::Executable> rhs, bool negated) {
+        return runtime::IsTrue(Identity(std::move(lhs), std::move(rhs), negated).Execute(closure, context));
+    };
+    auto var = [](const string& name) {
+        return make_unique<VariableValue>(name);
+    };
+
+    ASSERT(is(var("a"s), var("alias"s), false));
+    ASSERT(!is(var("a"s), var("b"s), false));
+    ASSERT(is(var("a"s), var("b"s), true));
+    ASSERT(is(var("none"s), make_unique<None>(), false));
+    ASSERT(!is(var("a"s), make_unique<None>(), false));
+    ASSERT(is(var("a"s), make_unique<None>(), true));
+    ASSERT(is(make_unique<BoolConst>(runtime::Bool(true)), make_unique<BoolConst>(runtime::Bool(true)), false));
+    ASSERT(!is(make_unique<BoolConst>(runtime::Bool(true)), make_unique<BoolConst>(runtime::Bool(false)), false));
+}
+
+// Подстановки форматируются как str(...), в том числе через __str__ экземпляра
+void TestFormatString() {
+    Closure closure;
+    closure["n"s] = ObjectHolder::Own(runtime::Number(-42));
+    closure["s"s] = ObjectHolder::Own(runtime::String("text"s));
+    closure["big"s] = ObjectHolder::Own(runtime::BigNumber(runtime::BigInt::FromString("12345678901234567890"s)));
+    vector<runtime::Method> methods;
+    methods.push_back({"__str__"s, {}, make_unique<MethodBody>(make_unique<Return>(make_unique<StringConst>("Point"s)))});
+    runtime::Class cls("P"s, std::move(methods), nullptr);
+    closure["p"s] = ObjectHolder::Own(runtime::ClassInstance(cls));
+    runtime::DummyContext context;
+
+    vector<unique_ptr<runtime::Executable>> slots;
+    for (const string& name : {"n"s, "s"s, "big"s, "p"s}) {
+        slots.push_back(make_unique<VariableValue>(name));
+    }
+    slots.push_back(make_unique<None>());
+    slots.push_back(make_unique<BoolConst>(runtime::Bool(false)));
+    FormatString format({"n="s, ", s="s, " "s, " "s, " "s, ""s, "!"s}, std::move(slots));
+    const string expected = "n=-42, s=text 12345678901234567890 Point NoneFalse!"s;
+    ASSERT_EQUAL(format.Execute(closure, context).TryAs<runtime::String>()->GetValue(), expected);
+    // Повторное выполнение с подсказкой размера даёт тот же результат
+    closure["n"s] = ObjectHolder::Own(runtime::Number(7));
+    ASSERT_EQUAL(format.Execute(closure, context).TryAs<runtime::String>()->GetValue(), "n=7, s=text 12345678901234567890 Point NoneFalse!"s);
+    ASSERT(context.output.str().empty());
+}
+
+// Цепочка x == key_i: ветвь i возвращает 100 + i, else - -1
+unique_ptr<Switch> MakeSwitch(const vector<ObjectHolder>& keys) {
+    vector<IfElse::Arm> arms;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        unique_ptr<runtime::Executable> key;
+        if (const runtime::String* str = keys[i].TryAs<runtime::String>()) {
+            key = make_unique<StringConst>(runtime::String(str->GetValue()));
+        }
+        else {
+            key = make_unique<NumericConst>(keys[i].TryAs<runtime::Number>()->GetValue());
+        }
+        arms.emplace_back(make_unique<Comparison>(runtime::Equal, make_unique<VariableValue>("x"s), std::move(key)), make_unique<NumericConst>(100 + static_cast<int>(i)));
+    }
+    auto chain = make_unique<IfElse>(std::move(arms), make_unique<NumericConst>(-1));
+    return make_unique<Switch>(make_unique<VariableValue>("x"s), keys, std::move(chain));
+}
+
+int RunSwitch(Switch& node, ObjectHolder x) {
+    Closure closure;
+    closure["x"s] = std::move(x);
+    runtime::DummyContext context;
+    return node.Execute(closure, context).TryAs<runtime::Number>()->GetValue();
+}
+
+void TestSwitch() {
+    auto number = [](int value) {
+        return ObjectHolder::Own(runtime::Number(value));
+    };
+    auto text = [](const string& value) {
+        return ObjectHolder::Own(runtime::String(value));
+    };
+
+    // Плотная таблица; повтор ключа уходит в первую ветвь, как в цепочке
+    unique_ptr<Switch> dense = MakeSwitch({number(3), number(5), number(4), number(5), number(7)});
+    ASSERT_EQUAL(RunSwitch(*dense, number(3)), 100);
+    ASSERT_EQUAL(RunSwitch(*dense, number(5)), 101);
+    ASSERT_EQUAL(RunSwitch(*dense, number(7)), 104);
+    ASSERT_EQUAL(RunSwitch(*dense, number(6)), -1);
+    ASSERT_EQUAL(RunSwitch(*dense, number(2)), -1);
+    ASSERT_EQUAL(RunSwitch(*dense, number(-2147483647 - 1)), -1);
+
+    unique_ptr<Switch> sparse = MakeSwitch({number(-1000000), number(0), number(17), number(2147483647)});
+    ASSERT_EQUAL(RunSwitch(*sparse, number(-1000000)), 100);
+    ASSERT_EQUAL(RunSwitch(*sparse, number(2147483647)), 103);
+    ASSERT_EQUAL(RunSwitch(*sparse, number(1)), -1);
+
+    unique_ptr<Switch> strings = MakeSwitch({text("add"s), text("sub"s), text(""s), text("mul"s)});
+    ASSERT_EQUAL(RunSwitch(*strings, text("mul"s)), 103);
+    ASSERT_EQUAL(RunSwitch(*strings, text(""s)), 102);
+    ASSERT_EQUAL(RunSwitch(*strings, text("div"s)), -1);
+
+    // Значение другого вида проходит исходную цепочку и получает ту же ошибку сравнения
+    try {
+        RunSwitch(*dense, text("3"s));
+        ASSERT(false);
+    }
+    catch (const std::runtime_error&) {
+    }
+}
+
+// Аргументы вычисляются в окружении вызова, тело видит только параметры
+void TestFunctionCall() {
+    runtime::Function function("sub"s, {"a"s, "b"s});
+    function.SetBody(make_unique<MethodBody>(make_unique<Return>(make_unique<Sub>(make_unique<VariableValue>("a"s), make_unique<VariableValue>("b"s)))));
+    Closure closure;
+    closure["x"s] = ObjectHolder::Own(runtime::Number(10));
+    runtime::DummyContext context;
+
+    vector<unique_ptr<runtime::Executable>> args;
+    args.push_back(make_unique<VariableValue>("x"s));
+    args.push_back(make_unique<NumericConst>(3));
+    FunctionCall call(function, std::move(args));
+    ASSERT_EQUAL(call.Execute(closure, context).TryAs<runtime::Number>()->GetValue(), 7);
+    ASSERT_EQUAL(closure.size(), 1u);
+
+    ASSERT_EQUAL(function.Call({ObjectHolder::Own(runtime::Number(1)), ObjectHolder::Own(runtime::Number(2))}, context).TryAs<runtime::Number>()->GetValue(), -1);
+    try {
+        function.Call({}, context);
+        ASSERT(false);
+    }
+    catch (const std::runtime_error&) {
+    }
+}
+
 }  // namespace
 
 void RunUnitTests(TestRunner& tr) {
@@ -431,6 +580,7 @@ void RunUnitTests(TestRunner& tr) {
     RUN_TEST(tr, ast::TestStringify);
     RUN_TEST(tr, ast::TestNumbersAddition);
     RUN_TEST(tr, ast::TestStringsAddition);
+    RUN_TEST(tr, ast::TestStringsAdditionKeepsNoSpareCapacity);
     RUN_TEST(tr, ast::TestBadAddition);
     RUN_TEST(tr, ast::TestSuccessfulClassInstanceAdd);
     RUN_TEST(tr, ast::TestClassInstanceAddWithoutMethod);
@@ -441,6 +591,10 @@ void RunUnitTests(TestRunner& tr) {
     RUN_TEST(tr, ast::TestOr);
     RUN_TEST(tr, ast::TestAnd);
     RUN_TEST(tr, ast::TestNot);
+    RUN_TEST(tr, ast::TestIdentity);
+    RUN_TEST(tr, ast::TestFormatString);
+    RUN_TEST(tr, ast::TestFunctionCall);
+    RUN_TEST(tr, ast::TestSwitch);
 }
 
 }  // namespace ast
\ No newline at end of file
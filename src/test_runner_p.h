@@ -1,7 +1,10 @@
 #pragma once
 
+#include <atomic>
+#include <cstdlib>
 #include <iostream>
 #include <map>
+#include <new>
 #include <set>
 #include <sstream>
 #include <stdexcept>
@@ -107,6 +110,101 @@ private:
     int fail_count = 0;
 };
 
+namespace TestRunnerPrivate {
+inline std::atomic<size_t> allocation_count{0};
+inline std::atomic<size_t> allocation_bytes{0};
+inline bool allocation_hooks_installed = false;
+
+inline void* CountingAllocate(std::size_t size) {
+    if (void* ptr = std::malloc(size ? size : 1u)) {
+        allocation_count.fetch_add(1u, std::memory_order_relaxed);
+        allocation_bytes.fetch_add(size, std::memory_order_relaxed);
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+// aligned_alloc требует размер, кратный выравниванию
+inline void* CountingAllocate(std::size_t size, std::align_val_t alignment) {
+    const std::size_t align = static_cast<std::size_t>(alignment);
+    const std::size_t rounded = ((size ? size : 1u) + align - 1u) / align * align;
+    if (void* ptr = std::aligned_alloc(align, rounded)) {
+        allocation_count.fetch_add(1u, std::memory_order_relaxed);
+        allocation_bytes.fetch_add(size, std::memory_order_relaxed);
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+template <typename... Args>
+void* CountingAllocateNothrow(Args... args) noexcept {
+    try {
+        return CountingAllocate(args...);
+    }
+    catch (const std::bad_alloc&) {
+        return nullptr;
+    }
+}
+}  // namespace TestRunnerPrivate
+
+// Считает вызовы глобального operator new и запрошенные байты с момента создания счётчика.
+// Подсчёт работает, только если в одной из единиц трансляции программы использован
+// макрос DEFINE_ALLOCATION_COUNTER_HOOKS, иначе счётчик всегда возвращает нули
+class AllocationCounter {
+public:
+    AllocationCounter() : m_start_count(TestRunnerPrivate::allocation_count.load()), m_start_bytes(TestRunnerPrivate::allocation_bytes.load()) {}
+
+    [[nodiscard]] size_t Count() const {
+        return TestRunnerPrivate::allocation_count.load() - m_start_count;
+    }
+
+    [[nodiscard]] size_t Bytes() const {
+        return TestRunnerPrivate::allocation_bytes.load() - m_start_bytes;
+    }
+
+    [[nodiscard]] static bool IsHooked() {
+        return TestRunnerPrivate::allocation_hooks_installed;
+    }
+
+private:
+    size_t m_start_count;
+    size_t m_start_bytes;
+};
+
+// Подменяет все заменяемые формы глобальных operator new/delete считающими версиями.
+// Формы с std::nothrow_t и std::align_val_t заменяются тоже: иначе память из них освобождалась бы
+// подменённым delete (а санитайзер считает это ошибкой), а выровненные выделения не учитывались бы
+#define DEFINE_ALLOCATION_COUNTER_HOOKS                                                                                          \
+    static const bool __allocation_hooks_installed_private = (TestRunnerPrivate::allocation_hooks_installed = true);            \
+    void* operator new(std::size_t size) { return TestRunnerPrivate::CountingAllocate(size); }                                   \
+    void* operator new[](std::size_t size) { return TestRunnerPrivate::CountingAllocate(size); }                                 \
+    void* operator new(std::size_t size, std::align_val_t al) { return TestRunnerPrivate::CountingAllocate(size, al); }          \
+    void* operator new[](std::size_t size, std::align_val_t al) { return TestRunnerPrivate::CountingAllocate(size, al); }        \
+    void* operator new(std::size_t size, const std::nothrow_t&) noexcept {                                                     \
+        return TestRunnerPrivate::CountingAllocateNothrow(size);                                                               \
+    }                                                                                                                          \
+    void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {                                                   \
+        return TestRunnerPrivate::CountingAllocateNothrow(size);                                                               \
+    }                                                                                                                          \
+    void* operator new(std::size_t size, std::align_val_t al, const std::nothrow_t&) noexcept {                                \
+        return TestRunnerPrivate::CountingAllocateNothrow(size, al);                                                           \
+    }                                                                                                                          \
+    void* operator new[](std::size_t size, std::align_val_t al, const std::nothrow_t&) noexcept {                              \
+        return TestRunnerPrivate::CountingAllocateNothrow(size, al);                                                           \
+    }                                                                                                                          \
+    void operator delete(void* ptr) noexcept { std::free(ptr); }                                                                 \
+    void operator delete[](void* ptr) noexcept { std::free(ptr); }                                                               \
+    void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }                                                    \
+    void operator delete[](void* ptr, std::size_t) noexcept { std::free(ptr); }                                                  \
+    void operator delete(void* ptr, std::align_val_t) noexcept { std::free(ptr); }                                               \
+    void operator delete[](void* ptr, std::align_val_t) noexcept { std::free(ptr); }                                             \
+    void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept { std::free(ptr); }                                  \
+    void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept { std::free(ptr); }                                \
+    void operator delete(void* ptr, const std::nothrow_t&) noexcept { std::free(ptr); }                                          \
+    void operator delete[](void* ptr, const std::nothrow_t&) noexcept { std::free(ptr); }                                        \
+    void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { std::free(ptr); }                        \
+    void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { std::free(ptr); }
+
 #ifndef FILE_NAME
 #define FILE_NAME __FILE__
 #endif
@@ -163,4 +261,16 @@ private:
         Assert(false, __assert_private_os.str());               \
     }
 
+// Проверяет, что выражение expr выполняет не больше max_count выделений памяти
+#define ASSERT_ALLOCATIONS_AT_MOST(expr, max_count)                                                    \
+    {                                                                                                   \
+        AllocationCounter __allocation_counter_private;                                                 \
+        expr;                                                                                           \
+        const size_t __allocation_count_private = __allocation_counter_private.Count();                 \
+        std::ostringstream __assert_private_os;                                                         \
+        __assert_private_os << "Expression " #expr " made " << __allocation_count_private               \
+                            << " allocations, budget is " << (max_count) << " " FILE_NAME ":" << __LINE__; \
+        Assert(__allocation_count_private <= static_cast<size_t>(max_count), __assert_private_os.str()); \
+    }
+
 #define EOF_GUARD
\ No newline at end of file
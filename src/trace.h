@@ -0,0 +1,81 @@
+#pragma once
+
+/*
+ * Статические точки трассировки (USDT) интерпретатора Mython.
+ *
+ * Каждая точка компилируется в одну инструкцию nop и запись в секции ELF .note.stapsdt,
+ * по которой её находят bpftrace, perf, SystemTap и прочие инструменты:
+ *
+ *   bpftrace -e 'usdt:./mython:mython:method__entry { printf("%s.%s\n", str(arg0), str(arg1)); }'
+ *
+ * Если доступен <sys/sdt.h>, используются его макросы. Иначе на x86-64 и AArch64 записи
+ * формируются собственной реализацией в том же формате. На прочих платформах, а также при
+ * определённом MYTHON_DISABLE_TRACEPOINTS, точки трассировки не генерируют никакого кода.
+ *
+ * Точки провайдера mython:
+ *   method__entry(class_name, method_name), method__return(class_name, method_name)
+ *   instance__new(class_name)
+ *   parse__start(), parse__done()
+ *   output__flush()
+ */
+
+#if !defined(MYTHON_DISABLE_TRACEPOINTS) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define MYTHON_TRACEPOINTS_SYS_SDT 1
+#endif
+#endif
+
+#if defined(MYTHON_TRACEPOINTS_SYS_SDT)
+
+#define MYTHON_TRACEPOINTS_ENABLED 1
+#define MYTHON_TRACE0(name) STAP_PROBE(mython, name)
+#define MYTHON_TRACE1(name, arg1) STAP_PROBE1(mython, name, arg1)
+#define MYTHON_TRACE2(name, arg1, arg2) STAP_PROBE2(mython, name, arg1, arg2)
+
+#elif !defined(MYTHON_DISABLE_TRACEPOINTS) && defined(__ELF__) && (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__aarch64__))
+
+#define MYTHON_TRACEPOINTS_ENABLED 1
+
+// Аргументы описываются строкой "<размер>@<операнд>", см. формат stapsdt v3
+#define MYTHON_SDT_NOTE(provider, name, args)                                    \
+    "990: nop\n"                                                                 \
+    ".pushsection .note.stapsdt,\"?\",\"note\"\n"                                \
+    ".balign 4\n"                                                                \
+    ".4byte 992f-991f, 994f-993f, 3\n"                                           \
+    "991: .asciz \"stapsdt\"\n"                                                  \
+    "992: .balign 4\n"                                                           \
+    "993: .8byte 990b\n"                                                         \
+    ".8byte _.stapsdt.base\n"                                                    \
+    ".8byte 0\n"                                                                 \
+    ".asciz \"" #provider "\"\n"                                                 \
+    ".asciz \"" #name "\"\n"                                                     \
+    ".asciz \"" args "\"\n"                                                      \
+    "994: .balign 4\n"                                                           \
+    ".popsection\n"                                                              \
+    ".ifndef _.stapsdt.base\n"                                                   \
+    ".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n"      \
+    ".weak _.stapsdt.base\n"                                                     \
+    ".hidden _.stapsdt.base\n"                                                   \
+    "_.stapsdt.base: .space 1\n"                                                 \
+    ".size _.stapsdt.base, 1\n"                                                  \
+    ".popsection\n"                                                              \
+    ".endif\n"
+
+#define MYTHON_TRACE0(name) \
+    __asm__ __volatile__(MYTHON_SDT_NOTE(mython, name, ""))
+
+#define MYTHON_TRACE1(name, arg1) \
+    __asm__ __volatile__(MYTHON_SDT_NOTE(mython, name, "8@%0") :: "nor"((unsigned long long)(arg1)))
+
+#define MYTHON_TRACE2(name, arg1, arg2)                                   \
+    __asm__ __volatile__(MYTHON_SDT_NOTE(mython, name, "8@%0 8@%1")       \
+                         :: "nor"((unsigned long long)(arg1)), "nor"((unsigned long long)(arg2)))
+
+#else
+
+#define MYTHON_TRACE0(name) ((void)0)
+#define MYTHON_TRACE1(name, arg1) ((void)0)
+#define MYTHON_TRACE2(name, arg1, arg2) ((void)0)
+
+#endif
@@ -0,0 +1,88 @@
+#include "trace.h"
+#include "test_runner_p.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <set>
+#include <string>
+#include <utility>
+
+#if defined(MYTHON_TRACEPOINTS_ENABLED)
+#include <elf.h>
+#endif
+
+using namespace std;
+
+namespace trace {
+
+namespace {
+
+#if defined(MYTHON_TRACEPOINTS_ENABLED)
+
+template <typename T>
+T ReadAt(const string& image, size_t offset) {
+    T value{};
+    if (offset + sizeof(T) > image.size()) {
+        throw runtime_error("Truncated ELF image"s);
+    }
+    memcpy(&value, image.data() + offset, sizeof(T));
+    return value;
+}
+
+// Возвращает пары (провайдер, имя) всех записей stapsdt из секции .note.stapsdt
+set<pair<string, string>> ReadProbes(const string& path) {
+    ifstream in(path, ios::binary);
+    const string image((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+
+    const auto header = ReadAt<Elf64_Ehdr>(image, 0u);
+    if (memcmp(header.e_ident, ELFMAG, SELFMAG) != 0 || header.e_ident[EI_CLASS] != ELFCLASS64) {
+        throw runtime_error("Not an ELF64 image: "s + path);
+    }
+    const auto names_section = ReadAt<Elf64_Shdr>(image, header.e_shoff + header.e_shstrndx * sizeof(Elf64_Shdr));
+
+    set<pair<string, string>> probes;
+    for (size_t i = 0u; i < header.e_shnum; ++i) {
+        const auto section = ReadAt<Elf64_Shdr>(image, header.e_shoff + i * sizeof(Elf64_Shdr));
+        const string name = image.c_str() + names_section.sh_offset + section.sh_name;
+        if (name != ".note.stapsdt"s) {
+            continue;
+        }
+
+        size_t offset = section.sh_offset;
+        const size_t end = section.sh_offset + section.sh_size;
+        while (offset + sizeof(Elf64_Nhdr) <= end) {
+            const auto note = ReadAt<Elf64_Nhdr>(image, offset);
+            const size_t desc = offset + sizeof(Elf64_Nhdr) + ((note.n_namesz + 3u) & ~3u);
+            // Описание: адрес точки, адрес .stapsdt.base, адрес семафора, затем строки провайдера и имени
+            const char* provider = image.c_str() + desc + 3u * sizeof(uint64_t);
+            const char* probe = provider + strlen(provider) + 1u;
+            probes.emplace(provider, probe);
+            offset = desc + ((note.n_descsz + 3u) & ~3u);
+        }
+    }
+    return probes;
+}
+
+void TestProbesInElfNotes() {
+    const set<pair<string, string>> probes = ReadProbes("/proc/self/exe"s);
+    for (const string& name : {"method__entry"s, "method__return"s, "instance__new"s, "parse__start"s, "parse__done"s, "output__flush"s}) {
+        ASSERT_EQUAL(probes.count({"mython"s, name}), 1u);
+    }
+}
+
+#else
+
+void TestProbesInElfNotes() {
+    // Точки трассировки отключены для этой сборки, проверять нечего
+}
+
+#endif
+
+}  // namespace
+
+void RunTraceTests(TestRunner& tr) {
+    RUN_TEST(tr, trace::TestProbesInElfNotes);
+}
+
+}  // namespace trace